@@ -253,6 +253,8 @@ AS_IF([test "x$qthread_cv_atomic_CAS64" = "xyes"],
 	  	[if the compiler supports __sync_val_compare_and_swap on 64-bit ints])])
 AS_IF([test "x$qthread_cv_atomic_CAS" = "xyes"],
 	[AC_DEFINE([QTHREAD_ATOMIC_CAS],[1],[if the compiler supports __sync_val_compare_and_swap])])
+AS_IF([test "x$qthread_cv_atomic_CAS128" = "xyes"],
+	[AC_DEFINE([QTHREAD_ATOMIC_CAS128],[1],[if the cmpxchg16b instruction is available])])
 AS_IF([test "$qthread_cv_atomic_incr" = "yes" -a "$qt_cv_atomic_incr_works" != "no"],
 	[AC_DEFINE([QTHREAD_ATOMIC_INCR],[1],[if the compiler supports __sync_fetch_and_add])])
 ])
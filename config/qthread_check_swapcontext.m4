@@ -13,6 +13,35 @@ AC_ARG_ENABLE([fastcontext],
                                calls. If you run into bugs, you can disable it
                                on some systems to use the slower libc-provided
                                version.])])
+AC_ARG_ENABLE([jump-context],
+              [AS_HELP_STRING([--enable-jump-context],
+                              [switch contexts by saving only the
+                               callee-saved registers on the stack being left,
+                               and swapping stack pointers (x86-64 and AArch64
+                               only). Implies --enable-fastcontext.])])
+AC_ARG_ENABLE([jump-context-fpu],
+              [AS_HELP_STRING([--disable-jump-context-fpu],
+                              [do not preserve the floating point control
+                               words (MXCSR and x87 CW, or FPCR) across jump
+                               context switches. Only safe if no task changes
+                               its rounding mode or exception masks.])])
+AS_IF([test "x$enable_jump_context" = xyes],
+      [AC_MSG_CHECKING([whether we have a jump context swap for this system])
+       case "$host" in
+         x86_64-*|amd64-*|aarch64-*|arm64-*)
+           AC_MSG_RESULT([yes])
+           ;;
+         *)
+           AC_MSG_RESULT([no])
+           AC_MSG_ERROR([Do not have an implementation of jump contexts for $host])
+           ;;
+       esac
+       AC_DEFINE([QTHREAD_JUMP_CONTEXT], [1],
+                 [Switch contexts by saving callee-saved registers on the stack])
+       AS_IF([test "x$enable_jump_context_fpu" != xno],
+             [AC_DEFINE([QTHREAD_JUMP_CONTEXT_FPU], [1],
+                        [Preserve the floating point control words across jump context switches])])
+       enable_fastcontext=yes])
 AC_MSG_CHECKING([whether we have a fast context swap for this system])
 case "$host" in
   *-solaris2.8)
@@ -35,6 +64,10 @@ case "$host" in
   armv7l-*)
     qt_host_based_enable_fastcontext=yes
 	;;
+  aarch64-*|arm64-*)
+    # only jump contexts
+    qt_host_based_enable_fastcontext=$enable_jump_context
+	;;
   *)
     qt_host_based_enable_fastcontext=no
 	;;
@@ -0,0 +1,47 @@
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#ifdef HAVE_STDARG_H
+# include <stdarg.h> /* for the qt_makectxt prototype */
+#endif
+#include <stddef.h> /* for size_t, per C89 */
+
+#include "qthread-int.h"
+
+/* Jump contexts keep nothing but a stack pointer: qt_swapctxt() pushes the
+ * callee-saved registers (and, with QTHREAD_JUMP_CONTEXT_FPU, the floating
+ * point control words) onto the stack it leaves, saves its stack pointer,
+ * loads the other one, and pops them off again. Everything the ABI lets a
+ * call clobber is left to the compiler, which already assumes it is lost. */
+
+#define setcontext(u) qt_setmctxt(&(u)->mc)
+typedef struct mctxt mctxt_t;
+typedef struct uctxt uctxt_t;
+
+int qt_swapctxt(uctxt_t *,
+                uctxt_t *);
+void qt_makectxt(uctxt_t *, void (*)(void), int, ...);
+void qt_setmctxt(mctxt_t *);
+
+/* there is nothing to save ahead of time */
+static QINLINE int getcontext(uctxt_t *u)
+{
+    (void)u;
+    return 0;
+}
+
+struct mctxt {
+    void *sp; /* where the rest of the context was pushed */
+};
+
+struct uctxt {
+    mctxt_t mc;
+    struct {
+        uint8_t *ss_sp;
+        size_t   ss_size;
+        int      ss_flags;
+    } uc_stack;
+};
+
+/* vim:set expandtab: */
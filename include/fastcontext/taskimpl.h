@@ -6,7 +6,10 @@
 #endif
 #include "qthread/common.h"
 
-#if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_TILEPRO) || \
+#if defined(QTHREAD_JUMP_CONTEXT)
+# define NEEDJUMPMAKECONTEXT
+# include "jump-ucontext.h"
+#elif ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_TILEPRO) || \
     (QTHREAD_ASSEMBLY_ARCH == QTHREAD_TILEGX))
 # ifdef HAVE_STDARG_H
 #  include <stdarg.h>
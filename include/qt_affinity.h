@@ -96,6 +96,9 @@ void INTERNAL *qt_affinity_alloc_onnode(size_t bytes,
 void INTERNAL qt_affinity_mem_tonode(void  *addr,
                                      size_t bytes,
                                      int    node);
+/* the node (as for qt_affinity_mem_tonode()) whose memory holds addr, or -1
+ * if that is not known, e.g. because the page has not been touched yet */
+int INTERNAL qt_affinity_mem_node(const void *addr);
 void INTERNAL qt_affinity_free(void  *ptr,
                                size_t bytes);
 #endif
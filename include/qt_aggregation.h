@@ -0,0 +1,76 @@
+#ifndef QT_AGGREGATION_H
+#define QT_AGGREGATION_H
+
+#include <qthread/qthread.h>
+#include <qthread/performance.h>
+
+#include "qt_visibility.h"
+#include "qt_qthread_struct.h"
+#include "qt_threadqueues.h"
+
+/* Task aggregation.
+ *
+ * Tasks spawned with QTHREAD_SPAWN_AGGREGABLE are timed when they run, and
+ * a moving average of the run time is kept per task function ("call site").
+ * From it, the number of such tasks that together take about QT_AGG_GRAIN
+ * microseconds is learned. When a worker is handed an aggregable task, it
+ * takes up to that many more tasks of the same function off its own end of
+ * the deque (qt_threadqueue_dequeue_agg()) and runs them all as one task,
+ * through qlib->agg_f. Schedulers without a deque take none. */
+
+#define QT_AGG_MAX_BATCH 64 /* tasks per aggregate, at most */
+#define QT_AGG_SHARE     2  /* take no more than 1/QT_AGG_SHARE of a deque */
+
+/* t->preconds of an aggregate (QTHREAD_AGGREGATED) task */
+typedef struct qt_agg_batch_s {
+    int       count;
+    qthread_f f[QT_AGG_MAX_BATCH];
+    void     *arg[QT_AGG_MAX_BATCH];
+    void     *ret[QT_AGG_MAX_BATCH];
+} qt_agg_batch_t;
+
+#define QT_AGG_EXCLUDED (QTHREAD_FUTURE | QTHREAD_REAL_MCCOY | QTHREAD_UNSTEALABLE | \
+                         QTHREAD_HAS_ARGCOPY | QTHREAD_BIG_STRUCT |                   \
+                         QTHREAD_TEAM_LEADER | QTHREAD_TEAM_WATCHER |                 \
+                         QTHREAD_AGGREGATED | QTHREAD_NETWORK | QTHREAD_NODE_BOUND)
+#define QT_AGG_KEY (QTHREAD_AGGREGABLE | QTHREAD_SIMPLE | QTHREAD_RET_MASK)
+
+/* Could t head an aggregate? Tasks with a separately allocated argument
+ * copy, or that belong to a team, cannot be folded into another. */
+static QINLINE int qt_agg_eligible(const qthread_t *t)
+{   /*{{{*/
+    return (t->flags & (QTHREAD_AGGREGABLE | QT_AGG_EXCLUDED)) == QTHREAD_AGGREGABLE &&
+           t->thread_state == QTHREAD_STATE_NEW && t->rdata == NULL && t->preconds == NULL &&
+           t->team == NULL && t->target_shepherd == NO_SHEPHERD;
+} /*}}}*/
+
+/* May u run in the same aggregate as t (which is eligible)? u is freed when
+ * it joins, so its argument must not have been copied into it. */
+static QINLINE int qt_agg_compatible(const qthread_t *t,
+                                     const qthread_t *u)
+{   /*{{{*/
+    return u->f == t->f && qt_agg_eligible(u) && !(u->flags & QTHREAD_BIG_STRUCT) &&
+           (u->flags & QT_AGG_KEY) == (t->flags & QT_AGG_KEY) &&
+           u->priority == t->priority;
+} /*}}}*/
+
+/* How many of the len tasks in a deque one aggregate may take */
+static QINLINE int qt_agg_limit(int  max,
+                                long len)
+{   /*{{{*/
+    return (len / QT_AGG_SHARE < max) ? (int)(len / QT_AGG_SHARE) : max;
+} /*}}}*/
+
+void INTERNAL       qt_aggregation_subsystem_init(void);
+qthread_t INTERNAL *qt_agg_gather(qthread_t                *t,
+                                  qt_threadqueue_t         *q,
+                                  qt_threadqueue_private_t *qc);
+void INTERNAL       qt_agg_record(qthread_f f,
+                                  double    secs,
+                                  int       count);
+void INTERNAL       qt_agg_batch_free(qt_agg_batch_t *b);
+size_t INTERNAL     qt_agg_report(qtperf_agg_site_t *sites,
+                                  size_t             max);
+
+#endif // ifndef QT_AGGREGATION_H
+/* vim:set expandtab: */
@@ -14,10 +14,10 @@ void INTERNAL *qt_calloc(size_t nmemb, size_t size);
 
 void INTERNAL *qt_realloc(void *ptr, size_t size);
 
-void INTERNAL *qt_internal_aligned_alloc(size_t        alloc_size,
-                                              uint_fast16_t alignment);
-void INTERNAL qt_internal_aligned_free(void         *ptr,
-                                            uint_fast16_t alignment);
+void INTERNAL *qt_internal_aligned_alloc(size_t alloc_size,
+                                              size_t alignment);
+void INTERNAL qt_internal_aligned_free(void  *ptr,
+                                            size_t alignment);
 
 void INTERNAL qt_internal_alignment_init(void);
 
@@ -37,6 +37,7 @@
 # define QTHREAD_FASTLOCK_INIT(x)     tmc_sync_mutex_init(&(x))
 # define QTHREAD_FASTLOCK_INIT_PTR(x) tmc_sync_mutex_init((x))
 # define QTHREAD_FASTLOCK_LOCK(x)     tmc_sync_mutex_lock((x))
+# define QTHREAD_FASTLOCK_TRY(x)      (tmc_sync_mutex_trylock((x)) == 0)
 # define QTHREAD_FASTLOCK_UNLOCK(x)   tmc_sync_mutex_unlock((x))
 # define QTHREAD_FASTLOCK_DESTROY(x)
 # define QTHREAD_FASTLOCK_DESTROY_PTR(x)
@@ -57,10 +58,19 @@ void qt_spin_exclusive_unlock(qt_spin_exclusive_t *);
                                         while (val != (x)->exit) SPINLOCK_BODY(); /* spin waiting for my turn */ }
 # define QTHREAD_FASTLOCK_UNLOCK(x)   do { COMPILER_FENCE; \
                                            (x)->exit++; /* allow next guy's turn */ } while (0)
+# define QTHREAD_FASTLOCK_TRY(x)      qt_spin_exclusive_try((x))
 # define QTHREAD_FASTLOCK_DESTROY(x)
 # define QTHREAD_FASTLOCK_DESTROY_PTR(x)
 # define QTHREAD_FASTLOCK_TYPE        qt_spin_exclusive_t
 # define QTHREAD_FASTLOCK_INITIALIZER (qt_spin_exclusive_t) {0, 0 }
+
+/* take the next ticket only if it would be served immediately */
+static inline int qt_spin_exclusive_try(qt_spin_exclusive_t *x)
+{
+    const aligned_t ex = x->exit;
+
+    return (x->enter == ex) && (qthread_cas(&x->enter, ex, ex + 1) == ex);
+}
 #elif defined(HAVE_PTHREAD_SPIN_INIT) && !defined(QTHREAD_OVERSUBSCRIPTION)
 # include <pthread.h>
 # define QTHREAD_FASTLOCK_ATTRVAR
@@ -69,6 +79,7 @@ void qt_spin_exclusive_unlock(qt_spin_exclusive_t *);
 # define QTHREAD_FASTLOCK_INIT_PTR(x)    pthread_spin_init((x), PTHREAD_PROCESS_PRIVATE)
 # define QTHREAD_FASTLOCK_LOCK(x)        pthread_spin_lock((x))
 # define QTHREAD_FASTLOCK_UNLOCK(x)      pthread_spin_unlock((x))
+# define QTHREAD_FASTLOCK_TRY(x)         (pthread_spin_trylock((x)) == 0)
 # define QTHREAD_FASTLOCK_DESTROY(x)     pthread_spin_destroy(&(x))
 # define QTHREAD_FASTLOCK_DESTROY_PTR(x) pthread_spin_destroy((x))
 # define QTHREAD_FASTLOCK_TYPE        pthread_spinlock_t
@@ -88,6 +99,7 @@ extern pthread_mutexattr_t _fastlock_attr;
 # define QTHREAD_FASTLOCK_INIT_PTR(x)    pthread_mutex_init((x), &_fastlock_attr)
 # define QTHREAD_FASTLOCK_LOCK(x)        pthread_mutex_lock((x))
 # define QTHREAD_FASTLOCK_UNLOCK(x)      pthread_mutex_unlock((x))
+# define QTHREAD_FASTLOCK_TRY(x)         (pthread_mutex_trylock((x)) == 0)
 # define QTHREAD_FASTLOCK_DESTROY(x)     pthread_mutex_destroy(&(x))
 # define QTHREAD_FASTLOCK_DESTROY_PTR(x) pthread_mutex_destroy((x))
 # define QTHREAD_FASTLOCK_TYPE        pthread_mutex_t
@@ -5,6 +5,10 @@
 #include "qt_hash.h" /* for qt_key_t */
 #include "qt_qthread_t.h"
 #include "qt_filters.h" /* for filter_code */
+#include <qthread/performance.h> /* for qtperf_feb_stripe_t */
+
+/* the most locking stripes that QT_LOCKING_STRIPES may ask for */
+#define QTHREAD_MAX_LOCKING_STRIPES (1 << 16)
 
 typedef void (*qt_feb_callback_f)(qt_key_t     addr,
                                   qthread_f    f,
@@ -28,6 +32,10 @@ int INTERNAL qthread_readFF_nb(aligned_t *restrict const       dest,
 int INTERNAL qthread_readFE_nb(aligned_t *restrict const       dest,
                                const aligned_t *restrict const src);
 int INTERNAL qthread_check_feb_preconds(qthread_t *t);
+void INTERNAL qt_feb_word_release(qt_feb_word_t *w);
+void INTERNAL qt_feb_many_release(qthread_t *t);
+size_t INTERNAL qt_feb_stripe_report(qtperf_feb_stripe_t *stripes,
+                                     size_t               max);
 
 void API_FUNC qthread_feb_callback(qt_feb_callback_f cb,
                                    void             *arg);
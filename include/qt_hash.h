@@ -127,6 +127,17 @@ void INTERNAL qt_hash_lock(qt_hash h);
  */
 void INTERNAL qt_hash_unlock(qt_hash h);
 
+/*!
+ * @fn qt_hash_lock_stats(qt_hash h,
+ *                        size_t *acquisitions,
+ *                        size_t *contended)
+ * @brief Report how many times the hash map's lock has been taken, and how
+ *	many of those times it was already held by someone else.
+ */
+void INTERNAL qt_hash_lock_stats(qt_hash h,
+                                 size_t *acquisitions,
+                                 size_t *contended);
+
 #ifdef __cplusplus
 }
 #endif
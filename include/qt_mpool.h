@@ -18,5 +18,8 @@ void qt_mpool_destroy(qt_mpool pool);
 
 void qt_mpool_subsystem_init(void);
 
+/* items freed on a node other than the one they were allocated for */
+size_t qt_mpool_remote_frees(void);
+
 #endif // ifndef QT_MPOOL_H
 /* vim:set expandtab: */
@@ -0,0 +1,93 @@
+#ifndef QT_PARKING_H
+#define QT_PARKING_H
+
+#include <stddef.h> /* for size_t */
+#ifndef QTHREAD_PARK_FUTEX
+# include <pthread.h>
+#endif
+
+#include <qthread/qthread.h>
+
+#include "qt_visibility.h"
+
+/* Idle-worker parking.
+ *
+ * A parking lot is an "eventcount": a 32-bit epoch (the futex word on Linux)
+ * and a count of workers that intend to sleep. An idle worker parks in three
+ * steps:
+ *
+ *     key = qt_park_prepare(&lot);
+ *     if (<queue still empty>) { qt_park_wait(&lot, key); }
+ *     else                     { qt_park_cancel(&lot); }
+ *
+ * and every enqueue calls qt_park_notify() after the new task is visible.
+ * Because prepare() announces the waiter before the final emptiness check
+ * and notify() publishes the task before looking for waiters, either the
+ * waiter sees the task or the notifier sees the waiter; in the latter case
+ * the epoch is bumped so a wait() that has not yet started returns at once.
+ * When nobody is parked, notify() costs a fence and a load: no syscall, no
+ * lock.
+ *
+ * Workers spin for qt_park_spincount fruitless polls (QT_SPINCOUNT) before
+ * parking. */
+typedef struct {
+    uint32_t  epoch;   /* bumped by every wakeup */
+    aligned_t waiters; /* workers between prepare() and the end of wait() */
+#ifndef QTHREAD_PARK_FUTEX
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+#endif
+} qt_parking_lot_t;
+
+extern unsigned long qt_park_spincount;
+extern aligned_t     qt_parked_workers; /* sum of waiters over all lots */
+
+void INTERNAL qt_parking_subsystem_init(void);
+void INTERNAL qt_parking_init(qt_parking_lot_t *lot);
+void INTERNAL qt_parking_destroy(qt_parking_lot_t *lot);
+void INTERNAL qt_park_wait(qt_parking_lot_t *lot,
+                           uint32_t          key);
+void INTERNAL qt_park_wake(qt_parking_lot_t *lot,
+                           int               all);
+int INTERNAL  qt_park_notify_thief(size_t lot_offset);
+
+static QINLINE uint32_t qt_park_prepare(qt_parking_lot_t *lot)
+{   /*{{{*/
+    (void)qthread_incr(&lot->waiters, 1);
+    (void)qthread_incr(&qt_parked_workers, 1);
+    MACHINE_FENCE;
+    return lot->epoch;
+} /*}}}*/
+
+static QINLINE void qt_park_cancel(qt_parking_lot_t *lot)
+{   /*{{{*/
+    (void)qthread_incr(&lot->waiters, -1);
+    (void)qthread_incr(&qt_parked_workers, -1);
+} /*}}}*/
+
+/* Wake one (or, if all is set, every) worker parked on lot. Returns nonzero
+ * if there was anyone to wake. */
+static QINLINE int qt_park_notify(qt_parking_lot_t *lot,
+                                  int               all)
+{   /*{{{*/
+    MACHINE_FENCE;
+    if (lot->waiters) {
+        qt_park_wake(lot, all);
+        return 1;
+    }
+    return 0;
+} /*}}}*/
+
+/* For work-stealing schedulers: new work on q can be run by any idle
+ * worker, so if nobody is parked on q's own lot wake the nearest idle thief.
+ * lot_offset is offsetof() the lot within the scheduler's qt_threadqueue_t. */
+static QINLINE void qt_park_notify_stealable(qt_parking_lot_t *lot,
+                                             size_t            lot_offset)
+{   /*{{{*/
+    if (!qt_park_notify(lot, 0) && qt_parked_workers) {
+        (void)qt_park_notify_thief(lot_offset);
+    }
+} /*}}}*/
+
+#endif // ifndef QT_PARKING_H
+/* vim:set expandtab: */
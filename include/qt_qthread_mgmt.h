@@ -6,6 +6,7 @@
 
 void INTERNAL       qthread_thread_free(qthread_t *t);
 qthread_t INTERNAL *qthread_internal_self(void);
+void INTERNAL       qthread_run_inline(qthread_t *t);
 
 #endif
 /* vim:set expandtab: */
@@ -32,14 +32,15 @@
 #define QTHREAD_AGGREGABLE       (1 << 10)
 #define QTHREAD_AGGREGATED       (1 << 11)
 #define QTHREAD_NETWORK          (1 << 12)
-#define QTHREAD_RESERVED_FLAG3   (1 << 13)
-#define QTHREAD_RESERVED_FLAG2   (1 << 14)
-#define QTHREAD_RESERVED_FLAG1   (1 << 15)
+#define QTHREAD_LAZY             (1 << 13)
+#define QTHREAD_LAZY_PARENT      (1 << 14)
+#define QTHREAD_NODE_BOUND       (1 << 15) /* only stolen by workers near target_shepherd */
 
 #define QTHREAD_RET_MASK (QTHREAD_RET_IS_SYNCVAR | QTHREAD_RET_IS_SINC)
 
 struct qthread_runtime_data_s {
     void         *stack;           /* the thread's stack */
+    size_t        stack_size;      /* in bytes; see qthread_t.stack_class */
     qt_context_t  context;         /* the context switch info */
     qt_context_t *return_context;  /* context of parent shepherd */
 
@@ -47,14 +48,19 @@ struct qthread_runtime_data_s {
      * context swapping */
     union {
         qthread_addrstat_t       *addr;
+        qt_feb_word_t            *word;
+        aligned_t                *pending; /* see qthread_readFF_many() */
         qt_blocking_queue_node_t *io;
         qthread_t                *thread;
         qthread_queue_t           queue;
+        struct qt_timer_s        *timer;
     } blockedon;
     qthread_shepherd_t *shepherd_ptr;    /* the shepherd we run on */
     unsigned            tasklocal_size;
     int                 criticalsect; /* critical section depth */
+    unsigned            inline_depth; /* tasks running inline on this stack; see qt_touch.h */
     qt_barrier_t       *barrier;      /* add to allow barriers to be stacked/nested parallelism - akp 10/16/12 */
+    void               *retired_arg;  /* an argument copy that qthread_replace() could not free yet */
 
 #ifdef QTHREAD_USE_VALGRIND
     unsigned int valgrind_stack_id;
@@ -78,13 +84,19 @@ struct qthread_s {
     qt_team_t                     *team; /* reference to task team */
     /* preconditions for data-dependent tasks */
     void                          *preconds;
+#ifdef QTHREAD_DEADLINES
+    double                         deadline; /* absolute qtimer_wtime(), or 0 for none; costs the cacheline, so EDF builds only */
+#endif
 
     unsigned int               thread_id;
     qthread_shepherd_id_t      target_shepherd; /* the shepherd we'd rather run on; set to NO_SHEPHERD unless the thread either migrated or was spawned to a specific destination (aka the programmer expressed a desire for this thread to be somewhere) */
     uint16_t                   flags;           /* may not need all bits */
-    uint8_t                    thread_state : 4;
+    uint8_t                    thread_state : 5;
+    uint8_t                    priority     : 3; /* scheduling band; see QTHREAD_SPAWN_PRIORITY() */
+    uint8_t                    stack_class;      /* see QTHREAD_SPAWN_STACK() */
+    uint8_t                    data_class;       /* see QTHREAD_DATA_CLASSES */
 
-    Q_ALIGNED(8) uint8_t data[]; /* this is where we stick argcopy and tasklocal data */
+    Q_ALIGNED(8) uint8_t data[]; /* this is where we stick tasklocal and argcopy data */
 };
 
 #endif // ifndef QT_QTHREAD_STRUCT_H
@@ -3,4 +3,11 @@
 
 typedef struct qthread_s qthread_t;
 
+/* qthread_t comes in size classes by how much data[] it has room for: class
+ * 0 holds just the task-local area, classes 1 through 4 are 64 << (c-1)
+ * bytes, and the last holds an argument of up to qthread_argcopy_size bytes.
+ * The task-local area is always at the start of data[], and a copied
+ * argument follows it, at qthread_argcopy_offset. */
+#define QTHREAD_DATA_CLASSES 6
+
 #endif
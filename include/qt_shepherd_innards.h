@@ -44,9 +44,16 @@ struct qthread_worker_s {
     struct qthread_s        **nostealbuffer;
     struct qthread_s        **stealbuffer;
     qthread_t                *current;
+    qthread_t                *handoff;     /* woken task to switch to directly, see qthread_internal_handoff() */
+    qthread_t                *swapped_out; /* task that switched to current, not yet made ready */
     qthread_worker_id_t       unique_id;
     qthread_worker_id_t       worker_id;
     qthread_worker_id_t       packed_worker_id;
+    size_t                    park_count; /* times this worker went to sleep while idle */
+    size_t                    wake_count; /* ... and was woken by an enqueue */
+#ifdef QTHREAD_DEADLINES
+    qthread_lateness_t        lateness;   /* deadline tasks finished here */
+#endif
 #ifdef QTHREAD_PERFORMANCE
     struct qtperfdata_s*             performance_data;
 #endif
@@ -69,11 +76,13 @@ struct qthread_shepherd_s {
     uintptr_t             QTHREAD_CASLOCK(active);
     /* affinity information */
     unsigned int          node;  /* whereami */
+    int                   mem_node; /* the memory node (as for qt_affinity_mem_node()) it runs on, or -1 */
 #ifdef QTHREAD_HAVE_LGRP
     unsigned int          lgrp;
 #endif
     unsigned int          *shep_dists;
     qthread_shepherd_id_t *sorted_sheplist;
+    qthread_shepherd_id_t  num_near_sheps; /* leading entries of sorted_sheplist in the nearest distance class */
     unsigned int           stealing; /* True when a worker is in the steal (attempt) process OR if stealing disabled*/
 #ifdef QTHREAD_OMP_AFFINITY
     unsigned int           stealing_mode; /* Specifies when a shepherd may steal */
@@ -146,6 +155,9 @@ qthread_shepherd_t INTERNAL *qthread_find_active_shepherd(qthread_shepherd_id_t
 
 void qthread_back_to_master(qthread_t *t);
 void qthread_back_to_master2(qthread_t *t);
+int  qthread_internal_handoff_offer(qthread_t          *waiter,
+                                    qthread_shepherd_t *shep);
+void qthread_internal_handoff(void);
 
 #endif // ifndef QT_SHEPHERD_INNARDS_H
 /* vim:set expandtab: */
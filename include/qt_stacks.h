@@ -0,0 +1,40 @@
+#ifndef QT_STACKS_H
+#define QT_STACKS_H
+
+#include <stddef.h> /* for size_t */
+
+#include "qt_visibility.h"
+
+/* Task stacks.
+ *
+ * Stacks are carved out of large regions of address space reserved with
+ * mmap(), QT_STACK_REGION_SLOTS stacks (or QT_STACK_REGION_BYTES, whichever
+ * is less) at a time, so that only the pages tasks actually touch are ever
+ * resident. Each stack size class (see QTHREAD_SPAWN_STACK()) has regions
+ * and free lists of its own. With QTHREAD_GUARD_PAGES, every slot is laid
+ * out as
+ *
+ *   [guard page][stack][upper guard page][runtime data]
+ *
+ * or else as [stack][runtime data], where the runtime data shares the top
+ * page of the stack, and only the region as a whole starts with a guard
+ * page. The guard pages are protected once, when the region is reserved;
+ * if that (or the mmap()) fails, the pool counts as exhausted until a stack
+ * is freed, and spawns of tasks that need a stack fail meanwhile. A freed
+ * stack stays "warm" (untouched) on its shepherd's free list while that
+ * list is short; past that, the pages below its top one are given back to
+ * the OS with madvise() before it is listed as "cold". */
+
+#define QT_STACK_REGION_SLOTS 256                 /* stacks reserved at a time */
+#define QT_STACK_REGION_BYTES (64 * 1024 * 1024UL) /* but no more than this */
+
+void INTERNAL   qt_stacks_subsystem_init(int guard);
+void INTERNAL  *qt_stack_alloc(unsigned stack_class);
+void INTERNAL   qt_stack_free(void    *stack,
+                              unsigned stack_class);
+int INTERNAL    qt_stacks_exhausted(void);
+size_t INTERNAL qt_stacks_reserved(void);
+size_t INTERNAL qt_stacks_resident(void);
+
+#endif // ifndef QT_STACKS_H
+/* vim:set expandtab: */
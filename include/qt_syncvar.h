@@ -26,6 +26,8 @@ int INTERNAL qthread_syncvar_readFF_nb(uint64_t *restrict const  dest,
                                        syncvar_t *restrict const src);
 int INTERNAL qthread_syncvar_readFE_nb(uint64_t *restrict const  dest,
                                        syncvar_t *restrict const src);
+int INTERNAL qthread_syncvar_precond(syncvar_t *src,
+                                     qthread_t *t);
 
 void API_FUNC qthread_syncvar_callback(qt_syncvar_callback_f cb,
                                        void                 *arg);
@@ -30,6 +30,11 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
                                      qthread_t *restrict        t);
 void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
                                              qthread_t *restrict        t);
+/* Enqueue the n tasks in t at the tail of q, as one operation where the
+ * queue allows it (see qthread_spawn_bulk()). */
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n);
 void INTERNAL qt_threadqueue_enqueue_cache(qt_threadqueue_t         *q,
                                            qt_threadqueue_private_t *cache);
 int INTERNAL qt_threadqueue_private_enqueue(qt_threadqueue_private_t *restrict pq,
@@ -54,9 +59,19 @@ void INTERNAL qthread_steal_enable(void);
 void INTERNAL qthread_steal_disable(void);
 void INTERNAL qthread_cas_steal_stat(void);
 
-/* Functions for work stealing functionality */
+/* Lazy task creation: take the not yet started task that will fill value
+ * off the calling worker's end of q (see qt_touch.h), or return NULL. */
 qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *q,
                                                     void             *value);
+
+/* Task aggregation: take up to max tasks that can run in one aggregate with
+ * t (see qt_aggregation.h) off the calling worker's end of q. Returns how
+ * many were stored in batch. */
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max);
 enum threadqueue_policy {
     THREADQUEUE_POLICY_FALSE = 0,
     THREADQUEUE_POLICY_TRUE  = 1,
@@ -16,6 +16,9 @@ typedef enum threadstate {
     QTHREAD_STATE_TERMINATED,           /* thread function returned */
     QTHREAD_STATE_MIGRATING,            /* thread needs to be moved, otherwise ready-to-run */
     QTHREAD_STATE_SYSCALL,              /* thread performing external blocking operation */
+    QTHREAD_STATE_SLEEPING,             /* insert me into a timer wheel */
+    QTHREAD_STATE_FEB_WORD_BLOCKED,     /* waiting for a qt_feb_word_t */
+    QTHREAD_STATE_FEB_MANY_BLOCKED,     /* waiting for several febs */
     QTHREAD_STATE_ILLEGAL,              /* illegal state */
     QTHREAD_STATE_TERM_SHEP,            /* special flag to terminate the shepherd */
     QTHREAD_STATE_NUM_STATES            /* tell performance data how many states there are */
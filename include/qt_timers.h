@@ -0,0 +1,31 @@
+#ifndef QT_TIMERS_H
+#define QT_TIMERS_H
+
+#include <qthread/qthread.h>
+
+#include "qt_visibility.h"
+
+/* Timed tasks (qthread_fork_after(), qthread_fork_periodic(), and
+ * qthread_sleep()) wait on a hierarchical timer wheel owned by each
+ * shepherd. The wheel is advanced by that shepherd's workers: between tasks
+ * in qthread_master(), and by idle workers, which bound their parking time
+ * by the next expiry (see qt_park_wait()). */
+struct qt_timer_s;
+struct qthread_shepherd_s;
+
+extern aligned_t qt_timers_armed; /* timers waiting in any wheel */
+
+void INTERNAL   qt_timers_subsystem_init(void);
+void INTERNAL   qt_timer_sleep(struct qthread_shepherd_s *shep,
+                               struct qt_timer_s         *tm);
+int INTERNAL    qt_timers_run(struct qthread_shepherd_s *shep);
+double INTERNAL qt_timers_timeout(struct qthread_shepherd_s *shep);
+
+/* Fire the timers of shep that are due. Returns the number fired. */
+static QINLINE int qt_timers_poll(struct qthread_shepherd_s *shep)
+{   /*{{{*/
+    return qt_timers_armed ? qt_timers_run(shep) : 0;
+} /*}}}*/
+
+#endif // ifndef QT_TIMERS_H
+/* vim:set expandtab: */
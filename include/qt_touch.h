@@ -1,8 +1,29 @@
-#ifndef QT_SYNCVAR_OPERATIONS_H
-#define QT_SYNCVAR_OPERATIONS_H
+#ifndef QT_TOUCH_H
+#define QT_TOUCH_H
 
-#include "qthread/qthread.h"
+#include "qt_visibility.h"
+#include "qt_qthread_struct.h"
 
-void qthread_run_needed_task(syncvar_t * value);
+/* Lazy task creation.
+ *
+ * A task spawned with QTHREAD_SPAWN_LAZY is queued like any other, so that
+ * an idle worker may steal it and run it on a stack of its own. When the
+ * task that spawned it joins on its return value before that happens, the
+ * joiner "touches" it instead: takes it back off its own shepherd's queue
+ * (qt_threadqueue_dequeue_specific()) and runs it to completion on its own
+ * stack, without a context switch. */
+
+#define QT_TOUCH_WINDOW 8 /* queue entries searched for the task, at most */
+
+/* May t be run by the task that joins on value? */
+static QINLINE int qt_touch_runnable(const qthread_t *t,
+                                     const void      *value)
+{   /*{{{*/
+    return t->ret == value && (t->flags & QTHREAD_LAZY) &&
+           t->thread_state == QTHREAD_STATE_NEW && t->rdata == NULL;
+} /*}}}*/
+
+int INTERNAL qthread_run_needed_task(void *value);
 
 #endif
+/* vim:set expandtab: */
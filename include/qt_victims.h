@@ -0,0 +1,102 @@
+#ifndef QT_VICTIMS_H
+#define QT_VICTIMS_H
+
+#include "qt_visibility.h"
+#include "qthread_innards.h" /* for qlib */
+#include "qt_shepherd_innards.h"
+
+/* Hierarchical victim selection, shared by the work-stealing schedulers.
+ *
+ * Thieves look for work in rings of increasing distance so that stolen tasks
+ * keep their working set in nearby caches:
+ *
+ *   QT_VICTIM_LOCAL  - the thief's own shepherd, i.e. the other workers that
+ *                      share its cache (only useful to schedulers that keep
+ *                      per-worker queues)
+ *   QT_VICTIM_NODE   - shepherds in the nearest distance class according to
+ *                      shep_dists (normally those on the same NUMA node)
+ *   QT_VICTIM_REMOTE - every other shepherd, nearest first
+ *
+ * Each ring is swept QT_STEAL_RETRIES_{LOCAL,NODE,REMOTE} times before the
+ * thief moves outward. Within the NODE ring, where every victim is equally
+ * far away, thieves start at an offset derived from their worker id so they
+ * do not all pile onto the same victim. */
+enum qt_victim_level {
+    QT_VICTIM_LOCAL = 0,
+    QT_VICTIM_NODE,
+    QT_VICTIM_REMOTE,
+    QT_VICTIM_LEVELS
+};
+
+typedef struct {
+    const qthread_shepherd_t *thief;
+    qthread_shepherd_id_t     pos;    /* position within the current level */
+    qthread_shepherd_id_t     offset; /* rotates the start of the NODE ring */
+    uint8_t                   level;
+    uint8_t                   pass;   /* completed sweeps of the current level */
+} qt_victim_iter_t;
+
+extern unsigned int qt_victim_retries[QT_VICTIM_LEVELS];
+
+void INTERNAL qt_victims_init(void);
+
+static QINLINE void qt_victim_iter_init(qt_victim_iter_t         *it,
+                                        const qthread_shepherd_t *thief,
+                                        qthread_worker_id_t       thief_worker,
+                                        int                       include_local)
+{   /*{{{*/
+    it->thief  = thief;
+    it->pos    = 0;
+    it->offset = (qthread_shepherd_id_t)thief_worker;
+    it->level  = include_local ? QT_VICTIM_LOCAL : QT_VICTIM_NODE;
+    it->pass   = 0;
+} /*}}}*/
+
+/* Returns the next victim shepherd, or NO_SHEPHERD once every ring has been
+ * swept. it->level tells the caller which ring the victim came from. */
+static QINLINE qthread_shepherd_id_t qt_victim_next(qt_victim_iter_t *it)
+{   /*{{{*/
+    const qthread_shepherd_t *thief = it->thief;
+
+    while (it->level < QT_VICTIM_LEVELS) {
+        qthread_shepherd_id_t begin, len;
+
+        switch (it->level) {
+            case QT_VICTIM_LOCAL:
+                begin = 0;
+                len   = 1;
+                break;
+            case QT_VICTIM_NODE:
+                begin = 0;
+                len   = thief->num_near_sheps;
+                break;
+            default:
+                begin = thief->num_near_sheps;
+                len   = qlib->nshepherds - 1 - thief->num_near_sheps;
+                break;
+        }
+        if ((it->pass < qt_victim_retries[it->level]) && (it->pos < len)) {
+            qthread_shepherd_id_t p = it->pos++;
+            switch (it->level) {
+                case QT_VICTIM_LOCAL:
+                    return thief->shepherd_id;
+
+                case QT_VICTIM_NODE:
+                    return thief->sorted_sheplist[begin + (p + it->offset) % len];
+
+                default:
+                    return thief->sorted_sheplist[begin + p];
+            }
+        }
+        it->pos = 0;
+        if ((len > 0) && (++it->pass < qt_victim_retries[it->level])) {
+            continue;
+        }
+        it->pass = 0;
+        it->level++;
+    }
+    return NO_SHEPHERD;
+} /*}}}*/
+
+#endif // ifndef QT_VICTIMS_H
+/* vim:set expandtab: */
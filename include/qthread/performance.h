@@ -616,6 +616,93 @@ void qtperf_piggyback_state(qtperfdata_t* source_data, qtperfid_t trigger_state,
  */
 qtperfdata_t* qtperf_get_qthread_data(void);
 
+//--------------- TASK AGGREGATION ----------------------------------
+/** qtperf_agg_site_t reports what the library has learned about one
+ *  task function spawned with QTHREAD_SPAWN_AGGREGABLE. The library
+ *  times such tasks and batches as many of them into one aggregate
+ *  task as fit in QT_AGG_GRAIN microseconds.
+ *  @see qtperf_agg_sites
+ */
+typedef struct qtperf_agg_site_s {
+  /// The task function (a qthread_f)
+  void* f;
+  /// Moving average of the run time of one task, in seconds
+  double task_time;
+  /// Number of tasks timed, whether they ran alone or aggregated
+  unsigned long tasks;
+  /// Number of aggregates run
+  unsigned long batches;
+  /// How many tasks currently go into one aggregate
+  size_t batch_size;
+} qtperf_agg_site_t;
+
+/** @brief Retrieve the learned task aggregation batch sizes
+ *
+ * This function copies the aggregation statistics of up to max task
+ * functions into sites, and returns the number of task functions the
+ * library has statistics for (which may be more than max, so call it
+ * with max of zero to size the array). The library keeps these
+ * statistics whether or not data collection has been started. If the
+ * library was configured with --disable-task-aggregation, this
+ * returns 0.
+ *
+ * @param sites Array to fill in, may be NULL if max is zero
+ * @param max Length of the sites array
+ * @see qtperf_print_agg_sites
+ */
+size_t qtperf_agg_sites(qtperf_agg_site_t* sites, size_t max);
+
+/** @brief Print the learned task aggregation batch sizes
+ *
+ * This function prints one line per aggregable task function, with
+ * its average run time, how many tasks and aggregates have run, and
+ * the current batch size.
+ *
+ * @see qtperf_agg_sites
+ */
+void qtperf_print_agg_sites(void);
+
+//--------------- FEB LOCKING STRIPES -------------------------------
+/** qtperf_feb_stripe_t reports how busy one of the locking stripes
+ *  that guard the full/empty bit state has been. An address is
+ *  assigned to a stripe by hashing it; the number of stripes is
+ *  chosen at initialization (see QT_LOCKING_STRIPES).
+ *  @see qtperf_feb_stripes
+ */
+typedef struct qtperf_feb_stripe_s {
+  /// Number of times the stripe's lock has been taken
+  size_t acquisitions;
+  /// Number of those times the lock was already held
+  size_t contended;
+} qtperf_feb_stripe_t;
+
+/** @brief Retrieve the FEB locking stripe statistics
+ *
+ * This function copies the statistics of up to max locking stripes
+ * into stripes, and returns the number of stripes (which may be more
+ * than max, so call it with max of zero to size the array). The
+ * library keeps these statistics whether or not data collection has
+ * been started. Operations on words that are full and have no
+ * waiters do not take a stripe lock, and so are not counted. When
+ * the library runs with a single worker, or was configured with
+ * --enable-lf-febs, the stripes have no locks and all counts are 0.
+ *
+ * @param stripes Array to fill in, may be NULL if max is zero
+ * @param max Length of the stripes array
+ * @see qtperf_print_feb_stripes
+ */
+size_t qtperf_feb_stripes(qtperf_feb_stripe_t* stripes, size_t max);
+
+/** @brief Print the FEB locking stripe statistics
+ *
+ * This function prints the number of locking stripes and one line
+ * per stripe that has been used, with how many times its lock has
+ * been taken and how many of those were contended.
+ *
+ * @see qtperf_feb_stripes
+ */
+void qtperf_print_feb_stripes(void);
+
 #ifdef QTPERF_TESTING
 #include<stdarg.h>
 #include<stddef.h>
@@ -116,6 +116,28 @@ typedef struct _syncvar_s {
 #define SYNCVAR_INITIALIZE_TO(value)              ((syncvar_t)SYNCVAR_STATIC_INITIALIZE_TO(value))
 #define SYNCVAR_EMPTY_INITIALIZE_TO(value)        ((syncvar_t)SYNCVAR_STATIC_EMPTY_INITIALIZE_TO(value))
 
+/* An inline FEB word keeps its full/empty bit, and the list of tasks waiting
+ * on it, next to the data it guards, so that operating on it does not involve
+ * the library's address-keyed FEB table. Unlike a syncvar_t, it carries a
+ * whole aligned_t. A zeroed word is full, like any other memory. */
+typedef struct _qt_feb_word_s {
+    aligned_t state;   /* internal: lock and full/empty bits */
+    void     *waiters; /* internal: tasks blocked on this word */
+    aligned_t data;
+} qt_feb_word_t;
+
+/* internal: the bit of a qt_feb_word_t's state that marks it empty */
+#define QT_FEB_WORD_EMPTY_BIT 2
+
+#define QT_FEB_WORD_STATIC_INITIALIZER                { 0, NULL, 0 }
+#define QT_FEB_WORD_STATIC_EMPTY_INITIALIZER          { QT_FEB_WORD_EMPTY_BIT, NULL, 0 }
+#define QT_FEB_WORD_STATIC_INITIALIZE_TO(value)       { 0, NULL, (value) }
+#define QT_FEB_WORD_STATIC_EMPTY_INITIALIZE_TO(value) { QT_FEB_WORD_EMPTY_BIT, NULL, (value) }
+#define QT_FEB_WORD_INITIALIZER                       ((qt_feb_word_t)QT_FEB_WORD_STATIC_INITIALIZER)
+#define QT_FEB_WORD_EMPTY_INITIALIZER                 ((qt_feb_word_t)QT_FEB_WORD_STATIC_EMPTY_INITIALIZER)
+#define QT_FEB_WORD_INITIALIZE_TO(value)              ((qt_feb_word_t)QT_FEB_WORD_STATIC_INITIALIZE_TO(value))
+#define QT_FEB_WORD_EMPTY_INITIALIZE_TO(value)        ((qt_feb_word_t)QT_FEB_WORD_STATIC_EMPTY_INITIALIZE_TO(value))
+
 #define INT64TOINT60(x)       ((uint64_t)((x) & (uint64_t)0xfffffffffffffffULL))
 #define INT60TOINT64(x)       ((int64_t)(((x) & (uint64_t)0x800000000000000ULL) ? ((x) | (uint64_t)0xf800000000000000ULL) : (x)))
 #define DBL64TODBL60(in, out) do { memcpy(&(out), &(in), 8); out >>= 4; } while (0)
@@ -273,7 +295,9 @@ enum _qthread_features {
     SPAWN_AGGREGABLE,
     SPAWN_COUNT,
     SPAWN_LOCAL_PRIORITY,
-    SPAWN_NETWORK
+    SPAWN_NETWORK,
+    SPAWN_LAZY,
+    SPAWN_NEAR
 };
 
 #define QTHREAD_SPAWN_PARENT        (1 << SPAWN_PARENT)
@@ -287,6 +311,41 @@ enum _qthread_features {
 #define QTHREAD_SPAWN_AGGREGABLE    (1 << SPAWN_AGGREGABLE)
 #define QTHREAD_SPAWN_LOCAL_PRIORITY (1 << SPAWN_LOCAL_PRIORITY)
 #define QTHREAD_SPAWN_NETWORK (1 << SPAWN_NETWORK)
+/* Run the task on its parent's stack if the parent joins on its return value
+ * before an idle worker steals it (see qthread_spawn(3)). */
+#define QTHREAD_SPAWN_LAZY    (1 << SPAWN_LAZY)
+/* Treat target_shep as a placement hint: the task is queued there, but idle
+ * workers on the same memory node may still steal it. */
+#define QTHREAD_SPAWN_NEAR    (1 << SPAWN_NEAR)
+
+/* Scheduling priority band, from 0 (the default, lowest) up to
+ * QTHREAD_PRIORITY_BANDS_MAX - 1. Schedulers without priority support
+ * ignore it. */
+#define QTHREAD_PRIORITY_BANDS_MAX   8
+#define QTHREAD_SPAWN_PRIORITY_SHIFT 16
+#define QTHREAD_SPAWN_PRIORITY_MASK  (0xf << QTHREAD_SPAWN_PRIORITY_SHIFT)
+#define QTHREAD_SPAWN_PRIORITY(p)    ((((unsigned int)(p)) << QTHREAD_SPAWN_PRIORITY_SHIFT) & QTHREAD_SPAWN_PRIORITY_MASK)
+
+/* Stack size class. QTHREAD_STACK_DEFAULT stacks are $QTHREAD_STACK_SIZE
+ * bytes; each class has its own pool of stacks. Simple tasks have no stack,
+ * and ignore it. */
+enum qthread_stack_class {
+    QTHREAD_STACK_DEFAULT,
+    QTHREAD_STACK_4K,
+    QTHREAD_STACK_16K,
+    QTHREAD_STACK_64K,
+    QTHREAD_STACK_1M,
+    QTHREAD_STACK_CLASSES
+};
+#define QTHREAD_SPAWN_STACK_SHIFT 20
+#define QTHREAD_SPAWN_STACK_MASK  (0x7 << QTHREAD_SPAWN_STACK_SHIFT)
+#define QTHREAD_SPAWN_STACK(c)    ((((unsigned int)(c)) << QTHREAD_SPAWN_STACK_SHIFT) & QTHREAD_SPAWN_STACK_MASK)
+
+/* Marks one entry of a precondition list as a syncvar_t, so that aligned_t
+ * and syncvar_t preconditions can be mixed without QTHREAD_SPAWN_PC_SYNCVAR_T
+ * (see qthread_spawn(3)). The mark is the address's low bit, so the aligned_t
+ * preconditions in such a list must be aligned. */
+#define QTHREAD_PRECOND_SYNCVAR(sv) ((aligned_t *)((uintptr_t)(sv) | 1))
 
 int qthread_spawn(qthread_f             f,
                   const void           *arg,
@@ -297,6 +356,95 @@ int qthread_spawn(qthread_f             f,
                   qthread_shepherd_id_t target_shep,
                   unsigned int          feature_flag);
 
+/* Spawn n tasks running f at once, as if by n calls to qthread_spawn()
+ * without preconditions. Task i gets a copy of the i'th of n arg_size-byte
+ * arguments in args or, if arg_size is 0, the i'th pointer in args. rets is
+ * NULL, an array of n return values, or (with QTHREAD_SPAWN_RET_SINC or
+ * QTHREAD_SPAWN_RET_SINC_VOID) one sinc for them all. target_sheps is NULL,
+ * to let the scheduler place every task, or an array of n shepherds. */
+int qthread_spawn_bulk(qthread_f                    f,
+                       const void                  *args,
+                       size_t                       arg_size,
+                       size_t                       n,
+                       void                        *rets,
+                       const qthread_shepherd_id_t *target_sheps,
+                       unsigned int                 feature_flag);
+
+/* Like qthread_spawn(), but the task is due by deadline, an absolute time as
+ * returned by qtimer_wtime(). The EDF scheduler runs tasks earliest deadline
+ * first; other schedulers ignore the deadline. */
+int qthread_spawn_deadline(qthread_f             f,
+                           const void           *arg,
+                           size_t                arg_size,
+                           void                 *ret,
+                           size_t                npreconds,
+                           void                 *preconds,
+                           qthread_shepherd_id_t target_shep,
+                           unsigned int          feature_flag,
+                           double                deadline);
+#define qthread_fork_deadline(f, a, r, d) \
+    qthread_spawn_deadline((f), (a), 0, (r), 0, NULL, NO_SHEPHERD, 0, (d))
+
+/* Like qthread_spawn(), but the task is placed near the memory at addr: on a
+ * shepherd of the memory node that holds it (see qthread_shep_near()), as by
+ * QTHREAD_SPAWN_NEAR, or wherever the scheduler likes if that is unknown. */
+int qthread_spawn_near(qthread_f    f,
+                       const void  *arg,
+                       size_t       arg_size,
+                       void        *ret,
+                       size_t       npreconds,
+                       void        *preconds,
+                       const void  *addr,
+                       unsigned int feature_flag);
+#define qthread_fork_near(f, a, r, addr) \
+    qthread_spawn_near((f), (a), 0, (r), 0, NULL, (addr), 0)
+
+/* How late tasks spawned with a deadline finished, summed over all workers.
+ * Only collected by the EDF scheduler; elsewhere qthread_lateness() returns
+ * QTHREAD_NOT_ALLOWED. Late tasks are counted in histogram[i] when they
+ * finished less than 2^i microseconds late (the last bucket takes the rest). */
+#define QTHREAD_LATENESS_BUCKETS 32
+typedef struct qthread_lateness_s {
+    size_t tasks;          /* deadline tasks that finished */
+    size_t late;           /* ... after their deadline */
+    double total_lateness; /* seconds, over the late tasks */
+    double max_lateness;   /* seconds */
+    size_t histogram[QTHREAD_LATENESS_BUCKETS];
+} qthread_lateness_t;
+
+int    qthread_lateness(qthread_lateness_t *stats);
+void   qthread_lateness_reset(void);
+double qthread_lateness_quantile(const qthread_lateness_t *stats,
+                                 double                    quantile);
+
+/* Timed tasks. Delays and periods are in seconds. qthread_fork_after() runs
+ * f(arg) once, delay seconds from now; qthread_fork_periodic() runs it every
+ * period seconds, starting one period from now, until it returns nonzero.
+ * In both cases ret (if not NULL) is emptied at once and filled with the
+ * (final) return value. qthread_sleep() suspends the calling task without
+ * tying up its worker. Timers are kept on a timer wheel per shepherd, with
+ * a resolution of QT_TIMER_RESOLUTION microseconds. */
+int qthread_fork_after(qthread_f   f,
+                       const void *arg,
+                       aligned_t  *ret,
+                       double      delay);
+int qthread_fork_periodic(qthread_f   f,
+                          const void *arg,
+                          aligned_t  *ret,
+                          double      period);
+int qthread_sleep(double seconds);
+
+/* Tail calls between tasks. qthread_replace() turns the calling task into
+ * f(arg), as if f had been its function all along: it starts over at the top
+ * of the same stack, with a copy of arg_size bytes of arg (or, if arg_size
+ * is 0, arg itself), and what f finally returns is what the task returns.
+ * The caller's stack frames are discarded. It does not return, unless the
+ * task cannot be replaced (QTHREAD_NOT_ALLOWED): the main task, a simple
+ * task, or one run inline by the task that joined on it. */
+int qthread_replace(qthread_f   f,
+                    const void *arg,
+                    size_t      arg_size);
+
 /* This is a function to move a thread from one shepherd to another. */
 int qthread_migrate_to(const qthread_shepherd_id_t shepherd);
 
@@ -340,6 +488,9 @@ const qthread_shepherd_id_t *qthread_sorted_sheps(void);
 const qthread_shepherd_id_t *qthread_sorted_sheps_remote(const
                                                          qthread_shepherd_id_t
                                                          src);
+/* returns a shepherd on the memory node that holds addr (the caller's own,
+ * if it is on that node), or NO_SHEPHERD if that is not known */
+qthread_shepherd_id_t qthread_shep_near(const void *addr);
 /* returns the number of actively-scheduling shepherds */
 qthread_shepherd_id_t qthread_num_shepherds(void);
 qthread_worker_id_t   qthread_num_workers(void); /* how many kernel-level threads are running */
@@ -359,7 +510,12 @@ enum introspective_state {
     CURRENT_WORKER,
     CURRENT_UNIQUE_WORKER,
     CURRENT_TEAM,
-    PARENT_TEAM
+    PARENT_TEAM,
+    PARKED_COUNT,
+    WOKEN_COUNT,
+    STACK_RESERVED_BYTES,
+    STACK_RESIDENT_BYTES,
+    MPOOL_REMOTE_FREES
 };
 size_t qthread_readstate(const enum introspective_state type);
 
@@ -428,6 +584,7 @@ int       qthread_queue_destroy(qthread_queue_t q);
  * is full, and 0 if the address is empty */
 int qthread_feb_status(const aligned_t *addr);
 int qthread_syncvar_status(syncvar_t *const v);
+int qthread_feb_word_status(const qt_feb_word_t *w);
 
 /* The empty/fill functions merely assert the empty or full state of the given
  * address. */
@@ -435,6 +592,13 @@ int qthread_empty(const aligned_t *dest);
 int qthread_syncvar_empty(syncvar_t *restrict dest);
 int qthread_fill(const aligned_t *dest);
 int qthread_syncvar_fill(syncvar_t *restrict dest);
+int qthread_feb_word_empty(qt_feb_word_t *dest);
+int qthread_feb_word_fill(qt_feb_word_t *dest);
+
+/* This fills each of the n addresses in dest[], locking each FEB locking
+ * stripe once rather than once per address. */
+int qthread_fill_many(const aligned_t *const *dest,
+                      size_t                  n);
 
 /* These functions wait for memory to become empty, and then fill it. When
  * memory becomes empty, only one thread blocked like this will be awoken. Data
@@ -453,6 +617,10 @@ int qthread_syncvar_writeEF(syncvar_t *restrict      dest,
                             const uint64_t *restrict src);
 int qthread_syncvar_writeEF_const(syncvar_t *restrict dest,
                                   uint64_t            src);
+int qthread_feb_word_writeEF(qt_feb_word_t *restrict   dest,
+                             const aligned_t *restrict src);
+int qthread_feb_word_writeEF_const(qt_feb_word_t *dest,
+                                   aligned_t      src);
 
 /* This function is a cross between qthread_fill() and qthread_writeEF(). It
  * does not wait for memory to become empty, but performs the write and sets
@@ -471,6 +639,10 @@ int qthread_syncvar_writeF(syncvar_t *restrict      dest,
                            const uint64_t *restrict src);
 int qthread_syncvar_writeF_const(syncvar_t *restrict dest,
                                  uint64_t            src);
+int qthread_feb_word_writeF(qt_feb_word_t *restrict   dest,
+                            const aligned_t *restrict src);
+int qthread_feb_word_writeF_const(qt_feb_word_t *dest,
+                                  aligned_t      src);
 
 /* This function is essentially qthread_empty, but it also writes 0. It does
  * not wait for memory to become empty, but performs the write and sets the
@@ -519,6 +691,15 @@ int qthread_readFF(aligned_t       *dest,
                    const aligned_t *src);
 int qthread_syncvar_readFF(uint64_t *restrict  dest,
                            syncvar_t *restrict src);
+int qthread_feb_word_readFF(aligned_t *restrict     dest,
+                            qt_feb_word_t *restrict src);
+
+/* This waits for all n addresses in src[] to become full, blocking at most
+ * once, and then copies each src[i] to dest[i] (if dest and dest[i] are not
+ * NULL). Like qthread_fill_many(), it locks each FEB locking stripe once. */
+int qthread_readFF_many(aligned_t *const       *dest,
+                        const aligned_t *const *src,
+                        size_t                  n);
 
 /* These functions wait for memory to become full, and then empty it. When
  * memory becomes full, only one thread blocked like this will be awoken. Data
@@ -533,6 +714,8 @@ int qthread_readFE(aligned_t       *dest,
                    const aligned_t *src);
 int qthread_syncvar_readFE(uint64_t *restrict  dest,
                            syncvar_t *restrict src);
+int qthread_feb_word_readFE(aligned_t *restrict     dest,
+                            qt_feb_word_t *restrict src);
 
 /* This function ignores the FEB state. Data is read from src and written to
  * dest.
@@ -51,11 +51,14 @@ typedef struct qlib_s {
 #endif /* ifdef QTHREAD_LOCAL_PRIORITY */
 
     unsigned                   qthread_stack_size;
+    unsigned                   qthread_stack_class_size[QTHREAD_STACK_CLASSES]; /* [QTHREAD_STACK_DEFAULT] is qthread_stack_size */
     unsigned                   master_stack_size;
     unsigned                   max_stack_size;
 
     unsigned                   qthread_argcopy_size;
     unsigned                   qthread_tasklocal_size;
+    unsigned                   qthread_argcopy_offset; /* tasklocal size, rounded up to 16 */
+    unsigned                   qthread_data_class_size[QTHREAD_DATA_CLASSES]; /* bytes of data[] */
 
     qthread_t                 *mccoy_thread; /* free when exiting */
 
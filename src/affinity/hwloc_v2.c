@@ -603,6 +603,18 @@ void INTERNAL qt_affinity_set(qthread_worker_t *me,
     }
 }                                      /*}}} */
 
+/* the memory node (as for qt_affinity_mem_node()) of obj's cores, or -1 if
+ * they span several; obj's logical index at the shepherd depth is not one */
+static int obj_mem_node(hwloc_obj_t obj)
+{                                      /*{{{ */
+#if HWLOC_API_VERSION >= 0x00010b03
+    if (obj && obj->nodeset && (hwloc_bitmap_weight(obj->nodeset) == 1)) {
+        return hwloc_bitmap_first(obj->nodeset);
+    }
+#endif
+    return -1;
+}                                      /*}}} */
+
 int INTERNAL qt_affinity_gendists(qthread_shepherd_t   *sheps,
                                   qthread_shepherd_id_t nshepherds)
 {   /*{{{ */
@@ -610,6 +622,7 @@ int INTERNAL qt_affinity_gendists(qthread_shepherd_t   *sheps,
 
     for (size_t i = 0; i < qt_topo.num_sheps; i++) {
         sheps[i].node            = i % qt_topo.num_sheps;
+        sheps[i].mem_node        = obj_mem_node(hwloc_get_obj_inside_cpuset_by_depth(sys_topo, hwloc_topology_get_allowed_cpuset(sys_topo), qt_topo.shep_level, sheps[i].node));
         sheps[i].sorted_sheplist = qt_calloc(qt_topo.num_sheps - 1,
                                              sizeof(qthread_shepherd_id_t));
         sheps[i].shep_dists      = qt_calloc(qt_topo.num_sheps,
@@ -689,6 +702,25 @@ void INTERNAL qt_affinity_mem_tonode(void  *addr,
     hwloc_bitmap_free(nodeset);
 }                                      /*}}} */
 
+/* hwloc_get_area_memlocation() appeared in hwloc 1.11.3 */
+int INTERNAL qt_affinity_mem_node(const void *addr)
+{                                      /*{{{ */
+#if HWLOC_API_VERSION >= 0x00010b03
+    hwloc_nodeset_t nodeset = hwloc_bitmap_alloc();
+    int             node    = -1;
+
+    DEBUG_ONLY(hwloc_topology_check(sys_topo));
+    if (hwloc_get_area_memlocation(sys_topo, addr, 1, nodeset,
+                                   HWLOC_MEMBIND_BYNODESET) == 0) {
+        node = hwloc_bitmap_first(nodeset);
+    }
+    hwloc_bitmap_free(nodeset);
+    return node;
+#else
+    return -1;
+#endif
+}                                      /*}}} */
+
 void INTERNAL *qt_affinity_alloc(size_t bytes)
 {                                      /*{{{ */
     DEBUG_ONLY(hwloc_topology_check(sys_topo));
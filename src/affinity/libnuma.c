@@ -3,6 +3,7 @@
 #endif
 
 #include <numa.h>
+#include <numaif.h> /* for move_pages() */
 
 #include "qt_subsystems.h"
 #include "qt_asserts.h"
@@ -45,6 +46,18 @@ void INTERNAL qt_affinity_mem_tonode(void  *addr,
     numa_tonode_memory(addr, bytes, node);
 }                                      /*}}} */
 
+int INTERNAL qt_affinity_mem_node(const void *addr)
+{                                      /*{{{ */
+    void *page = (void *)((uintptr_t)addr & ~(uintptr_t)(numa_pagesize() - 1));
+    int   status;
+
+    /* with no destination nodes, move_pages() only reports where they are */
+    if (move_pages(0, 1, &page, NULL, &status, 0) != 0) {
+        return -1;
+    }
+    return (status >= 0) ? status : -1;
+}                                      /*}}} */
+
 void INTERNAL *qt_affinity_alloc(size_t bytes)
 {                                      /*{{{ */
     return numa_alloc(bytes);
@@ -148,7 +161,8 @@ int INTERNAL qt_affinity_gendists(qthread_shepherd_t   *sheps,
     /* assign nodes */
     qthread_debug(AFFINITY_DETAILS, "assign nodes...\n");
     for (size_t i = 0; i < nshepherds; ++i) {
-        sheps[i].node = i % num_extant_nodes;
+        sheps[i].node     = i % num_extant_nodes;
+        sheps[i].mem_node = sheps[i].node;
 	qthread_debug(AFFINITY_DETAILS, "set bit %u in bmask\n", i % num_extant_nodes);
         nodemask_set(&bmask, i % num_extant_nodes);
     }
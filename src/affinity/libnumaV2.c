@@ -3,6 +3,7 @@
 #endif
 
 #include <numa.h>
+#include <numaif.h> /* for move_pages() */
 #include <stdio.h>
 
 #include "qt_subsystems.h"
@@ -46,6 +47,18 @@ void INTERNAL qt_affinity_mem_tonode(void  *addr,
     numa_tonode_memory(addr, bytes, node);
 }                                      /*}}} */
 
+int INTERNAL qt_affinity_mem_node(const void *addr)
+{                                      /*{{{ */
+    void *page = (void *)((uintptr_t)addr & ~(uintptr_t)(numa_pagesize() - 1));
+    int   status;
+
+    /* with no destination nodes, move_pages() only reports where they are */
+    if (move_pages(0, 1, &page, NULL, &status, 0) != 0) {
+        return -1;
+    }
+    return (status >= 0) ? status : -1;
+}                                      /*}}} */
+
 void INTERNAL *qt_affinity_alloc(size_t bytes)
 {                                      /*{{{ */
     return numa_alloc(bytes);
@@ -184,7 +197,8 @@ static void assign_nodes(qthread_shepherd_t *sheps,
         }
         qthread_debug(AFFINITY_DETAILS, "setting shep %i to numa node %i\n",
                       (int)i, (int)node);
-        sheps[i].node = node;
+        sheps[i].node     = node;
+        sheps[i].mem_node = node;
         node++;
         node *= (node < num_extant_nodes);
     }
@@ -0,0 +1,195 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <string.h> /* for memset() */
+
+/* API Headers */
+#include "qthread/qthread.h"
+#include "qthread/performance.h"
+
+/* Internal Headers */
+#include "qt_visibility.h"
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qt_debug.h"
+#include "qt_alloc.h"
+#include "qt_mpool.h"
+#include "qt_envariables.h"
+#include "qt_subsystems.h"   /* for qthread_internal_cleanup() */
+#include "qthread_innards.h" /* for qlib */
+#include "qt_qthread_struct.h"
+#include "qt_threadqueues.h"
+#include "qt_aggregation.h"
+
+/* The cost model: one entry per task function that has run aggregable
+ * tasks, in an open-addressed table. Entries are claimed with a CAS and
+ * never removed; the statistics in them are updated without
+ * synchronization, so concurrent updates from several workers may lose a
+ * sample, which only blurs the average. */
+#define AGG_SITES  256 /* a power of two */
+#define AGG_WEIGHT 8   /* a new sample moves the average 1/AGG_WEIGHT of the way */
+#define AGG_WARMUP 4   /* samples before a batch size is trusted */
+
+typedef struct {
+    void *volatile    key;     /* the qthread_f; NULL while the entry is free */
+    volatile double   avg;     /* seconds per task */
+    volatile unsigned batch;   /* learned aggregate size */
+    unsigned long     tasks;   /* tasks timed, on their own or in aggregates */
+    unsigned long     batches; /* aggregates run */
+} qt_agg_site_t;
+
+static qt_agg_site_t agg_sites[AGG_SITES];
+static double        agg_grain = 20e-6;
+
+void qthread_thread_free(qthread_t *t);
+
+/* Memory Management */
+#ifdef UNPOOLED
+# define ALLOC_BATCH() (qt_agg_batch_t *)MALLOC(sizeof(qt_agg_batch_t))
+# define FREE_BATCH(b) FREE((b), sizeof(qt_agg_batch_t))
+#else
+static qt_mpool batch_pool = NULL;
+# define ALLOC_BATCH() (qt_agg_batch_t *)qt_mpool_alloc(batch_pool)
+# define FREE_BATCH(b) qt_mpool_free(batch_pool, (b))
+#endif
+
+static void qt_aggregation_subsystem_shutdown(void)
+{   /*{{{*/
+#ifndef UNPOOLED
+    qt_mpool_destroy(batch_pool);
+    batch_pool = NULL;
+#endif
+} /*}}}*/
+
+void INTERNAL qt_aggregation_subsystem_init(void)
+{   /*{{{*/
+    agg_grain = qt_internal_get_env_num("AGG_GRAIN", 20, 20) * 1e-6;
+    memset(agg_sites, 0, sizeof(agg_sites));
+#ifndef UNPOOLED
+    batch_pool = qt_mpool_create(sizeof(qt_agg_batch_t));
+#endif
+    qthread_internal_cleanup(qt_aggregation_subsystem_shutdown);
+} /*}}}*/
+
+static qt_agg_site_t *agg_site(qthread_f f,
+                               int       insert)
+{   /*{{{*/
+    void *const  key = (void *)f;
+    const size_t h   = (size_t)(((uintptr_t)key >> 4) * 0x9E3779B1u);
+
+    for (size_t i = 0; i < AGG_SITES; i++) {
+        qt_agg_site_t *s = &agg_sites[(h + i) & (AGG_SITES - 1)];
+        void          *k = s->key;
+
+        if (k == key) { return s; }
+        if (k == NULL) {
+            if (!insert) { return NULL; }
+            k = qthread_cas_ptr(&s->key, NULL, key);
+            if ((k == NULL) || (k == key)) { return s; }
+        }
+    }
+    return NULL; /* table full: this site is never aggregated */
+} /*}}}*/
+
+/* Account secs of run time to count tasks of f */
+void INTERNAL qt_agg_record(qthread_f f,
+                            double    secs,
+                            int       count)
+{   /*{{{*/
+    qt_agg_site_t *s   = agg_site(f, 1);
+    const double   per = secs / count;
+
+    if (s == NULL) { return; }
+    if (s->tasks == 0) {
+        s->avg = per;
+    } else {
+        s->avg += (per - s->avg) / AGG_WEIGHT;
+    }
+    s->tasks += count;
+    if (count > 1) { s->batches++; }
+    if (s->tasks >= AGG_WARMUP) {
+        const double n = (s->avg > 0.0) ? (agg_grain / s->avg) : QT_AGG_MAX_BATCH;
+
+        s->batch = (n >= QT_AGG_MAX_BATCH) ? QT_AGG_MAX_BATCH : ((n < 1.0) ? 1 : (unsigned)n);
+    }
+} /*}}}*/
+
+/* Turn t, which was just handed to this worker, into an aggregate of t and
+ * as many of its siblings from q as the cost model says fit in the grain.
+ * Returns t either way. */
+qthread_t INTERNAL *qt_agg_gather(qthread_t                *t,
+                                  qt_threadqueue_t         *q,
+                                  qt_threadqueue_private_t *qc)
+{   /*{{{*/
+    qthread_t      *more[QT_AGG_MAX_BATCH - 1];
+    qt_agg_site_t  *s;
+    qt_agg_batch_t *b;
+    int             n, vetoed = 0;
+
+    if (!qt_agg_eligible(t) || ((s = agg_site(t->f, 0)) == NULL) || (s->batch <= 1)) { return t; }
+    n = qt_threadqueue_dequeue_agg(q, qc, t, more, (int)s->batch - 1);
+    if (n == 0) { return t; }
+
+    b = ALLOC_BATCH();
+    assert(b);
+    b->count  = 1;
+    b->f[0]   = t->f;
+    b->arg[0] = t->arg;
+    b->ret[0] = t->ret;
+    for (int i = 0; i < n; i++) {
+        qthread_t *u = more[i];
+
+        b->f[b->count]   = u->f;
+        b->arg[b->count] = u->arg;
+        /* a cost function given to qthread_initialize_agg() can still veto */
+        if (!vetoed && (qlib->agg_cost(b->count, b->f, b->arg) < qlib->max_c)) {
+            b->ret[b->count++] = u->ret;
+            qthread_thread_free(u);
+        } else {
+            vetoed = 1;
+            qt_threadqueue_enqueue(q, u);
+        }
+    }
+    if (b->count == 1) {
+        FREE_BATCH(b);
+        return t;
+    }
+    qthread_debug(THREAD_DETAILS, "aggregating %d tasks of f=%p\n", b->count, t->f);
+    t->f        = (qthread_f)qlib->agg_f;
+    t->arg      = b->arg;
+    t->ret      = b->ret;
+    t->preconds = b;
+    t->flags   |= QTHREAD_AGGREGATED;
+    return t;
+} /*}}}*/
+
+void INTERNAL qt_agg_batch_free(qt_agg_batch_t *b)
+{   /*{{{*/
+    FREE_BATCH(b);
+} /*}}}*/
+
+/* Copy out up to max entries of the cost model; returns how many exist */
+size_t INTERNAL qt_agg_report(qtperf_agg_site_t *sites,
+                              size_t             max)
+{   /*{{{*/
+    size_t n = 0;
+
+    for (size_t i = 0; i < AGG_SITES; i++) {
+        const qt_agg_site_t *s = &agg_sites[i];
+
+        if (s->key == NULL) { continue; }
+        if (n < max) {
+            sites[n].f          = s->key;
+            sites[n].task_time  = s->avg;
+            sites[n].tasks      = s->tasks;
+            sites[n].batches    = s->batches;
+            sites[n].batch_size = (s->batch > 1) ? s->batch : 1;
+        }
+        n++;
+    }
+    return n;
+} /*}}}*/
+
+/* vim:set expandtab: */
@@ -47,8 +47,8 @@ void qt_internal_alignment_init(void)
     _pagesize = getpagesize();
 }
 
-void *qt_internal_aligned_alloc(size_t        alloc_size,
-                                     uint_fast16_t alignment)
+void *qt_internal_aligned_alloc(size_t alloc_size,
+                                     size_t alignment)
 {
     void *ret;
 
@@ -96,8 +96,8 @@ void *qt_internal_aligned_alloc(size_t        alloc_size,
     return ret;
 }
 
-void qt_internal_aligned_free(void         *ptr,
-                                   uint_fast16_t alignment)
+void qt_internal_aligned_free(void  *ptr,
+                                   size_t alignment)
 {
     assert(ptr);
     switch (alignment) {
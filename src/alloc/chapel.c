@@ -44,13 +44,13 @@ void qt_internal_alignment_init(void) {
   _pagesize = getpagesize();
 }
 
-void *qt_internal_aligned_alloc(size_t        alloc_size,
-                                     uint_fast16_t alignment) {
+void *qt_internal_aligned_alloc(size_t alloc_size,
+                                     size_t alignment) {
   return chpl_mem_memalign(alignment, alloc_size, CHPL_RT_MD_TASK_LAYER_UNSPEC,
                            0, CHPL_FILE_IDX_INTERNAL);
 }
 
-void qt_internal_aligned_free(void         *ptr,
-                                   uint_fast16_t alignment) {
+void qt_internal_aligned_free(void  *ptr,
+                                   size_t alignment) {
   chpl_mem_free(ptr, 0, CHPL_FILE_IDX_INTERNAL);
 }
@@ -973,6 +973,38 @@ qarray_loop_strider_exit:
     return 0;
 }                                      /*}}} */
 
+/* Spawn f to each of the nsheps shepherds from first_shep on, all at once.
+ * With arg_size 0 every task gets arg; otherwise task i gets a copy of the
+ * i'th arg_size-byte structure in arg. rets is NULL or nsheps aligned_t's. */
+static void qarray_spawn_sheps(qthread_f             f,
+                               const void           *arg,
+                               size_t                arg_size,
+                               aligned_t            *rets,
+                               qthread_shepherd_id_t first_shep,
+                               size_t                nsheps)
+{                                      /*{{{ */
+    const void           **args  = NULL;
+    qthread_shepherd_id_t *sheps = MALLOC(nsheps * sizeof(qthread_shepherd_id_t));
+
+    assert(sheps);
+    for (size_t i = 0; i < nsheps; i++) {
+        sheps[i] = first_shep + i;
+    }
+    if (arg_size == 0) {
+        args = MALLOC(nsheps * sizeof(void *));
+        assert(args);
+        for (size_t i = 0; i < nsheps; i++) {
+            args[i] = arg;
+        }
+    }
+    qassert(qthread_spawn_bulk(f, arg_size ? arg : (const void *)args, arg_size,
+                               nsheps, rets, sheps, 0), QTHREAD_SUCCESS);
+    if (args) {
+        FREE(args, nsheps * sizeof(void *));
+    }
+    FREE(sheps, nsheps * sizeof(qthread_shepherd_id_t));
+}                                      /*}}} */
+
 void qarray_iter(qarray      *a,
                  const size_t startat,
                  const size_t stopat,
@@ -997,11 +1029,9 @@ void qarray_iter(qarray      *a,
         {
             qthread_shepherd_id_t start_shep = qarray_shepof(a, startat);
             qthread_shepherd_id_t stop_shep  = qarray_shepof(a, stopat - 1);
-            size_t                num_spawns = 0;
-            for (qthread_shepherd_id_t s = start_shep; s <= stop_shep; s++) {
-                qthread_fork_to((qthread_f)qarray_strider, &qfwa, NULL, s);
-                num_spawns++;
-            }
+            size_t                num_spawns = (stop_shep - start_shep) + 1;
+
+            qarray_spawn_sheps((qthread_f)qarray_strider, &qfwa, 0, NULL, start_shep, num_spawns);
             while (donecount < num_spawns) {
                 qthread_yield();
             }
@@ -1022,14 +1052,10 @@ void qarray_iter(qarray      *a,
                     qthread_yield();
                 }
             } else {
-                qthread_shepherd_id_t       i;
                 const qthread_shepherd_id_t maxsheps =
                     qthread_num_shepherds();
 
-                for (i = 0; i < maxsheps; i++) {
-                    qthread_fork_to((qthread_f)qarray_strider, &qfwa, NULL,
-                                    i);
-                }
+                qarray_spawn_sheps((qthread_f)qarray_strider, &qfwa, 0, NULL, 0, maxsheps);
                 while (donecount < maxsheps) {
                     qthread_yield();
                 }
@@ -1062,12 +1088,9 @@ void qarray_iter_loop(qarray      *a,
         {
             qthread_shepherd_id_t start_shep = qarray_shepof(a, startat);
             qthread_shepherd_id_t stop_shep  = qarray_shepof(a, stopat - 1);
-            size_t                num_spawns = 0;
-            for (qthread_shepherd_id_t s = start_shep; s <= stop_shep; s++) {
-                qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa, NULL,
-                                s);
-                num_spawns++;
-            }
+            size_t                num_spawns = (stop_shep - start_shep) + 1;
+
+            qarray_spawn_sheps((qthread_f)qarray_loop_strider, &qfwa, 0, NULL, start_shep, num_spawns);
             while (donecount < num_spawns) {
                 qthread_yield();
             }
@@ -1088,14 +1111,10 @@ void qarray_iter_loop(qarray      *a,
                     qthread_yield();
                 }
             } else {
-                qthread_shepherd_id_t       i;
                 const qthread_shepherd_id_t maxsheps =
                     qthread_num_shepherds();
 
-                for (i = 0; i < maxsheps; i++) {
-                    qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa,
-                                    NULL, i);
-                }
+                qarray_spawn_sheps((qthread_f)qarray_loop_strider, &qfwa, 0, NULL, 0, maxsheps);
                 while (donecount < maxsheps) {
                     qthread_yield();
                 }
@@ -1161,12 +1180,9 @@ void qarray_iter_constloop(const qarray *a,
         {
             qthread_shepherd_id_t start_shep = qarray_shepof(a, startat);
             qthread_shepherd_id_t stop_shep  = qarray_shepof(a, stopat - 1);
-            size_t                num_spawns = 0;
-            for (qthread_shepherd_id_t s = start_shep; s <= stop_shep; s++) {
-                qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa, NULL,
-                                s);
-                num_spawns++;
-            }
+            size_t                num_spawns = (stop_shep - start_shep) + 1;
+
+            qarray_spawn_sheps((qthread_f)qarray_loop_strider, &qfwa, 0, NULL, start_shep, num_spawns);
             while (donecount < num_spawns) {
                 qthread_yield();
             }
@@ -1187,14 +1203,10 @@ void qarray_iter_constloop(const qarray *a,
                     qthread_yield();
                 }
             } else {
-                qthread_shepherd_id_t       i;
                 const qthread_shepherd_id_t maxsheps =
                     qthread_num_shepherds();
 
-                for (i = 0; i < maxsheps; i++) {
-                    qthread_fork_to((qthread_f)qarray_loop_strider, &qfwa,
-                                    NULL, i);
-                }
+                qarray_spawn_sheps((qthread_f)qarray_loop_strider, &qfwa, 0, NULL, 0, maxsheps);
                 while (donecount < maxsheps) {
                     qthread_yield();
                 }
@@ -1242,8 +1254,7 @@ void qarray_iter_loopaccum(qarray      *a,
             assert(rets);
             assert(rv);
             qfwa[0].ret = ret;
-            for (qthread_shepherd_id_t s = start_shep; s <= stop_shep; s++) {
-                i               = s - start_shep;
+            for (i = 0; i < num_spawns; i++) {
                 qfwa[i].func.ql = func;
                 qfwa[i].acc     = acc;
                 qfwa[i].a       = a;
@@ -1251,12 +1262,13 @@ void qarray_iter_loopaccum(qarray      *a,
                 qfwa[i].startat = startat;
                 qfwa[i].stopat  = stopat;
                 qfwa[i].retsize = retsize;
-                if (s > start_shep) {
+                if (i > 0) {
                     qfwa[i].ret = rets + ((i - 1) * retsize);
                 }
-                qthread_fork_to((qthread_f)qarray_loopaccum_strider,
-                                &qfwa[i], &rv[i], s);
             }
+            qarray_spawn_sheps((qthread_f)qarray_loopaccum_strider, qfwa,
+                               sizeof(struct qarray_accumfunc_wrapper_args),
+                               rv, start_shep, num_spawns);
             for (i = 0; i < num_spawns; i++) {
                 qthread_readFF(NULL, &(rv[i]));
                 if (i > 0) {
@@ -1350,9 +1362,10 @@ void qarray_iter_loopaccum(qarray      *a,
                     if (i > 0) {
                         qfwa[i].ret = rets + ((i - 1) * retsize);
                     }
-                    qthread_fork_to((qthread_f)qarray_loopaccum_strider,
-                                    &qfwa[i], &rv[i], i);
                 }
+                qarray_spawn_sheps((qthread_f)qarray_loopaccum_strider, qfwa,
+                                   sizeof(struct qarray_accumfunc_wrapper_args),
+                                   rv, 0, maxsheps);
                 for (i = 0; i < maxsheps; i++) {
                     qthread_readFF(NULL, &(rv[i]));
                     if (i > 0) {
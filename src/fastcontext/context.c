@@ -14,7 +14,70 @@
 #include "qt_prefetch.h"
 #include "qt_asserts.h"
 
-#ifdef NEEDPOWERMAKECONTEXT
+#ifdef NEEDJUMPMAKECONTEXT
+/* in jump.S: pops the new context's function and argument out of the
+ * callee-saved registers qt_makectxt() put them in, and calls it */
+extern void qt_jump_start(void);
+
+/* This function is entirely copyright Sandia National Laboratories */
+void INTERNAL qt_makectxt(uctxt_t *ucp,
+                          void     (*func)(void),
+                          int      argc,
+                          ...)
+{
+    uintptr_t *sp;
+    va_list    arg;
+    uintptr_t  a0;
+
+    assert(argc == 1);
+    va_start(arg, argc);
+    a0 = va_arg(arg, uintptr_t);
+    va_end(arg);
+
+    /* top of stack, 16-aligned, which is where the first frame starts */
+    sp = (uintptr_t *)(((uintptr_t)ucp->uc_stack.ss_sp + ucp->uc_stack.ss_size) & ~(uintptr_t)15);
+# if defined(__x86_64__)
+    /* what qt_swapctxt() pops, from the top down: return address, %rbp,
+     * %rbx, %r12-%r15, and the control words (MXCSR, x87 CW) */
+    sp   -= 8;
+    sp[7] = (uintptr_t)qt_jump_start;
+    sp[6] = 0;                 /* %rbp: end of the frame chain */
+    sp[5] = 0;                 /* %rbx */
+    sp[4] = (uintptr_t)func;   /* %r12 */
+    sp[3] = a0;                /* %r13 */
+    sp[2] = 0;                 /* %r14 */
+    sp[1] = 0;                 /* %r15 */
+    {
+        uint32_t mxcsr;
+        uint16_t fpcw;
+
+        __asm__ __volatile__ ("stmxcsr %0\n\tfnstcw %1" : "=m" (mxcsr), "=m" (fpcw));
+        sp[0] = (uintptr_t)mxcsr | ((uintptr_t)fpcw << 32);
+    }
+# elif defined(__aarch64__)
+    /* what qt_swapctxt() pops, from the bottom up: d8-d15, x19-x30, FPCR,
+     * and a pad word to keep sp 16-aligned */
+    sp -= 22;
+    for (int i = 0; i < 22; i++) {
+        sp[i] = 0;
+    }
+    sp[8]  = (uintptr_t)func;          /* x19 */
+    sp[9]  = a0;                       /* x20 */
+    sp[18] = 0;                        /* x29: end of the frame chain */
+    sp[19] = (uintptr_t)qt_jump_start; /* x30: where ret goes */
+    {
+        uint64_t fpcr;
+
+        __asm__ __volatile__ ("mrs %0, fpcr" : "=r" (fpcr));
+        sp[20] = fpcr;
+    }
+# else
+#  error Jump contexts are only implemented for x86-64 and AArch64
+# endif
+    ucp->mc.sp = sp;
+}
+
+#elif defined(NEEDPOWERMAKECONTEXT)
 void INTERNAL qt_makectxt(uctxt_t *ucp,
                           void     (*func)(void),
                           int      argc,
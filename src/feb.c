@@ -6,12 +6,15 @@
 #include "qthread/qthread.h"
 
 /* System Headers */
+#include <stdlib.h> /* for qsort() */
+#include <string.h> /* for memset() */
 
 /* Qthread Headers */
 #include <qthread/hash.h>
 
 /* FEB Internal API */
 #include "qt_feb.h"
+#include "qt_syncvar.h" /* for qthread_syncvar_precond() */
 
 /* Internal Headers */
 #include "qt_subsystems.h"
@@ -26,6 +29,7 @@
 #include "qt_blocking_structs.h"
 #include "qt_addrstat.h"
 #include "qt_threadqueues.h"
+#include "qt_touch.h"
 #include "qt_debug.h"
 #ifdef QTHREAD_USE_EUREKAS
 #include "qt_eurekas.h" // for qthread_internal_assassinate() (used in taskfilter)
@@ -36,6 +40,39 @@
  * Local Variables
  *********************************************************************/
 static qt_hash *FEBs;
+/* An address with no addrstat in FEBs is full, with nobody waiting on it.
+ * FEB_present counts the addrstats in FEBs per presence slot (a finer split
+ * of the address space than the locking stripes), so that an operation which
+ * only needs to know that an address is full can find out with a single load
+ * instead of locking a stripe and probing its hash. An addrstat is counted
+ * before it goes into FEBs and uncounted after it comes out, so a slot whose
+ * count reads zero means that every address in it was full at that moment.
+ *
+ * The upper half of a slot is a generation, which every addrstat that goes in
+ * bumps. Reading a full address's data without locking is thus a seqlock
+ * read: load the slot, load the data, and load the slot again; if the slot
+ * did not change, no address in it left the full state in between (see
+ * qthread_feb_read_if_full()). Only operations that do not write the word may
+ * rely on any of this: a writer could see the address full, lose it to an
+ * emptying reader, and then store into an empty word, so writeF() and
+ * writeFF() always take the stripe lock. */
+static aligned_t *FEB_present;
+#define QTHREAD_FEB_PRESENT_BITS       12
+#define QTHREAD_FEB_PRESENT_SLOTS      (1 << QTHREAD_FEB_PRESENT_BITS)
+#define QTHREAD_FEB_PRESENT_GEN_SHIFT  (sizeof(aligned_t) * 4)
+#define QTHREAD_FEB_PRESENT_COUNT_MASK (((aligned_t)1 << QTHREAD_FEB_PRESENT_GEN_SHIFT) - 1)
+#define QTHREAD_FEB_PRESENT_ONE        ((aligned_t)1 + ((aligned_t)1 << QTHREAD_FEB_PRESENT_GEN_SHIFT))
+
+/* Keeps the loads of a lock-free read in order: the data must not be read
+ * before the first load of the state, nor the state again before the data.
+ * x86 never reorders loads with other loads, so there only the compiler needs
+ * to be held back. */
+#if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA32))
+# define QT_FEB_READ_FENCE COMPILER_FENCE
+#else
+# define QT_FEB_READ_FENCE MACHINE_FENCE
+#endif
 #ifdef QTHREAD_COUNT_THREADS
 aligned_t *febs_stripes;
 # ifdef QTHREAD_MUTEX_INCREMENT
@@ -57,12 +94,21 @@ typedef enum bt {
     READFE,
     READFE_NB,
     FILL,
-    EMPTY
+    EMPTY,
+    READFF_MANY,
+    FILL_MANY,
+    WORD_WRITEEF,
+    WORD_WRITEF,
+    WORD_READFF,
+    WORD_READFE,
+    WORD_FILL,
+    WORD_EMPTY
 } blocker_type;
 typedef struct {
     pthread_mutex_t lock;
     void           *a;
     void           *b;
+    size_t          n;
     blocker_type    type;
     int             retval;
 } qthread_feb_blocker_t;
@@ -97,8 +143,7 @@ qt_mpool generic_addrstat_pool = NULL;
 qt_mpool generic_addrres_pool = NULL;
 #endif
 
-/* guaranteed to be between 0 and 128, using the first parts of addr that are
- * significant */
+/* a power of two, chosen by qthread_initialize() (see QT_LOCKING_STRIPES) */
 unsigned int QTHREAD_LOCKING_STRIPES = 128;
 
 /********************************************************************
@@ -121,6 +166,8 @@ static void qt_feb_subsystem_shutdown(void)
 #endif
     }
     FREE(FEBs, sizeof(qt_hash) * QTHREAD_LOCKING_STRIPES);
+    FEBs = NULL;
+    FREE(FEB_present, sizeof(aligned_t) * QTHREAD_FEB_PRESENT_SLOTS);
 #ifdef QTHREAD_COUNT_THREADS
     FREE(febs_stripes, sizeof(aligned_t) * QTHREAD_LOCKING_STRIPES);
 # ifdef QTHREAD_MUTEX_INCREMENT
@@ -149,6 +196,9 @@ void INTERNAL qt_feb_subsystem_init(uint_fast8_t need_sync)
 #endif
     FEBs = MALLOC(sizeof(qt_hash) * QTHREAD_LOCKING_STRIPES);
     assert(FEBs);
+    FEB_present = MALLOC(sizeof(aligned_t) * QTHREAD_FEB_PRESENT_SLOTS);
+    assert(FEB_present);
+    memset(FEB_present, 0, sizeof(aligned_t) * QTHREAD_FEB_PRESENT_SLOTS);
 #ifdef QTHREAD_COUNT_THREADS
     febs_stripes = MALLOC(sizeof(aligned_t) * QTHREAD_LOCKING_STRIPES);
     assert(febs_stripes);
@@ -170,13 +220,27 @@ void INTERNAL qt_feb_subsystem_init(uint_fast8_t need_sync)
     qthread_internal_cleanup_late(qt_feb_subsystem_shutdown);
 }
 
+size_t INTERNAL qt_feb_stripe_report(qtperf_feb_stripe_t *stripes,
+                                     size_t               max)
+{
+    if (FEBs == NULL) {
+        return 0;
+    }
+    for (unsigned i = 0; i < QTHREAD_LOCKING_STRIPES && i < max; i++) {
+        qt_hash_lock_stats(FEBs[i], &stripes[i].acquisitions, &stripes[i].contended);
+    }
+    return QTHREAD_LOCKING_STRIPES;
+}
+
 static inline void qt_feb_schedule(qthread_t          *waiter,
                                    qthread_shepherd_t *shep)
 {
     qthread_debug(FEB_DETAILS, "waiter(%p:%i), shep(%p:%i): setting waiter to 'RUNNING'\n", waiter, (int)waiter->thread_id, shep, (int)shep->shepherd_id);
     waiter->thread_state = QTHREAD_STATE_RUNNING;
     QTPERF_QTHREAD_ENTER_STATE(waiter->rdata->performance_data, QTHREAD_STATE_RUNNING);
-    if ((waiter->flags & QTHREAD_UNSTEALABLE) && (waiter->rdata->shepherd_ptr != shep)) {
+    if (qthread_internal_handoff_offer(waiter, shep)) {
+        qthread_debug(FEB_DETAILS, "waiter(%p:%i), shep(%p:%i): waiter will be swapped to directly\n", waiter, (int)waiter->thread_id, shep, (int)shep->shepherd_id);
+    } else if ((waiter->flags & QTHREAD_UNSTEALABLE) && (waiter->rdata->shepherd_ptr != shep)) {
         qthread_debug(FEB_DETAILS, "waiter(%p:%i), shep(%p:%i): enqueueing waiter in target_shep's ready queue (%p:%i)\n", waiter, (int)waiter->thread_id, shep, (int)shep->shepherd_id, waiter->rdata->shepherd_ptr, waiter->rdata->shepherd_ptr->shepherd_id);
         qt_threadqueue_enqueue(waiter->rdata->shepherd_ptr->ready, waiter);
     } else
@@ -229,16 +293,41 @@ static aligned_t qthread_feb_blocker_thread(void *arg)
         case EMPTY:
             a->retval = qthread_empty(a->a);
             break;
+        case READFF_MANY:
+            a->retval = qthread_readFF_many(a->a, a->b, a->n);
+            break;
+        case FILL_MANY:
+            a->retval = qthread_fill_many(a->b, a->n);
+            break;
+        case WORD_WRITEEF:
+            a->retval = qthread_feb_word_writeEF(a->a, a->b);
+            break;
+        case WORD_WRITEF:
+            a->retval = qthread_feb_word_writeF(a->a, a->b);
+            break;
+        case WORD_READFF:
+            a->retval = qthread_feb_word_readFF(a->a, a->b);
+            break;
+        case WORD_READFE:
+            a->retval = qthread_feb_word_readFE(a->a, a->b);
+            break;
+        case WORD_FILL:
+            a->retval = qthread_feb_word_fill(a->a);
+            break;
+        case WORD_EMPTY:
+            a->retval = qthread_feb_word_empty(a->a);
+            break;
     }
     pthread_mutex_unlock(&(a->lock));
     return 0;
 }                                      /*}}} */
 
-static int qthread_feb_blocker_func(void        *dest,
+static int qthread_feb_blocker_many(void        *dest,
                                     void        *src,
+                                    size_t       n,
                                     blocker_type t)
 {   /*{{{*/
-    qthread_feb_blocker_t args = { PTHREAD_MUTEX_INITIALIZER, dest, src, t, QTHREAD_SUCCESS };
+    qthread_feb_blocker_t args = { PTHREAD_MUTEX_INITIALIZER, dest, src, n, t, QTHREAD_SUCCESS };
 
     pthread_mutex_lock(&args.lock);
     qthread_fork(qthread_feb_blocker_thread, &args, NULL);
@@ -248,8 +337,68 @@ static int qthread_feb_blocker_func(void        *dest,
     return args.retval;
 } /*}}}*/
 
+static int qthread_feb_blocker_func(void        *dest,
+                                    void        *src,
+                                    blocker_type t)
+{   /*{{{*/
+    return qthread_feb_blocker_many(dest, src, 0, t);
+} /*}}}*/
+
 #define QTHREAD_CHOOSE_STRIPE2(addr) (qt_hash64((uint64_t)(uintptr_t)addr) & (QTHREAD_LOCKING_STRIPES - 1))
 // #define QTHREAD_CHOOSE_STRIPE2(addr) QTHREAD_CHOOSE_STRIPE(addr)
+/* multiplicative hashing: cheap enough for the fast path, unlike qt_hash64() */
+#define QTHREAD_FEB_PRESENT_SLOT(addr) (((uintptr_t)(addr) * (uintptr_t)GOLDEN_RATIO) >> (sizeof(uintptr_t) * 8 - QTHREAD_FEB_PRESENT_BITS))
+
+static QINLINE aligned_t qthread_feb_present_stamp(const void *addr)
+{                      /*{{{ */
+    const aligned_t s = *(volatile aligned_t *)&FEB_present[QTHREAD_FEB_PRESENT_SLOT(addr)];
+
+    QT_FEB_READ_FENCE;
+    return s;
+}                      /*}}} */
+
+/* true if addr is certainly full with no waiters, without touching FEBs */
+static QINLINE int qthread_feb_surely_full(const void *addr)
+{                      /*{{{ */
+    return (qthread_feb_present_stamp(addr) & QTHREAD_FEB_PRESENT_COUNT_MASK) == 0;
+}                      /*}}} */
+
+/* Copies src to dest (unless dest is NULL or src) and returns true if
+ * alignedaddr is certainly full with no waiters and stayed that way while src
+ * was read; returns false, having copied nothing, otherwise. */
+static QINLINE int qthread_feb_read_if_full(aligned_t *restrict       dest,
+                                            const aligned_t *restrict src,
+                                            const aligned_t          *alignedaddr)
+{                      /*{{{ */
+    const aligned_t stamp = qthread_feb_present_stamp(alignedaddr);
+    aligned_t       data;
+
+    if (stamp & QTHREAD_FEB_PRESENT_COUNT_MASK) {
+        return 0;
+    }
+    if ((dest == NULL) || (dest == src)) {
+        return 1;
+    }
+    data = *(volatile const aligned_t *)src;
+    if (qthread_feb_present_stamp(alignedaddr) != stamp) {
+        return 0;
+    }
+    *dest = data;
+    return 1;
+}                      /*}}} */
+
+/* Call before an addrstat for addr goes into FEBs... */
+static QINLINE void qthread_feb_present(const void *addr)
+{                      /*{{{ */
+    (void)qthread_incr(&FEB_present[QTHREAD_FEB_PRESENT_SLOT(addr)], QTHREAD_FEB_PRESENT_ONE);
+}                      /*}}} */
+
+/* ...and after it has been taken out (or failed to go in). */
+static QINLINE void qthread_feb_absent(const void *addr)
+{                      /*{{{ */
+    (void)qthread_incr(&FEB_present[QTHREAD_FEB_PRESENT_SLOT(addr)], -1);
+}                      /*}}} */
+
 /* The lock ordering in these functions is very particular, and is designed to
  * reduce the impact of having only one hashtable. Don't monkey with it unless
  * you REALLY know what you're doing! If one hashtable becomes a problem, we
@@ -266,10 +415,14 @@ int API_FUNC qthread_feb_status(const aligned_t *addr)
         return 1;
     }
     qthread_addrstat_t *m;
-    int                 status  = 1; /* full */
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(addr);
+    int                 status = 1; /* full */
 
     QALIGN(addr, alignedaddr);
+    if (qthread_feb_surely_full(alignedaddr)) {
+        qthread_debug(FEB_BEHAVIOR, "addr %p is %i\n", addr, status);
+        return status;
+    }
+    const int lockbin = QTHREAD_CHOOSE_STRIPE2(addr);
     QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
 #ifdef LOCK_FREE_FEBS
     do {
@@ -368,6 +521,7 @@ got_m:
 #endif /* ifdef LOCK_FREE_FEBS */
     if (m != NULL) {
         QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+        qthread_feb_absent(maddr);
 #ifdef LOCK_FREE_FEBS
         hazardous_release_node((hazardous_free_f)qthread_addrstat_delete, m);
 #else
@@ -443,6 +597,7 @@ static QINLINE void qthread_gotlock_empty_inner(qthread_shepherd_t *shep,
         if (removeable) {
             qthread_FEB_remove(maddr);
         }
+        qthread_internal_handoff();
     }
 }                      /*}}} */
 
@@ -530,6 +685,12 @@ static QINLINE void qthread_gotlock_fill_inner(qthread_shepherd_t *shep,
             }
             ((qthread_addrres_t *)((*precond_tasks)->waiter))->next = X;
             (*precond_tasks)->waiter                                = (void *)X;
+        } else if (QTHREAD_STATE_FEB_MANY_BLOCKED == waiter->thread_state) {
+            /* in qthread_readFF_many(); only the last address it waits for wakes it */
+            if (qthread_incr(waiter->rdata->blockedon.pending, -1) == 1) {
+                qt_feb_schedule(waiter, shep);
+            }
+            FREE_ADDRRES(X);
         } else {
             qt_feb_schedule(waiter, shep);
             FREE_ADDRRES(X);
@@ -566,6 +727,7 @@ static QINLINE void qthread_gotlock_fill_inner(qthread_shepherd_t *shep,
             qthread_debug(FEB_DETAILS, "m(%p), addr(%p), recursive(%u): removing addrstat\n", m, maddr, recursive);
             qthread_FEB_remove(maddr);
         }
+        qthread_internal_handoff();
     }
 }                      /*}}} */
 
@@ -609,7 +771,9 @@ int API_FUNC qthread_empty(const aligned_t *dest)
             m->full = 0;
             MACHINE_FENCE;
             QTHREAD_EMPTY_TIMER_START(m);
+            qthread_feb_present(alignedaddr);
             if (!qt_hash_put(FEBbin, (void *)alignedaddr, m)) {
+                qthread_feb_absent(alignedaddr);
                 qthread_addrstat_delete(m);
                 continue;
             }
@@ -646,6 +810,7 @@ int API_FUNC qthread_empty(const aligned_t *dest)
             m->full = 0;
             QTHREAD_EMPTY_TIMER_START(m);
             COMPILER_FENCE;
+            qthread_feb_present(alignedaddr);
             qassertnot(qt_hash_put_locked(FEBbin, (void *)alignedaddr, m), 0);
             qthread_debug(FEB_DETAILS, "dest=%p (tid=%i): inserted m=%p\n", dest, qthread_id(), m);
             m = NULL;
@@ -673,8 +838,7 @@ int API_FUNC qthread_fill(const aligned_t *dest)
         return QTHREAD_SUCCESS;
     }
     qthread_addrstat_t *m;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(dest);
-    qthread_shepherd_t *shep    = qthread_internal_getshep();
+    qthread_shepherd_t *shep = qthread_internal_getshep();
 
     assert(qthread_library_initialized);
 
@@ -683,6 +847,11 @@ int API_FUNC qthread_fill(const aligned_t *dest)
     }
     qthread_debug(FEB_CALLS, "dest=%p (tid=%i)\n", dest, qthread_id());
     QALIGN(dest, alignedaddr);
+    if (qthread_feb_surely_full(alignedaddr)) {
+        qthread_debug(FEB_DETAILS, "dest=%p (tid=%i): already full\n", dest, qthread_id());
+        return QTHREAD_SUCCESS;
+    }
+    const int lockbin = QTHREAD_CHOOSE_STRIPE2(dest);
     /* lock hash */
     QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
 #ifdef LOCK_FREE_FEBS
@@ -829,7 +998,9 @@ int API_FUNC qthread_purge_to(aligned_t *restrict       dest,
             m->full = 0;
             MACHINE_FENCE;
             QTHREAD_EMPTY_TIMER_START(m);
+            qthread_feb_present(alignedaddr);
             if (!qt_hash_put(FEBbin, (void *)alignedaddr, m)) {
+                qthread_feb_absent(alignedaddr);
                 qthread_addrstat_delete(m);
                 continue;
             }
@@ -866,6 +1037,7 @@ int API_FUNC qthread_purge_to(aligned_t *restrict       dest,
             m->full = 0;
             QTHREAD_EMPTY_TIMER_START(m);
             COMPILER_FENCE;
+            qthread_feb_present(alignedaddr);
             qassertnot(qt_hash_put_locked(FEBbin, (void *)alignedaddr, m), 0);
             qthread_debug(FEB_DETAILS, "dest=%p src=%p (tid=%i): inserted m=%p\n", dest, src, qthread_id(), m);
             m = NULL;
@@ -941,8 +1113,10 @@ got_m:
                 return QTHREAD_MALLOC_ERROR;
             }
             QTHREAD_FASTLOCK_LOCK(&m->lock);
+            qthread_feb_present(alignedaddr);
             if (!qt_hash_put(FEBs[lockbin], (void *)alignedaddr, m)) {
                 // qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): put failure\n", dest, src, me->thread_id);
+                qthread_feb_absent(alignedaddr);
                 QTHREAD_FASTLOCK_UNLOCK(&m->lock);
                 qthread_addrstat_delete(m);
                 continue;
@@ -981,9 +1155,27 @@ got_m:
                 qt_hash_unlock(FEBs[lockbin]);
                 return QTHREAD_MALLOC_ERROR;
             }
+            qthread_feb_present(alignedaddr);
             qassertnot(qt_hash_put_locked(FEBs[lockbin], alignedaddr, m), 0);
         }
         QTHREAD_FASTLOCK_LOCK(&(m->lock));
+        if ((m->full == 0) && (m->EFQ == NULL) && (m->FEQ == NULL) && (m->FFQ == NULL) && (m->FFWQ == NULL)) {
+            /* empty, and nobody to wake: fill it by taking the addrstat out
+             * now, rather than coming back for it in qthread_FEB_remove() */
+            if (dest && (dest != src)) {
+                *(aligned_t *)dest = *(aligned_t *)src;
+                MACHINE_FENCE;
+            }
+            qassertnot(qt_hash_remove_locked(FEBs[lockbin], alignedaddr), 0);
+            qt_hash_unlock(FEBs[lockbin]);
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            qthread_feb_absent(alignedaddr);
+            QTHREAD_EMPTY_TIMER_STOP(m);
+            qthread_addrstat_delete(m);
+            qthread_debug(FEB_BEHAVIOR, "dest=%p, src=%p (tid=%i): succeeded! nobody waiting\n", dest, src, me->thread_id);
+            QTHREAD_FEB_TIMER_STOP(febblock, me);
+            return QTHREAD_SUCCESS;
+        }
     }
     qt_hash_unlock(FEBs[lockbin]);
 #endif  /* ifdef LOCK_FREE_FEBS */
@@ -1206,10 +1398,9 @@ int API_FUNC qthread_readFF(aligned_t *restrict       dest,
 {                      /*{{{ */
     const aligned_t *alignedaddr;
 
-    qthread_addrstat_t *m       = NULL;
-    qthread_addrres_t  *X       = NULL;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(src);
-    qthread_t          *me      = qthread_internal_self();
+    qthread_addrstat_t *m  = NULL;
+    qthread_addrres_t  *X  = NULL;
+    qthread_t          *me = qthread_internal_self();
 
     QTHREAD_FEB_TIMER_DECLARATION(febblock);
 
@@ -1218,10 +1409,21 @@ int API_FUNC qthread_readFF(aligned_t *restrict       dest,
     if (!me) {
         return qthread_feb_blocker_func(dest, (void *)src, READFF);
     }
+    if (me->flags & QTHREAD_LAZY_PARENT) {
+        /* if the task that fills src has not started, run it here */
+        qthread_run_needed_task((void *)src);
+    }
     qthread_debug(FEB_CALLS, "dest=%p, src=%p (tid=%u)\n", dest, src, me->thread_id);
     QTHREAD_FEB_UNIQUERECORD(feb, src, me);
     QTHREAD_FEB_TIMER_START(febblock);
     QALIGN(src, alignedaddr);
+    if (qthread_feb_read_if_full(dest, src, alignedaddr)) {
+        MACHINE_FENCE;
+        qthread_debug(FEB_BEHAVIOR, "dest=%p, src=%p (tid=%u): succeeded without locking!\n", dest, src, me->thread_id);
+        QTHREAD_FEB_TIMER_STOP(febblock, me);
+        return QTHREAD_SUCCESS;
+    }
+    const int lockbin = QTHREAD_CHOOSE_STRIPE2(src);
     QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
 # ifdef LOCK_FREE_FEBS
     do {
@@ -1294,9 +1496,8 @@ int INTERNAL qthread_readFF_nb(aligned_t *restrict       dest,
     const aligned_t *alignedaddr;
 
     qthread_debug(FEB_CALLS, "dest=%p, src=%p\n", dest, src);
-    qthread_addrstat_t *m       = NULL;
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE2(src);
-    qthread_t          *me      = qthread_internal_self();
+    qthread_addrstat_t *m  = NULL;
+    qthread_t          *me = qthread_internal_self();
 
     if (!me) {
         return qthread_feb_blocker_func(dest, (void *)src, READFF_NB);
@@ -1304,6 +1505,12 @@ int INTERNAL qthread_readFF_nb(aligned_t *restrict       dest,
     qthread_debug(FEB_BEHAVIOR, "tid %u dest=%p src=%p...\n", me->thread_id, dest, src);
     QTHREAD_FEB_UNIQUERECORD(feb, src, me);
     QALIGN(src, alignedaddr);
+    if (qthread_feb_read_if_full(dest, src, alignedaddr)) {
+        MACHINE_FENCE;
+        qthread_debug(FEB_BEHAVIOR, "tid %u succeeded on %p=%p without locking\n", me->thread_id, dest, src);
+        return QTHREAD_SUCCESS;
+    }
+    const int lockbin = QTHREAD_CHOOSE_STRIPE2(src);
     QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
 # ifdef LOCK_FREE_FEBS
     do {
@@ -1394,7 +1601,9 @@ got_m:
             m = qthread_addrstat_new();
             if (!m) { return QTHREAD_MALLOC_ERROR; }
             QTHREAD_FASTLOCK_LOCK(&m->lock);
+            qthread_feb_present(alignedaddr);
             if (!qt_hash_put(FEBs[lockbin], alignedaddr, m)) {
+                qthread_feb_absent(alignedaddr);
                 QTHREAD_FASTLOCK_UNLOCK(&m->lock);
                 qthread_addrstat_delete(m);
                 continue;
@@ -1422,12 +1631,27 @@ got_m:
     {
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], alignedaddr);
         if (!m) {
+            /* full, and nobody waiting: empty it by putting an empty
+             * addrstat in the hash; nobody else can see m until then, so
+             * there is no need to lock it */
             m = qthread_addrstat_new();
             if (!m) {
                 qt_hash_unlock(FEBs[lockbin]);
                 return QTHREAD_MALLOC_ERROR;
             }
+            if (dest && (dest != src)) {
+                *(aligned_t *)dest = *(aligned_t *)src;
+                MACHINE_FENCE;
+            }
+            m->full = 0;
+            QTHREAD_EMPTY_TIMER_START(m);
+            COMPILER_FENCE;
+            qthread_feb_present(alignedaddr);
             qassertnot(qt_hash_put_locked(FEBs[lockbin], alignedaddr, m), 0);
+            qt_hash_unlock(FEBs[lockbin]);
+            qthread_debug(FEB_BEHAVIOR, "tid %u succeeded on %p=%p, inserted m=%p\n", me->thread_id, dest, src, m);
+            QTHREAD_FEB_TIMER_STOP(febblock, me);
+            return QTHREAD_SUCCESS;
         }
         QTHREAD_FASTLOCK_LOCK(&(m->lock));
     }
@@ -1514,7 +1738,9 @@ int INTERNAL qthread_readFE_nb(aligned_t *restrict       dest,
             m = qthread_addrstat_new();
             if (!m) { return QTHREAD_MALLOC_ERROR; }
             QTHREAD_FASTLOCK_LOCK(&m->lock);
+            qthread_feb_present(alignedaddr);
             if (!qt_hash_put(FEBs[lockbin], alignedaddr, m)) {
+                qthread_feb_absent(alignedaddr);
                 QTHREAD_FASTLOCK_UNLOCK(&m->lock);
                 qthread_addrstat_delete(m);
                 continue;
@@ -1538,12 +1764,26 @@ int INTERNAL qthread_readFE_nb(aligned_t *restrict       dest,
     {
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], alignedaddr);
         if (!m) {
+            /* full, and nobody waiting: empty it by putting an empty
+             * addrstat in the hash; nobody else can see m until then, so
+             * there is no need to lock it */
             m = qthread_addrstat_new();
             if (!m) {
                 qt_hash_unlock(FEBs[lockbin]);
                 return QTHREAD_MALLOC_ERROR;
             }
+            if (dest && (dest != src)) {
+                *(aligned_t *)dest = *(aligned_t *)src;
+                MACHINE_FENCE;
+            }
+            m->full = 0;
+            QTHREAD_EMPTY_TIMER_START(m);
+            COMPILER_FENCE;
+            qthread_feb_present(alignedaddr);
             qassertnot(qt_hash_put_locked(FEBs[lockbin], alignedaddr, m), 0);
+            qt_hash_unlock(FEBs[lockbin]);
+            qthread_debug(FEB_BEHAVIOR, "tid %u succeeded on %p=%p, inserted m=%p\n", me->thread_id, dest, src, m);
+            return QTHREAD_SUCCESS;
         }
         QTHREAD_FASTLOCK_LOCK(&(m->lock));
     }
@@ -1566,6 +1806,602 @@ int INTERNAL qthread_readFE_nb(aligned_t *restrict       dest,
     return QTHREAD_SUCCESS;
 }                      /*}}} */
 
+/********************************************************************
+ * Batched FEB operations
+ *
+ * qthread_readFF_many() and qthread_fill_many() sort the addresses that are
+ * not surely full by locking stripe, and lock each stripe once per call.
+ * qthread_readFF_many() queues its task on every empty address before it
+ * sleeps, and sleeps once: blockedon.pending counts those addresses plus one
+ * more, which the shepherd drops after it has switched away from the task
+ * (see qt_feb_many_release()). Whoever takes the count to zero wakes the task.
+ *********************************************************************/
+#define QT_FEB_MANY_ONSTACK 64
+
+typedef struct {
+    unsigned int lockbin;
+    size_t       i;
+} qt_feb_many_t;
+
+static int qt_feb_many_cmp(const void *a,
+                           const void *b)
+{                      /*{{{ */
+    const qt_feb_many_t *x = (const qt_feb_many_t *)a;
+    const qt_feb_many_t *y = (const qt_feb_many_t *)b;
+
+    if (x->lockbin != y->lockbin) {
+        return (x->lockbin < y->lockbin) ? -1 : 1;
+    }
+    return (x->i < y->i) ? -1 : (x->i > y->i);
+}                      /*}}} */
+
+void INTERNAL qt_feb_many_release(qthread_t *t)
+{                      /*{{{ */
+    if (qthread_incr(t->rdata->blockedon.pending, -1) == 1) {
+        /* every address was filled before t got off of its stack */
+        t->thread_state = QTHREAD_STATE_RUNNING;
+        QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_RUNNING);
+        qt_threadqueue_enqueue(t->rdata->shepherd_ptr->ready, t);
+    }
+}                      /*}}} */
+
+int API_FUNC qthread_readFF_many(aligned_t *const       *dest,
+                                 const aligned_t *const *src,
+                                 size_t                  n)
+{                      /*{{{ */
+    qt_feb_many_t      onstack[QT_FEB_MANY_ONSTACK];
+    qt_feb_many_t     *order   = onstack;
+    qthread_addrres_t *spare   = NULL;
+    size_t             k       = 0, queued = 0;
+    aligned_t          pending = 1;
+    qthread_t         *me      = qthread_internal_self();
+
+    QTHREAD_FEB_TIMER_DECLARATION(febblock);
+
+    assert(qthread_library_initialized);
+
+    if (n == 0) {
+        return QTHREAD_SUCCESS;
+    }
+    qassert_ret(src != NULL, QTHREAD_BADARGS);
+    if (!me) {
+        return qthread_feb_blocker_many((void *)dest, (void *)src, n, READFF_MANY);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p, src=%p, n=%u (tid=%u)\n", dest, src, (unsigned)n, me->thread_id);
+    QTHREAD_FEB_TIMER_START(febblock);
+    if (n > QT_FEB_MANY_ONSTACK) {
+        order = MALLOC(n * sizeof(qt_feb_many_t));
+        if (order == NULL) {
+            return QTHREAD_MALLOC_ERROR;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        const aligned_t *alignedaddr;
+
+        if (me->flags & QTHREAD_LAZY_PARENT) {
+            /* if the task that fills src[i] has not started, run it here */
+            qthread_run_needed_task((void *)src[i]);
+        }
+        QALIGN(src[i], alignedaddr);
+        if (!qthread_feb_read_if_full(dest ? dest[i] : NULL, src[i], alignedaddr)) {
+            order[k].lockbin = QTHREAD_CHOOSE_STRIPE2(src[i]);
+            order[k].i       = i;
+            k++;
+        }
+    }
+    qsort(order, k, sizeof(qt_feb_many_t), qt_feb_many_cmp);
+    /* allocated up front, so that running out cannot leave this task queued
+     * on some addresses but not others */
+    for (size_t j = 0; j < k; j++) {
+        qthread_addrres_t *X = ALLOC_ADDRRES();
+
+        if (X == NULL) {
+            while (spare != NULL) {
+                X     = spare;
+                spare = X->next;
+                FREE_ADDRRES(X);
+            }
+            if (order != onstack) {
+                FREE(order, n * sizeof(qt_feb_many_t));
+            }
+            return QTHREAD_MALLOC_ERROR;
+        }
+        X->next = spare;
+        spare   = X;
+    }
+    for (size_t j = 0; j < k;) {
+        const unsigned int lockbin = order[j].lockbin;
+
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
+#ifndef LOCK_FREE_FEBS
+        qt_hash_lock(FEBs[lockbin]);
+#endif
+        for (; j < k && order[j].lockbin == lockbin; j++) {
+            const size_t        i = order[j].i;
+            const aligned_t    *alignedaddr;
+            qthread_addrstat_t *m;
+
+            QALIGN(src[i], alignedaddr);
+#ifdef LOCK_FREE_FEBS
+            do {
+                m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
+                if (!m) { break; }
+                hazardous_ptr(0, m);
+                if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
+                if (!m->valid) { continue; }
+                QTHREAD_FASTLOCK_LOCK(&m->lock);
+                if (!m->valid) {
+                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+                    continue;
+                }
+                break;
+            } while (1);
+#else       /* ifdef LOCK_FREE_FEBS */
+            m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
+            if (m) {
+                QTHREAD_FASTLOCK_LOCK(&m->lock);
+            }
+#endif      /* ifdef LOCK_FREE_FEBS */
+            if ((m == NULL) || (m->full == 1)) {
+                if (dest && dest[i] && (dest[i] != src[i])) {
+                    *dest[i] = *src[i];
+                }
+            } else {
+                qthread_addrres_t *X = spare;
+
+                if (queued++ == 0) {
+                    /* wakers look at these with m locked, so set them first */
+                    me->rdata->blockedon.pending = &pending;
+                    me->thread_state             = QTHREAD_STATE_FEB_MANY_BLOCKED;
+                }
+                (void)qthread_incr(&pending, 1);
+                spare     = X->next;
+                X->addr   = dest ? dest[i] : NULL;
+                X->waiter = me;
+                X->next   = m->FFQ;
+                m->FFQ    = X;
+                qthread_debug(FEB_DETAILS, "src[%u]=%p (tid=%u): queued\n", (unsigned)i, src[i], me->thread_id);
+            }
+            if (m) {
+                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            }
+        }
+#ifndef LOCK_FREE_FEBS
+        qt_hash_unlock(FEBs[lockbin]);
+#endif
+    }
+    while (spare != NULL) {
+        qthread_addrres_t *X = spare;
+
+        spare = X->next;
+        FREE_ADDRRES(X);
+    }
+    if (order != onstack) {
+        FREE(order, n * sizeof(qt_feb_many_t));
+    }
+    MACHINE_FENCE;
+    if (queued) {
+        QTHREAD_WAIT_TIMER_DECLARATION;
+        qthread_debug(FEB_DETAILS, "n=%u (tid=%u): waiting for %u addresses\n", (unsigned)n, me->thread_id, (unsigned)queued);
+        QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_FEB_MANY_BLOCKED);
+        QTHREAD_WAIT_TIMER_START();
+        qthread_back_to_master(me);
+        QTHREAD_WAIT_TIMER_STOP(me, febwait);
+#ifdef QTHREAD_USE_EUREKAS
+        qt_eureka_check(0);
+#endif /* QTHREAD_USE_EUREKAS */
+    }
+    qthread_debug(FEB_BEHAVIOR, "n=%u (tid=%u): succeeded\n", (unsigned)n, me->thread_id);
+    QTHREAD_FEB_TIMER_STOP(febblock, me);
+    return QTHREAD_SUCCESS;
+}                      /*}}} */
+
+int API_FUNC qthread_fill_many(const aligned_t *const *dest,
+                               size_t                  n)
+{                      /*{{{ */
+    qt_feb_many_t       onstack[QT_FEB_MANY_ONSTACK];
+    qt_feb_many_t      *order         = onstack;
+    qthread_addrres_t  *precond_tasks = NULL;
+    size_t              k             = 0;
+    qthread_shepherd_t *shep;
+
+    if ((qlib == NULL) || (n == 0)) {
+        return QTHREAD_SUCCESS;
+    }
+    qassert_ret(dest != NULL, QTHREAD_BADARGS);
+    shep = qthread_internal_getshep();
+
+    assert(qthread_library_initialized);
+
+    if (!shep) {
+        return qthread_feb_blocker_many(NULL, (void *)dest, n, FILL_MANY);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p, n=%u (tid=%i)\n", dest, (unsigned)n, qthread_id());
+    if (n > QT_FEB_MANY_ONSTACK) {
+        order = MALLOC(n * sizeof(qt_feb_many_t));
+        if (order == NULL) {
+            return QTHREAD_MALLOC_ERROR;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        const aligned_t *alignedaddr;
+
+        QALIGN(dest[i], alignedaddr);
+        if (!qthread_feb_surely_full(alignedaddr)) {
+            order[k].lockbin = QTHREAD_CHOOSE_STRIPE2(dest[i]);
+            order[k].i       = i;
+            k++;
+        }
+    }
+    qsort(order, k, sizeof(qt_feb_many_t), qt_feb_many_cmp);
+    for (size_t j = 0; j < k;) {
+        const unsigned int lockbin = order[j].lockbin;
+
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
+#ifndef LOCK_FREE_FEBS
+        qt_hash_lock(FEBs[lockbin]);
+#endif
+        for (; j < k && order[j].lockbin == lockbin; j++) {
+            const aligned_t    *alignedaddr;
+            qthread_addrstat_t *m;
+            int                 removeable;
+
+            QALIGN(dest[order[j].i], alignedaddr);
+#ifdef LOCK_FREE_FEBS
+            do {
+                m = qt_hash_get(FEBs[lockbin], (void *)alignedaddr);
+                if (!m) { break; }
+                hazardous_ptr(0, m);
+                if (m != qt_hash_get(FEBs[lockbin], (void *)alignedaddr)) { continue; }
+                if (!m->valid) { continue; }
+                QTHREAD_FASTLOCK_LOCK(&m->lock);
+                if (!m->valid) {
+                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+                    continue;
+                }
+                break;
+            } while (1);
+            if (!m) { continue; }
+            qthread_gotlock_fill_inner(shep, m, (void *)alignedaddr, 1, &precond_tasks);
+            removeable = (m->EFQ == NULL) && (m->FEQ == NULL) && (m->full == 1);
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            if (removeable) {
+                qthread_FEB_remove((void *)alignedaddr);
+            }
+#else       /* ifdef LOCK_FREE_FEBS */
+            m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
+            if (!m) { continue; }
+            QTHREAD_FASTLOCK_LOCK(&m->lock);
+            qthread_gotlock_fill_inner(shep, m, (void *)alignedaddr, 1, &precond_tasks);
+            /* the stripe is already locked, so remove it here rather than
+             * with qthread_FEB_remove() */
+            removeable = (m->EFQ == NULL) && (m->FEQ == NULL) && (m->FFQ == NULL) &&
+                         (m->FFWQ == NULL) && (m->full == 1);
+            if (removeable) {
+                qassertnot(qt_hash_remove_locked(FEBs[lockbin], (void *)alignedaddr), 0);
+            }
+            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            if (removeable) {
+                qthread_feb_absent(alignedaddr);
+                qthread_addrstat_delete(m);
+            }
+#endif      /* ifdef LOCK_FREE_FEBS */
+        }
+#ifndef LOCK_FREE_FEBS
+        qt_hash_unlock(FEBs[lockbin]);
+#endif
+    }
+    if (order != onstack) {
+        FREE(order, n * sizeof(qt_feb_many_t));
+    }
+    if (precond_tasks) {
+        qthread_precond_launch(shep, precond_tasks);
+    }
+    qthread_internal_handoff();
+    qthread_debug(FEB_DETAILS, "dest=%p, n=%u (tid=%i): success\n", dest, (unsigned)n, qthread_id());
+    return QTHREAD_SUCCESS;
+}                      /*}}} */
+
+/********************************************************************
+ * Inline FEB words
+ *
+ * A qt_feb_word_t's state holds QT_FEB_WORD_LOCKED, QT_FEB_WORD_EMPTY, and
+ * above them a sequence number that every unlock bumps. A full word can thus
+ * be read without locking it: read the state, then the data, then the state
+ * again, and if the state did not change, the data was full all along. Tasks
+ * blocked on a word are listed, newest first, in qt_feb_word_waiter_t records
+ * on their own stacks; the word stays locked until the shepherd has switched
+ * away from the blocked task (see qt_feb_word_release()).
+ *********************************************************************/
+#define QT_FEB_WORD_LOCKED ((aligned_t)1)
+#define QT_FEB_WORD_EMPTY  ((aligned_t)QT_FEB_WORD_EMPTY_BIT)
+#define QT_FEB_WORD_SEQ    ((aligned_t)4)
+
+typedef struct qt_feb_word_waiter_s {
+    qthread_t                   *waiter;
+    aligned_t                   *addr; /* READFF/READFE: where to copy the data to; WRITEEF: where from */
+    blocker_type                 type;
+    struct qt_feb_word_waiter_s *next;
+} qt_feb_word_waiter_t;
+
+/* returns the state, with QT_FEB_WORD_LOCKED set */
+static QINLINE aligned_t qt_feb_word_lock(qt_feb_word_t *w)
+{                      /*{{{ */
+    aligned_t s;
+
+    do {
+        s = *(volatile aligned_t *)&w->state;
+        if (s & QT_FEB_WORD_LOCKED) {
+            SPINLOCK_BODY();
+            continue;
+        }
+        if (qthread_cas(&w->state, s, s | QT_FEB_WORD_LOCKED) == s) {
+            return s | QT_FEB_WORD_LOCKED;
+        }
+    } while (1);
+}                      /*}}} */
+
+static QINLINE void qt_feb_word_unlock(qt_feb_word_t *w,
+                                       aligned_t      s)
+{                      /*{{{ */
+    MACHINE_FENCE;
+    *(volatile aligned_t *)&w->state = (s & ~QT_FEB_WORD_LOCKED) + QT_FEB_WORD_SEQ;
+}                      /*}}} */
+
+void INTERNAL qt_feb_word_release(qt_feb_word_t *w)
+{                      /*{{{ */
+    assert(w->state & QT_FEB_WORD_LOCKED);
+    qt_feb_word_unlock(w, w->state);
+}                      /*}}} */
+
+/* takes the oldest waiter of the given type off of w's list */
+static QINLINE qt_feb_word_waiter_t *qt_feb_word_dequeue(qt_feb_word_t *w,
+                                                          blocker_type   type)
+{                      /*{{{ */
+    qt_feb_word_waiter_t **found = NULL;
+
+    for (qt_feb_word_waiter_t **p = (qt_feb_word_waiter_t **)&w->waiters; *p; p = &(*p)->next) {
+        if ((*p)->type == type) {
+            found = p;
+        }
+    }
+    if (found) {
+        qt_feb_word_waiter_t *X = *found;
+
+        *found = X->next;
+        return X;
+    }
+    return NULL;
+}                      /*}}} */
+
+/* Settles w's waiters after its state changed to s (w is locked): a full word
+ * releases every readFF and then one readFE, which empties it; an empty word
+ * releases one writeEF, which fills it; and so on until nobody else can go.
+ * Returns the resulting state. */
+static aligned_t qt_feb_word_wake(qthread_shepherd_t *shep,
+                                  qt_feb_word_t      *w,
+                                  aligned_t           s)
+{                      /*{{{ */
+    qt_feb_word_waiter_t *X;
+
+    while (w->waiters) {
+        qthread_t *waiter;
+
+        if (s & QT_FEB_WORD_EMPTY) {
+            X = qt_feb_word_dequeue(w, WRITEEF);
+            if (X == NULL) {
+                break;
+            }
+            w->data = *X->addr;
+            s      &= ~QT_FEB_WORD_EMPTY;
+        } else {
+            while ((X = qt_feb_word_dequeue(w, READFF)) != NULL) {
+                waiter = X->waiter;
+                if (X->addr) {
+                    *X->addr = w->data;
+                }
+                qt_feb_schedule(waiter, shep);
+            }
+            X = qt_feb_word_dequeue(w, READFE);
+            if (X == NULL) {
+                break;
+            }
+            if (X->addr) {
+                *X->addr = w->data;
+            }
+            s |= QT_FEB_WORD_EMPTY;
+        }
+        /* X belongs to the waiter's stack, so do not touch it once it runs */
+        waiter = X->waiter;
+        qt_feb_schedule(waiter, shep);
+    }
+    return s;
+}                      /*}}} */
+
+/* queues me on w, which must be locked, and sleeps until a waker is done */
+static QINLINE void qt_feb_word_block(qthread_t     *me,
+                                      qt_feb_word_t *w,
+                                      aligned_t     *addr,
+                                      blocker_type   type)
+{                      /*{{{ */
+    qt_feb_word_waiter_t X = { me, addr, type, w->waiters };
+
+    QTHREAD_WAIT_TIMER_DECLARATION;
+    w->waiters                = &X;
+    me->thread_state          = QTHREAD_STATE_FEB_WORD_BLOCKED;
+    QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_FEB_WORD_BLOCKED);
+    me->rdata->blockedon.word = w;
+    QTHREAD_WAIT_TIMER_START();
+    qthread_back_to_master(me);
+    QTHREAD_WAIT_TIMER_STOP(me, febwait);
+#ifdef QTHREAD_USE_EUREKAS
+    qt_eureka_check(0);
+#endif /* QTHREAD_USE_EUREKAS */
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_status(const qt_feb_word_t *w)
+{                      /*{{{ */
+    assert(w);
+    return (*(volatile aligned_t *)&w->state & QT_FEB_WORD_EMPTY) == 0;
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_empty(qt_feb_word_t *dest)
+{                      /*{{{ */
+    qthread_shepherd_t *shep = qthread_internal_getshep();
+    aligned_t           s;
+
+    assert(qthread_library_initialized);
+    assert(dest);
+    if (!shep) {
+        return qthread_feb_blocker_func(dest, NULL, WORD_EMPTY);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p (tid=%i)\n", dest, qthread_id());
+    s = qt_feb_word_lock(dest);
+    s = qt_feb_word_wake(shep, dest, s | QT_FEB_WORD_EMPTY);
+    qt_feb_word_unlock(dest, s);
+    qthread_internal_handoff();
+    return QTHREAD_SUCCESS;
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_fill(qt_feb_word_t *dest)
+{                      /*{{{ */
+    qthread_shepherd_t *shep = qthread_internal_getshep();
+    aligned_t           s;
+
+    assert(qthread_library_initialized);
+    assert(dest);
+    if (!shep) {
+        return qthread_feb_blocker_func(dest, NULL, WORD_FILL);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p (tid=%i)\n", dest, qthread_id());
+    s = qt_feb_word_lock(dest);
+    s = qt_feb_word_wake(shep, dest, s & ~QT_FEB_WORD_EMPTY);
+    qt_feb_word_unlock(dest, s);
+    qthread_internal_handoff();
+    return QTHREAD_SUCCESS;
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_writeF(qt_feb_word_t *restrict   dest,
+                                     const aligned_t *restrict src)
+{                      /*{{{ */
+    qthread_shepherd_t *shep = qthread_internal_getshep();
+    aligned_t           s;
+
+    assert(qthread_library_initialized);
+    assert(dest);
+    if (!shep) {
+        return qthread_feb_blocker_func(dest, (void *)src, WORD_WRITEF);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p, src=%p (tid=%i)\n", dest, src, qthread_id());
+    s          = qt_feb_word_lock(dest);
+    dest->data = *src;
+    s          = qt_feb_word_wake(shep, dest, s & ~QT_FEB_WORD_EMPTY);
+    qt_feb_word_unlock(dest, s);
+    qthread_internal_handoff();
+    return QTHREAD_SUCCESS;
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_writeF_const(qt_feb_word_t *dest,
+                                           aligned_t      src)
+{                      /*{{{ */
+    return qthread_feb_word_writeF(dest, &src);
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_writeEF(qt_feb_word_t *restrict   dest,
+                                      const aligned_t *restrict src)
+{                      /*{{{ */
+    qthread_t *me = qthread_internal_self();
+    aligned_t  s;
+
+    assert(qthread_library_initialized);
+    assert(dest);
+    if (!me) {
+        return qthread_feb_blocker_func(dest, (void *)src, WORD_WRITEEF);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p, src=%p (tid=%i)\n", dest, src, me->thread_id);
+    s = qt_feb_word_lock(dest);
+    if (s & QT_FEB_WORD_EMPTY) {
+        dest->data = *src;
+        s          = qt_feb_word_wake(me->rdata->shepherd_ptr, dest, s & ~QT_FEB_WORD_EMPTY);
+        qt_feb_word_unlock(dest, s);
+        qthread_internal_handoff();
+    } else {
+        /* the waker copies *src for us */
+        qt_feb_word_block(me, dest, (aligned_t *)src, WRITEEF);
+    }
+    return QTHREAD_SUCCESS;
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_writeEF_const(qt_feb_word_t *dest,
+                                            aligned_t      src)
+{                      /*{{{ */
+    return qthread_feb_word_writeEF(dest, &src);
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_readFF(aligned_t *restrict     dest,
+                                     qt_feb_word_t *restrict src)
+{                      /*{{{ */
+    qthread_t *me = qthread_internal_self();
+    aligned_t  s;
+
+    assert(qthread_library_initialized);
+    assert(src);
+    if (!me) {
+        return qthread_feb_blocker_func(dest, src, WORD_READFF);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p, src=%p (tid=%i)\n", dest, src, me->thread_id);
+    s = *(volatile aligned_t *)&src->state;
+    if ((s & (QT_FEB_WORD_LOCKED | QT_FEB_WORD_EMPTY)) == 0) {
+        aligned_t data;
+
+        QT_FEB_READ_FENCE;
+        data = *(volatile aligned_t *)&src->data;
+        QT_FEB_READ_FENCE;
+        if (*(volatile aligned_t *)&src->state == s) {
+            if (dest) {
+                *dest = data;
+            }
+            return QTHREAD_SUCCESS;
+        }
+    }
+    s = qt_feb_word_lock(src);
+    if (s & QT_FEB_WORD_EMPTY) {
+        qt_feb_word_block(me, src, dest, READFF);
+    } else {
+        if (dest) {
+            *dest = src->data;
+        }
+        qt_feb_word_unlock(src, s);
+    }
+    return QTHREAD_SUCCESS;
+}                      /*}}} */
+
+int API_FUNC qthread_feb_word_readFE(aligned_t *restrict     dest,
+                                     qt_feb_word_t *restrict src)
+{                      /*{{{ */
+    qthread_t *me = qthread_internal_self();
+    aligned_t  s;
+
+    assert(qthread_library_initialized);
+    assert(src);
+    if (!me) {
+        return qthread_feb_blocker_func(dest, src, WORD_READFE);
+    }
+    qthread_debug(FEB_CALLS, "dest=%p, src=%p (tid=%i)\n", dest, src, me->thread_id);
+    s = qt_feb_word_lock(src);
+    if (s & QT_FEB_WORD_EMPTY) {
+        qt_feb_word_block(me, src, dest, READFE);
+    } else {
+        if (dest) {
+            *dest = src->data;
+        }
+        s = qt_feb_word_wake(me->rdata->shepherd_ptr, src, s | QT_FEB_WORD_EMPTY);
+        qt_feb_word_unlock(src, s);
+        qthread_internal_handoff();
+    }
+    return QTHREAD_SUCCESS;
+}                      /*}}} */
+
 #ifdef QTHREAD_COUNT_THREADS
 extern aligned_t             threadcount;
 extern aligned_t             maxconcurrentthreads;
@@ -1584,6 +2420,8 @@ extern QTHREAD_FASTLOCK_TYPE effconcurrentthreads_lock;
  *
  * This is a modified readFF() that does not suspend the calling thread, but
  * simply enqueues the specified qthread in the FFQ associated with the target.
+ * Preconditions marked with QTHREAD_PRECOND_SYNCVAR() are syncvar_t's, which
+ * are checked (and waited for) by qthread_syncvar_precond() instead.
  */
 int INTERNAL qthread_check_feb_preconds(qthread_t *t)
 {   /*{{{*/
@@ -1600,13 +2438,31 @@ int INTERNAL qthread_check_feb_preconds(qthread_t *t)
     // Process input preconds
     while (these_preconds && (these_preconds[0] != NULL)) {
         aligned_t          *this_sync = these_preconds[(uintptr_t)these_preconds[0]];
-        const int           lockbin   = QTHREAD_CHOOSE_STRIPE2(this_sync);
         const aligned_t    *alignedaddr;
         qthread_addrstat_t *m = NULL;
 
+        if ((uintptr_t)this_sync & 1) {
+            /* a syncvar_t, marked by QTHREAD_PRECOND_SYNCVAR() */
+            switch (qthread_syncvar_precond((syncvar_t *)((uintptr_t)this_sync & ~(uintptr_t)1), t)) {
+                case 0:
+                    these_preconds[0] = (aligned_t *)(((uintptr_t)these_preconds[0]) - 1);
+                    continue;
+                case 1:
+                    return 1;
+                default:
+                    abort();
+                    return QTHREAD_MALLOC_ERROR;
+            }
+        }
         QTHREAD_FEB_UNIQUERECORD2(feb, this_sync, curshep);
         QTHREAD_FEB_TIMER_START(febblock);
         QALIGN(this_sync, alignedaddr);
+        if (qthread_feb_surely_full(alignedaddr)) {
+            these_preconds[0] = (aligned_t *)(((uintptr_t)these_preconds[0]) - 1);
+            qthread_debug(FEB_DETAILS, "precond=%p (tid=%u): address already full\n", this_sync, t->thread_id);
+            continue;
+        }
+        const int lockbin = QTHREAD_CHOOSE_STRIPE2(this_sync);
         QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
 #ifdef LOCK_FREE_FEBS
         do {
@@ -1695,17 +2551,9 @@ static filter_code qt_feb_tf_call_cb(const qt_key_t            addr,
     void             *tls;
 
     if (waiter->rdata->tasklocal_size <= qlib->qthread_tasklocal_size) {
-        if (waiter->flags & QTHREAD_BIG_STRUCT) {
-            tls = &waiter->data[qlib->qthread_argcopy_size];
-        } else {
-            tls = waiter->data;
-        }
+        tls = waiter->data;
     } else {
-        if (waiter->flags & QTHREAD_BIG_STRUCT) {
-            tls = *(void **)&waiter->data[qlib->qthread_argcopy_size];
-        } else {
-            tls = *(void **)&waiter->data[0];
-        }
+        tls = *(void **)&waiter->data[0];
     }
     f((void *)addr, waiter->f, waiter->arg, waiter->ret, waiter->thread_id, tls, f_arg);
     return IGNORE_AND_CONTINUE;
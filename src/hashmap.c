@@ -27,8 +27,13 @@ typedef struct {
     void    *value;
 } hash_entry;
 
+/* Each synchronized hash carries its own lock and is allocated on cache-line
+ * boundaries, so that neighbouring hashes (e.g. the FEB locking stripes) do
+ * not false-share their lock words. */
 struct qt_hash_s {
     QTHREAD_FASTLOCK_TYPE *lock;
+    QTHREAD_FASTLOCK_TYPE  lockstore;
+    size_t                 acquisitions, contended; // protected by the lock
     hash_entry            *entries;
     uint64_t               mask;
     size_t                 num_entries;
@@ -41,6 +46,7 @@ struct qt_hash_s {
 static uint_fast8_t linesize = 0;
 static uint_fast8_t bucketsize;
 static size_t bucketmask;
+static size_t hashsize; // sizeof(struct qt_hash_s), padded to a cache line
 #define KEY_NULL    ((qt_key_t)0)
 #define KEY_DELETED ((qt_key_t)1)
 
@@ -78,9 +84,24 @@ static inline void qt_hash_internal_create(qt_hash ret,
     assert(ret->entries);
     if (ret->entries) {
         memset(ret->entries, 0, sizeof(hash_entry) * entries);
-    } else {
-        FREE(ret, sizeof(struct qt_hash_s));
-        ret = NULL;
+    }
+} /*}}}*/
+
+static inline void qt_hash_internal_lock(qt_hash h)
+{   /*{{{*/
+    if (h->lock) {
+        if (!QTHREAD_FASTLOCK_TRY(h->lock)) {
+            QTHREAD_FASTLOCK_LOCK(h->lock);
+            h->contended++;
+        }
+        h->acquisitions++;
+    }
+} /*}}}*/
+
+static inline void qt_hash_internal_unlock(qt_hash h)
+{   /*{{{*/
+    if (h->lock) {
+        QTHREAD_FASTLOCK_UNLOCK(h->lock);
     }
 } /*}}}*/
 
@@ -134,21 +155,27 @@ void INTERNAL qt_hash_initialize_subsystem(void)
     linesize = qthread_cacheline();
     bucketsize = linesize / sizeof(hash_entry);
     bucketmask = bucketsize - 1;
+    hashsize   = (sizeof(struct qt_hash_s) + linesize - 1) & ~(size_t)(linesize - 1);
 }
 
 qt_hash INTERNAL qt_hash_create(int needSync)
 {   /*{{{*/
     qt_hash ret;
 
-    ret = qt_calloc(1, sizeof(struct qt_hash_s));
+    ret = qt_internal_aligned_alloc(hashsize, linesize);
     if (ret) {
+        memset(ret, 0, hashsize);
         if (needSync) {
-            ret->lock = MALLOC(sizeof(QTHREAD_FASTLOCK_TYPE));
+            ret->lock = &ret->lockstore;
             QTHREAD_FASTLOCK_INIT_PTR(ret->lock);
         } else {
             ret->lock = NULL;
         }
         qt_hash_internal_create(ret, 100);
+        if (ret->entries == NULL) {
+            qt_internal_aligned_free(ret, linesize);
+            ret = NULL;
+        }
     }
     return ret;
 } /*}}}*/
@@ -158,11 +185,10 @@ void INTERNAL qt_hash_destroy(qt_hash h)
     assert(h);
     if (h->lock) {
         QTHREAD_FASTLOCK_DESTROY_PTR(h->lock);
-        FREE((void *)h->lock, sizeof(QTHREAD_FASTLOCK_TYPE));
     }
     assert(h->entries);
     qt_internal_aligned_free(h->entries, linesize);
-    FREE(h, sizeof(struct qt_hash_s));
+    qt_internal_aligned_free(h, linesize);
 } /*}}}*/
 
 /* This function destroys the hash and applies the given deallocator function
@@ -173,9 +199,7 @@ void INTERNAL qt_hash_destroy_deallocate(qt_hash                h,
     size_t visited = 0;
 
     assert(h);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_LOCK(h->lock);
-    }
+    qt_hash_internal_lock(h);
     if (h->has_key[0] == 1) {
         ++visited;
         f(h->value[0]);
@@ -197,9 +221,7 @@ void INTERNAL qt_hash_destroy_deallocate(qt_hash                h,
         }
     }
     assert(visited == h->population);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_UNLOCK(h->lock);
-    }
+    qt_hash_internal_unlock(h);
     qt_hash_destroy(h);
 } /*}}}*/
 
@@ -212,13 +234,9 @@ int INTERNAL qt_hash_put(qt_hash  h,
     int ret;
 
     assert(h);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_LOCK(h->lock);
-    }
+    qt_hash_internal_lock(h);
     ret = qt_hash_put_locked(h, key, value);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_UNLOCK(h->lock);
-    }
+    qt_hash_internal_unlock(h);
     return ret;
 } /*}}}*/
 
@@ -361,13 +379,9 @@ int INTERNAL qt_hash_remove(qt_hash        h,
     int ret;
 
     assert(h);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_LOCK(h->lock);
-    }
+    qt_hash_internal_lock(h);
     ret = qt_hash_remove_locked(h, key);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_UNLOCK(h->lock);
-    }
+    qt_hash_internal_unlock(h);
     return ret;
 } /*}}}*/
 
@@ -409,13 +423,9 @@ void INTERNAL *qt_hash_get(qt_hash        h,
     void *ret;
 
     assert(h);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_LOCK(h->lock);
-    }
+    qt_hash_internal_lock(h);
     ret = qt_hash_get_locked(h, key);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_UNLOCK(h->lock);
-    }
+    qt_hash_internal_unlock(h);
     return (void *)ret;
 } /*}}}*/
 
@@ -440,9 +450,7 @@ void INTERNAL qt_hash_callback(qt_hash             h,
     size_t visited = 0;
 
     assert(h);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_LOCK(h->lock);
-    }
+    qt_hash_internal_lock(h);
     if (h->has_key[0] == 1) {
         ++visited;
         f(KEY_NULL, h->value[0], arg);
@@ -463,9 +471,7 @@ void INTERNAL qt_hash_callback(qt_hash             h,
             }
         }
     }
-    if (h->lock) {
-        QTHREAD_FASTLOCK_UNLOCK(h->lock);
-    }
+    qt_hash_internal_unlock(h);
 } /*}}}*/
 
 size_t INTERNAL qt_hash_count(qt_hash h)
@@ -473,30 +479,32 @@ size_t INTERNAL qt_hash_count(qt_hash h)
     size_t ct;
 
     assert(h);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_LOCK(h->lock);
-    }
+    qt_hash_internal_lock(h);
     ct = h->population + h->has_key[0] + h->has_key[1];
-    if (h->lock) {
-        QTHREAD_FASTLOCK_UNLOCK(h->lock);
-    }
+    qt_hash_internal_unlock(h);
     return ct;
 } /*}}}*/
 
 void INTERNAL qt_hash_lock(qt_hash h)
 {   /*{{{*/
     assert(h);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_LOCK(h->lock);
-    }
+    qt_hash_internal_lock(h);
 } /*}}}*/
 
 void INTERNAL qt_hash_unlock(qt_hash h)
 {   /*{{{*/
     assert(h);
-    if (h->lock) {
-        QTHREAD_FASTLOCK_UNLOCK(h->lock);
-    }
+    qt_hash_internal_unlock(h);
+} /*}}}*/
+
+void INTERNAL qt_hash_lock_stats(qt_hash h,
+                                 size_t *acquisitions,
+                                 size_t *contended)
+{   /*{{{*/
+    assert(h);
+    /* racy reads; these are statistics */
+    *acquisitions = h->acquisitions;
+    *contended    = h->contended;
 } /*}}}*/
 
 /* vim:set expandtab: */
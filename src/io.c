@@ -80,10 +80,14 @@ static void *qt_blocking_subsystem_proxy_thread(void *QUNUSED(arg))
 {   /*{{{*/
     while (proxy_exit == 0) {
         if (qt_process_blocking_call()) {
-            break;
+            /* timed out; qt_process_blocking_call() already retired us */
+            qthread_debug(IO_DETAILS, "idle, exiting\n");
+            pthread_exit(NULL);
         }
         COMPILER_FENCE;
     }
+    /* stopwork() is waiting for every proxy to leave */
+    (void)qthread_incr(&io_worker_count, -1);
     qthread_debug(IO_DETAILS, "proxy_exit = %i, exiting\n", proxy_exit);
     pthread_exit(NULL);
     return 0;
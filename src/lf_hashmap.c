@@ -415,4 +415,14 @@ void INTERNAL qt_hash_callback(qt_hash             h,
     }
 }
 
+void INTERNAL qt_hash_lock_stats(qt_hash h,
+                                 size_t *acquisitions,
+                                 size_t *contended)
+{
+    assert(h);
+    /* there is no lock */
+    *acquisitions = 0;
+    *contended    = 0;
+}
+
 /* vim:set expandtab: */
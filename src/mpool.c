@@ -35,6 +35,9 @@
 #include "qt_visibility.h"
 #include "qt_alloc.h"
 #include "qt_subsystems.h"
+#include "qthread_innards.h"           /* for qlib (and hwloc.h) */
+#include "qt_shepherd_innards.h"       /* for the shepherds' mem_node */
+#include "qt_affinity.h"
 
 /* Seems SLIGHTLY faster without TLS, and a whole lot safer and cleaner */
 #ifdef TLS
@@ -50,11 +53,56 @@ static aligned_t                      pool_cache_global_max = 1;
 static qt_mpool_threadlocal_cache_t **pool_cache_array      = NULL;
 #endif
 
+typedef struct qt_mpool_cache_entry_s {
+    struct qt_mpool_cache_entry_s *next;
+    struct qt_mpool_cache_entry_s *block_tail;
+    uint8_t                        data[];
+} qt_mpool_cache_t;
+
+/* The reuse pool is a stack of chains of exactly items_per_alloc items, each
+ * linked through its head's block_tail (the chain's own tail is found from
+ * any item after the head). Where there is a 128-bit CAS, the top of the
+ * stack is tagged with a count of the changes made to it, so that a chain
+ * popped and pushed back between another thread's read and its CAS cannot
+ * be mistaken for an unchanged stack; otherwise, a lock protects it. */
+#if defined(QTHREAD_ATOMIC_CAS128) && (QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64)
+# define QT_MPOOL_LOCKFREE_REUSE
+#endif
+typedef struct qt_mpool_reuse_s {
+    qt_mpool_cache_t *chain;
+    uintptr_t         tag;
+} Q_ALIGNED(16) qt_mpool_reuse_t;
+
+/* A pool keeps one arena per memory node. Blocks are allocated on the node
+ * of the worker that needs them, and their items are only ever cached by
+ * workers of that node: an item freed on another node is pushed onto its
+ * arena's remote_frees list instead, and a worker of the owning node takes
+ * that list back, all at once, when its cache runs dry. */
+typedef struct qt_mpool_arena_s {
+    volatile qt_mpool_reuse_t reuse;
+#ifndef QT_MPOOL_LOCKFREE_REUSE
+    QTHREAD_FASTLOCK_TYPE     reuse_lock;
+#endif
+
+    Q_ALIGNED(CACHELINE_WIDTH) qt_mpool_cache_t *volatile remote_frees;
+} qt_mpool_arena_t;
+
+/* Blocks are aligned to their size, a power of two, so that this header at
+ * the start of every block can be found from any of its items. */
+typedef struct qt_mpool_block_s {
+    struct qt_mpool_block_s *next; /* every block of the pool, for cleanup */
+    unsigned int             arena;
+} qt_mpool_block_t;
+
+#define QT_MPOOL_BLOCK(pool, mem) \
+    ((qt_mpool_block_t *)((uintptr_t)(mem) & ~(uintptr_t)((pool)->alloc_size - 1)))
+
 struct qt_mpool_s {
     size_t item_size;
-    size_t alloc_size;
+    size_t alloc_size;     /* the size, and alignment, of each block */
     size_t items_per_alloc;
     size_t alignment;
+    size_t block_offset;   /* of the first item in a block */
 
 #ifdef TLS
     size_t                        offset;
@@ -63,28 +111,25 @@ struct qt_mpool_s {
 #endif
     qt_mpool_threadlocal_cache_t *caches;  // for cleanup
 
-    QTHREAD_FASTLOCK_TYPE         reuse_lock;
-    void                         *reuse_pool;
+    unsigned int                  num_arenas;
+    qt_mpool_arena_t             *arenas;
 
-    QTHREAD_FASTLOCK_TYPE         pool_lock;
-    void                        **alloc_list;
-    size_t                        alloc_list_pos;
+    qt_mpool_block_t *volatile    blocks;
 };
 
-typedef struct qt_mpool_cache_entry_s {
-    struct qt_mpool_cache_entry_s *next;
-    struct qt_mpool_cache_entry_s *block_tail;
-    uint8_t                        data[];
-} qt_mpool_cache_t;
-
 struct threadlocal_cache_s {
     qt_mpool_cache_t             *cache;
     uint_fast16_t                 count;
     uint8_t                      *block;
     uint_fast32_t                 i;
+    unsigned int                  arena; /* the one this thread allocates from */
+    int                           node;  /* its memory node, or -1 if it has none */
     qt_mpool_threadlocal_cache_t *next;  // for cleanup
 };
 
+/* items freed on a node other than their own, counted as they are taken back */
+static aligned_t remote_frees_taken = 0;
+
 #ifdef TLS
 static void qt_mpool_subsystem_shutdown(void)
 {
@@ -112,6 +157,24 @@ void INTERNAL qt_mpool_subsystem_init(void)
 }
 
 /* local funcs */
+/* One arena per memory node that shepherds run on (a shepherd's mem_node,
+ * which is -1 if it has none); until shepherds have nodes, just one. */
+static unsigned int qt_mpool_internal_num_arenas(void)
+{                                      /*{{{ */
+    unsigned int n = 1;
+
+    if (qlib && qlib->shepherds) {
+        for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+            const int node = qlib->shepherds[i].mem_node;
+
+            if ((node >= 0) && ((unsigned int)node >= n)) {
+                n = (unsigned int)node + 1;
+            }
+        }
+    }
+    return n;
+}                                      /*}}} */
+
 static QINLINE void *qt_mpool_internal_aligned_alloc(size_t alloc_size,
                                                      size_t alignment)
 {                                      /*{{{ */
@@ -200,23 +263,46 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
             alloc_size *= 2;
         }
     }
+    /* finally, round the block up to a power of two, with room for its
+     * header and at least two items */
+    pool->block_offset = sizeof(qt_mpool_block_t);
+    if (pool->block_offset % alignment) {
+        pool->block_offset += alignment - (pool->block_offset % alignment);
+    }
+    {
+        size_t block_size = pagesize;
+
+        while (block_size < alloc_size) {
+            block_size *= 2;
+        }
+        if ((block_size > max_alloc_size) &&
+            ((block_size / 2 - pool->block_offset) / item_size >= 2)) {
+            block_size /= 2;
+        }
+        while ((block_size - pool->block_offset) / item_size < 2) {
+            block_size *= 2;
+        }
+        alloc_size = block_size;
+    }
     pool->alloc_size      = alloc_size;
-    pool->items_per_alloc = alloc_size / item_size;
-    pool->reuse_pool      = NULL;
-    QTHREAD_FASTLOCK_INIT(pool->reuse_lock);
-    QTHREAD_FASTLOCK_INIT(pool->pool_lock);
+    pool->items_per_alloc = (alloc_size - pool->block_offset) / item_size;
+    pool->num_arenas      = qt_mpool_internal_num_arenas();
+    pool->arenas          = qt_internal_aligned_alloc(pool->num_arenas * sizeof(qt_mpool_arena_t), CACHELINE_WIDTH);
+    qassert_goto((pool->arenas != NULL), errexit);
+    for (unsigned int a = 0; a < pool->num_arenas; a++) {
+        pool->arenas[a].reuse.chain  = NULL;
+        pool->arenas[a].reuse.tag    = 0;
+        pool->arenas[a].remote_frees = NULL;
+#ifndef QT_MPOOL_LOCKFREE_REUSE
+        QTHREAD_FASTLOCK_INIT(pool->arenas[a].reuse_lock);
+#endif
+    }
 #ifdef TLS
     pool->offset = qthread_incr(&pool_cache_global_max, 1);
 #else
     pthread_key_create(&pool->threadlocal_cache, NULL);
 #endif
-    /* this assumes that pagesize is a multiple of sizeof(void*) */
-    assert(pagesize % sizeof(void *) == 0);
-    pool->alloc_list = qt_internal_aligned_alloc(pagesize, pagesize);
-    qassert_goto((pool->alloc_list != NULL), errexit);
-    memset(pool->alloc_list, 0, pagesize);
-    pool->alloc_list_pos = 0;
-
+    pool->blocks = NULL;
     pool->caches = NULL;
     return pool;
 
@@ -227,6 +313,17 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
     return NULL;
 }                                      /*}}} */
 
+/* Which node is the calling thread on, and so which arena of pool does it
+ * allocate from? */
+static void qt_mpool_internal_sethome(qt_mpool                      pool,
+                                      qt_mpool_threadlocal_cache_t *tc)
+{   /*{{{*/
+    const qthread_shepherd_id_t shep = qthread_shep();
+
+    tc->node  = (shep == NO_SHEPHERD) ? -1 : qlib->shepherds[shep].mem_node;
+    tc->arena = (tc->node < 0) ? 0 : ((unsigned int)tc->node % pool->num_arenas);
+} /*}}}*/
+
 static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
 {
     qt_mpool_threadlocal_cache_t *tc;
@@ -268,6 +365,7 @@ static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
                     qthread_debug(MPOOL_DETAILS, "leaking memory (%p)\n", newtc);
                 }
             }
+            /* NB: these caches all allocate from arena 0 */
             memset(tc + count_caches, 0, sizeof(qt_mpool_threadlocal_cache_t) * (pool->offset - count_caches));
             count_caches = pool->offset;
             TLS_SET(pool_cache_count, count_caches);
@@ -301,6 +399,7 @@ static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
         tc->count = 0;
         tc->block = NULL;
         tc->i     = 0;
+        qt_mpool_internal_sethome(pool, tc);
         do {
             tc->next = pool->caches;
         } while (qthread_cas_ptr(&pool->caches, tc->next, tc) != tc->next);
@@ -311,6 +410,152 @@ static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
     return tc;
 }
 
+#ifdef QT_MPOOL_LOCKFREE_REUSE
+static QINLINE int qt_mpool_internal_cas128(volatile qt_mpool_reuse_t *addr,
+                                            qt_mpool_reuse_t          *cmp,
+                                            qt_mpool_reuse_t           with)
+{   /*{{{*/
+    char ok;
+
+    /* on failure, cmp is updated to what was found */
+    __asm__ __volatile__ ("lock; cmpxchg16b %1\n\t"
+                          "setz %0"
+                          : "=q" (ok),
+                          "+m" (*addr),
+                          "+a" (cmp->chain),
+                          "+d" (cmp->tag)
+                          : "b" (with.chain),
+                          "c" (with.tag)
+                          : "cc", "memory");
+    return ok;
+} /*}}}*/
+#endif /* ifdef QT_MPOOL_LOCKFREE_REUSE */
+
+/* Push chain, items_per_alloc items ending in a NULL next, onto the arena's
+ * reuse pool. */
+static QINLINE void qt_mpool_internal_reuse_push(qt_mpool_arena_t *arena,
+                                                 qt_mpool_cache_t *chain)
+{   /*{{{*/
+    assert(chain->block_tail->next == NULL);
+#ifdef QT_MPOOL_LOCKFREE_REUSE
+    qt_mpool_reuse_t top, with;
+
+    top.tag    = arena->reuse.tag;
+    top.chain  = arena->reuse.chain;
+    with.chain = chain;
+    do {
+        chain->block_tail = top.chain;
+        with.tag          = top.tag + 1;
+    } while (!qt_mpool_internal_cas128(&arena->reuse, &top, with));
+#else
+    QTHREAD_FASTLOCK_LOCK(&arena->reuse_lock);
+    chain->block_tail  = arena->reuse.chain;
+    arena->reuse.chain = chain;
+    QTHREAD_FASTLOCK_UNLOCK(&arena->reuse_lock);
+#endif
+} /*}}}*/
+
+/* Pop a chain off the arena's reuse pool, or return NULL if it is empty. */
+static QINLINE qt_mpool_cache_t *qt_mpool_internal_reuse_pop(qt_mpool_arena_t *arena)
+{   /*{{{*/
+    qt_mpool_cache_t *chain;
+
+#ifdef QT_MPOOL_LOCKFREE_REUSE
+    qt_mpool_reuse_t top, with;
+
+    top.tag    = arena->reuse.tag;
+    top.chain  = arena->reuse.chain;
+    do {
+        chain = top.chain;
+        if (chain == NULL) { return NULL; }
+        /* Pool memory is never unmapped before the pool is destroyed, so
+         * even if another thread has taken this chain meanwhile, reading its
+         * link is safe; the tag makes sure a stale link is never installed. */
+        with.chain = chain->block_tail;
+        with.tag   = top.tag + 1;
+    } while (!qt_mpool_internal_cas128(&arena->reuse, &top, with));
+#else
+    QTHREAD_FASTLOCK_LOCK(&arena->reuse_lock);
+    chain = arena->reuse.chain;
+    if (chain) {
+        arena->reuse.chain = chain->block_tail;
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&arena->reuse_lock);
+    if (chain == NULL) { return NULL; }
+#endif
+    /* every item after the head points at the tail */
+    chain->block_tail = chain->next->block_tail;
+    assert(chain->block_tail->next == NULL);
+    return chain;
+} /*}}}*/
+
+/* Put n, an item of tc's arena, in tc's cache; a full block's worth beyond
+ * what the cache keeps goes to the arena's reuse pool. */
+static QINLINE void qt_mpool_internal_cache_push(qt_mpool                      pool,
+                                                 qt_mpool_threadlocal_cache_t *tc,
+                                                 qt_mpool_cache_t             *n)
+{   /*{{{*/
+    qt_mpool_cache_t *cache           = tc->cache;
+    size_t            cnt             = tc->count;
+    const size_t      items_per_alloc = pool->items_per_alloc;
+
+    qthread_debug(MPOOL_DETAILS, "->cache:%p (bt:%p) cnt:%u\n", cache, cache ? cache->block_tail : NULL, (unsigned int)cnt);
+    if (cache) {
+        assert(cnt != 0);
+        n->next       = cache;
+        n->block_tail = cache->block_tail; // cache is likely to be IN cache, so this won't be slow
+    } else {
+        assert(cnt == 0);
+        n->next       = NULL;
+        n->block_tail = n;
+    }
+    cnt++;
+    if (cnt >= (items_per_alloc * 2)) {
+        qt_mpool_arena_t *arena = &pool->arenas[tc->arena];
+        qt_mpool_cache_t *toglobal;
+        /* push to global */
+        qthread_debug(MPOOL_BEHAVIOR, "->push to global! cnt:%u\n", (unsigned)cnt);
+        assert(n);
+        assert(n->block_tail);
+        toglobal            = n->block_tail->next;
+        n->block_tail->next = NULL;
+        assert(toglobal);
+        assert(toglobal->block_tail);
+        qt_mpool_internal_reuse_push(arena, toglobal);
+        cnt -= items_per_alloc;
+    } else if (cnt == items_per_alloc + 1) {
+        qthread_debug(MPOOL_BEHAVIOR, "->chop_block\n");
+        n->block_tail = n;
+    }
+    tc->cache = n;
+    tc->count = cnt;
+    qthread_debug(MPOOL_DETAILS, "->free count = %zu\n", (size_t)cnt);
+} /*}}}*/
+
+/* Take back, into tc's cache, everything other nodes freed to tc's arena. */
+static void qt_mpool_internal_take_remote(qt_mpool                      pool,
+                                          qt_mpool_threadlocal_cache_t *tc)
+{   /*{{{*/
+    qt_mpool_arena_t *arena = &pool->arenas[tc->arena];
+    qt_mpool_cache_t *list  = arena->remote_frees;
+    qt_mpool_cache_t *old;
+    aligned_t         cnt = 0;
+
+    /* Nothing but this ever removes items from the list, and it takes them
+     * all, so there is no ABA problem. */
+    while ((old = qthread_cas_ptr((void **)&arena->remote_frees, list, NULL)) != list) {
+        list = old;
+    }
+    while (list) {
+        qt_mpool_cache_t *next = list->next;
+        qt_mpool_internal_cache_push(pool, tc, list);
+        list = next;
+        cnt++;
+    }
+    qthread_debug(MPOOL_BEHAVIOR, "->took back %u remote frees\n", (unsigned)cnt);
+    qthread_incr(&remote_frees_taken, cnt);
+} /*}}}*/
+
 void INTERNAL *qt_mpool_alloc(qt_mpool pool)
 {   /*{{{*/
     qt_mpool_threadlocal_cache_t *tc;
@@ -321,6 +566,9 @@ void INTERNAL *qt_mpool_alloc(qt_mpool pool)
 
     tc = qt_mpool_internal_getcache(pool);
     qthread_debug(MPOOL_BEHAVIOR, "->tc:%p cache:%p (bt:%p) cnt:%u\n", tc, tc->cache, tc->cache ? tc->cache->block_tail : NULL, (unsigned int)tc->count);
+    if ((tc->cache == NULL) && (tc->block == NULL) && pool->arenas[tc->arena].remote_frees) {
+        qt_mpool_internal_take_remote(pool, tc);
+    }
     if (tc->cache) {
         qt_mpool_cache_t *cache = tc->cache;
         qthread_debug(MPOOL_DETAILS, "->...cached count:%zu\n", (size_t)tc->count - 1);
@@ -338,45 +586,42 @@ void INTERNAL *qt_mpool_alloc(qt_mpool pool)
         return ret;
     } else {
         const size_t      items_per_alloc = pool->items_per_alloc;
+        qt_mpool_arena_t *arena           = &pool->arenas[tc->arena];
         qt_mpool_cache_t *cache           = NULL;
 
         cnt = 0;
         /* cache is empty; need to fill it */
-        if (pool->reuse_pool) { // global cache
+        if (arena->reuse.chain) { // node-wide cache
             qthread_debug(MPOOL_BEHAVIOR, "->...pull from reuse\n");
-            QTHREAD_FASTLOCK_LOCK(&pool->reuse_lock);
-            if (pool->reuse_pool) {
-                cache                   = pool->reuse_pool;
-                pool->reuse_pool        = cache->block_tail->next;
-                cache->block_tail->next = NULL;
-                cnt                     = items_per_alloc;
-            }
-            QTHREAD_FASTLOCK_UNLOCK(&pool->reuse_lock);
+            cache = qt_mpool_internal_reuse_pop(arena);
+            cnt   = items_per_alloc;
         }
         if (NULL == cache) {
             uint8_t *p;
-            // const size_t item_size = pool->item_size;
 
             /* need to allocate a new block and record that I did so in the central pool */
             qthread_debug(MPOOL_BEHAVIOR, "->...allocating new block\n");
             p = qt_mpool_internal_aligned_alloc(pool->alloc_size,
-                                                pool->alignment);
+                                                pool->alloc_size);
             qassert_ret((p != NULL), NULL);
-            assert(pool->alignment == 0 ||
-                   (((uintptr_t)p) & (pool->alignment - 1)) == 0);
-            QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
-            if (pool->alloc_list_pos == (pagesize / sizeof(void *) - 1)) {
-                void **tmp = qt_internal_aligned_alloc(pagesize, pagesize);
-                qassert_ret((tmp != NULL), NULL);
-                memset(tmp, 0, pagesize);
-                tmp[pagesize / sizeof(void *) - 1] = pool->alloc_list;
-                pool->alloc_list                   = tmp;
-                pool->alloc_list_pos               = 0;
+            assert((((uintptr_t)p) & (pool->alloc_size - 1)) == 0);
+#ifdef QTHREAD_HAVE_MEM_AFFINITY
+            if (tc->node >= 0) {
+                qt_affinity_mem_tonode(p, pool->alloc_size, tc->node);
+            }
+#endif
+            VALGRIND_MAKE_MEM_DEFINED(p, sizeof(qt_mpool_block_t));
+            {
+                qt_mpool_block_t *b = (qt_mpool_block_t *)p;
+
+                b->arena = tc->arena;
+                /* blocks are only ever pushed here, so there is no ABA */
+                do {
+                    b->next = pool->blocks;
+                } while (qthread_cas_ptr((void **)&pool->blocks, b->next, b) != b->next);
             }
-            pool->alloc_list[pool->alloc_list_pos] = p;
-            pool->alloc_list_pos++;
-            QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
             /* store the block for later allocation */
+            p        += pool->block_offset;
             tc->block = p;
             tc->i     = 1;
             ALLOC_SCRIBBLE(p, pool->item_size);
@@ -397,73 +642,47 @@ void INTERNAL qt_mpool_free(qt_mpool pool,
                             void    *mem)
 {   /*{{{*/
     qt_mpool_threadlocal_cache_t *tc;
-    qt_mpool_cache_t             *cache = NULL;
-    qt_mpool_cache_t             *n     = (qt_mpool_cache_t *)mem;
-    size_t                        cnt;
-    const size_t                  items_per_alloc = pool->items_per_alloc;
+    qt_mpool_cache_t             *n = (qt_mpool_cache_t *)mem;
 
     qthread_debug(MPOOL_CALLS, "pool=%p mem=%p\n", pool, mem);
     qassert_retvoid((mem != NULL));
     qassert_retvoid((pool != NULL));
     FREE_SCRIBBLE(mem, pool->item_size);
-    tc    = qt_mpool_internal_getcache(pool);
-    cache = tc->cache;
-    cnt   = tc->count;
-    qthread_debug(MPOOL_DETAILS, "->cache:%p (bt:%p) cnt:%u\n", cache, cache ? cache->block_tail : NULL, (unsigned int)cnt);
-    if (cache) {
-        assert(cnt != 0);
-        n->next       = cache;
-        n->block_tail = cache->block_tail; // cache is likely to be IN cache, so this won't be slow
-    } else {
-        assert(cnt == 0);
-        n->next       = NULL;
-        n->block_tail = n;
-    }
-    cnt++;
-    if (cnt >= (items_per_alloc * 2)) {
-        qt_mpool_cache_t *toglobal;
-        /* push to global */
-        qthread_debug(MPOOL_BEHAVIOR, "->push to global! cnt:%u\n", (unsigned)cnt);
-        assert(n);
-        assert(n->block_tail);
-        toglobal            = n->block_tail->next;
-        n->block_tail->next = NULL;
-        assert(toglobal);
-        assert(toglobal->block_tail);
-        QTHREAD_FASTLOCK_LOCK(&pool->reuse_lock);
-        toglobal->block_tail->next = pool->reuse_pool;
-        pool->reuse_pool           = toglobal;
-        QTHREAD_FASTLOCK_UNLOCK(&pool->reuse_lock);
-        cnt -= items_per_alloc;
-    } else if (cnt == items_per_alloc + 1) {
-        qthread_debug(MPOOL_BEHAVIOR, "->chop_block\n");
-        n->block_tail = n;
+    tc = qt_mpool_internal_getcache(pool);
+    if (pool->num_arenas > 1) {
+        const unsigned int owner = QT_MPOOL_BLOCK(pool, mem)->arena;
+
+        if (owner != tc->arena) {
+            qt_mpool_arena_t *arena = &pool->arenas[owner];
+            qt_mpool_cache_t *head;
+
+            qthread_debug(MPOOL_BEHAVIOR, "->remote free to arena %u\n", owner);
+            do {
+                head    = arena->remote_frees;
+                n->next = head;
+            } while (qthread_cas_ptr((void **)&arena->remote_frees, head, n) != head);
+            VALGRIND_MEMPOOL_FREE(pool, mem);
+            return;
+        }
     }
-    tc->cache = n;
-    tc->count = cnt;
-    qthread_debug(MPOOL_DETAILS, "->free count = %zu\n", (size_t)cnt);
+    qt_mpool_internal_cache_push(pool, tc, n);
     VALGRIND_MEMPOOL_FREE(pool, mem);
 } /*}}}*/
 
+size_t INTERNAL qt_mpool_remote_frees(void)
+{   /*{{{*/
+    return remote_frees_taken;
+} /*}}}*/
+
 void INTERNAL qt_mpool_destroy(qt_mpool pool)
 {                                      /*{{{ */
     qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
     qassert_retvoid((pool != NULL));
-    while (pool->alloc_list) {
-        unsigned int i = 0;
+    while (pool->blocks) {
+        qt_mpool_block_t *b = pool->blocks;
 
-        void *p = pool->alloc_list[0];
-
-        while (p && i < (pagesize / sizeof(void *) - 1)) {
-            qt_mpool_internal_aligned_free(p,
-                                           pool->alignment);
-            i++;
-            p = pool->alloc_list[i];
-        }
-        p                = pool->alloc_list;
-        pool->alloc_list = pool->alloc_list[pagesize / sizeof(void *) - 1];
-        FREE_SCRIBBLE(p, pagesize);
-        qt_internal_aligned_free(p, pagesize);
+        pool->blocks = b->next;
+        qt_mpool_internal_aligned_free(b, pool->alloc_size);
     }
     qthread_debug(MPOOL_DETAILS, "begin free TLS caches\n");
     while (pool->caches) {
@@ -475,8 +694,12 @@ void INTERNAL qt_mpool_destroy(qt_mpool pool)
 #ifndef TLS
     pthread_key_delete(pool->threadlocal_cache);
 #endif
-    QTHREAD_FASTLOCK_DESTROY(pool->pool_lock);
-    QTHREAD_FASTLOCK_DESTROY(pool->reuse_lock);
+#ifndef QT_MPOOL_LOCKFREE_REUSE
+    for (unsigned int a = 0; a < pool->num_arenas; a++) {
+        QTHREAD_FASTLOCK_DESTROY(pool->arenas[a].reuse_lock);
+    }
+#endif
+    qt_internal_aligned_free(pool->arenas, CACHELINE_WIDTH);
     VALGRIND_DESTROY_MEMPOOL(pool);
     FREE(pool, sizeof(struct qt_mpool_s));
 }                                      /*}}} */
@@ -0,0 +1,164 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <limits.h> /* for INT_MAX */
+#include <pthread.h>
+#include <time.h>   /* for struct timespec */
+#ifndef QTHREAD_PARK_FUTEX
+# include <sys/time.h> /* for gettimeofday() */
+#endif
+#ifdef QTHREAD_PARK_FUTEX
+# include <unistd.h>
+# include <sys/syscall.h>
+# include <linux/futex.h>
+#endif
+
+/* Internal Headers */
+#include "qthread/qthread.h"
+#include "qt_visibility.h"
+#include "qt_asserts.h"
+#include "qt_debug.h"
+#include "qthread_innards.h" /* for qlib */
+#include "qt_shepherd_innards.h"
+#include "qt_envariables.h"
+#include "qt_parking.h"
+#include "qt_timers.h"
+
+#if defined(QTHREAD_OVERSUBSCRIPTION) || defined(QTHREAD_CONDWAIT_BLOCKING_QUEUE)
+# define DEFAULT_SPINCOUNT 300
+#else
+# define DEFAULT_SPINCOUNT 300000
+#endif
+
+unsigned long qt_park_spincount = DEFAULT_SPINCOUNT;
+aligned_t     qt_parked_workers = 0;
+
+void INTERNAL qt_parking_subsystem_init(void)
+{   /*{{{*/
+    qt_park_spincount = qt_internal_get_env_num("SPINCOUNT", DEFAULT_SPINCOUNT, 0);
+    qt_parked_workers = 0;
+} /*}}}*/
+
+void INTERNAL qt_parking_init(qt_parking_lot_t *lot)
+{   /*{{{*/
+    lot->epoch   = 0;
+    lot->waiters = 0;
+#ifndef QTHREAD_PARK_FUTEX
+    qassert(pthread_mutex_init(&lot->lock, NULL), 0);
+    qassert(pthread_cond_init(&lot->cond, NULL), 0);
+#endif
+} /*}}}*/
+
+void INTERNAL qt_parking_destroy(qt_parking_lot_t *lot)
+{   /*{{{*/
+    assert(lot->waiters == 0);
+#ifndef QTHREAD_PARK_FUTEX
+    qassert(pthread_cond_destroy(&lot->cond), 0);
+    qassert(pthread_mutex_destroy(&lot->lock), 0);
+#endif
+} /*}}}*/
+
+/* Sleep until lot's epoch moves past key, then retire the waiter announced by
+ * qt_park_prepare(). May return early (signals, races); callers re-check
+ * their queue either way. A worker never sleeps past the next timer of its
+ * shepherd, and fires the timers that are due on its way in and out. */
+void INTERNAL qt_park_wait(qt_parking_lot_t *lot,
+                           uint32_t          key)
+{   /*{{{*/
+    qthread_worker_t *me      = qthread_internal_getworker();
+    double            timeout = 0.0;
+
+    if (me) {
+        me->park_count++;
+        if (qt_timers_poll(me->shepherd)) {
+            /* whatever they made ready is ours to run */
+            qt_park_cancel(lot);
+            return;
+        }
+        timeout = qt_timers_timeout(me->shepherd);
+    }
+    qthread_debug(THREADQUEUE_DETAILS, "parking on lot %p (epoch %u, timeout %g)\n", lot, (unsigned)key, timeout);
+#ifdef QTHREAD_PARK_FUTEX
+    if (lot->epoch == key) {
+        struct timespec ts;
+
+        if (timeout > 0.0) {
+            ts.tv_sec  = (time_t)timeout;
+            ts.tv_nsec = (long)((timeout - (double)ts.tv_sec) * 1e9);
+        }
+        syscall(SYS_futex, &lot->epoch, FUTEX_WAIT_PRIVATE, key, (timeout > 0.0) ? &ts : NULL, NULL, 0);
+    }
+#else
+    pthread_mutex_lock(&lot->lock);
+    if (lot->epoch == key) {
+        if (timeout > 0.0) {
+            struct timeval  now;
+            struct timespec ts;
+
+            gettimeofday(&now, NULL);
+            timeout   += now.tv_sec + now.tv_usec * 1e-6;
+            ts.tv_sec  = (time_t)timeout;
+            ts.tv_nsec = (long)((timeout - (double)ts.tv_sec) * 1e9);
+            pthread_cond_timedwait(&lot->cond, &lot->lock, &ts);
+        } else {
+            pthread_cond_wait(&lot->cond, &lot->lock);
+        }
+    }
+    pthread_mutex_unlock(&lot->lock);
+#endif
+    if (me && (lot->epoch != key)) { me->wake_count++; }
+    qt_park_cancel(lot);
+    if (me) { (void)qt_timers_poll(me->shepherd); }
+} /*}}}*/
+
+void INTERNAL qt_park_wake(qt_parking_lot_t *lot,
+                           int               all)
+{   /*{{{*/
+#ifdef QTHREAD_PARK_FUTEX
+    (void)qthread_incr(&lot->epoch, 1);
+    syscall(SYS_futex, &lot->epoch, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&lot->lock);
+    lot->epoch++;
+    if (all) {
+        pthread_cond_broadcast(&lot->cond);
+    } else {
+        pthread_cond_signal(&lot->cond);
+    }
+    pthread_mutex_unlock(&lot->lock);
+#endif
+} /*}}}*/
+
+/* Wake one parked worker on the shepherd nearest to the caller (or the
+ * lowest-numbered one, for callers that are not workers). Returns nonzero if
+ * a worker was woken. */
+int INTERNAL qt_park_notify_thief(size_t lot_offset)
+{   /*{{{*/
+    const qthread_shepherd_t *me     = qthread_internal_getshep();
+    const qthread_shepherd_id_t nshep = qlib->nshepherds;
+
+#define LOT(s) ((qt_parking_lot_t *)((char *)qlib->shepherds[(s)].ready + lot_offset))
+    if (me && me->sorted_sheplist) {
+        for (qthread_shepherd_id_t i = 0; i < nshep - 1; i++) {
+            qt_parking_lot_t *lot = LOT(me->sorted_sheplist[i]);
+            if (lot->waiters) {
+                qt_park_wake(lot, 0);
+                return 1;
+            }
+        }
+    } else {
+        for (qthread_shepherd_id_t i = 0; i < nshep; i++) {
+            qt_parking_lot_t *lot = LOT(i);
+            if (lot->waiters) {
+                qt_park_wake(lot, 0);
+                return 1;
+            }
+        }
+    }
+#undef LOT
+    return 0;
+} /*}}}*/
+
+/* vim:set expandtab: */
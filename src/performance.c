@@ -4,6 +4,8 @@
 #include"qt_threadstate.h"
 #include"qt_qthread_mgmt.h"
 #include"qt_qthread_struct.h"
+#include"qt_aggregation.h"
+#include"qt_feb.h"
 #include<string.h>
 #include<strings.h>
 #include<stdlib.h>
@@ -429,12 +431,15 @@ static const char* qthread_state_names[] ={
     "QTHREAD_STATE_TERMINATED",           /* thread function returned */
     "QTHREAD_STATE_MIGRATING",            /* thread needs to be moved, otherwise ready-to-run */
     "QTHREAD_STATE_SYSCALL",              /* thread performing external blocking operation */
+    "QTHREAD_STATE_SLEEPING",             /* insert me into a timer wheel */
+    "QTHREAD_STATE_FEB_WORD_BLOCKED",     /* waiting for a qt_feb_word_t */
+    "QTHREAD_STATE_FEB_MANY_BLOCKED",     /* waiting for several febs */
     "QTHREAD_STATE_ILLEGAL",              /* illegal state */
     "QTHREAD_STATE_TERM_SHEP"             /* special flag to terminate the shepherd */
 };
 
 void qtperf_set_instrument_qthreads(bool yes_no) {
-  QTPERF_ASSERT(QTHREAD_STATE_NUM_STATES == 16
+  QTPERF_ASSERT(QTHREAD_STATE_NUM_STATES == 19
                 && "threadstate_t has changed, check to make sure all states are represented in qthread_state_names in performance.c" );// make sure we're still current with our names array.
   qtperf_should_instrument_qthreads = yes_no;
 
@@ -498,6 +503,57 @@ qtperfdata_t* qtperf_get_qthread_data(void){
   }
   return me->rdata->performance_data;
 }
+size_t qtperf_agg_sites(qtperf_agg_site_t* sites, size_t max){
+#ifdef QTHREAD_TASK_AGGREGATION
+  return qt_agg_report(sites, max);
+#else
+  return 0;
+#endif
+}
+
+void qtperf_print_agg_sites(){
+  qtperf_agg_site_t sites[64];
+  size_t n = qtperf_agg_sites(sites, 64);
+  size_t i=0;
+  if(n > 64){
+    n = 64;
+  }
+  for(i=0; i<n; i++){
+    printf("aggregable task %p: %.3g us/task, %lu tasks in %lu aggregates, batch size %lu\n",
+           sites[i].f, sites[i].task_time * 1e6, sites[i].tasks, sites[i].batches,
+           (unsigned long)sites[i].batch_size);
+  }
+}
+
+size_t qtperf_feb_stripes(qtperf_feb_stripe_t* stripes, size_t max){
+  return qt_feb_stripe_report(stripes, max);
+}
+
+void qtperf_print_feb_stripes(){
+  size_t n = qtperf_feb_stripes(NULL, 0);
+  qtperf_feb_stripe_t* stripes = NULL;
+  size_t i=0;
+  if(n == 0){
+    return;
+  }
+  stripes = malloc(n * sizeof(qtperf_feb_stripe_t));
+  if(stripes == NULL){
+    return;
+  }
+  n = qtperf_feb_stripes(stripes, n);
+  printf("%lu FEB locking stripes\n", (unsigned long)n);
+  for(i=0; i<n; i++){
+    if(stripes[i].acquisitions == 0){
+      continue;
+    }
+    printf("stripe %lu: %lu acquisitions, %lu contended (%.1f%%)\n",
+           (unsigned long)i, (unsigned long)stripes[i].acquisitions,
+           (unsigned long)stripes[i].contended,
+           100.0 * stripes[i].contended / stripes[i].acquisitions);
+  }
+  free(stripes);
+}
+
 /**
  * qtperf_print_delimited prints the data for a state group as a
  * table, one row per instance of the state group, with columns
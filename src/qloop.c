@@ -163,22 +163,28 @@ static aligned_t qt_loop_wrapper(struct qt_loop_wrapper_args *const restrict arg
 
 #define QT_LOOP_SPAWNER_SIMPLE (1 << 0)
 
+/* how many iterations qt_loop_spawner() spawns at once */
+#define QT_LOOP_SPAWNER_BULK 32
+
 static void qt_loop_spawner(const size_t start,
                             const size_t stop,
                             void        *args_)
 {   /*{{{*/
-    size_t                      i, threadct;
+    size_t                      i, threadct, chunk;
     size_t                      steps     = stop - start;
-    struct qt_loop_wrapper_args qwa;
+    struct qt_loop_wrapper_args *qwa;
     unsigned int                flags     = 0;
     const synctype_t            sync_type = ((struct qt_loop_spawner_arg *)args_)->sync_type;
     const qt_loop_f             func      = ((struct qt_loop_spawner_arg *)args_)->func;
     void *const                 argptr    = ((struct qt_loop_spawner_arg *)args_)->argptr;
-    void                       *retptr    = NULL;
     aligned_t                   dc;
     int                         yieldarg  = 2;
 
     assert(func);
+    /* not on the stack: the spawner runs on a task's stack, which may be
+     * small */
+    qwa = MALLOC(QT_LOOP_SPAWNER_BULK * sizeof(struct qt_loop_wrapper_args));
+    assert(qwa);
 
     union {
         syncvar_t *syncvar;
@@ -187,7 +193,7 @@ static void qt_loop_spawner(const size_t start,
     } Q_ALIGNED(QTHREAD_ALIGNMENT_ALIGNED_T) sync = { NULL };
     switch (sync_type) {
         case SYNCVAR_T:
-            retptr = sync.syncvar = MALLOC(steps * sizeof(syncvar_t));
+            sync.syncvar = MALLOC(steps * sizeof(syncvar_t));
             assert(sync.syncvar);
             for (i = 0; i < (stop - start); ++i) {
                 sync.syncvar[i] = SYNCVAR_EMPTY_INITIALIZER;
@@ -199,8 +205,8 @@ static void qt_loop_spawner(const size_t start,
             assert(sync.sinc);
             break;
         case ALIGNED:
-            retptr = sync.aligned = qt_internal_aligned_alloc(steps * sizeof(aligned_t), QTHREAD_ALIGNMENT_ALIGNED_T);
-            ALLOC_SCRIBBLE(retptr, steps * sizeof(aligned_t));
+            sync.aligned = qt_internal_aligned_alloc(steps * sizeof(aligned_t), QTHREAD_ALIGNMENT_ALIGNED_T);
+            ALLOC_SCRIBBLE(sync.aligned, steps * sizeof(aligned_t));
             assert(sync.aligned);
             for (i = 0; i < (stop - start); ++i) {
                 qthread_empty(&sync.aligned[i]);
@@ -219,26 +225,37 @@ static void qt_loop_spawner(const size_t start,
             yieldarg = 0;
             break;
     }
-    for (i = start, threadct = 0; i < stop; ++i, ++threadct) {
-        qwa.func      = func;
-        qwa.startat   = i;
-        qwa.stopat    = i + 1;
-        qwa.arg       = argptr;
-        qwa.id        = threadct;
-        qwa.sync_type = sync_type;
-        if (sync_type == DONECOUNT) {
-            qwa.sync = &dc;
-            qassert_aligned(dc, QTHREAD_ALIGNMENT_ALIGNED_T);
-        } else {
-            qwa.sync = sync.syncvar;
+    for (i = start, threadct = 0; i < stop; i += chunk) {
+        void *rets = NULL;
+
+        chunk = ((stop - i) < QT_LOOP_SPAWNER_BULK) ? (stop - i) : QT_LOOP_SPAWNER_BULK;
+        for (size_t j = 0; j < chunk; ++j, ++threadct) {
+            qwa[j].func      = func;
+            qwa[j].startat   = i + j;
+            qwa[j].stopat    = i + j + 1;
+            qwa[j].arg       = argptr;
+            qwa[j].id        = threadct;
+            qwa[j].sync_type = sync_type;
+            if (sync_type == DONECOUNT) {
+                qwa[j].sync = &dc;
+                qassert_aligned(dc, QTHREAD_ALIGNMENT_ALIGNED_T);
+            } else {
+                qwa[j].sync = sync.syncvar;
+            }
         }
-        qassert(qthread_spawn((qthread_f)qt_loop_wrapper,
-                              &qwa, sizeof(struct qt_loop_wrapper_args),
-                              retptr,
-                              0, NULL,
-                              NO_SHEPHERD, flags), QTHREAD_SUCCESS);
+        /* each iteration returns into its own element */
+        if (sync_type == SYNCVAR_T) {
+            rets = sync.syncvar + (i - start);
+        } else if (sync_type == ALIGNED) {
+            rets = sync.aligned + (i - start);
+        }
+        qassert(qthread_spawn_bulk((qthread_f)qt_loop_wrapper,
+                                   qwa, sizeof(struct qt_loop_wrapper_args),
+                                   chunk, rets,
+                                   NULL, flags), QTHREAD_SUCCESS);
         qthread_yield_(yieldarg);
     }
+    FREE(qwa, QT_LOOP_SPAWNER_BULK * sizeof(struct qt_loop_wrapper_args));
     switch (sync_type) {
         case SYNCVAR_T:
             for (i = 0; i < steps; i++) {
@@ -1141,10 +1158,20 @@ void API_FUNC qt_loop_queue_run(qqloop_handle_t *loop)
         aligned_t *const            dc      = &(loop->stat.donecount);
         aligned_t *const            as      = &(loop->stat.activesheps);
 
+        void                 **args  = MALLOC(maxwkrs * sizeof(void *));
+        qthread_shepherd_id_t *sheps = MALLOC(maxwkrs * sizeof(qthread_shepherd_id_t));
+
+        assert(args);
+        assert(sheps);
         loop->stat.activesheps = maxwkrs;
         for (i = 0; i < maxwkrs; i++) {
-            qthread_fork_to((qthread_f)qqloop_wrapper, loop->qwa + i, NULL, i);
+            args[i]  = loop->qwa + i;
+            sheps[i] = i;
         }
+        qassert(qthread_spawn_bulk((qthread_f)qqloop_wrapper, args, 0, maxwkrs,
+                                   NULL, sheps, 0), QTHREAD_SUCCESS);
+        FREE(args, maxwkrs * sizeof(void *));
+        FREE(sheps, maxwkrs * sizeof(qthread_shepherd_id_t));
         /* turning this into a spinlock :P
          * I *would* do readFF, except shepherds can join and leave
          * during the loop */
@@ -40,7 +40,8 @@
 /* Public Headers                                     */
 /******************************************************/
 #include "qthread/cacheline.h"
-#if (defined(QTHREAD_SHEPHERD_PROFILING) || defined(QTHREAD_FEB_PROFILING))
+#if (defined(QTHREAD_SHEPHERD_PROFILING) || defined(QTHREAD_FEB_PROFILING) || defined(QTHREAD_DEADLINES) || \
+     defined(QTHREAD_TASK_AGGREGATION))
 # include "qthread/qtimer.h"
 #endif
 #include "qthread/barrier.h"
@@ -61,6 +62,11 @@
 #include "qt_qthread_struct.h"
 #include "qt_qthread_mgmt.h"
 #include "qt_shepherd_innards.h"
+#include "qt_victims.h"
+#include "qt_parking.h"
+#include "qt_timers.h"
+#include "qt_stacks.h"
+#include "qt_aggregation.h"
 #include "qt_blocking_structs.h"
 #include "qt_addrstat.h"
 #include "qt_threadqueues.h"
@@ -131,6 +137,8 @@ int GUARD_PAGES = 1;
 #define GUARD_PAGES 0
 #endif
 
+static int direct_swap = 0;
+
 /* Internal Prototypes */
 #ifdef QTHREAD_MAKECONTEXT_SPLIT
 static void qthread_wrapper(unsigned int high,
@@ -157,45 +165,45 @@ void qthread_thread_free(qthread_t *t);
 
 
 #if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED)
-# define ALLOC_QTHREAD()     (qthread_t *)MALLOC(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size)
-# define ALLOC_BIG_QTHREAD() (qthread_t *)MALLOC(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
-# define FREE_QTHREAD(t)     FREE(t, sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size)
-# define FREE_BIG_QTHREAD(t) FREE(t, sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
+# define ALLOC_QTHREAD(c) (qthread_t *)MALLOC(sizeof(qthread_t) + qlib->qthread_data_class_size[c])
+# define FREE_QTHREAD(t)  FREE(t, sizeof(qthread_t) + qlib->qthread_data_class_size[(t)->data_class])
 #else /* if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED) */
-qt_mpool generic_qthread_pool     = NULL;
-qt_mpool generic_big_qthread_pool = NULL;
-# define ALLOC_QTHREAD()     (qthread_t *)qt_mpool_alloc(generic_qthread_pool)
-# define ALLOC_BIG_QTHREAD() (qthread_t *)qt_mpool_alloc(generic_big_qthread_pool)
-# define FREE_QTHREAD(t)     qt_mpool_free(generic_qthread_pool, t)
-# define FREE_BIG_QTHREAD(t) qt_mpool_free(generic_big_qthread_pool, t)
+static qt_mpool generic_qthread_pools[QTHREAD_DATA_CLASSES];
+# define ALLOC_QTHREAD(c) (qthread_t *)qt_mpool_alloc(generic_qthread_pools[c])
+# define FREE_QTHREAD(t)  qt_mpool_free(generic_qthread_pools[(t)->data_class], t)
 #endif /* if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED) */
 
 #if defined(UNPOOLED_STACKS) || defined(UNPOOLED)
 # ifdef QTHREAD_GUARD_PAGES
-static QINLINE void *ALLOC_STACK(void)
+static QINLINE void *ALLOC_STACK(unsigned c)
 {                      /*{{{ */
+    const size_t stack_size = qlib->qthread_stack_class_size[c];
+
     if (GUARD_PAGES) {
-        uint8_t *tmp = qt_internal_aligned_alloc(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) + (2 * getpagesize()), getpagesize());
+        uint8_t *tmp = qt_internal_aligned_alloc(stack_size + sizeof(struct qthread_runtime_data_s) + (2 * getpagesize()), getpagesize());
 
         assert(tmp != NULL);
         if (tmp == NULL) {
             return NULL;
         }
-        ALLOC_SCRIBBLE(tmp, qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) + (2 * getpagesize()));
+        ALLOC_SCRIBBLE(tmp, stack_size + sizeof(struct qthread_runtime_data_s) + (2 * getpagesize()));
         if (mprotect(tmp, getpagesize(), PROT_NONE) != 0) {
             perror("mprotect in ALLOC_STACK (1)");
         }
-        if (mprotect(tmp + qlib->qthread_stack_size + getpagesize(), getpagesize(), PROT_NONE) != 0) {
+        if (mprotect(tmp + stack_size + getpagesize(), getpagesize(), PROT_NONE) != 0) {
             perror("mprotect in ALLOC_STACK (2)");
         }
         return tmp + getpagesize();
     } else {
-        return MALLOC(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s));
+        return MALLOC(stack_size + sizeof(struct qthread_runtime_data_s));
     }
 }                      /*}}} */
 
-static QINLINE void FREE_STACK(void *t)
+static QINLINE void FREE_STACK(void    *t,
+                               unsigned c)
 {                      /*{{{ */
+    const size_t stack_size = qlib->qthread_stack_class_size[c];
+
     if (GUARD_PAGES) {
         uint8_t *tmp = t;
 
@@ -204,28 +212,33 @@ static QINLINE void FREE_STACK(void *t)
         if (mprotect(tmp, getpagesize(), PROT_READ | PROT_WRITE) != 0) {
             perror("mprotect in FREE_STACK (1)");
         }
-        if (mprotect(tmp + qlib->qthread_stack_size + getpagesize(),
+        if (mprotect(tmp + stack_size + getpagesize(),
                     getpagesize(),
                     PROT_READ | PROT_WRITE) != 0) {
             perror("mprotect in FREE_STACK (2)");
         }
-        FREE(tmp, qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) + (2 * getpagesize()));
+        FREE(tmp, stack_size + sizeof(struct qthread_runtime_data_s) + (2 * getpagesize()));
     } else {
-        FREE(t, qlib->qthread_stack_size); /* XXX: this size seems wrong */
+        FREE(t, stack_size); /* XXX: this size seems wrong */
     }
 }                      /*}}} */
 
 # else /* ifdef QTHREAD_GUARD_PAGES */
-#  define ALLOC_STACK() MALLOC(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s))
-#  define FREE_STACK(t) FREE(t, qlib->qthread_stack_size) /* XXX: this size seems wrong */
+#  define ALLOC_STACK(c)   MALLOC(qlib->qthread_stack_class_size[c] + sizeof(struct qthread_runtime_data_s))
+#  define FREE_STACK(t, c) FREE(t, qlib->qthread_stack_class_size[c]) /* XXX: this size seems wrong */
 # endif /* ifdef QTHREAD_GUARD_PAGES */
+#elif defined(QTHREAD_MMAP_STACKS)
+/* guard pages are set up once, as the stacks are reserved (see qt_stacks.h) */
+# define ALLOC_STACK(c)     qt_stack_alloc(c)
+# define FREE_STACK(t, c)   qt_stack_free((t), (c))
+# define STACKS_EXHAUSTED() qt_stacks_exhausted()
 #else /* if defined(UNPOOLED_STACKS) || defined(UNPOOLED) */
-static qt_mpool generic_stack_pool = NULL;
+static qt_mpool generic_stack_pool[QTHREAD_STACK_CLASSES];
 # ifdef QTHREAD_GUARD_PAGES
-static QINLINE void *ALLOC_STACK(void)
+static QINLINE void *ALLOC_STACK(unsigned c)
 {                      /*{{{ */
     if (GUARD_PAGES) {
-        uint8_t *tmp = qt_mpool_alloc(generic_stack_pool);
+        uint8_t *tmp = qt_mpool_alloc(generic_stack_pool[c]);
 
         assert(tmp);
         if (tmp == NULL) {
@@ -234,18 +247,19 @@ static QINLINE void *ALLOC_STACK(void)
         if (mprotect(tmp, getpagesize(), PROT_NONE) != 0) {
             perror("mprotect in ALLOC_STACK (1)");
         }
-        if (mprotect(tmp + qlib->qthread_stack_size + getpagesize(),
+        if (mprotect(tmp + qlib->qthread_stack_class_size[c] + getpagesize(),
                     getpagesize(),
                     PROT_NONE) != 0) {
             perror("mprotect in ALLOC_STACK (2)");
         }
         return tmp + getpagesize();
     } else {
-        return qt_mpool_alloc(generic_stack_pool);
+        return qt_mpool_alloc(generic_stack_pool[c]);
     }
 }                      /*}}} */
 
-static QINLINE void FREE_STACK(void *t)
+static QINLINE void FREE_STACK(void    *t,
+                               unsigned c)
 {                      /*{{{ */
     if (GUARD_PAGES) {
         assert(t);
@@ -253,21 +267,25 @@ static QINLINE void FREE_STACK(void *t)
         if (mprotect(t, getpagesize(), PROT_READ | PROT_WRITE) != 0) {
             perror("mprotect in FREE_STACK (1)");
         }
-        if (mprotect(((uint8_t*)t) + qlib->qthread_stack_size + getpagesize(),
+        if (mprotect(((uint8_t*)t) + qlib->qthread_stack_class_size[c] + getpagesize(),
                     getpagesize(),
                     PROT_READ | PROT_WRITE) != 0) {
             perror("mprotect in FREE_STACK (2)");
         }
     }
-    qt_mpool_free(generic_stack_pool, t);
+    qt_mpool_free(generic_stack_pool[c], t);
 }                      /*}}} */
 
 # else /* ifdef QTHREAD_GUARD_PAGES */
-#  define ALLOC_STACK() qt_mpool_alloc(generic_stack_pool)
-#  define FREE_STACK(t) qt_mpool_free(generic_stack_pool, t)
+#  define ALLOC_STACK(c)   qt_mpool_alloc(generic_stack_pool[c])
+#  define FREE_STACK(t, c) qt_mpool_free(generic_stack_pool[c], t)
 # endif /* ifdef QTHREAD_GUARD_PAGES */
 #endif  /* if defined(UNPOOLED_STACKS) || defined(UNPOOLED) */
 
+#ifndef STACKS_EXHAUSTED
+# define STACKS_EXHAUSTED() 0
+#endif
+
 #if defined(UNPOOLED)
 # define ALLOC_RDATA() (struct qthread_runtime_data_s *)MALLOC(sizeof(struct qthread_runtime_data_s));
 # define FREE_RDATA(r) FREE(r, sizeof(struct qthread_runtime_data_s))
@@ -297,7 +315,7 @@ static qt_mpool generic_rdata_pool = NULL;
         if ((thr)->flags & QTHREAD_REAL_MCCOY) {                                                            \
             rlp.rlim_cur = qlib->master_stack_size;                                                         \
         } else {                                                                                            \
-            rlp.rlim_cur = qlib->qthread_stack_size;                                                        \
+            rlp.rlim_cur = (thr)->rdata->stack_size;                                                        \
         }                                                                                                   \
         rlp.rlim_max = qlib->max_stack_size;                                                                \
         qassert(setrlimit(RLIMIT_STACK, &rlp), 0);                                                          \
@@ -334,31 +352,37 @@ int   qthread_library_initialized = 0;
 void *shep0arg                    = NULL;
 #endif
 
-static QINLINE void alloc_rdata(qthread_shepherd_t *me,
-                                qthread_t          *t)
+/* Returns nonzero, leaving t as it was, if no stack could be had for it. */
+static QINLINE int alloc_rdata(qthread_shepherd_t *me,
+                               qthread_t          *t)
 {   /*{{{*/
-    void                          *stack = NULL;
+    void                          *stack      = NULL;
+    size_t                         stack_size = 0;
     struct qthread_runtime_data_s *rdata;
 
     if (t->flags & QTHREAD_SIMPLE) {
         rdata = t->rdata = ALLOC_RDATA();
     } else {
-        stack = ALLOC_STACK();
-        assert(stack);
+        stack_size = qlib->qthread_stack_class_size[t->stack_class];
+        stack      = ALLOC_STACK(t->stack_class);
+        if (QTHREAD_UNLIKELY(stack == NULL)) { return 1; }
         if (GUARD_PAGES) {
-            rdata = t->rdata = (struct qthread_runtime_data_s *)(((uint8_t *)stack) + getpagesize() + qlib->qthread_stack_size);
+            rdata = t->rdata = (struct qthread_runtime_data_s *)(((uint8_t *)stack) + getpagesize() + stack_size);
         } else {
-            rdata = t->rdata = (struct qthread_runtime_data_s *)(((uint8_t *)stack) + qlib->qthread_stack_size);
+            rdata = t->rdata = (struct qthread_runtime_data_s *)(((uint8_t *)stack) + stack_size);
         }
     }
     rdata->tasklocal_size = 0;
     rdata->criticalsect   = 0;
+    rdata->inline_depth   = 0;
+    rdata->retired_arg    = NULL;
     rdata->stack          = stack;
+    rdata->stack_size     = stack_size;
     rdata->shepherd_ptr   = me;
     rdata->blockedon.io   = NULL;
 #ifdef QTHREAD_USE_VALGRIND
     if (stack) {
-        rdata->valgrind_stack_id = VALGRIND_STACK_REGISTER(stack, qlib->qthread_stack_size);
+        rdata->valgrind_stack_id = VALGRIND_STACK_REGISTER(stack, stack_size);
     }
 #endif
 #ifdef QTHREAD_PERFORMANCE
@@ -368,8 +392,68 @@ static QINLINE void alloc_rdata(qthread_shepherd_t *me,
       rdata->performance_data = qtperf_create_perfdata(qtperf_qthreads_group);
     }
 #endif
+    return 0;
+} /*}}}*/
+
+
+static QINLINE void free_tasklocal(qthread_t *t)
+{   /*{{{*/
+    if (t->rdata->tasklocal_size > 0) {
+        qthread_debug(THREAD_DETAILS, "t(%p,%i): destroying %u bytes of task-local storage\n", t, t->thread_id, t->rdata->tasklocal_size);
+        FREE(*(void **)&t->data[0], t->rdata->tasklocal_size);
+        *(void **)&t->data[0] = NULL;
+    }
+} /*}}}*/
+
+/* May t run on shepherd me, rather than be sent back to its target shepherd?
+ * A task spawned with QTHREAD_SPAWN_NEAR may run anywhere on that
+ * shepherd's node. */
+static QINLINE int qthread_at_home(const qthread_t          *t,
+                                   const qthread_shepherd_t *me)
+{   /*{{{*/
+    return (t->target_shepherd == NO_SHEPHERD) ||
+           (t->target_shepherd == me->shepherd_id) ||
+           ((t->flags & QTHREAD_NODE_BOUND) &&
+            (qlib->shepherds[t->target_shepherd].mem_node == me->mem_node));
 } /*}}}*/
 
+/* Simple tasks never block, so a worker can run them to completion as a
+ * plain call, on its own stack and with runtime data of its own (rdata):
+ * no stack or runtime data is allocated, and no context is switched. */
+static QINLINE void run_simple(qthread_shepherd_t            *me,
+                               qthread_t                    **current,
+                               qthread_t                     *t,
+                               struct qthread_runtime_data_s *rdata)
+{   /*{{{*/
+    assert(t->thread_state == QTHREAD_STATE_NEW);
+    rdata->tasklocal_size = 0;
+    rdata->criticalsect   = 0;
+    rdata->inline_depth   = 0;
+    rdata->retired_arg    = NULL;
+    rdata->stack          = NULL;
+    rdata->stack_size     = 0;
+    rdata->shepherd_ptr   = me;
+    rdata->blockedon.io   = NULL;
+#ifdef QTHREAD_PERFORMANCE
+    rdata->performance_data = NULL;
+#endif
+    t->rdata        = rdata;
+    t->thread_state = QTHREAD_STATE_RUNNING;
+#ifdef QTHREAD_SHEPHERD_PROFILING
+    me->num_threads++;
+#endif
+    *current = t;
+#ifdef QTHREAD_MAKECONTEXT_SPLIT
+    qthread_wrapper((((uintptr_t)t) >> 32) & 0xffffffff, ((uintptr_t)t) & 0xffffffff);
+#else
+    qthread_wrapper(t);
+#endif
+    *current = NULL;
+    assert(t->thread_state == QTHREAD_STATE_TERMINATED);
+    free_tasklocal(t);
+    t->rdata = NULL;
+    qthread_thread_free(t);
+} /*}}}*/
 
 /* the qthread_master() function is the loop responsible for actually
  * executing the work units
@@ -407,6 +491,7 @@ static void *qthread_master(void *arg)
     qthread_t                *t;
     qthread_t               **current;
     int                       done = 0;
+    struct qthread_runtime_data_s simple_rdata; /* for run_simple() */
 
 #ifdef QTHREAD_SHEPHERD_PROFILING
     me->total_time = qtimer_create();
@@ -467,12 +552,18 @@ static void *qthread_master(void *arg)
         while (!QTHREAD_CASLOCK_READ_UI(me_worker->active)) {
             SPINLOCK_BODY();
         }
+        (void)qt_timers_poll(me);
 #ifdef QTHREAD_LOCAL_PRIORITY
         t = qt_scheduler_get_thread(threadqueue, localpriorityqueue, localqueue, QTHREAD_CASLOCK_READ_UI(me->active));
 #else
         t = qt_scheduler_get_thread(threadqueue, localqueue, QTHREAD_CASLOCK_READ_UI(me->active));
 #endif /* ifdef QTHREAD_LOCAL_PRIORITY */
         assert(t);
+#ifdef QTHREAD_TASK_AGGREGATION
+        if (t->flags & QTHREAD_AGGREGABLE) {
+            t = qt_agg_gather(t, threadqueue, localqueue);
+        }
+#endif
 #ifdef QTHREAD_SHEPHERD_PROFILING
         qtimer_stop(idle);
         me->idle_count++;
@@ -501,6 +592,10 @@ static void *qthread_master(void *arg)
 #endif
             done = 1;
             qthread_thread_free(t); /* free qthread data structures */
+        } else if ((t->flags & QTHREAD_SIMPLE) && (t->rdata == NULL) &&
+                   qthread_at_home(t, me) &&
+                   QTHREAD_CASLOCK_READ_UI(me->active)) {
+            run_simple(me, current, t, &simple_rdata);
         } else {
             /* yielded only happens for the first thread */
             assert((t->thread_state == QTHREAD_STATE_NEW) ||
@@ -510,7 +605,12 @@ static void *qthread_master(void *arg)
 
             assert(t->f != NULL || t->flags & QTHREAD_REAL_MCCOY);
             if (t->rdata == NULL) {
-                alloc_rdata(me, t);
+                if (QTHREAD_UNLIKELY(alloc_rdata(me, t) != 0)) {
+                    /* no stack for it until another task frees one; let the
+                     * others run first */
+                    qt_threadqueue_enqueue_yielded(me->ready, t);
+                    continue;
+                }
             } else {
                 assert(t->rdata->shepherd_ptr != NULL);
                 if (t->rdata->shepherd_ptr != me) {
@@ -518,7 +618,7 @@ static void *qthread_master(void *arg)
                 }
             }
 
-            if ((t->target_shepherd != NO_SHEPHERD) && (t->target_shepherd != my_id) &&
+            if (!qthread_at_home(t, me) &&
                 QTHREAD_CASLOCK_READ_UI(qlib->shepherds[t->target_shepherd].active)) {
                 /* send this thread home */
                 qthread_debug(THREAD_DETAILS,
@@ -651,6 +751,18 @@ static void *qthread_master(void *arg)
                         QTHREAD_FASTLOCK_UNLOCK(&(m->lock));
                         break;
                     }
+                    case QTHREAD_STATE_FEB_WORD_BLOCKED: /* unlock the word it is queued on */
+                        qthread_debug(THREAD_DETAILS | FEB_DETAILS | SHEPHERD_DETAILS,
+                                      "id(%u): thread tid=%i(%p) blocked on FEB word %p\n",
+                                      my_id, t->thread_id, t, t->rdata->blockedon.word);
+                        qt_feb_word_release(t->rdata->blockedon.word);
+                        break;
+                    case QTHREAD_STATE_FEB_MANY_BLOCKED: /* let the last address filled wake it */
+                        qthread_debug(THREAD_DETAILS | FEB_DETAILS | SHEPHERD_DETAILS,
+                                      "id(%u): thread tid=%i(%p) blocked on several FEBs\n",
+                                      my_id, t->thread_id, t);
+                        qt_feb_many_release(t);
+                        break;
 
                     case QTHREAD_STATE_PARENT_YIELD:
                         t->thread_state = QTHREAD_STATE_PARENT_BLOCKED;
@@ -678,6 +790,12 @@ static void *qthread_master(void *arg)
                                       my_id, t->thread_id);
                         qt_blocking_subsystem_enqueue(t->rdata->blockedon.io);
                         break;
+                    case QTHREAD_STATE_SLEEPING:
+                        qthread_debug(THREAD_DETAILS | SHEPHERD_DETAILS,
+                                      "id(%u): thread %i going to sleep\n",
+                                      my_id, t->thread_id);
+                        qt_timer_sleep(me, t->rdata->blockedon.timer);
+                        break;
 #ifdef QTHREAD_USE_EUREKAS
                     case QTHREAD_STATE_ASSASSINATED:
                         qthread_debug(THREAD_DETAILS | SHEPHERD_DETAILS,
@@ -818,14 +936,6 @@ int API_FUNC qthread_initialize(void)
     qlib = (qlib_t)MALLOC(sizeof(struct qlib_s));
     qassert_ret(qlib, QTHREAD_MALLOC_ERROR);
 
-#if defined(QTHREAD_MUTEX_INCREMENT) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC32)
-    qlib->atomic_locks = MALLOC(sizeof(QTHREAD_FASTLOCK_TYPE) * QTHREAD_LOCKING_STRIPES);
-    qassert_ret(qlib->atomic_locks, QTHREAD_MALLOC_ERROR);
-    for (i = 0; i < QTHREAD_LOCKING_STRIPES; i++) {
-        QTHREAD_FASTLOCK_INIT(qlib->atomic_locks[i]);
-    }
-#endif
-
     qt_internal_alignment_init();
     qt_hash_initialize_subsystem();
 
@@ -836,7 +946,28 @@ int API_FUNC qthread_initialize(void)
     if ((nshepherds == 1) && (nworkerspershep == 1)) {
         need_sync = 0;
     }
-    QTHREAD_LOCKING_STRIPES = 2 << (QT_INT_LOG(nshepherds * nworkerspershep) + 1);
+    {
+        /* a power of two, so that choosing a stripe is a mask; by default
+         * scaled to the number of workers */
+        unsigned long stripes = qt_internal_get_env_num("LOCKING_STRIPES",
+                                                        2 << (QT_INT_LOG(nshepherds * nworkerspershep) + 1),
+                                                        1);
+
+        if (stripes > QTHREAD_MAX_LOCKING_STRIPES) {
+            stripes = QTHREAD_MAX_LOCKING_STRIPES;
+        } else if (stripes & (stripes - 1)) {
+            stripes = 2 << QT_INT_LOG(stripes);
+        }
+        QTHREAD_LOCKING_STRIPES = stripes;
+    }
+    qthread_debug(CORE_BEHAVIOR, "there will be %u locking stripe(s)\n", QTHREAD_LOCKING_STRIPES);
+#if defined(QTHREAD_MUTEX_INCREMENT) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC32)
+    qlib->atomic_locks = MALLOC(sizeof(QTHREAD_FASTLOCK_TYPE) * QTHREAD_LOCKING_STRIPES);
+    qassert_ret(qlib->atomic_locks, QTHREAD_MALLOC_ERROR);
+    for (i = 0; i < QTHREAD_LOCKING_STRIPES; i++) {
+        QTHREAD_FASTLOCK_INIT(qlib->atomic_locks[i]);
+    }
+#endif
     qthread_debug(CORE_BEHAVIOR, "there will be %u shepherd(s)\n", (unsigned)nshepherds);
 
 #ifdef QTHREAD_COUNT_THREADS
@@ -898,6 +1029,17 @@ int API_FUNC qthread_initialize(void)
     if (print_info) {
         print_status("Using %u byte stack size.\n", qlib->qthread_stack_size);
     }
+    {
+        static const unsigned class_size[QTHREAD_STACK_CLASSES] = { 0, 4096, 16384, 65536, 1048576 };
+
+        qlib->qthread_stack_class_size[QTHREAD_STACK_DEFAULT] = qlib->qthread_stack_size;
+        for (unsigned c = QTHREAD_STACK_DEFAULT + 1; c < QTHREAD_STACK_CLASSES; c++) {
+            qlib->qthread_stack_class_size[c] = class_size[c];
+            if (GUARD_PAGES && (class_size[c] % pagesize)) {
+                qlib->qthread_stack_class_size[c] += pagesize - (class_size[c] % pagesize);
+            }
+        }
+    }
 
 
     qlib->max_thread_id  = 1;
@@ -928,6 +1070,7 @@ int API_FUNC qthread_initialize(void)
     /* initialize the shepherds as having no affinity */
     for (i = 0; i < nshepherds; i++) {
         qlib->shepherds[i].node            = -1;
+        qlib->shepherds[i].mem_node        = -1;
         qlib->shepherds[i].shep_dists      = NULL;
         qlib->shepherds[i].sorted_sheplist = NULL;
         qlib->shepherds[i].workers = (qthread_worker_t *) qt_calloc(nworkerspershep,
@@ -936,6 +1079,7 @@ int API_FUNC qthread_initialize(void)
     }
     qaffinity = qt_internal_get_env_bool("AFFINITY", 1);
     qthread_debug(AFFINITY_DETAILS, "qaffinity = %i\n", qaffinity);
+    direct_swap = qt_internal_get_env_bool("DIRECT_SWAP", 0);
 #ifndef QTHREAD_NO_ASSERTS
     qthread_library_initialized = 1;
     MACHINE_FENCE;
@@ -948,6 +1092,7 @@ int API_FUNC qthread_initialize(void)
         }
         assert(qlib->shepherds[0].sorted_sheplist);
         assert(qlib->shepherds[0].shep_dists);
+        qt_victims_init();
     }
 
     // Set task argument buffer size
@@ -960,16 +1105,39 @@ int API_FUNC qthread_initialize(void)
                                                            sizeof(void *));
     qthread_debug(CORE_DETAILS, "qthread task-local size: %u\n", qlib->qthread_tasklocal_size);
 
+    // Size the qthread_t classes; see QTHREAD_DATA_CLASSES
+    qlib->qthread_argcopy_offset     = (qlib->qthread_tasklocal_size + 15) & ~15u;
+    qlib->qthread_data_class_size[0] = qlib->qthread_argcopy_offset;
+    for (unsigned c = 1; c < QTHREAD_DATA_CLASSES; c++) {
+        unsigned size = qlib->qthread_argcopy_offset + qlib->qthread_argcopy_size;
+
+        if ((c < QTHREAD_DATA_CLASSES - 1) && ((64u << (c - 1)) < size)) {
+            size = 64u << (c - 1);
+        }
+        if (size < qlib->qthread_argcopy_offset) {
+            size = qlib->qthread_argcopy_offset; /* room for no argument at all */
+        }
+        qlib->qthread_data_class_size[c] = size;
+        qthread_debug(CORE_DETAILS, "qthread data class %u: %u bytes\n", c, size);
+    }
+
 #ifndef UNPOOLED
-    generic_qthread_pool     = qt_mpool_create_aligned(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size, qthread_cacheline());
-    generic_big_qthread_pool = qt_mpool_create(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size);
-    if (GUARD_PAGES) {
-        generic_stack_pool =
-            qt_mpool_create_aligned(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) +
-                                    (2 * getpagesize()), getpagesize());
-    } else {
-        generic_stack_pool = qt_mpool_create_aligned(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s), QTHREAD_STACK_ALIGNMENT);     // stacks on most platforms must be 16-byte aligned (or less)
+    for (unsigned c = 0; c < QTHREAD_DATA_CLASSES; c++) {
+        generic_qthread_pools[c] = qt_mpool_create_aligned(sizeof(qthread_t) + qlib->qthread_data_class_size[c], qthread_cacheline());
+    }
+# ifdef QTHREAD_MMAP_STACKS
+    qt_stacks_subsystem_init(GUARD_PAGES);
+# else
+    for (unsigned c = 0; c < QTHREAD_STACK_CLASSES; c++) {
+        if (GUARD_PAGES) {
+            generic_stack_pool[c] =
+                qt_mpool_create_aligned(qlib->qthread_stack_class_size[c] + sizeof(struct qthread_runtime_data_s) +
+                                        (2 * getpagesize()), getpagesize());
+        } else {
+            generic_stack_pool[c] = qt_mpool_create_aligned(qlib->qthread_stack_class_size[c] + sizeof(struct qthread_runtime_data_s), QTHREAD_STACK_ALIGNMENT);     // stacks on most platforms must be 16-byte aligned (or less)
+        }
     }
+# endif
     generic_rdata_pool = qt_mpool_create(sizeof(struct qthread_runtime_data_s));
 #endif /* ifndef UNPOOLED */
     initialize_hazardptrs();
@@ -977,8 +1145,11 @@ int API_FUNC qthread_initialize(void)
     qthread_queue_subsystem_init();
     qt_feb_subsystem_init(need_sync);
     qt_syncvar_subsystem_init(need_sync);
+    qt_parking_subsystem_init();
     qt_threadqueue_subsystem_init();
     qt_blocking_subsystem_init();
+    qt_timers_subsystem_init();
+    qt_aggregation_subsystem_init();
 
 /* Set up agg methods*/
     qlib->agg_cost = qthread_default_agg_cost;
@@ -1053,7 +1224,10 @@ int API_FUNC qthread_initialize(void)
     assert(qlib->mccoy_thread->rdata != NULL);
     qlib->mccoy_thread->rdata->shepherd_ptr   = &(qlib->shepherds[0]);
     qlib->mccoy_thread->rdata->stack          = NULL;
+    qlib->mccoy_thread->rdata->stack_size     = 0;
     qlib->mccoy_thread->rdata->tasklocal_size = 0;
+    qlib->mccoy_thread->rdata->inline_depth   = 0;
+    qlib->mccoy_thread->rdata->retired_arg    = NULL;
 
     qthread_debug(CORE_DETAILS, "enqueueing mccoy thread\n");
     TLS_SET(shepherd_structs, (qthread_shepherd_t *)&(qlib->shepherds[0].workers[0]));
@@ -1661,12 +1835,16 @@ void API_FUNC qthread_finalize(void)
 
 #ifndef UNPOOLED
     qthread_debug(CORE_DETAILS, "destroy global memory pools\n");
-    qt_mpool_destroy(generic_qthread_pool);
-    generic_qthread_pool = NULL;
-    qt_mpool_destroy(generic_big_qthread_pool);
-    generic_big_qthread_pool = NULL;
-    qt_mpool_destroy(generic_stack_pool);
-    generic_stack_pool = NULL;
+    for (unsigned c = 0; c < QTHREAD_DATA_CLASSES; c++) {
+        qt_mpool_destroy(generic_qthread_pools[c]);
+        generic_qthread_pools[c] = NULL;
+    }
+# ifndef QTHREAD_MMAP_STACKS
+    for (unsigned c = 0; c < QTHREAD_STACK_CLASSES; c++) {
+        qt_mpool_destroy(generic_stack_pool[c]);
+        generic_stack_pool[c] = NULL;
+    }
+# endif
     qt_mpool_destroy(generic_rdata_pool);
     generic_rdata_pool = NULL;
 #endif /* ifndef UNPOOLED */
@@ -1715,18 +1893,10 @@ void API_FUNC *qthread_get_tasklocal(unsigned int size)
         qthread_debug(THREAD_DETAILS, "tasklocal_size=%u, global tasklocal_size=%u\n", tl_sz, qlib->qthread_tasklocal_size);
         if ((0 == tl_sz) && (size <= qlib->qthread_tasklocal_size)) {
             // Use default space
-            if (f->flags & QTHREAD_BIG_STRUCT) {
-                return &f->data[qlib->qthread_argcopy_size];
-            } else {
-                return &f->data;
-            }
+            return &f->data;
         } else {
-            void **data_blob;
-            if (f->flags & QTHREAD_BIG_STRUCT) {
-                data_blob = (void **)&f->data[qlib->qthread_argcopy_size];
-            } else {
-                data_blob = (void **)&f->data[0];
-            }
+            void **data_blob = (void **)&f->data[0];
+
             if (0 == tl_sz) {
                 qthread_debug(THREAD_DETAILS, "Allocate space and copy old data\n");
                 void *tmp_data = MALLOC(size);
@@ -1779,7 +1949,7 @@ API_FUNC void* qthread_bos(void)
 {
     const qthread_t *f = qthread_internal_self();
 
-    return f->rdata->stack + qlib->qthread_stack_size;
+    return (uint8_t *)f->rdata->stack + f->rdata->stack_size;
 }
 
 size_t API_FUNC qthread_stackleft(void)
@@ -1788,17 +1958,17 @@ size_t API_FUNC qthread_stackleft(void)
 
     if ((f != NULL) && (f->rdata->stack != NULL)) {
         assert((size_t)&f > (size_t)f->rdata->stack &&
-               (size_t)&f < ((size_t)f->rdata->stack + qlib->qthread_stack_size));
+               (size_t)&f < ((size_t)f->rdata->stack + f->rdata->stack_size));
 #ifdef STACK_GROWS_DOWN
         /* not tested */
-        assert(((size_t)(f->rdata->stack) + qlib->qthread_stack_size) -
-               (size_t)(&f) < qlib->qthread_stack_size);
-        return ((size_t)(f->rdata->stack) + qlib->qthread_stack_size) -
+        assert(((size_t)(f->rdata->stack) + f->rdata->stack_size) -
+               (size_t)(&f) < f->rdata->stack_size);
+        return ((size_t)(f->rdata->stack) + f->rdata->stack_size) -
                (size_t)(&f);
 
 #else
         assert((size_t)(&f) - (size_t)(f->rdata->stack) <
-               qlib->qthread_stack_size);
+               f->rdata->stack_size);
         return (size_t)(&f) - (size_t)(f->rdata->stack);
 #endif
     } else {
@@ -1815,6 +1985,23 @@ size_t API_FUNC qthread_readstate(const enum introspective_state type)
         case RUNTIME_DATA_SIZE:
              return sizeof(struct qthread_runtime_data_s);
 
+        case STACK_RESERVED_BYTES:
+#if defined(QTHREAD_MMAP_STACKS) && !defined(UNPOOLED_STACKS) && !defined(UNPOOLED)
+            return qt_stacks_reserved();
+#else
+            return (size_t)(-1);
+#endif
+
+        case STACK_RESIDENT_BYTES:
+#if defined(QTHREAD_MMAP_STACKS) && !defined(UNPOOLED_STACKS) && !defined(UNPOOLED)
+            return qt_stacks_resident();
+#else
+            return (size_t)(-1);
+#endif
+
+        case MPOOL_REMOTE_FREES:
+            return qt_mpool_remote_frees();
+
         case BUSYNESS:
         {
             qthread_shepherd_t *shep = qthread_internal_getshep();
@@ -1852,6 +2039,19 @@ size_t API_FUNC qthread_readstate(const enum introspective_state type)
             }
             return count;
         }
+        case PARKED_COUNT:
+        case WOKEN_COUNT:
+        {
+            size_t count = 0;
+            const qthread_shepherd_t *sheps = qlib->shepherds;
+            for (qthread_shepherd_id_t s=0; s<qlib->nshepherds; s++) {
+                const qthread_worker_t *wkrs = sheps[s].workers;
+                for (qthread_worker_id_t w=0; w<qlib->nworkerspershep; w++) {
+                    count += (type == PARKED_COUNT) ? wkrs[w].park_count : wkrs[w].wake_count;
+                }
+            }
+            return count;
+        }
         case ACTIVE_SHEPHERDS:
             return (size_t)(qlib->nshepherds_active);
 
@@ -1912,6 +2112,94 @@ size_t API_FUNC qthread_readstate(const enum introspective_state type)
     }
 }                      /*}}} */
 
+#ifdef QTHREAD_DEADLINES
+/* Called as a task with a deadline finishes, by the worker that ran it */
+static void qt_lateness_record(const qthread_t *t)
+{                      /*{{{ */
+    qthread_lateness_t *l    = &qthread_internal_getworker()->lateness;
+    const double        late = qtimer_wtime() - t->deadline;
+
+    l->tasks++;
+    if (late > 0.0) {
+        uint64_t     us     = (uint64_t)(late * 1e6);
+        unsigned int bucket = 0;
+
+        while (us && (bucket < QTHREAD_LATENESS_BUCKETS - 1)) {
+            us >>= 1;
+            bucket++;
+        }
+        l->late++;
+        l->total_lateness += late;
+        if (late > l->max_lateness) {
+            l->max_lateness = late;
+        }
+        l->histogram[bucket]++;
+    }
+}                      /*}}} */
+#endif /* ifdef QTHREAD_DEADLINES */
+
+int API_FUNC qthread_lateness(qthread_lateness_t *stats)
+{                      /*{{{ */
+    assert(stats);
+    memset(stats, 0, sizeof(qthread_lateness_t));
+#ifdef QTHREAD_DEADLINES
+    for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+        const qthread_worker_t *wkrs = qlib->shepherds[s].workers;
+        for (qthread_worker_id_t w = 0; w < qlib->nworkerspershep; w++) {
+            const qthread_lateness_t *l = &wkrs[w].lateness;
+
+            stats->tasks          += l->tasks;
+            stats->late           += l->late;
+            stats->total_lateness += l->total_lateness;
+            if (l->max_lateness > stats->max_lateness) {
+                stats->max_lateness = l->max_lateness;
+            }
+            for (int i = 0; i < QTHREAD_LATENESS_BUCKETS; i++) {
+                stats->histogram[i] += l->histogram[i];
+            }
+        }
+    }
+    return QTHREAD_SUCCESS;
+#else
+    return QTHREAD_NOT_ALLOWED;
+#endif
+}                      /*}}} */
+
+/* Racy if tasks with deadlines are finishing at the same time */
+void API_FUNC qthread_lateness_reset(void)
+{                      /*{{{ */
+#ifdef QTHREAD_DEADLINES
+    for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+        qthread_worker_t *wkrs = qlib->shepherds[s].workers;
+        for (qthread_worker_id_t w = 0; w < qlib->nworkerspershep; w++) {
+            memset(&wkrs[w].lateness, 0, sizeof(qthread_lateness_t));
+        }
+    }
+#endif
+}                      /*}}} */
+
+/* An upper bound on the given quantile (0..1) of the lateness of all
+ * deadline tasks in stats, in seconds; on-time tasks count as 0. */
+double API_FUNC qthread_lateness_quantile(const qthread_lateness_t *stats,
+                                          double                    quantile)
+{                      /*{{{ */
+    size_t rank, seen;
+
+    assert(stats);
+    if (stats->late == 0) { return 0.0; }
+    rank = (size_t)(quantile * stats->tasks + 0.999999);
+    seen = stats->tasks - stats->late;
+    if (rank <= seen) { return 0.0; }
+    for (int i = 0; i < QTHREAD_LATENESS_BUCKETS - 1; i++) {
+        seen += stats->histogram[i];
+        if (rank <= seen) {
+            const double bound = (double)((uint64_t)1 << i) * 1e-6;
+            return (bound < stats->max_lateness) ? bound : stats->max_lateness;
+        }
+    }
+    return stats->max_lateness;
+}                      /*}}} */
+
 aligned_t API_FUNC *qthread_retloc(void)
 {                      /*{{{ */
     qthread_t *me = qthread_internal_self();
@@ -1934,13 +2222,17 @@ static QINLINE qthread_t *qthread_thread_new(const qthread_f f,
                                              int             team_leader)
 {                      /*{{{ */
     qthread_t *t;
+    unsigned   c = 0;
 
+    // the smallest class with room for the argument; the last always has
     if ((arg_size > 0) && (arg_size <= qlib->qthread_argcopy_size)) {
-        t = ALLOC_BIG_QTHREAD();
-    } else {
-        t = ALLOC_QTHREAD();
+        c = 1;
+        while (arg_size > qlib->qthread_data_class_size[c] - qlib->qthread_argcopy_offset) {
+            c++;
+        }
     }
-    qthread_debug(THREAD_DETAILS, "t = %p\n", t);
+    t = ALLOC_QTHREAD(c);
+    qthread_debug(THREAD_DETAILS, "t = %p (data class %u)\n", t, c);
 
     t->f     = f;
     t->arg   = (void *)arg;
@@ -1971,11 +2263,17 @@ static QINLINE qthread_t *qthread_thread_new(const qthread_f f,
 #endif /* ifdef QTHREAD_NONLAZY_THREADIDS */
 
     t->target_shepherd = NO_SHEPHERD;
+    t->priority        = 0;
+    t->stack_class     = QTHREAD_STACK_DEFAULT;
+    t->data_class      = c;
+#ifdef QTHREAD_DEADLINES
+    t->deadline = 0.0;
+#endif
 
     // should I use the builtin block for args?
     if (arg_size > 0) {
         if (arg_size <= qlib->qthread_argcopy_size) {
-            t->arg   = (void *)(&t->data);
+            t->arg   = (void *)&t->data[qlib->qthread_argcopy_offset];
             t->flags = QTHREAD_BIG_STRUCT;
         } else {
             t->arg   = MALLOC(arg_size);
@@ -2004,15 +2302,9 @@ void qthread_thread_free(qthread_t *t)
 
     qthread_debug(THREAD_FUNCTIONS, "t(%p): destroying thread id %i\n", t, t->thread_id);
     if (t->rdata != NULL) {
-        if (t->rdata->tasklocal_size > 0) {
-            qthread_debug(THREAD_DETAILS, "t(%p,%i): destroying %u bytes of task-local storage\n", t, t->thread_id, t->rdata->tasklocal_size);
-            if (t->flags & QTHREAD_BIG_STRUCT) {
-                FREE(*(void **)&t->data[qlib->qthread_argcopy_size], t->rdata->tasklocal_size);
-                *(void **)&t->data[qlib->qthread_argcopy_size] = NULL;
-            } else {
-                FREE(*(void **)&t->data[0], t->rdata->tasklocal_size);
-                *(void **)&t->data[0] = NULL;
-            }
+        free_tasklocal(t);
+        if (t->rdata->retired_arg) {
+            qt_free(t->rdata->retired_arg);
         }
 #ifdef QTHREAD_USE_VALGRIND
         VALGRIND_STACK_DEREGISTER(t->rdata->valgrind_stack_id);
@@ -2023,22 +2315,18 @@ void qthread_thread_free(qthread_t *t)
         } else {
             assert(t->rdata->stack);
             qthread_debug(THREAD_DETAILS, "t(%p): releasing stack %p\n", t, t->rdata->stack);
-            FREE_STACK(t->rdata->stack);
+            FREE_STACK(t->rdata->stack, t->stack_class);
         }
 
         t->rdata = NULL;
     }
     if (t->flags & QTHREAD_HAS_ARGCOPY) {
-        assert(&t->data != t->arg);
+        assert(&t->data[qlib->qthread_argcopy_offset] != t->arg);
         qt_free(t->arg); // I don't record the size of this anywhere, so I can't scribble it
         t->arg = NULL;
     }
     qthread_debug(THREAD_DETAILS, "t(%p): releasing thread handle %p\n", t, t);
-    if (t->flags & QTHREAD_BIG_STRUCT) {
-        FREE_BIG_QTHREAD(t);
-    } else {
-        FREE_QTHREAD(t);
-    }
+    FREE_QTHREAD(t);
 }                      /*}}} */
 
 #ifdef QTHREAD_ALLOW_HPCTOOLKIT_STACK_UNWINDING
@@ -2055,7 +2343,7 @@ extern void *qthread_fence2;
 void API_FUNC qthread_call_method(qthread_f f, void*arg, void* ret, uint16_t flags){
     if (ret) {
         if (flags & QTHREAD_RET_IS_SINC) {
-            if (flags & QTHREAD_RET_IS_VOID_SINC) {
+            if ((flags & QTHREAD_RET_IS_VOID_SINC) == QTHREAD_RET_IS_VOID_SINC) {
                 (f)(arg);
                 qt_sinc_submit((qt_sinc_t *)ret, NULL);
             } else {
@@ -2075,6 +2363,102 @@ void API_FUNC qthread_call_method(qthread_f f, void*arg, void* ret, uint16_t fla
         (f)(arg);
 }
 
+/* Run t, a lazily spawned task that no worker has started, to completion on
+ * the stack of the task that joins on it, and release it. It never gets a
+ * stack or runtime data of its own. */
+void INTERNAL qthread_run_inline(qthread_t *t)
+{                      /*{{{ */
+    assert(t->thread_state == QTHREAD_STATE_NEW && t->rdata == NULL);
+    qthread_debug(THREAD_DETAILS, "tid %u running inline\n", t->thread_id);
+    qthread_call_method(t->f, t->arg, t->ret, t->flags);
+    if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
+#ifdef QTHREAD_COUNT_THREADS
+    QTHREAD_FASTLOCK_LOCK(&concurrentthreads_lock);
+    assert(concurrentthreads > 0);
+    concurrentthreads--;
+    QTHREAD_FASTLOCK_UNLOCK(&concurrentthreads_lock);
+#endif
+    qthread_thread_free(t);
+}                      /*}}} */
+
+/* Runs t's function, hands its return value over, and marks t terminated;
+ * this is the part of a task that starts over after qthread_replace(). */
+static void qthread_wrapper_run(qthread_t *t)
+{                      /*{{{ */
+    assert(t->rdata);
+#ifdef QTHREAD_TASK_AGGREGATION
+    /* aggregable tasks are timed, to learn how many to batch together */
+    const double agg_start = (t->flags & QTHREAD_AGGREGABLE) ? qtimer_wtime() : 0.0;
+#endif
+    if(t->flags & QTHREAD_AGGREGATED){
+        qt_agg_batch_t *batch = (qt_agg_batch_t *)t->preconds;
+        qthread_agg_f agg_f = (qthread_agg_f) ( t->f ) ;
+        agg_f(batch->count, batch->f, batch->arg, batch->ret, t->flags);
+        if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
+        //TODO: How to handle ret sinc flags? 
+        //Temp solution: use qthread_call_method and pass task flags to the agg function.
+#ifdef QTHREAD_TASK_AGGREGATION
+        qt_agg_record(batch->f[0], qtimer_wtime() - agg_start, batch->count);
+#endif
+        t->preconds = NULL;
+        qt_agg_batch_free(batch);
+    }
+    else if (t->ret) {
+        qthread_debug(THREAD_DETAILS, "tid %u, with flags %u, handling retval\n", t->thread_id, t->flags);
+        if (t->flags & QTHREAD_RET_IS_SINC) {
+            if ((t->flags & QTHREAD_RET_IS_VOID_SINC) == QTHREAD_RET_IS_VOID_SINC) {
+                (t->f)(t->arg);
+                if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
+                qt_sinc_submit((qt_sinc_t *)t->ret, NULL);
+            } else {
+                aligned_t retval = (t->f)(t->arg);
+                if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
+                qt_sinc_submit((qt_sinc_t *)t->ret, &retval);
+            }
+        } else if (t->flags & QTHREAD_RET_IS_SYNCVAR) {
+            /* this should avoid problems with irresponsible return values */
+            uint64_t retval = INT64TOINT60((t->f)(t->arg));
+            if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
+            qassert(qthread_syncvar_writeEF_const((syncvar_t *)t->ret, retval), QTHREAD_SUCCESS);
+        } else {
+            aligned_t retval = (t->f)(t->arg);
+            if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
+            qthread_debug(FEB_DETAILS, "tid %u filling retval (%p)\n", t->thread_id, t->ret);
+            qassert(qthread_writeEF_const((aligned_t *)t->ret, retval), QTHREAD_SUCCESS);
+        }
+    } else {
+        assert(t->f);
+        (t->f)(t->arg);
+        if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
+    }
+#ifdef QTHREAD_TASK_AGGREGATION
+    if ((t->flags & (QTHREAD_AGGREGABLE | QTHREAD_AGGREGATED)) == QTHREAD_AGGREGABLE) {
+        qt_agg_record(t->f, qtimer_wtime() - agg_start, 1);
+    }
+#endif
+
+    t->thread_state = QTHREAD_STATE_TERMINATED;
+#ifdef QTHREAD_PERFORMANCE
+    QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_TERMINATED);
+#endif /*  ifdef QTHREAD_PERFORMANCE */
+#ifdef QTHREAD_DEADLINES
+    if (t->deadline != 0.0) {
+        qt_lateness_record(t);
+    }
+#endif
+
+
+#ifdef QTHREAD_COUNT_THREADS
+    QTHREAD_FASTLOCK_LOCK(&effconcurrentthreads_lock);
+    effconcurrentthreads--;
+    QTHREAD_FASTLOCK_UNLOCK(&effconcurrentthreads_lock);
+    QTHREAD_FASTLOCK_LOCK(&concurrentthreads_lock);
+    assert(concurrentthreads > 0);
+    concurrentthreads--;
+    QTHREAD_FASTLOCK_UNLOCK(&concurrentthreads_lock);
+#endif
+}                      /*}}} */
+
 /* this function runs a thread until it completes or yields */
 #ifdef QTHREAD_MAKECONTEXT_SPLIT
 static void qthread_wrapper(unsigned int high,
@@ -2120,7 +2504,7 @@ static void qthread_wrapper(void *ptr)
                   t->thread_id, t->f, t->arg);
     if ((t->flags & QTHREAD_SIMPLE) == 0) {
         assert((size_t)&t > (size_t)t->rdata->stack &&
-               (size_t)&t < ((size_t)t->rdata->stack + qlib->qthread_stack_size));
+               (size_t)&t < ((size_t)t->rdata->stack + t->rdata->stack_size));
     }
 #ifdef QTHREAD_COUNT_THREADS
     QTHREAD_FASTLOCK_LOCK(&effconcurrentthreads_lock);
@@ -2144,60 +2528,8 @@ static void qthread_wrapper(void *ptr)
         }
     }
 
-    assert(t->rdata);
-    if(t->flags & QTHREAD_AGGREGATED){
-        int count = ((int*)t->preconds)[0];
-        qthread_f *list_of_f = (qthread_f*) ( & (((int*)t->preconds)[1]) );
-        qthread_agg_f agg_f = (qthread_agg_f) ( t->f ) ;
-        agg_f(count, list_of_f, (void**)t->arg, (void**)t->ret, t->flags);
-        if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
-        //TODO: How to handle ret sinc flags? 
-        //Temp solution: use qthread_call_method and pass task flags to the agg function.
-    }
-    else if (t->ret) {
-        qthread_debug(THREAD_DETAILS, "tid %u, with flags %u, handling retval\n", t->thread_id, t->flags);
-        if (t->flags & QTHREAD_RET_IS_SINC) {
-            if (t->flags & QTHREAD_RET_IS_VOID_SINC) {
-                (t->f)(t->arg);
-                if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
-                qt_sinc_submit((qt_sinc_t *)t->ret, NULL);
-            } else {
-                aligned_t retval = (t->f)(t->arg);
-                if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
-                qt_sinc_submit((qt_sinc_t *)t->ret, &retval);
-            }
-        } else if (t->flags & QTHREAD_RET_IS_SYNCVAR) {
-            /* this should avoid problems with irresponsible return values */
-            uint64_t retval = INT64TOINT60((t->f)(t->arg));
-            if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
-            qassert(qthread_syncvar_writeEF_const((syncvar_t *)t->ret, retval), QTHREAD_SUCCESS);
-        } else {
-            aligned_t retval = (t->f)(t->arg);
-            if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
-            qthread_debug(FEB_DETAILS, "tid %u filling retval (%p)\n", t->thread_id, t->ret);
-            qassert(qthread_writeEF_const((aligned_t *)t->ret, retval), QTHREAD_SUCCESS);
-        }
-    } else {
-        assert(t->f);
-        (t->f)(t->arg);
-        if (NULL != t->team) { qt_internal_teamfinish(t->team, t->flags); }
-    }
-
-    t->thread_state = QTHREAD_STATE_TERMINATED;
-#ifdef QTHREAD_PERFORMANCE
-    QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_TERMINATED);
-#endif /*  ifdef QTHREAD_PERFORMANCE */
-
+    qthread_wrapper_run(t);
 
-#ifdef QTHREAD_COUNT_THREADS
-    QTHREAD_FASTLOCK_LOCK(&effconcurrentthreads_lock);
-    effconcurrentthreads--;
-    QTHREAD_FASTLOCK_UNLOCK(&effconcurrentthreads_lock);
-    QTHREAD_FASTLOCK_LOCK(&concurrentthreads_lock);
-    assert(concurrentthreads > 0);
-    concurrentthreads--;
-    QTHREAD_FASTLOCK_UNLOCK(&concurrentthreads_lock);
-#endif
     /* theoretically, we could rely on the uc_link pointer to bring us back to
      * the parent shepherd. HOWEVER, this doesn't work in lots of situations,
      * so we do it manually. A brief list of situations:
@@ -2228,6 +2560,94 @@ int in_qthread_fence(void *addr)
 
 #endif
 
+/* where a task starts over after qthread_replace(), on a fresh stack frame;
+ * what qthread_wrapper() does before running the task has been done */
+#ifdef QTHREAD_MAKECONTEXT_SPLIT
+static void qthread_replaced_wrapper(unsigned int high,
+                                     unsigned int low)
+{                      /*{{{ */
+    qthread_t *t = (qthread_t *)((((uintptr_t)high) << 32) | low);
+
+#else
+static void qthread_replaced_wrapper(void *ptr)
+{
+    qthread_t *t = (qthread_t *)ptr;
+#endif
+#ifdef QTHREAD_USE_EUREKAS
+    qt_eureka_check(0);
+#endif /* QTHREAD_USE_EUREKAS */
+    qthread_debug(THREAD_BEHAVIOR,
+                  "tid %u replaced by f=%p arg=%p...\n",
+                  t->thread_id, t->f, t->arg);
+    qthread_wrapper_run(t);
+    qthread_debug(THREAD_BEHAVIOR, "tid %u exiting.\n",
+                  t->thread_id);
+    qthread_back_to_master2(t);
+}                      /*}}} */
+
+/* Replaces the running task's function and argument, and starts it over at
+ * the top of its own stack: the stack, the qthread_t, and the return value
+ * location are all reused, and the scheduler is not involved. Returns only
+ * if the task cannot be replaced. */
+int API_FUNC qthread_replace(qthread_f   f,
+                             const void *arg,
+                             size_t      arg_size)
+{                      /*{{{ */
+    qthread_t *t = qthread_internal_self();
+
+    qthread_debug(THREAD_CALLS, "f(%p), arg(%p), arg_size(%u)\n", f, arg, (unsigned)arg_size);
+    if (QTHREAD_UNLIKELY(f == NULL)) { return QTHREAD_BADARGS; }
+    /* a task without a stack of its own, or one running on another's stack
+     * (simple tasks, aggregated batches, touched lazy tasks, the main task),
+     * cannot be started over */
+    if ((t == NULL) || (t->rdata == NULL) || (t->rdata->stack == NULL) ||
+        (t->flags & (QTHREAD_SIMPLE | QTHREAD_AGGREGATED | QTHREAD_REAL_MCCOY)) ||
+        (t->rdata->inline_depth != 0)) {
+        return QTHREAD_NOT_ALLOWED;
+    }
+    assert(t->thread_state == QTHREAD_STATE_RUNNING);
+
+    /* the new argument may be (part of) the old one, so it is copied before
+     * the old one is released */
+    if (arg_size > 0) {
+        const size_t room = qlib->qthread_data_class_size[t->data_class] -
+                            qlib->qthread_argcopy_offset;
+        void *const  copy = (arg_size <= room) ? (void *)&t->data[qlib->qthread_argcopy_offset]
+                                               : MALLOC(arg_size);
+
+        if (QTHREAD_UNLIKELY(copy == NULL)) { return QTHREAD_MALLOC_ERROR; }
+        memmove(copy, arg, arg_size);
+        if (t->flags & QTHREAD_HAS_ARGCOPY) {
+            qt_free(t->arg);
+        }
+        t->arg    = copy;
+        t->flags &= ~(QTHREAD_HAS_ARGCOPY | QTHREAD_BIG_STRUCT);
+        t->flags |= (arg_size <= room) ? QTHREAD_BIG_STRUCT : QTHREAD_HAS_ARGCOPY;
+    } else {
+        /* the new argument may point into the old copy, whose size is not
+         * recorded, so the copy is kept until the task ends; only one is
+         * kept, so an earlier one is released now */
+        if (t->flags & QTHREAD_HAS_ARGCOPY) {
+            if (t->rdata->retired_arg) {
+                qt_free(t->rdata->retired_arg);
+            }
+            t->rdata->retired_arg = t->arg;
+        }
+        t->arg    = (void *)arg;
+        t->flags &= ~(QTHREAD_HAS_ARGCOPY | QTHREAD_BIG_STRUCT);
+    }
+    t->f = f;
+
+    /* Only the first few words at the top of the stack are written here;
+     * they belong to the first frame, which is done with, while this one is
+     * well below it. Nothing on the stack is used after the jump. */
+    qthread_makecontext(&t->rdata->context, t->rdata->stack, t->rdata->stack_size,
+                        (void (*)(void))qthread_replaced_wrapper, t,
+                        t->rdata->return_context);
+    setcontext(&t->rdata->context);
+    return QTHREAD_SUCCESS; /* not reached */
+}                      /*}}} */
+
 /* This function means "run thread t". The second argument (c) is a pointer
  * to the current context. */
 void INTERNAL qthread_exec(qthread_t    *t,
@@ -2246,7 +2666,7 @@ void INTERNAL qthread_exec(qthread_t    *t,
             QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_RUNNING);
 #endif /*  ifdef QTHREAD_PERFORMANCE */
             qthread_makecontext(&t->rdata->context,
-                                t->rdata->stack, qlib->qthread_stack_size,
+                                t->rdata->stack, t->rdata->stack_size,
                                 (void (*)(void))qthread_wrapper, t, c);
 #ifdef HAVE_NATIVE_MAKECONTEXT
         } else {
@@ -2328,11 +2748,14 @@ void API_FUNC qthread_yield_(int k)
                             goto basic_yield;
                         }
                         /* Initialize nt's rdata */
-                        alloc_rdata(t->rdata->shepherd_ptr, nt);
+                        if (QTHREAD_UNLIKELY(alloc_rdata(t->rdata->shepherd_ptr, nt) != 0)) {
+                            qt_spawncache_spawn(nt, t->rdata->shepherd_ptr->ready);
+                            goto basic_yield;
+                        }
                         nt->thread_state = QTHREAD_STATE_YIELDED; // special indicator state for qthread_wrapper()
                         QTPERF_QTHREAD_ENTER_STATE(nt->rdata->performance_data, QTHREAD_STATE_YIELDED);
                         nt->rdata->blockedon.thread = t;
-                        qthread_makecontext(&nt->rdata->context, nt->rdata->stack, qlib->qthread_stack_size, (void(*)(void))qthread_wrapper, nt, t->rdata->return_context);
+                        qthread_makecontext(&nt->rdata->context, nt->rdata->stack, nt->rdata->stack_size, (void(*)(void))qthread_wrapper, nt, t->rdata->return_context);
                         nt->rdata->return_context = t->rdata->return_context;
                         RLIMIT_TO_TASK(t);
                         /* SWAP! */
@@ -2403,14 +2826,94 @@ void API_FUNC qthread_flushsc(void)
  */
 #define QTHREAD_SPAWN_MASK_TEAMS (QTHREAD_SPAWN_NEW_TEAM | QTHREAD_SPAWN_NEW_SUBTEAM)
 
-int API_FUNC qthread_spawn(qthread_f             f,
-                           const void           *arg,
-                           size_t                arg_size,
-                           void                 *ret,
-                           size_t                npreconds,
-                           void                 *preconds,
-                           qthread_shepherd_id_t target_shep,
-                           unsigned int          feature_flag)
+/* Set the flags, priority and stack class of new task t from feature_flag. */
+static QINLINE void qthread_spawn_features(qthread_t   *t,
+                                           unsigned int feature_flag)
+{   /*{{{*/
+    if (feature_flag & QTHREAD_SPAWN_SIMPLE) {
+        t->flags |= QTHREAD_SIMPLE;
+    }
+    if (feature_flag & QTHREAD_SPAWN_AGGREGABLE) {
+        t->flags |= QTHREAD_AGGREGABLE;
+    }
+    if (feature_flag & QTHREAD_SPAWN_NETWORK) {
+        t->flags |= QTHREAD_NETWORK;
+    }
+    {
+        unsigned int priority = (feature_flag & QTHREAD_SPAWN_PRIORITY_MASK) >> QTHREAD_SPAWN_PRIORITY_SHIFT;
+        t->priority = (priority < QTHREAD_PRIORITY_BANDS_MAX) ? priority : (QTHREAD_PRIORITY_BANDS_MAX - 1);
+    }
+    {
+        unsigned int stack_class = (feature_flag & QTHREAD_SPAWN_STACK_MASK) >> QTHREAD_SPAWN_STACK_SHIFT;
+        t->stack_class = (stack_class < QTHREAD_STACK_CLASSES) ? stack_class : QTHREAD_STACK_DEFAULT;
+    }
+} /*}}}*/
+
+/* Get ret, of the type feature_flag says, ready to receive new task t's
+ * return value. */
+static QINLINE int qthread_spawn_ret(qthread_t   *t,
+                                     void        *ret,
+                                     unsigned int feature_flag)
+{   /*{{{*/
+    int      test     = QTHREAD_SUCCESS;
+    unsigned ret_type = feature_flag & (QTHREAD_SPAWN_RET_SYNCVAR_T |
+                                        QTHREAD_SPAWN_RET_SINC |
+                                        QTHREAD_SPAWN_RET_SINC_VOID);
+
+    switch (ret_type) {
+        case QTHREAD_SPAWN_RET_SYNCVAR_T:
+            t->flags |= QTHREAD_RET_IS_SYNCVAR;
+            if (qthread_syncvar_status((syncvar_t *)ret)) {
+                test = qthread_syncvar_empty((syncvar_t *)ret);
+            } else {
+                test = QTHREAD_SUCCESS;
+            }
+            break;
+        case QTHREAD_SPAWN_RET_SINC:
+            t->flags |= QTHREAD_RET_IS_SINC;
+            break;
+        case QTHREAD_SPAWN_RET_SINC_VOID:
+            t->flags |= QTHREAD_RET_IS_VOID_SINC;
+            break;
+        default:
+            // QTHREAD_SPAWN_RET_ALIGNED
+            qthread_debug(FEB_DETAILS, "emptying new thread %u's retval (%p)\n", t->thread_id, ret);
+            test = qthread_empty(ret);
+            break;
+    }
+    return test;
+} /*}}}*/
+
+#ifdef QTHREAD_COUNT_THREADS
+static void qthread_count_spawned(size_t n)
+{   /*{{{*/
+    QTHREAD_FASTLOCK_LOCK(&concurrentthreads_lock);
+    while (n--) {
+        threadcount++;
+        concurrentthreads++;
+        assert(concurrentthreads <= threadcount);
+        if (concurrentthreads > maxconcurrentthreads) {
+            maxconcurrentthreads = concurrentthreads;
+        }
+        avg_concurrent_threads =
+            (avg_concurrent_threads * (double)(threadcount - 1.0) / threadcount)
+            + ((double)concurrentthreads / threadcount);
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&concurrentthreads_lock);
+} /*}}}*/
+#else
+# define qthread_count_spawned(n) do { } while (0)
+#endif  /* ifdef QTHREAD_COUNT_THREADS */
+
+static int qthread_spawn_internal(qthread_f             f,
+                                  const void           *arg,
+                                  size_t                arg_size,
+                                  void                 *ret,
+                                  size_t                npreconds,
+                                  void                 *preconds,
+                                  qthread_shepherd_id_t target_shep,
+                                  unsigned int          feature_flag,
+                                  double                deadline)
 {   /*{{{*/
     assert(qthread_library_initialized);
     qthread_t            *t;
@@ -2452,6 +2955,19 @@ int API_FUNC qthread_spawn(qthread_f             f,
                    (feature_flag & QTHREAD_SPAWN_NEW_SUBTEAM) ? "sub_team" : "same_team"),
                   ((feature_flag & QTHREAD_SPAWN_SIMPLE) ? "simple" : "full"));
     assert(qlib);
+    if (QTHREAD_UNLIKELY(STACKS_EXHAUSTED() && !(feature_flag & QTHREAD_SPAWN_SIMPLE))) {
+        return QTHREAD_MALLOC_ERROR;
+    }
+    if (QTHREAD_UNLIKELY(npreconds != 0) && preconds && !(feature_flag & QTHREAD_SPAWN_PC_SYNCVAR_T)) {
+        /* bit 0 of an entry marks a syncvar_t (QTHREAD_PRECOND_SYNCVAR()), so
+         * an aligned_t's address must not use the low bits */
+        aligned_t *const *pc = (aligned_t *const *)preconds;
+        for (size_t i = 1; i <= npreconds; i++) {
+            if (QTHREAD_UNLIKELY(((uintptr_t)pc[i] & ~(uintptr_t)1) & (sizeof(aligned_t) - 1))) {
+                return QTHREAD_BADARGS;
+            }
+        }
+    }
     /* Step 2: Pick a destination */
     if (target_shep != NO_SHEPHERD) {
         dest_shep = target_shep % qlib->nshepherds;
@@ -2465,11 +2981,8 @@ int API_FUNC qthread_spawn(qthread_f             f,
         qassert_ret(f != NULL, QTHREAD_BADARGS);
         if (npreconds > 0) {
             qassert_ret(preconds != NULL, QTHREAD_BADARGS);
-            // XXX: remove the following assert when preconds support syncvar_t's
-            assert((feature_flag & QTHREAD_SPAWN_PC_SYNCVAR_T) == 0);
         } else {
             qassert_ret(preconds == NULL, QTHREAD_BADARGS);
-            assert((feature_flag & QTHREAD_SPAWN_PC_SYNCVAR_T) == 0);
         }
 #endif  /* ifdef QTHREAD_DEBUG */
     }
@@ -2519,7 +3032,7 @@ int API_FUNC qthread_spawn(qthread_f             f,
 
     if (QTHREAD_UNLIKELY(target_shep != NO_SHEPHERD)) {
         t->target_shepherd = dest_shep;
-        t->flags          |= QTHREAD_UNSTEALABLE;
+        t->flags          |= (feature_flag & QTHREAD_SPAWN_NEAR) ? QTHREAD_NODE_BOUND : QTHREAD_UNSTEALABLE;
     }
     if (QTHREAD_UNLIKELY(npreconds != 0)) {
         t->thread_state = QTHREAD_STATE_NASCENT; // special non-executable state
@@ -2529,40 +3042,33 @@ int API_FUNC qthread_spawn(qthread_f             f,
         t->preconds     = preconds;
         qthread_debug(THREAD_BEHAVIOR, "npreconds=%u, preconds[0]=%u\n", (unsigned int)npreconds, (unsigned int)(uintptr_t)((aligned_t **)preconds)[0]);
         assert(((aligned_t **)preconds)[0] == (aligned_t *)(uintptr_t)npreconds);
+        if (feature_flag & QTHREAD_SPAWN_PC_SYNCVAR_T) {
+            /* from here on, syncvar_t preconditions are told apart per entry */
+            aligned_t **pc = (aligned_t **)preconds;
+            for (size_t i = 1; i <= npreconds; i++) {
+                pc[i] = QTHREAD_PRECOND_SYNCVAR(pc[i]);
+            }
+        }
     } else {
         t->preconds = NULL;
     }
-    if (feature_flag & QTHREAD_SPAWN_SIMPLE) {
-        t->flags |= QTHREAD_SIMPLE;
+    qthread_spawn_features(t, feature_flag);
+    if ((feature_flag & QTHREAD_SPAWN_LAZY) && me && myshep &&
+        (target_shep == NO_SHEPHERD) && (npreconds == 0) &&
+        !(feature_flag & QTHREAD_SPAWN_MASK_TEAMS)) {
+        /* queued where the parent will look for it when it joins */
+        dest_shep  = myshep->shepherd_id;
+        t->flags  |= QTHREAD_LAZY;
+        me->flags |= QTHREAD_LAZY_PARENT;
     }
+#ifdef QTHREAD_DEADLINES
+    t->deadline = deadline;
+#endif
     qthread_debug(THREAD_BEHAVIOR, "new-tid %u shep %u\n", t->thread_id, dest_shep);
        /* Step 4: Prepare the return value location (if necessary) */
     if (ret) {
-        int      test     = QTHREAD_SUCCESS;
-        unsigned ret_type = feature_flag & (QTHREAD_SPAWN_RET_SYNCVAR_T |
-                                            QTHREAD_SPAWN_RET_SINC |
-                                            QTHREAD_SPAWN_RET_SINC_VOID);
-        switch (ret_type) {
-            case QTHREAD_SPAWN_RET_SYNCVAR_T:
-                t->flags |= QTHREAD_RET_IS_SYNCVAR;
-                if (qthread_syncvar_status((syncvar_t *)ret)) {
-                    test = qthread_syncvar_empty((syncvar_t *)ret);
-                } else {
-                    test = QTHREAD_SUCCESS;
-                }
-                break;
-            case QTHREAD_SPAWN_RET_SINC:
-                t->flags |= QTHREAD_RET_IS_SINC;
-                break;
-            case QTHREAD_SPAWN_RET_SINC_VOID:
-                t->flags |= QTHREAD_RET_IS_VOID_SINC;
-                break;
-            default:
-                // QTHREAD_SPAWN_RET_ALIGNED
-                qthread_debug(FEB_DETAILS, "tid %i emptying new thread %u's retval (%p)\n", me ? ((int)me->thread_id) : -1, t->thread_id, ret);
-                test = qthread_empty(ret);
-                break;
-        }
+        int test = qthread_spawn_ret(t, ret, feature_flag);
+
         if (QTHREAD_UNLIKELY(test != QTHREAD_SUCCESS)) {
             qthread_thread_free(t);
             return test;
@@ -2572,21 +3078,9 @@ int API_FUNC qthread_spawn(qthread_f             f,
     /* Step 5: Prepare the input preconditions (if necessary) */
     if (QTHREAD_LIKELY(!preconds) || (qthread_check_feb_preconds(t) == 0)) {
         /* Step 6: Set it going */
-#ifdef QTHREAD_COUNT_THREADS
-        QTHREAD_FASTLOCK_LOCK(&concurrentthreads_lock);
-        threadcount++;
-        concurrentthreads++;
-        assert(concurrentthreads <= threadcount);
-        if (concurrentthreads > maxconcurrentthreads) {
-            maxconcurrentthreads = concurrentthreads;
-        }
-        avg_concurrent_threads =
-            (avg_concurrent_threads * (double)(threadcount - 1.0) / threadcount)
-            + ((double)concurrentthreads / threadcount);
-        QTHREAD_FASTLOCK_UNLOCK(&concurrentthreads_lock);
-#endif  /* ifdef QTHREAD_COUNT_THREADS */
+        qthread_count_spawned(1);
 #ifdef QTHREAD_USE_SPAWNCACHE
-        if (target_shep == NO_SHEPHERD) {
+        if ((target_shep == NO_SHEPHERD) && !(t->flags & QTHREAD_LAZY)) {
             if (!qt_spawncache_spawn(t, qlib->threadqueues[dest_shep])) {
                 qt_threadqueue_enqueue(qlib->threadqueues[dest_shep], t);
             }
@@ -2603,9 +3097,183 @@ int API_FUNC qthread_spawn(qthread_f             f,
         }
     }
 
-    if (feature_flag & QTHREAD_SPAWN_NETWORK)
-        t->flags |= QTHREAD_NETWORK;
+    return QTHREAD_SUCCESS;
+} /*}}}*/
+
+int API_FUNC qthread_spawn(qthread_f             f,
+                           const void           *arg,
+                           size_t                arg_size,
+                           void                 *ret,
+                           size_t                npreconds,
+                           void                 *preconds,
+                           qthread_shepherd_id_t target_shep,
+                           unsigned int          feature_flag)
+{   /*{{{*/
+    return qthread_spawn_internal(f, arg, arg_size, ret, npreconds, preconds,
+                                  target_shep, feature_flag, 0.0);
+} /*}}}*/
+
+int API_FUNC qthread_spawn_deadline(qthread_f             f,
+                                    const void           *arg,
+                                    size_t                arg_size,
+                                    void                 *ret,
+                                    size_t                npreconds,
+                                    void                 *preconds,
+                                    qthread_shepherd_id_t target_shep,
+                                    unsigned int          feature_flag,
+                                    double                deadline)
+{   /*{{{*/
+    return qthread_spawn_internal(f, arg, arg_size, ret, npreconds, preconds,
+                                  target_shep, feature_flag, deadline);
+} /*}}}*/
+
+int API_FUNC qthread_spawn_near(qthread_f    f,
+                                const void  *arg,
+                                size_t       arg_size,
+                                void        *ret,
+                                size_t       npreconds,
+                                void        *preconds,
+                                const void  *addr,
+                                unsigned int feature_flag)
+{   /*{{{*/
+    return qthread_spawn_internal(f, arg, arg_size, ret, npreconds, preconds,
+                                  qthread_shep_near(addr),
+                                  feature_flag | QTHREAD_SPAWN_NEAR, 0.0);
+} /*}}}*/
+
+/* qthread_spawn_bulk() queues tasks this many at a time */
+#define QTHREAD_SPAWN_BULK_BATCH 64
+
+int API_FUNC qthread_spawn_bulk(qthread_f                    f,
+                                const void                  *args,
+                                size_t                       arg_size,
+                                size_t                       n,
+                                void                        *rets,
+                                const qthread_shepherd_id_t *target_sheps,
+                                unsigned int                 feature_flag)
+{   /*{{{*/
+    assert(qthread_library_initialized);
+    qthread_t             *me     = qthread_internal_self();
+    qthread_shepherd_t    *myshep = me ? me->rdata->shepherd_ptr : NULL;
+    qt_team_t             *team   = (me && me->team) ? me->team : NULL;
+    qt_threadqueue_t     **queues = qlib->threadqueues;
+    qthread_t            **batch;
+    qthread_shepherd_id_t *dest;
+
+    qthread_debug(THREAD_CALLS,
+                  "f(%p), args(%p), arg_size(%z), n(%z), rets(%p), ts(%p)\n",
+                  f, args, arg_size, n, rets, target_sheps);
+    /* every task joins the spawner's team, and none can be lazy */
+    if ((f == NULL) || (feature_flag & (QTHREAD_SPAWN_MASK_TEAMS | QTHREAD_SPAWN_LAZY))) {
+        return QTHREAD_BADARGS;
+    }
+    if (QTHREAD_UNLIKELY(STACKS_EXHAUSTED() && !(feature_flag & QTHREAD_SPAWN_SIMPLE))) {
+        return QTHREAD_MALLOC_ERROR;
+    }
+    if (n == 0) { return QTHREAD_SUCCESS; }
+#ifdef QTHREAD_LOCAL_PRIORITY
+    if (feature_flag & QTHREAD_SPAWN_LOCAL_PRIORITY) {
+        queues = qlib->local_priority_queues;
+    }
+#endif
+    /* not on the stack, which may be a task's small one */
+    batch = MALLOC(n * sizeof(qthread_t *));
+    dest  = MALLOC(n * sizeof(qthread_shepherd_id_t));
+    if (QTHREAD_UNLIKELY((batch == NULL) || (dest == NULL))) {
+        if (batch) { FREE(batch, n * sizeof(qthread_t *)); }
+        if (dest) { FREE(dest, n * sizeof(qthread_shepherd_id_t)); }
+        return QTHREAD_MALLOC_ERROR;
+    }
+
+    /* Step 1: Allocate & init all the structures, and pick their
+     * destinations, so that either every task is spawned or none is */
+    for (size_t i = 0; i < n; i++) {
+        const void *arg;
+        void       *ret;
+        qthread_t  *t;
+        int         test = QTHREAD_SUCCESS;
+
+        if (arg_size) {
+            arg = (const uint8_t *)args + i * arg_size;
+        } else {
+            arg = args ? ((void *const *)args)[i] : NULL;
+        }
+        if ((rets == NULL) ||
+            (feature_flag & (QTHREAD_SPAWN_RET_SINC | QTHREAD_SPAWN_RET_SINC_VOID))) {
+            ret = rets;
+        } else if (feature_flag & QTHREAD_SPAWN_RET_SYNCVAR_T) {
+            ret = (syncvar_t *)rets + i;
+        } else {
+            ret = (aligned_t *)rets + i;
+        }
+
+        t = qthread_thread_new(f, arg, arg_size, (aligned_t *)ret, team, 0);
+        if (QTHREAD_UNLIKELY(t == NULL)) {
+            test = QTHREAD_MALLOC_ERROR;
+        } else {
+            t->preconds = NULL;
+            qthread_spawn_features(t, feature_flag);
+            if (ret) {
+                test = qthread_spawn_ret(t, ret, feature_flag);
+                if (QTHREAD_UNLIKELY(test != QTHREAD_SUCCESS)) {
+                    qthread_thread_free(t);
+                }
+            }
+        }
+        if (QTHREAD_UNLIKELY(test != QTHREAD_SUCCESS)) {
+            while (i > 0) {
+                qthread_thread_free(batch[--i]);
+            }
+            FREE(batch, n * sizeof(qthread_t *));
+            FREE(dest, n * sizeof(qthread_shepherd_id_t));
+            return test;
+        }
+        if (target_sheps && (target_sheps[i] != NO_SHEPHERD)) {
+            dest[i]            = target_sheps[i] % qlib->nshepherds;
+            t->target_shepherd = dest[i];
+            t->flags          |= (feature_flag & QTHREAD_SPAWN_NEAR) ? QTHREAD_NODE_BOUND : QTHREAD_UNSTEALABLE;
+        } else {
+            dest[i] = qt_threadqueue_choose_dest(myshep);
+        }
+        batch[i] = t;
+    }
+
+    /* Step 2: Join the team, all at once */
+    if (team) {
+        qt_sinc_expect(team->sinc, n);
+    }
+    qthread_count_spawned(n);
+
+    /* Step 3: Set them going, a batch at a time, with one enqueue per
+     * destination in each batch */
+    for (size_t done = 0; done < n;) {
+        const size_t           cnt = ((n - done) < QTHREAD_SPAWN_BULK_BATCH) ? (n - done) : QTHREAD_SPAWN_BULK_BATCH;
+        qthread_t            **b   = batch + done;
+        qthread_shepherd_id_t *ds  = dest + done;
+
+        for (size_t first = 0; first < cnt;) {
+            const qthread_shepherd_id_t d    = ds[first];
+            size_t                      last = first + 1;
 
+            for (size_t j = last; j < cnt; j++) {
+                if (ds[j] == d) {
+                    qthread_t *tmp = b[last];
+
+                    b[last]  = b[j];
+                    b[j]     = tmp;
+                    ds[j]    = ds[last];
+                    ds[last] = d;
+                    last++;
+                }
+            }
+            qthread_debug(THREAD_BEHAVIOR, "%u new tasks to shep %u\n", (unsigned)(last - first), d);
+            qt_threadqueue_enqueue_bulk(queues[d], b + first, last - first);
+            first = last;
+        }
+        done += cnt;
+    }
+    FREE(batch, n * sizeof(qthread_t *));
+    FREE(dest, n * sizeof(qthread_shepherd_id_t));
     return QTHREAD_SUCCESS;
 } /*}}}*/
 
@@ -2924,6 +3592,19 @@ void INTERNAL qthread_back_to_master(qthread_t *t)
 #ifdef QTHREAD_PERFORMANCE
     QTPERF_WORKER_ENTER_STATE(qthread_internal_getworker()->performance_data, WKR_QTHREAD_ACTIVE);
 #endif /*  QTHREAD_PERFORMANCE */
+    {
+        /* if we were resumed by a direct swap, the task that swapped to us
+         * is now off its stack and can be made ready again (blocking
+         * actions resume on an I/O thread, which is not a worker) */
+        qthread_worker_t *w    = qthread_internal_getworker();
+        qthread_t        *prev = w ? w->swapped_out : NULL;
+
+        if (prev) {
+            w->swapped_out = NULL;
+            qthread_debug(THREAD_DETAILS, "t(%p): requeueing tid %u after direct swap\n", t, prev->thread_id);
+            qt_threadqueue_enqueue(prev->rdata->shepherd_ptr->ready, prev);
+        }
+    }
 }                      /*}}} */
 
 void INTERNAL qthread_back_to_master2(qthread_t *t)
@@ -2948,6 +3629,73 @@ void INTERNAL qthread_back_to_master2(qthread_t *t)
 #endif
 }                      /*}}} */
 
+/* Called, with the wait-queue lock held, for a blocked task that is being
+ * woken by the running task. If direct swapping is enabled and the waiter
+ * could run on this worker, it is remembered for qthread_internal_handoff()
+ * instead of being enqueued, and 1 is returned. */
+int INTERNAL qthread_internal_handoff_offer(qthread_t          *waiter,
+                                            qthread_shepherd_t *shep)
+{                      /*{{{ */
+    qthread_worker_t *w;
+    qthread_t        *me;
+
+    if (!direct_swap) { return 0; }
+    w = qthread_internal_getworker();
+    if ((w == NULL) || (w->shepherd != shep) || (w->handoff != NULL)) { return 0; }
+    me = w->current;
+    if ((me == NULL) || (me->thread_state != QTHREAD_STATE_RUNNING) ||
+        (me->flags & (QTHREAD_SIMPLE | QTHREAD_REAL_MCCOY))) {
+        return 0;
+    }
+    if ((waiter->flags & (QTHREAD_SIMPLE | QTHREAD_REAL_MCCOY)) ||
+        ((waiter->target_shepherd != NO_SHEPHERD) && (waiter->target_shepherd != shep->shepherd_id)) ||
+        ((waiter->flags & QTHREAD_UNSTEALABLE) && (waiter->rdata->shepherd_ptr != shep)) ||
+        !QTHREAD_CASLOCK_READ_UI(w->active)) {
+        return 0;
+    }
+    w->handoff = waiter;
+    return 1;
+}                      /*}}} */
+
+/* Switch straight from the running task to the task accepted by
+ * qthread_internal_handoff_offer(), if any, without a trip through the
+ * ready queue. Must be called with no locks held. The running task is made
+ * ready again once the woken task is running on its stack (see
+ * qthread_back_to_master()). */
+void INTERNAL qthread_internal_handoff(void)
+{                      /*{{{ */
+    qthread_worker_t *w = qthread_internal_getworker();
+    qthread_t        *t, *nt;
+
+    if ((w == NULL) || ((nt = w->handoff) == NULL)) { return; }
+    w->handoff = NULL;
+    t          = w->current;
+    assert(t != NULL);
+    assert(t->thread_state == QTHREAD_STATE_RUNNING);
+    assert(nt->thread_state == QTHREAD_STATE_RUNNING);
+    assert(w->swapped_out == NULL);
+
+    qthread_debug(THREAD_BEHAVIOR, "tid %u swapping directly to tid %u\n", t->thread_id, nt->thread_id);
+    nt->rdata->shepherd_ptr   = w->shepherd;
+    nt->rdata->return_context = t->rdata->return_context;
+#ifdef HAVE_NATIVE_MAKECONTEXT
+    nt->rdata->context.uc_link = t->rdata->return_context;
+#endif
+    w->swapped_out = t;
+    w->current     = nt;
+#ifdef QTHREAD_USE_VALGRIND
+    VALGRIND_CHECK_MEM_IS_ADDRESSABLE(&nt->rdata->context, sizeof(qt_context_t));
+    VALGRIND_MAKE_MEM_DEFINED(&nt->rdata->context, sizeof(qt_context_t));
+#endif
+#ifdef HAVE_NATIVE_MAKECONTEXT
+    qassert(swapcontext(&t->rdata->context, &nt->rdata->context), 0);
+#else
+    qassert(qt_swapctxt(&t->rdata->context, &nt->rdata->context), 0);
+#endif
+    /* t is resumed later like any other ready task, via qthread_exec() */
+    qthread_debug(THREAD_BEHAVIOR, "tid %u resumed after direct swap.\n", t->thread_id);
+}                      /*}}} */
+
 /* function to move a qthread from one shepherd to another */
 int API_FUNC qthread_migrate_to(const qthread_shepherd_id_t shepherd)
 {                      /*{{{ */
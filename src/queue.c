@@ -115,7 +115,9 @@ static void qthread_queue_internal_launch(qthread_t          *t,
     assert(t);
     assert(cur_shep);
     t->thread_state = QTHREAD_STATE_RUNNING;
-    if ((t->flags & QTHREAD_UNSTEALABLE) && (t->rdata->shepherd_ptr != cur_shep)) {
+    if (qthread_internal_handoff_offer(t, cur_shep)) {
+        qthread_debug(FEB_DETAILS, "qthread(%p:%i) will be swapped to directly\n", t, (int)t->thread_id);
+    } else if ((t->flags & QTHREAD_UNSTEALABLE) && (t->rdata->shepherd_ptr != cur_shep)) {
         qthread_debug(FEB_DETAILS, "qthread(%p:%i) enqueueing in target_shep's ready queue (%p:%i)\n", t, (int)t->thread_id, t->rdata->shepherd_ptr, (int)t->rdata->shepherd_ptr->shepherd_id);
         qt_threadqueue_enqueue(t->rdata->shepherd_ptr->ready, t);
     } else
@@ -155,6 +157,7 @@ int API_FUNC qthread_queue_release_one(qthread_queue_t q)
     } else {
         qthread_queue_internal_launch(t, &qlib->shepherds[destination]);
     }
+    qthread_internal_handoff();
     return QTHREAD_SUCCESS;
 }
 
@@ -206,6 +209,7 @@ int API_FUNC qthread_queue_release_all(qthread_queue_t q)
         default:
             QTHREAD_TRAP();
     }
+    qthread_internal_handoff();
     return QTHREAD_SUCCESS;
 }
 
@@ -18,9 +18,13 @@
 #include "qt_qthread_struct.h"
 #include "qt_qthread_mgmt.h"
 #include "qt_macros.h"
+#include "qt_envariables.h"
+#include "qt_victims.h"
+#include "qt_affinity.h"
 
 /* Shared Globals */
 TLS_DECL_INIT(qthread_shepherd_t *, shepherd_structs);
+unsigned int qt_victim_retries[QT_VICTIM_LEVELS] = { 1, 1, 1 };
 
 int API_FUNC qthread_shep_ok(void)
 {                      /*{{{ */
@@ -150,6 +154,43 @@ const qthread_shepherd_id_t API_FUNC *qthread_sorted_sheps_remote(const qthread_
     return qlib->shepherds[src].sorted_sheplist;
 }                      /*}}} */
 
+/* returns a shepherd on the memory node that holds addr, for a task that
+ * works on it: the caller's own if it is there, otherwise each of the node's
+ * shepherds in turn; NO_SHEPHERD if the node is not known */
+qthread_shepherd_id_t API_FUNC qthread_shep_near(const void *addr)
+{                      /*{{{ */
+    assert(qthread_library_initialized);
+#ifdef QTHREAD_HAVE_MEM_AFFINITY
+    static aligned_t            next   = 0;
+    const qthread_shepherd_id_t nsheps = (qthread_shepherd_id_t)qlib->nshepherds;
+    qthread_shepherd_t         *me     = qthread_internal_getshep();
+    int                         node;
+    qthread_shepherd_id_t       start;
+
+    if (addr == NULL) {
+        return NO_SHEPHERD;
+    }
+    node = qt_affinity_mem_node(addr);
+    qthread_debug(AFFINITY_DETAILS, "addr %p is on node %i\n", addr, node);
+    if (node < 0) {
+        return NO_SHEPHERD;
+    }
+    if (me && (me->mem_node == node) && QTHREAD_CASLOCK_READ_UI(me->active)) {
+        return me->shepherd_id;
+    }
+    start = (qthread_shepherd_id_t)(qthread_incr(&next, 1) % nsheps);
+    for (qthread_shepherd_id_t i = 0; i < nsheps; i++) {
+        const qthread_shepherd_id_t s = (qthread_shepherd_id_t)((start + i) % nsheps);
+
+        if ((qlib->shepherds[s].mem_node == node) &&
+            QTHREAD_CASLOCK_READ_UI(qlib->shepherds[s].active)) {
+            return s;
+        }
+    }
+#endif /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
+    return NO_SHEPHERD;
+}                      /*}}} */
+
 /* returns the number of shepherds actively scheduling work */
 qthread_shepherd_id_t API_FUNC qthread_num_shepherds(void)
 {                      /*{{{ */
@@ -280,4 +321,31 @@ qthread_shepherd_t INTERNAL *qthread_find_active_shepherd(qthread_shepherd_id_t
     }
 }                      /*}}} */
 
+/* Group each shepherd's sorted_sheplist into steal rings (see qt_victims.h).
+ * Must run after qt_affinity_gendists(). */
+void INTERNAL qt_victims_init(void)
+{                      /*{{{ */
+    const qthread_shepherd_id_t nsheps = (qthread_shepherd_id_t)qlib->nshepherds;
+
+    qt_victim_retries[QT_VICTIM_LOCAL]  = qt_internal_get_env_num("STEAL_RETRIES_LOCAL", 1, 0);
+    qt_victim_retries[QT_VICTIM_NODE]   = qt_internal_get_env_num("STEAL_RETRIES_NODE", 1, 0);
+    qt_victim_retries[QT_VICTIM_REMOTE] = qt_internal_get_env_num("STEAL_RETRIES_REMOTE", 1, 0);
+
+    for (qthread_shepherd_id_t i = 0; i < nsheps; i++) {
+        qthread_shepherd_t *const shep = &qlib->shepherds[i];
+        qthread_shepherd_id_t     near = 0;
+
+        if (nsheps > 1) {
+            const unsigned int near_dist = shep->shep_dists[shep->sorted_sheplist[0]];
+            while (near < (nsheps - 1) &&
+                   shep->shep_dists[shep->sorted_sheplist[near]] == near_dist) {
+                near++;
+            }
+        }
+        shep->num_near_sheps = near;
+        qthread_debug(AFFINITY_DETAILS, "shep %i: %i near shepherds, %i remote\n",
+                      (int)i, (int)near, (int)(nsheps - 1 - near));
+    }
+}                      /*}}} */
+
 /* vim:set expandtab: */
@@ -18,6 +18,7 @@
 #include "qt_alloc.h"
 #include "qt_subsystems.h"
 #include "qt_atomics.h"
+#include "qt_qthread_struct.h" /* for qthread_t.priority */
 
 /* Globals */
 TLS_DECL_INIT(qt_threadqueue_private_t *, spawn_cache);
@@ -70,7 +71,8 @@ int INTERNAL qt_spawncache_spawn(qthread_t        *t,
 {
     qt_threadqueue_private_t *cache = TLS_GET(spawn_cache);
 
-    if (cache) {
+    /* the cache is not banded; prioritized tasks go straight to the queue */
+    if (cache && (t->priority == 0)) {
         int ret = qt_threadqueue_private_enqueue(cache, q, t);
         if( !ret) {
             return ret;
@@ -85,7 +87,7 @@ int INTERNAL qt_spawncache_yield(qthread_t *t)
 {
     qt_threadqueue_private_t *cache = TLS_GET(spawn_cache);
 
-    if (cache) {
+    if (cache && (t->priority == 0)) {
         return qt_threadqueue_private_enqueue_yielded(cache, t);
     } else {
         return 0;
@@ -0,0 +1,321 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdint.h>
+#include <stdio.h>    /* for perror() */
+#include <unistd.h>   /* for getpagesize() */
+#include <sys/mman.h> /* for mmap(), mprotect(), madvise(), mincore() */
+
+/* API Headers */
+#include "qthread/qthread.h"
+
+/* Internal Headers */
+#include "qt_visibility.h"
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qt_expect.h"
+#include "qt_debug.h"
+#include "qt_alloc.h"
+#include "qt_envariables.h"
+#include "qt_subsystems.h"   /* for qthread_internal_cleanup() */
+#include "qthread_innards.h" /* for qlib */
+#include "qt_shepherd_innards.h"
+#include "qt_qthread_struct.h" /* for struct qthread_runtime_data_s */
+#include "qt_stacks.h"
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+# define MAP_NORESERVE 0
+#endif
+#ifdef MADV_FREE
+# define QT_MADV_COLD MADV_FREE
+#else
+# define QT_MADV_COLD MADV_DONTNEED
+#endif
+
+typedef struct qt_stack_region_s {
+    struct qt_stack_region_s *next;
+    uint8_t                  *base;
+    size_t                    len;
+} qt_stack_region_t;
+
+/* a free stack; the link lives at its top, in the page that stays warm */
+typedef struct qt_free_stack_s {
+    struct qt_free_stack_s *next;
+} qt_free_stack_t;
+
+#define STACK_LINK(s, c) ((qt_free_stack_t *)((uint8_t *)(s) + classes[c].stack_size) - 1)
+#define LINK_STACK(l, c) ((void *)((uint8_t *)((l) + 1) - classes[c].stack_size))
+
+typedef struct {
+    QTHREAD_FASTLOCK_TYPE lock;
+    qt_free_stack_t      *warm;
+    qt_free_stack_t      *cold;
+    size_t                nwarm;
+} qt_stack_list_t;
+
+typedef struct {
+    size_t           stack_size;
+    size_t           slot_size;    /* bytes per slot */
+    size_t           stack_offset; /* from the slot to the stack */
+    size_t           region_slots; /* slots reserved at a time */
+    uint8_t         *carve_next;   /* next never used slot */
+    uint8_t         *carve_end;
+    qt_stack_list_t *lists;        /* one per shepherd */
+} qt_stack_class_t;
+
+static qt_stack_region_t    *regions = NULL;
+static qt_stack_class_t      classes[QTHREAD_STACK_CLASSES];
+static QTHREAD_FASTLOCK_TYPE region_lock;
+static size_t                page;
+static size_t                warm_max; /* warm stacks kept per shepherd and class */
+static int                   guard_pages;  /* a guard page around every slot */
+static size_t                reserved = 0;
+static volatile int          exhausted = 0; /* the last attempt to reserve failed */
+
+static void qt_stacks_subsystem_shutdown(void)
+{   /*{{{*/
+    while (regions) {
+        qt_stack_region_t *r = regions;
+
+        regions = r->next;
+        if (munmap(r->base, r->len) != 0) {
+            perror("munmap in qt_stacks_subsystem_shutdown");
+        }
+        FREE(r, sizeof(qt_stack_region_t));
+    }
+    for (unsigned c = 0; c < QTHREAD_STACK_CLASSES; c++) {
+        for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+            QTHREAD_FASTLOCK_DESTROY(classes[c].lists[s].lock);
+        }
+        qt_free(classes[c].lists);
+        classes[c].lists      = NULL;
+        classes[c].carve_next = classes[c].carve_end = NULL;
+    }
+    QTHREAD_FASTLOCK_DESTROY(region_lock);
+    reserved = 0;
+} /*}}}*/
+
+void INTERNAL qt_stacks_subsystem_init(int guard)
+{   /*{{{*/
+    const size_t rdata_size  = sizeof(struct qthread_runtime_data_s);
+    const size_t rdata_pages = (rdata_size + getpagesize() - 1) & ~(size_t)(getpagesize() - 1);
+
+    page        = getpagesize();
+    guard_pages = guard;
+    warm_max    = qt_internal_get_env_num("STACK_WARM", 16, 0);
+    for (unsigned c = 0; c < QTHREAD_STACK_CLASSES; c++) {
+        qt_stack_class_t *k           = &classes[c];
+        const size_t      stack_size = qlib->qthread_stack_class_size[c];
+
+        k->stack_size = stack_size;
+        if (guard) {
+            const size_t stack_pages = (stack_size + page - 1) & ~(page - 1);
+
+            /* the stack ends where its upper guard page begins */
+            k->stack_offset = page + stack_pages - stack_size;
+            k->slot_size    = page + stack_pages + page + rdata_pages;
+        } else {
+            const size_t pages = (stack_size + rdata_size + page - 1) & ~(page - 1);
+
+            /* the runtime data shares the top page of the stack, so that an
+             * idle task costs a single resident page */
+            k->stack_offset = (pages - rdata_size - stack_size) & ~(size_t)(QTHREAD_STACK_ALIGNMENT - 1);
+            k->slot_size    = pages;
+        }
+        assert(k->stack_offset % QTHREAD_STACK_ALIGNMENT == 0);
+        /* keep regions of the big classes to a sane amount of address space */
+        k->region_slots = QT_STACK_REGION_BYTES / k->slot_size;
+        if (k->region_slots > QT_STACK_REGION_SLOTS) {
+            k->region_slots = QT_STACK_REGION_SLOTS;
+        } else if (k->region_slots == 0) {
+            k->region_slots = 1;
+        }
+        k->carve_next = k->carve_end = NULL;
+        k->lists      = qt_calloc(qlib->nshepherds, sizeof(qt_stack_list_t));
+        assert(k->lists);
+        for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+            QTHREAD_FASTLOCK_INIT(k->lists[s].lock);
+        }
+        qthread_debug(CORE_DETAILS, "stack class %u: slots of %u bytes, %u per region\n",
+                      c, (unsigned)k->slot_size, (unsigned)k->region_slots);
+    }
+    QTHREAD_FASTLOCK_INIT(region_lock);
+    qthread_debug(CORE_DETAILS, "%u warm stacks per shepherd\n", (unsigned)warm_max);
+    qthread_internal_cleanup(qt_stacks_subsystem_shutdown);
+} /*}}}*/
+
+/* Protect the guard pages of a new region: one below every slot with guard
+ * pages, or else one below the whole region. Each protected page splits the
+ * mapping, and there are only so many mappings (vm.max_map_count) to go
+ * around, which is why guarding every slot is left to QTHREAD_GUARD_PAGES. */
+static int qt_stacks_guard(const qt_stack_class_t *k,
+                           uint8_t                *base)
+{   /*{{{*/
+    if (!guard_pages) {
+        return mprotect(base, page, PROT_NONE);
+    }
+    for (size_t i = 0; i < k->region_slots; i++) {
+        uint8_t *guard = base + i * k->slot_size;
+
+        if ((mprotect(guard, page, PROT_NONE) != 0) ||
+            (mprotect(guard + k->stack_offset + k->stack_size, page, PROT_NONE) != 0)) {
+            return -1;
+        }
+    }
+    return 0;
+} /*}}}*/
+
+/* Hand out the next never used slot of class c, reserving a region of more
+ * (and protecting its guard pages) when there are none left. Untouched
+ * slots cost no memory. Returns NULL, and flags the pool as exhausted until
+ * the next stack is freed, if no region can be reserved; only the first such
+ * failure is reported. */
+static void *qt_stacks_carve(unsigned c)
+{   /*{{{*/
+    qt_stack_class_t *k    = &classes[c];
+    uint8_t          *slot = NULL;
+
+    QTHREAD_FASTLOCK_LOCK(&region_lock);
+    if (exhausted && (k->carve_next == k->carve_end)) {
+        /* don't try again before a stack has been freed */
+        QTHREAD_FASTLOCK_UNLOCK(&region_lock);
+        return NULL;
+    }
+    if (k->carve_next == k->carve_end) {
+        const size_t       lead = guard_pages ? 0 : page;
+        const size_t       len  = lead + k->slot_size * k->region_slots;
+        qt_stack_region_t *r;
+        uint8_t           *base;
+
+        base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) {
+            if (!exhausted) { perror("mmap in qt_stacks_carve"); }
+            exhausted = 1;
+            QTHREAD_FASTLOCK_UNLOCK(&region_lock);
+            return NULL;
+        }
+        if (qt_stacks_guard(k, base) != 0) {
+            if (!exhausted) { perror("mprotect in qt_stacks_carve"); }
+            if (munmap(base, len) != 0) {
+                perror("munmap in qt_stacks_carve");
+            }
+            exhausted = 1;
+            QTHREAD_FASTLOCK_UNLOCK(&region_lock);
+            return NULL;
+        }
+        r = MALLOC(sizeof(qt_stack_region_t));
+        assert(r);
+        r->base       = base;
+        r->len        = len;
+        r->next       = regions;
+        regions       = r;
+        reserved     += len;
+        k->carve_next = base + lead;
+        k->carve_end  = base + len;
+        qthread_debug(CORE_DETAILS, "reserved %u class %u stacks at %p\n",
+                      (unsigned)k->region_slots, c, base);
+    }
+    slot           = k->carve_next;
+    k->carve_next += k->slot_size;
+    QTHREAD_FASTLOCK_UNLOCK(&region_lock);
+
+    return slot + k->stack_offset;
+} /*}}}*/
+
+static QINLINE qt_stack_list_t *qt_stacks_mylist(unsigned c)
+{   /*{{{*/
+    qthread_shepherd_t *shep = qthread_internal_getshep();
+
+    return &classes[c].lists[shep ? shep->shepherd_id : 0];
+} /*}}}*/
+
+void INTERNAL *qt_stack_alloc(unsigned c)
+{   /*{{{*/
+    qt_stack_list_t *l = qt_stacks_mylist(c);
+    qt_free_stack_t *fs;
+
+    assert(c < QTHREAD_STACK_CLASSES);
+    QTHREAD_FASTLOCK_LOCK(&l->lock);
+    if ((fs = l->warm) != NULL) {
+        l->warm = fs->next;
+        l->nwarm--;
+    } else if ((fs = l->cold) != NULL) {
+        l->cold = fs->next;
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&l->lock);
+
+    return fs ? LINK_STACK(fs, c) : qt_stacks_carve(c);
+} /*}}}*/
+
+void INTERNAL qt_stack_free(void    *stack,
+                            unsigned c)
+{   /*{{{*/
+    qt_stack_list_t *l  = qt_stacks_mylist(c);
+    qt_free_stack_t *fs = STACK_LINK(stack, c);
+
+    assert(stack);
+    if (QTHREAD_UNLIKELY(exhausted)) {
+        exhausted = 0;
+    }
+    if (l->nwarm >= warm_max) {
+        /* everything below the top page of the stack is cold */
+        uint8_t *cold = (uint8_t *)(((uintptr_t)stack + page - 1) & ~(uintptr_t)(page - 1));
+        uint8_t *hot  = (uint8_t *)((uintptr_t)fs & ~(uintptr_t)(page - 1));
+
+        if (hot > cold) {
+            (void)madvise(cold, hot - cold, QT_MADV_COLD);
+        }
+        QTHREAD_FASTLOCK_LOCK(&l->lock);
+        fs->next = l->cold;
+        l->cold  = fs;
+        QTHREAD_FASTLOCK_UNLOCK(&l->lock);
+    } else {
+        QTHREAD_FASTLOCK_LOCK(&l->lock);
+        fs->next = l->warm;
+        l->warm  = fs;
+        l->nwarm++;
+        QTHREAD_FASTLOCK_UNLOCK(&l->lock);
+    }
+} /*}}}*/
+
+/* Would a task that needs a new stack not get one right now? */
+int INTERNAL qt_stacks_exhausted(void)
+{   /*{{{*/
+    return exhausted;
+} /*}}}*/
+
+size_t INTERNAL qt_stacks_reserved(void)
+{   /*{{{*/
+    return reserved;
+} /*}}}*/
+
+/* Resident bytes of all reserved regions, stacks and their runtime data */
+size_t INTERNAL qt_stacks_resident(void)
+{   /*{{{*/
+    size_t resident = 0;
+
+    QTHREAD_FASTLOCK_LOCK(&region_lock);
+    for (qt_stack_region_t *r = regions; r != NULL; r = r->next) {
+        const size_t   npages = r->len / page;
+        unsigned char *vec    = MALLOC(npages);
+
+        assert(vec);
+        if (mincore((void *)r->base, r->len, (void *)vec) == 0) {
+            for (size_t i = 0; i < npages; i++) {
+                resident += (vec[i] & 1) ? page : 0;
+            }
+        }
+        FREE(vec, npages);
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&region_lock);
+
+    return resident;
+} /*}}}*/
+
+/* vim:set expandtab: */
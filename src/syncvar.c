@@ -25,6 +25,8 @@
 #include "qt_qthread_struct.h"
 #include "qt_qthread_mgmt.h"
 #include "qt_threadqueues.h"
+#include "qt_touch.h"
+#include "qt_feb.h" /* for qthread_check_feb_preconds() */
 #include "qt_debug.h"
 #ifdef QTHREAD_USE_EUREKAS
 #include "qt_eurekas.h"
@@ -396,6 +398,10 @@ int API_FUNC qthread_syncvar_readFF(uint64_t *restrict  dest,
         }
     }
 #endif /* if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64)) */
+    if (me->flags & QTHREAD_LAZY_PARENT) {
+        /* if the task that fills src has not started, run it here */
+        qthread_run_needed_task(src);
+    }
     ret = qthread_mwaitc(src, SYNCFEB_FULL, INITIAL_TIMEOUT, &e);
     qthread_debug(SYNCVAR_DETAILS, "2 src(%p) = %x, ret = %x\n", src,
                   (uintptr_t)src->u.w, ret);
@@ -536,6 +542,100 @@ int INTERNAL qthread_syncvar_readFF_nb(uint64_t *restrict  dest,
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
 
+/* Used by qthread_check_feb_preconds(): returns 0 if src is full, and
+ * otherwise queues the nascent task t to have its preconditions checked
+ * again when src is filled, and returns 1. */
+int INTERNAL qthread_syncvar_precond(syncvar_t *src,
+                                     qthread_t *t)
+{                                      /*{{{ */
+    eflags_t            e = { 0, 0, 0, 0, 0 };
+    uint64_t            ret;
+    const int           lockbin = QTHREAD_CHOOSE_STRIPE(src);
+    qthread_addrstat_t *m;
+    qthread_addrres_t  *X;
+
+    assert(src);
+    qthread_debug(SYNCVAR_CALLS, "t(%p), src(%p) = %x\n", t, src, (uintptr_t)src->u.w);
+
+#if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) ||    \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) ||      \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64))
+    {
+        /* see qthread_syncvar_readFF() */
+        syncvar_t local_copy_of_src = *src;
+        if ((local_copy_of_src.u.s.lock == 0) && ((local_copy_of_src.u.s.state & 2) == 0)) {        /* full and unlocked */
+            return 0;
+        }
+    }
+#endif /* if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64)) */
+    /* allocated before src is locked, so that running out leaves it as it was */
+    X = ALLOC_ADDRRES();
+    if (!X) { return QTHREAD_MALLOC_ERROR; }
+    ret = qthread_mwaitc(src, SYNCFEB_ANY, INT_MAX, &e);
+    qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
+    if (e.pf == 0) {                         /* full */
+        UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, e.sf);
+        FREE_ADDRRES(X);
+        return 0;
+    }
+    QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
+#ifdef LOCK_FREE_FEBS
+    do {
+        m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
+got_m:
+        if (!m) {
+            m = qthread_addrstat_new();
+            if (!m) {
+                UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, (e.pf << 1) | e.sf);
+                FREE_ADDRRES(X);
+                return QTHREAD_MALLOC_ERROR;
+            }
+            QTHREAD_FASTLOCK_LOCK(&m->lock);
+            qassertnot(qt_hash_put(syncvars[lockbin], (void *)src, m), 0);
+        } else {
+            qthread_addrstat_t *m2;
+            hazardous_ptr(0, m);
+            if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)src))) {
+                m = m2;
+                goto got_m;
+            }
+            if (!m->valid) { continue; }
+            QTHREAD_FASTLOCK_LOCK(&m->lock);
+            if (!m->valid) {
+                QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+                continue;
+            }
+        }
+        break;
+    } while (1);
+#else   /* ifdef LOCK_FREE_FEBS */
+    /* Note that locking the hash table is unnecessary because we have
+     * locked the syncvar itself. */
+    m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
+    if (!m) {
+        m = qthread_addrstat_new();
+        if (!m) {
+            UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, (e.pf << 1) | e.sf);
+            FREE_ADDRRES(X);
+            return QTHREAD_MALLOC_ERROR;
+        }
+        qassertnot(qt_hash_put(syncvars[lockbin], (void *)src, m), 0);
+    }
+    QTHREAD_FASTLOCK_LOCK(&(m->lock));
+#endif  /* ifdef LOCK_FREE_FEBS */
+    UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, SYNCFEB_STATE_EMPTY_WITH_WAITERS);
+    X->addr         = NULL;
+    X->waiter       = t;
+    X->next         = m->FFQ;
+    m->FFQ          = X;
+    t->thread_state = QTHREAD_STATE_NASCENT;
+    QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_NASCENT);
+    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+    qthread_debug(SYNCVAR_DETAILS, "src(%p): t(%p) queued until full\n", src, t);
+    return 1;
+}                                      /*}}} */
+
 int API_FUNC qthread_syncvar_fill(syncvar_t *restrict addr)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
@@ -1076,7 +1176,8 @@ static QINLINE void qthread_syncvar_gotlock_fill(qthread_shepherd_t *shep,
                                                  syncvar_t          *maddr,
                                                  const uint64_t      ret)
 {                                      /*{{{ */
-    qthread_addrres_t *X = NULL;
+    qthread_addrres_t *X             = NULL;
+    qthread_addrres_t *precond_tasks = NULL;
     int                removeable;
 
     qthread_debug(SYNCVAR_FUNCTIONS, "m(%p), addr(%p)\n", m, maddr);
@@ -1088,6 +1189,12 @@ static QINLINE void qthread_syncvar_gotlock_fill(qthread_shepherd_t *shep,
         /* dQ */
         X      = m->FFQ;
         m->FFQ = X->next;
+        if (QTHREAD_STATE_NASCENT == X->waiter->thread_state) {
+            /* its other preconditions are checked once m is unlocked */
+            X->next       = precond_tasks;
+            precond_tasks = X;
+            continue;
+        }
         /* op */
         if (X->addr) {
             *(uint64_t *)X->addr = ret;
@@ -1117,6 +1224,20 @@ static QINLINE void qthread_syncvar_gotlock_fill(qthread_shepherd_t *shep,
     if (removeable) {
         qthread_syncvar_remove(maddr);
     }
+    while (precond_tasks != NULL) {
+        qthread_t *waiter = precond_tasks->waiter;
+
+        X             = precond_tasks;
+        precond_tasks = X->next;
+        FREE_ADDRRES(X);
+        if (qthread_check_feb_preconds(waiter) != 1) {
+            if (waiter->target_shepherd == NO_SHEPHERD) {
+                qt_threadqueue_enqueue(shep->ready, waiter);
+            } else {
+                qt_threadqueue_enqueue(qlib->shepherds[waiter->target_shepherd].ready, waiter);
+            }
+        }
+    }
 }                                      /*}}} */
 
 int API_FUNC qthread_syncvar_writeF(syncvar_t *restrict      dest,
@@ -1546,17 +1667,9 @@ static filter_code qt_syncvar_tf_call_cb(const qt_key_t            addr,
     void                 *tls;
 
     if (waiter->rdata->tasklocal_size <= qlib->qthread_tasklocal_size) {
-        if (waiter->flags & QTHREAD_BIG_STRUCT) {
-            tls = &waiter->data[qlib->qthread_argcopy_size];
-        } else {
-            tls = waiter->data;
-        }
+        tls = waiter->data;
     } else {
-        if (waiter->flags & QTHREAD_BIG_STRUCT) {
-            tls = *(void **)&waiter->data[qlib->qthread_argcopy_size];
-        } else {
-            tls = *(void **)&waiter->data[0];
-        }
+        tls = *(void **)&waiter->data[0];
     }
     f((void *)addr, waiter->f, waiter->arg, waiter->ret, waiter->thread_id, tls, f_arg);
     return IGNORE_AND_CONTINUE;
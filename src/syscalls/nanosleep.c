@@ -14,7 +14,6 @@
 
 /* API Headers */
 #include "qthread/qthread.h"
-#include "qthread/qtimer.h"
 
 /* Internal Headers */
 #include "qt_io.h"
@@ -25,20 +24,11 @@ int qt_nanosleep(const struct timespec *rqtp,
                  struct timespec       *rmtp)
 {
     if (qt_blockable()) {
-        qtimer_t t       = qtimer_create();
-        double   seconds = rqtp->tv_sec + (rqtp->tv_nsec * 1e-9);
-
-        qtimer_start(t);
-        do {
-            qthread_yield();
-            qtimer_stop(t);
-        } while (qtimer_secs(t) < seconds);
+        qthread_sleep(rqtp->tv_sec + (rqtp->tv_nsec * 1e-9));
         if (rmtp) {
-            time_t secs = (time_t)qtimer_secs(t);
-            rmtp->tv_sec = rqtp->tv_sec - secs;
-            rmtp->tv_nsec = (long)(qtimer_secs(t) - (double)secs) * 1e9;
+            rmtp->tv_sec  = 0;
+            rmtp->tv_nsec = 0;
         }
-        qtimer_destroy(t);
         return 0;
     } else {
         if (rmtp) {
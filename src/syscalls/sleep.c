@@ -12,7 +12,6 @@
 
 /* API Headers */
 #include "qthread/qthread.h"
-#include "qthread/qtimer.h"
 
 /* Internal Headers */
 #include "qt_io.h"
@@ -23,13 +22,7 @@
 unsigned int qt_sleep(unsigned int seconds)
 {
     if (qt_blockable()) {
-        qtimer_t t = qtimer_create();
-        qtimer_start(t);
-        do {
-            qthread_yield();
-            qtimer_stop(t);
-        } while (qtimer_secs(t) < seconds);
-        qtimer_destroy(t);
+        qthread_sleep(seconds);
         return 0;
     } else {
         return seconds;
@@ -12,7 +12,6 @@
 
 /* Public Headers */
 #include "qthread/qthread.h"
-#include "qthread/qtimer.h"
 
 /* Internal Headers */
 #include "qt_io.h"
@@ -22,14 +21,7 @@
 int qt_usleep(useconds_t useconds)
 {
      if (qt_blockable()) {
-        qtimer_t t       = qtimer_create();
-        double   seconds = useconds * 1e-6;
-        qtimer_start(t);
-        do {
-            qthread_yield();
-            qtimer_stop(t);
-        } while (qtimer_secs(t) < seconds);
-        qtimer_destroy(t);
+        qthread_sleep(useconds * 1e-6);
         return 0;
     } else {
         return -1;
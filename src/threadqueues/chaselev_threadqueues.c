@@ -0,0 +1,853 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Public Headers */
+#include "qthread/qthread.h"
+#include "qthread/cacheline.h"
+
+/* Internal Headers */
+#include "qt_alloc.h"
+#include "qt_visibility.h"
+#include "qthread_innards.h"           /* for qlib */
+#include "qt_shepherd_innards.h"
+#include "qt_victims.h"
+#include "qt_qthread_struct.h"
+#include "qt_qthread_mgmt.h"
+#include "qt_asserts.h"
+#include "qt_prefetch.h"
+#include "qt_threadqueues.h"
+#include "qt_envariables.h"
+#include "qt_debug.h"
+#ifdef QTHREAD_USE_EUREKAS
+#include "qt_eurekas.h" /* for qt_eureka_check() */
+#endif /* QTHREAD_USE_EUREKAS */
+#include "qt_expect.h"
+#include "qt_subsystems.h"
+#include "qt_parking.h"
+#include "qt_aggregation.h"
+#include "qt_touch.h"
+
+/* The Chase-Lev scheduler keeps the sherwood scheduling order (LIFO for the
+ * workers of a shepherd, FIFO for thieves) but gives every worker its own
+ * growable array-based work-stealing deque (Chase & Lev, SPAA'05; memory
+ * orderings per Le et al., PPoPP'13). The owning worker pushes and pops at
+ * the bottom without any lock or atomic read-modify-write in the common case;
+ * thieves (siblings in the same shepherd or workers of other shepherds) take
+ * from the top with a single CAS.
+ *
+ * Only the owner may push onto a Chase-Lev deque, so tasks enqueued by
+ * anybody else (other shepherds waking a waiter, non-qthread pthreads), tasks
+ * marked QTHREAD_UNSTEALABLE, and yielded tasks go onto a small mutex-protected
+ * "shared" list per shepherd instead. That list sees little traffic: it is
+ * checked after the worker's own deque, and thieves only take stealable
+ * entries from it. */
+
+/* Data Structures */
+struct _qt_threadqueue_node {
+    struct _qt_threadqueue_node *next;
+    struct _qt_threadqueue_node *prev;
+    uintptr_t                    stealable;
+    qthread_t                   *value;
+} /* qt_threadqueue_node_t */;
+
+typedef struct _qt_cl_array {
+    struct _qt_cl_array *retired; /* smaller predecessor; thieves may still be reading it */
+    aligned_t            mask;    /* size - 1, size is a power of two */
+    qthread_t           *buf[];
+} qt_cl_array_t;
+
+typedef struct {
+    volatile aligned_t      top;    /* thieves' end */
+    uint8_t                 pad1[CACHELINE_WIDTH - sizeof(aligned_t)];
+    volatile aligned_t      bottom; /* owner's end */
+    qt_cl_array_t *volatile array;
+    uint8_t                 pad2[CACHELINE_WIDTH - sizeof(aligned_t) - sizeof(void *)];
+} qt_cl_deque_t;
+
+struct _qt_threadqueue {
+    qt_cl_deque_t         *deques;  /* one per worker of the owning shepherd */
+    qt_threadqueue_node_t *head;    /* shared list: foreign, unstealable and yielded tasks */
+    qt_threadqueue_node_t *tail;
+    long                   qlength;
+    long                   qlength_stealable;
+    qthread_t *volatile    mccoy;   /* parked here until worker 0 picks it up */
+#ifdef STEAL_PROFILE
+    aligned_t steal_amount_stolen;
+#endif
+
+    QTHREAD_TRYLOCK_TYPE qlock;
+    qt_parking_lot_t     lot;
+} /* qt_threadqueue_t */;
+
+#define CL_DEFAULT_LOG_SIZE 8
+
+static aligned_t steal_disable    = 0;
+static size_t    cl_initial_size  = 1 << CL_DEFAULT_LOG_SIZE;
+
+#ifdef STEAL_PROFILE
+# define STEAL_CALLED(shep)     qthread_incr( & ((shep)->steal_called), 1)
+# define STEAL_ELECTED(shep)    qthread_incr( & ((shep)->steal_elected), 1)
+# define STEAL_ATTEMPTED(shep)  qthread_incr( & ((shep)->steal_attempted), 1)
+# define STEAL_SUCCESSFUL(shep) do {} while (0)
+# define STEAL_FAILED(shep)     qthread_incr( & ((shep)->steal_failed), 1)
+# define STEAL_AMOUNT(q, ct)    qthread_incr( & ((q)->steal_amount_stolen), ct)
+#else
+# define STEAL_CALLED(shep)     do {} while(0)
+# define STEAL_ELECTED(shep)    do {} while(0)
+# define STEAL_ATTEMPTED(shep)  do {} while(0)
+# define STEAL_SUCCESSFUL(shep) do {} while(0)
+# define STEAL_FAILED(shep)     do {} while(0)
+# define STEAL_AMOUNT(q, ct)    do {} while(0)
+#endif /* ifdef STEAL_PROFILE */
+
+/* On TSO machines stores are not reordered with older stores and loads are
+ * not reordered with older loads, so publishing a slot before bumping
+ * `bottom` (and reading `top` before `bottom` in a steal) only needs the
+ * compiler to behave. The store->load ordering in pop always needs a fence. */
+#if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || \
+    (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA32))
+# define CL_RELEASE_FENCE COMPILER_FENCE
+# define CL_ACQUIRE_FENCE COMPILER_FENCE
+#else
+# define CL_RELEASE_FENCE MACHINE_FENCE
+# define CL_ACQUIRE_FENCE MACHINE_FENCE
+#endif
+
+#define CL_SIZE(b, t) ((saligned_t)((b) - (t)))
+
+/* Memory Management */
+#if defined(UNPOOLED_QUEUES) || defined(UNPOOLED)
+# define ALLOC_THREADQUEUE() (qt_threadqueue_t *)MALLOC(sizeof(qt_threadqueue_t))
+# define FREE_THREADQUEUE(t) FREE(t, sizeof(qt_threadqueue_t))
+# define ALLOC_TQNODE()      (qt_threadqueue_node_t *)MALLOC(sizeof(qt_threadqueue_node_t))
+# define FREE_TQNODE(t)      FREE(t, sizeof(qt_threadqueue_node_t))
+
+static void qt_threadqueue_subsystem_shutdown(void)
+{}
+
+void INTERNAL qt_threadqueue_subsystem_init(void)
+{
+    cl_initial_size = (size_t)1 << qt_internal_get_env_num("DEQUE_LOG_SIZE", CL_DEFAULT_LOG_SIZE, 1);
+    qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
+}
+
+#else /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
+qt_threadqueue_pools_t generic_threadqueue_pools;
+# define ALLOC_THREADQUEUE() (qt_threadqueue_t *)qt_mpool_alloc(generic_threadqueue_pools.queues)
+# define FREE_THREADQUEUE(t) qt_mpool_free(generic_threadqueue_pools.queues, t)
+# define ALLOC_TQNODE()      (qt_threadqueue_node_t *)qt_mpool_alloc(generic_threadqueue_pools.nodes)
+# define FREE_TQNODE(t)      qt_mpool_free(generic_threadqueue_pools.nodes, t)
+
+static void qt_threadqueue_subsystem_shutdown(void)
+{   /*{{{*/
+    qt_mpool_destroy(generic_threadqueue_pools.nodes);
+    qt_mpool_destroy(generic_threadqueue_pools.queues);
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_subsystem_init(void)
+{   /*{{{*/
+    generic_threadqueue_pools.queues = qt_mpool_create_aligned(sizeof(qt_threadqueue_t),
+                                                               qthread_cacheline());
+    generic_threadqueue_pools.nodes = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t),
+                                                              qthread_cacheline());
+    cl_initial_size = (size_t)1 << qt_internal_get_env_num("DEQUE_LOG_SIZE", CL_DEFAULT_LOG_SIZE, 1);
+    qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
+} /*}}}*/
+#endif /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
+
+/* tasks left in a queue come in any qthread_t size class */
+#define FREE_QTHREAD(t) qthread_thread_free(t)
+
+static QINLINE int qt_threadqueue_isstealable(qthread_t *t)
+{   /*{{{*/
+    return ((t->flags & (QTHREAD_UNSTEALABLE | QTHREAD_NODE_BOUND)) == 0) ? 1 : 0;
+} /*}}}*/
+
+/*****************************************/
+/* Chase-Lev deque                       */
+/*****************************************/
+
+static qt_cl_array_t *cl_array_new(size_t size)
+{   /*{{{*/
+    qt_cl_array_t *a = qt_malloc(sizeof(qt_cl_array_t) + size * sizeof(qthread_t *));
+
+    assert(a);
+    assert((size & (size - 1)) == 0);
+    a->retired = NULL;
+    a->mask    = size - 1;
+    return a;
+} /*}}}*/
+
+static void cl_deque_init(qt_cl_deque_t *d)
+{   /*{{{*/
+    d->top    = 1;
+    d->bottom = 1;
+    d->array  = cl_array_new(cl_initial_size);
+} /*}}}*/
+
+static void cl_deque_destroy(qt_cl_deque_t *d)
+{   /*{{{*/
+    qt_cl_array_t *a = d->array;
+
+    while (CL_SIZE(d->bottom, d->top) > 0) {
+        FREE_QTHREAD(a->buf[d->top & a->mask]);
+        d->top++;
+    }
+    while (a) {
+        qt_cl_array_t *next = a->retired;
+        qt_free(a);
+        a = next;
+    }
+} /*}}}*/
+
+/* Only the owner grows the array. The old array is kept (not freed) until the
+ * queue is destroyed, because a thief may have loaded the pointer before the
+ * swap; growth doubles, so retained memory is bounded by the final size. */
+static qt_cl_array_t *cl_deque_grow(qt_cl_deque_t *d,
+                                    qt_cl_array_t *a,
+                                    aligned_t      b,
+                                    aligned_t      t)
+{   /*{{{*/
+    qt_cl_array_t *n = cl_array_new((a->mask + 1) << 1);
+
+    for (aligned_t i = t; i != b; i++) {
+        n->buf[i & n->mask] = a->buf[i & a->mask];
+    }
+    n->retired = a;
+    CL_RELEASE_FENCE;
+    d->array = n;
+    return n;
+} /*}}}*/
+
+static QINLINE void cl_deque_push(qt_cl_deque_t *d,
+                                  qthread_t     *t)
+{   /*{{{*/
+    aligned_t      b = d->bottom;
+    aligned_t      tp = d->top;
+    qt_cl_array_t *a = d->array;
+
+    if (QTHREAD_UNLIKELY(CL_SIZE(b, tp) > (saligned_t)a->mask)) {
+        a = cl_deque_grow(d, a, b, tp);
+    }
+    a->buf[b & a->mask] = t;
+    CL_RELEASE_FENCE;
+    d->bottom = b + 1;
+} /*}}}*/
+
+static QINLINE qthread_t *cl_deque_pop(qt_cl_deque_t *d)
+{   /*{{{*/
+    aligned_t      b = d->bottom - 1;
+    qt_cl_array_t *a = d->array;
+    aligned_t      tp;
+    qthread_t     *t = NULL;
+
+    d->bottom = b;
+    MACHINE_FENCE;
+    tp = d->top;
+    if (CL_SIZE(b, tp) >= 0) {
+        t = a->buf[b & a->mask];
+        if (b == tp) {
+            /* last entry: race any thieves for it */
+            if (qthread_cas(&d->top, tp, tp + 1) != tp) {
+                t = NULL;
+            }
+            d->bottom = b + 1;
+        }
+    } else {
+        d->bottom = b + 1;
+    }
+    return t;
+} /*}}}*/
+
+static QINLINE qthread_t *cl_deque_steal(qt_cl_deque_t *d)
+{   /*{{{*/
+    aligned_t tp = d->top;
+
+    CL_ACQUIRE_FENCE;
+    aligned_t b = d->bottom;
+    if (CL_SIZE(b, tp) > 0) {
+        qt_cl_array_t *a = d->array;
+        qthread_t     *t;
+
+        CL_ACQUIRE_FENCE;
+        t = a->buf[tp & a->mask];
+        if (qthread_cas(&d->top, tp, tp + 1) == tp) {
+            return t;
+        }
+    }
+    return NULL;
+} /*}}}*/
+
+/*****************************************/
+/* Shared (locked) list                  */
+/*****************************************/
+
+static QINLINE void shared_enqueue(qt_threadqueue_t *q,
+                                   qthread_t        *t,
+                                   int               at_head)
+{   /*{{{*/
+    qt_threadqueue_node_t *node = ALLOC_TQNODE();
+
+    assert(node != NULL);
+    node->value     = t;
+    node->stealable = qt_threadqueue_isstealable(t);
+
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    if (at_head) {
+        node->prev = NULL;
+        node->next = q->head;
+        q->head    = node;
+        if (q->tail == NULL) {
+            q->tail = node;
+        } else {
+            node->next->prev = node;
+        }
+    } else {
+        node->next = NULL;
+        node->prev = q->tail;
+        q->tail    = node;
+        if (q->head == NULL) {
+            q->head = node;
+        } else {
+            node->prev->next = node;
+        }
+    }
+    q->qlength++;
+    q->qlength_stealable += node->stealable;
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+} /*}}}*/
+
+static QINLINE void shared_unlink(qt_threadqueue_t      *q,
+                                  qt_threadqueue_node_t *node)
+{   /*{{{*/
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        q->head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        q->tail = node->prev;
+    }
+    q->qlength--;
+    q->qlength_stealable -= node->stealable;
+} /*}}}*/
+
+/* dequeue at tail, for the workers of the owning shepherd */
+static QINLINE qthread_t *shared_dequeue(qt_threadqueue_t *q)
+{   /*{{{*/
+    qt_threadqueue_node_t *node;
+    qthread_t             *t = NULL;
+
+    if (q->head == NULL) { return NULL; }
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    node = q->tail;
+    if (node != NULL) {
+        shared_unlink(q, node);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    if (node) {
+        t = node->value;
+        FREE_TQNODE(node);
+    }
+    return t;
+} /*}}}*/
+
+/* dequeue the oldest stealable entry, for thieves */
+static QINLINE qthread_t *shared_dequeue_steal(qt_threadqueue_t *q)
+{   /*{{{*/
+    qt_threadqueue_node_t *node;
+    qthread_t             *t = NULL;
+
+    if (q->qlength_stealable == 0) { return NULL; }
+    if (!QTHREAD_TRYLOCK_TRY(&q->qlock)) { return NULL; }
+    for (node = q->head; node != NULL && !node->stealable; node = node->next) ;
+    if (node) {
+        shared_unlink(q, node);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    if (node) {
+        t = node->value;
+        FREE_TQNODE(node);
+    }
+    return t;
+} /*}}}*/
+
+/*****************************************/
+/* functions to manage the thread queues */
+/*****************************************/
+
+qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
+{   /*{{{*/
+    qt_threadqueue_t *q = ALLOC_THREADQUEUE();
+
+    if (q != NULL) {
+        q->deques = qt_internal_aligned_alloc(qlib->nworkerspershep * sizeof(qt_cl_deque_t),
+                                              CACHELINE_WIDTH);
+        for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+            cl_deque_init(&q->deques[i]);
+        }
+        q->head              = NULL;
+        q->tail              = NULL;
+        q->qlength           = 0;
+        q->qlength_stealable = 0;
+        q->mccoy             = NULL;
+#ifdef STEAL_PROFILE
+        q->steal_amount_stolen = 0;
+#endif
+        QTHREAD_TRYLOCK_INIT(q->qlock);
+        qt_parking_init(&q->lot);
+    }
+
+    return q;
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
+{   /*{{{*/
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        cl_deque_destroy(&q->deques[i]);
+    }
+    qt_internal_aligned_free(q->deques, CACHELINE_WIDTH);
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    while (q->head) {
+        qt_threadqueue_node_t *node = q->head;
+        shared_unlink(q, node);
+        FREE_QTHREAD(node->value);
+        FREE_TQNODE(node);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    QTHREAD_TRYLOCK_DESTROY(q->qlock);
+    qt_parking_destroy(&q->lot);
+    FREE_THREADQUEUE(q);
+} /*}}}*/
+
+ssize_t INTERNAL qt_threadqueue_advisory_queuelen(qt_threadqueue_t *q)
+{   /*{{{*/
+    ssize_t len = q->qlength;
+
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        saligned_t sz = CL_SIZE(q->deques[i].bottom, q->deques[i].top);
+        if (sz > 0) { len += sz; }
+    }
+    return len;
+} /*}}}*/
+
+/* Does q hold anything a worker of its shepherd could run, or (if
+ * stealable_only) anything a thief from another shepherd could take? Only
+ * stealable tasks are ever pushed onto the deques. */
+static int queue_has_work(qt_threadqueue_t *q,
+                          int               stealable_only)
+{   /*{{{*/
+    if (stealable_only ? (q->qlength_stealable > 0) : (q->head != NULL)) { return 1; }
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        if (CL_SIZE(q->deques[i].bottom, q->deques[i].top) > 0) { return 1; }
+    }
+    return 0;
+} /*}}}*/
+
+/* Is there anything the calling worker could run, here or (as a thief)
+ * elsewhere? */
+static int has_work(qt_threadqueue_t   *q,
+                    qthread_worker_id_t worker_id,
+                    uint_fast8_t        active)
+{   /*{{{*/
+    if (((worker_id == 0) && (q->mccoy != NULL)) || queue_has_work(q, 0)) {
+        return 1;
+    }
+    if (active && (qlib->nshepherds > 1) && !steal_disable) {
+        for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+            qt_threadqueue_t *v = qlib->shepherds[i].ready;
+
+            if ((v != q) && queue_has_work(v, 1)) { return 1; }
+        }
+    }
+    return 0;
+} /*}}}*/
+
+/* Returns the calling worker's own deque if it belongs to the shepherd that
+ * owns `q`, NULL otherwise. */
+static QINLINE qt_cl_deque_t *my_deque(qt_threadqueue_t *q)
+{   /*{{{*/
+    qthread_worker_t *w = qthread_internal_getworker();
+
+    if (w && (w->shepherd->ready == q)) {
+        return &q->deques[w->worker_id];
+    }
+    return NULL;
+} /*}}}*/
+
+/* enqueue at tail */
+void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
+                                     qthread_t *restrict        t)
+{   /*{{{*/
+    qt_cl_deque_t *d;
+
+    assert(q != NULL);
+    assert(t != NULL);
+
+    if (qt_threadqueue_isstealable(t) && ((d = my_deque(q)) != NULL)) {
+        cl_deque_push(d, t);
+    } else {
+        shared_enqueue(q, t, 0);
+    }
+    qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
+} /*}}}*/
+
+/* yielded threads enqueue at head */
+void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
+                                             qthread_t *restrict        t)
+{   /*{{{*/
+    assert(q != NULL);
+    assert(t != NULL);
+
+    shared_enqueue(q, t, 1);
+    qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
+/* Steal a single task, first from the other workers of my own shepherd, then
+ * from the other shepherds ring by ring (see qt_victims.h). */
+static qthread_t *qthread_steal(qthread_shepherd_t *thief_shepherd,
+                                qthread_worker_id_t thief_worker,
+                                uint_fast8_t        active)
+{   /*{{{*/
+    const qthread_worker_id_t nw        = qlib->nworkerspershep;
+    qthread_shepherd_t *const shepherds = qlib->shepherds;
+    qt_threadqueue_t         *myqueue   = thief_shepherd->ready;
+    qt_victim_iter_t          victims;
+    qthread_shepherd_id_t     v;
+    qthread_t                *t;
+    int                       elected = 0;
+
+    STEAL_CALLED(thief_shepherd);
+    qt_victim_iter_init(&victims, thief_shepherd, thief_worker, 1);
+    while ((v = qt_victim_next(&victims)) != NO_SHEPHERD) {
+        if (victims.level == QT_VICTIM_LOCAL) {
+            for (qthread_worker_id_t i = 1; i < nw; i++) {
+                qt_cl_deque_t *d = &myqueue->deques[(thief_worker + i) % nw];
+                if (CL_SIZE(d->bottom, d->top) > 0) {
+                    if ((t = cl_deque_steal(d)) != NULL) { return t; }
+                }
+            }
+            continue;
+        }
+        if (!active || steal_disable) {
+            return NULL;
+        }
+
+        qt_threadqueue_t *victim_queue = shepherds[v].ready;
+
+        if (!elected) {
+            STEAL_ELECTED(thief_shepherd);
+            elected = 1;
+        }
+        for (qthread_worker_id_t i = 0; i < nw; i++) {
+            qt_cl_deque_t *d = &victim_queue->deques[(thief_worker + i) % nw];
+            if (CL_SIZE(d->bottom, d->top) > 0) {
+                STEAL_ATTEMPTED(thief_shepherd);
+                if ((t = cl_deque_steal(d)) != NULL) {
+                    STEAL_SUCCESSFUL(thief_shepherd);
+                    STEAL_AMOUNT(victim_queue, 1);
+                    return t;
+                }
+                STEAL_FAILED(thief_shepherd);
+            }
+        }
+        if (victim_queue->qlength_stealable) {
+            STEAL_ATTEMPTED(thief_shepherd);
+            if ((t = shared_dequeue_steal(victim_queue)) != NULL) {
+                STEAL_SUCCESSFUL(thief_shepherd);
+                STEAL_AMOUNT(victim_queue, 1);
+                return t;
+            }
+            STEAL_FAILED(thief_shepherd);
+        }
+        if (myqueue->head != NULL) {  // work at home quit steal attempt
+            break;
+        }
+    }
+    return NULL;
+} /*}}}*/
+
+/* dequeue at tail */
+qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
+#ifdef QTHREAD_LOCAL_PRIORITY
+                                            qt_threadqueue_t         *lpq,
+#endif /* ifdef QTHREAD_LOCAL_PRIORITY */
+                                            qt_threadqueue_private_t *qc,
+                                            uint_fast8_t              active)
+{   /*{{{*/
+    qthread_worker_t   *my_worker   = qthread_internal_getworker();
+    qthread_shepherd_t *my_shepherd = my_worker->shepherd;
+    qt_cl_deque_t      *my_d;
+    qthread_t          *t;
+    unsigned long       spins = 0;
+
+    assert(q != NULL);
+    assert(my_shepherd);
+    assert(my_shepherd->ready == q);
+    my_d = &q->deques[my_worker->worker_id];
+
+#ifdef QTHREAD_USE_EUREKAS
+    qt_eureka_disable();
+#endif /* QTHREAD_USE_EUREKAS */
+    while (1) {
+        if ((my_worker->worker_id == 0) && (q->mccoy != NULL)) {
+            t        = q->mccoy;
+            q->mccoy = NULL;
+            return t;
+        }
+#ifdef QTHREAD_LOCAL_PRIORITY
+        /* First check local priority queue */
+        t = shared_dequeue(lpq);
+        if (t == NULL)
+#endif /* ifdef QTHREAD_LOCAL_PRIORITY */
+        t = cl_deque_pop(my_d);
+        if (t == NULL) {
+            t = shared_dequeue(q);
+        }
+        if (t == NULL) {
+            t = qthread_steal(my_shepherd, my_worker->worker_id, active);
+        }
+        if (t == NULL) {
+#ifdef QTHREAD_USE_EUREKAS
+            qt_eureka_check(1);
+#endif /* QTHREAD_USE_EUREKAS */
+#ifndef QTHREAD_LOCAL_PRIORITY /* local priority queues have no parking lot */
+            if (spins++ >= qt_park_spincount) {
+                uint32_t key = qt_park_prepare(&q->lot);
+                if (has_work(q, my_worker->worker_id, active)) {
+                    qt_park_cancel(&q->lot);
+                } else {
+                    qt_park_wait(&q->lot, key);
+                }
+                spins = 0;
+                continue;
+            }
+#endif
+            SPINLOCK_BODY();
+            continue;
+        }
+        if ((t->flags & QTHREAD_REAL_MCCOY) && (my_worker->worker_id != 0)) {
+            /* McCoy thread can only run on worker 0 */
+            assert(q->mccoy == NULL);
+            q->mccoy = t;
+            (void)qt_park_notify(&q->lot, 1);
+            continue;
+        }
+        return t;
+    }
+} /*}}}*/
+
+#ifdef STEAL_PROFILE                   // should give mechanism to make steal profiling optional
+void INTERNAL qthread_steal_stat(void)
+{   /*{{{*/
+    int i;
+
+    assert(qlib);
+    for (i = 0; i < qlib->nshepherds; i++) {
+        fprintf(stdout,
+                "QTHREADS: shepherd %d - steals called:%ld elected:%ld attempted:%ld(failed:%ld successful:%ld) tasks-stolen:%ld\n",
+                qlib->shepherds[i].shepherd_id,
+                qlib->shepherds[i].steal_called,
+                qlib->shepherds[i].steal_elected,
+                qlib->shepherds[i].steal_attempted,
+                qlib->shepherds[i].steal_failed,
+                qlib->shepherds[i].steal_attempted - qlib->shepherds[i].steal_failed,
+                qlib->shepherds[i].ready->steal_amount_stolen);
+    }
+} /*}}}*/
+#endif  /* ifdef STEAL_PROFILE */
+
+/* walk queue removing all tasks matching this description
+ *
+ * The deques are only safe to walk while nobody pushes, pops or steals; this
+ * is called from the eureka barrier, where every worker is stopped. */
+void INTERNAL qt_threadqueue_filter(qt_threadqueue_t       *q,
+                                    qt_threadqueue_filter_f f)
+{   /*{{{*/
+    assert(q != NULL);
+
+    for (qthread_worker_id_t i = 0; i < qlib->nworkerspershep; i++) {
+        qt_cl_deque_t *d    = &q->deques[i];
+        qt_cl_array_t *a    = d->array;
+        aligned_t      keep = d->bottom;
+        int            stop = 0;
+
+        /* filter from the bottom (newest) like the other schedulers */
+        for (aligned_t j = d->bottom; !stop && j != d->top; j--) {
+            qthread_t *t = a->buf[(j - 1) & a->mask];
+            switch (f(t)) {
+                case IGNORE_AND_STOP:
+                    stop = 1;
+                    /* fallthrough */
+                case IGNORE_AND_CONTINUE:
+                    a->buf[(--keep) & a->mask] = t;
+                    break;
+                case REMOVE_AND_STOP:
+                    stop = 1;
+                    /* fallthrough */
+                case REMOVE_AND_CONTINUE:
+#ifdef QTHREAD_USE_EUREKAS
+                    qthread_internal_assassinate(t);
+#endif /* QTHREAD_USE_EUREKAS */
+                    break;
+            }
+            if (stop) {
+                /* slide the untouched remainder up against the kept entries */
+                for (j--; j != d->top; j--) {
+                    a->buf[(--keep) & a->mask] = a->buf[(j - 1) & a->mask];
+                }
+                break;
+            }
+        }
+        d->top = keep;
+    }
+
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    qt_threadqueue_node_t *node = q->tail;
+    while (node) {
+        qt_threadqueue_node_t *prev = node->prev;
+        qthread_t             *t    = node->value;
+        filter_code            rc   = f(t);
+        switch (rc) {
+            case IGNORE_AND_CONTINUE:
+                node = prev;
+                break;
+            case IGNORE_AND_STOP:
+                node = NULL;
+                break;
+            case REMOVE_AND_CONTINUE:
+            case REMOVE_AND_STOP:
+                shared_unlink(q, node);
+#ifdef QTHREAD_USE_EUREKAS
+                qthread_internal_assassinate(t);
+#endif /* QTHREAD_USE_EUREKAS */
+                FREE_TQNODE(node);
+                node = (rc == REMOVE_AND_STOP) ? NULL : prev;
+                break;
+        }
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+} /*}}}*/
+
+/* Pop up to max tasks that may run in one aggregate with t off the bottom of
+ * the calling worker's own deque; the shared list is left alone. */
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{   /*{{{*/
+    qt_cl_deque_t *d = my_deque(q);
+    int            n = 0;
+
+    if (d == NULL) { return 0; }
+    max = qt_agg_limit(max, CL_SIZE(d->bottom, d->top));
+    while (n < max) {
+        qthread_t *u = cl_deque_pop(d);
+
+        if (u == NULL) { break; }
+        if (!qt_agg_compatible(t, u)) {
+            cl_deque_push(d, u);
+            break;
+        }
+        batch[n++] = u;
+    }
+    return n;
+} /*}}}*/
+
+/* Look for the task that will fill value among the last few pushed on the
+ * calling worker's own deque, where its parent pushed it. The tasks popped
+ * on the way are pushed back in their original order. */
+qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *q,
+                                                    void             *value)
+{   /*{{{*/
+    qt_cl_deque_t *d = my_deque(q);
+    qthread_t     *popped[QT_TOUCH_WINDOW];
+    qthread_t     *t = NULL;
+    int            n = 0;
+
+    if (d == NULL) { return NULL; }
+    while (n < QT_TOUCH_WINDOW) {
+        qthread_t *u = cl_deque_pop(d);
+
+        if (u == NULL) { break; }
+        if (qt_touch_runnable(u, value)) {
+            t = u;
+            break;
+        }
+        popped[n++] = u;
+    }
+    while (n > 0) {
+        cl_deque_push(d, popped[--n]);
+    }
+    return t;
+} /*}}}*/
+
+/* Unsupported operations */
+qthread_t INTERNAL *qt_threadqueue_private_dequeue(qt_threadqueue_private_t *c)
+{
+    return NULL;
+}
+
+void INTERNAL qt_threadqueue_enqueue_cache(qt_threadqueue_t         *q,
+                                           qt_threadqueue_private_t *cache)
+{}
+
+void INTERNAL qt_threadqueue_private_filter(qt_threadqueue_private_t *restrict c,
+                                            qt_threadqueue_filter_f            f)
+{}
+
+int INTERNAL qt_threadqueue_private_enqueue(qt_threadqueue_private_t *restrict pq,
+                                            qt_threadqueue_t *restrict         q,
+                                            qthread_t *restrict                t)
+{ return 0; }
+
+int INTERNAL qt_threadqueue_private_enqueue_yielded(qt_threadqueue_private_t *restrict q,
+                                                    qthread_t *restrict                t)
+{ return 0; }
+
+void INTERNAL qthread_steal_enable()
+{       /*{{{*/
+    steal_disable = 0;
+}     /*}}}*/
+
+void INTERNAL qthread_steal_disable()
+{       /*{{{*/
+    steal_disable = 1;
+}     /*}}}*/
+
+qthread_shepherd_id_t INTERNAL qt_threadqueue_choose_dest(qthread_shepherd_t * curr_shep)
+{
+    if (curr_shep) {
+        return curr_shep->shepherd_id;
+    } else {
+        return (qthread_shepherd_id_t)0;
+    }
+}
+
+size_t INTERNAL qt_threadqueue_policy(const enum threadqueue_policy policy)
+{
+    switch (policy) {
+        default:
+            return THREADQUEUE_POLICY_UNSUPPORTED;
+    }
+}
+
+/* vim:set expandtab: */
@@ -5,6 +5,7 @@
 /* System Headers */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
 /* Public Headers */
@@ -15,6 +16,7 @@
 #include "qt_visibility.h"
 #include "qthread_innards.h"           /* for qlib */
 #include "qt_shepherd_innards.h"
+#include "qt_victims.h"
 #include "qt_qthread_struct.h"
 #include "qt_qthread_mgmt.h"
 #include "qt_asserts.h"
@@ -27,6 +29,9 @@
 #endif /* QTHREAD_USE_EUREKAS */
 #include "qt_expect.h"
 #include "qt_subsystems.h"
+#include "qt_parking.h"
+#include "qt_aggregation.h"
+#include "qt_touch.h"
 
 // Non portable
 typedef uint8_t cacheline[CACHELINE_WIDTH];
@@ -36,6 +41,15 @@ int max_backoff;
 int spinloop_backoff;
 int condwait_backoff;
 int steal_ratio;
+long steal_chunksize;
+
+/* Victim selection policy */
+enum steal_victim_policy {
+  STEAL_VICTIM_INDEX,    /* scan shepherds in index order (legacy) */
+  STEAL_VICTIM_RANDOM,   /* start at a random shepherd */
+  STEAL_VICTIM_DISTANCE  /* hierarchical rings, nearest first (qt_victims.h) */
+};
+static enum steal_victim_policy steal_victim = STEAL_VICTIM_RANDOM;
 
 /* Data Structures */
 struct _qt_threadqueue_node {
@@ -48,12 +62,16 @@ typedef struct {
   qt_threadqueue_node_t *head;
   qt_threadqueue_node_t *tail;
   long                 qlength;
+#ifdef STEAL_PROFILE
+  aligned_t            steal_amount_stolen;
+#endif
   QTHREAD_TRYLOCK_TYPE qlock;
   cacheline buf; // ensure internal nodes are a cacheline apart
 } qt_threadqueue_internal;
 
 typedef struct {
   size_t n;
+  uint32_t rng; // per-worker xorshift state for random victim selection
   cacheline buf; //ensure
 } w_ind;
 
@@ -61,10 +79,23 @@ struct _qt_threadqueue {
   qt_threadqueue_internal *t;
   size_t num_queues;
   w_ind* w_inds;
-  QTHREAD_COND_DECL(cond);
-  long                 numwaiters;
+  qt_parking_lot_t lot;
 }; 
 
+#ifdef STEAL_PROFILE
+# define STEAL_CALLED(shep)     qthread_incr( & ((shep)->steal_called), 1)
+# define STEAL_ELECTED(shep)    qthread_incr( & ((shep)->steal_elected), 1)
+# define STEAL_ATTEMPTED(shep)  qthread_incr( & ((shep)->steal_attempted), 1)
+# define STEAL_FAILED(shep)     qthread_incr( & ((shep)->steal_failed), 1)
+# define STEAL_AMOUNT(q, ct)    qthread_incr( & ((q)->steal_amount_stolen), ct)
+#else
+# define STEAL_CALLED(shep)     do {} while(0)
+# define STEAL_ELECTED(shep)    do {} while(0)
+# define STEAL_ATTEMPTED(shep)  do {} while(0)
+# define STEAL_FAILED(shep)     do {} while(0)
+# define STEAL_AMOUNT(q, ct)    do {} while(0)
+#endif /* ifdef STEAL_PROFILE */
+
 // global cond pool
 int finalizing;
 
@@ -73,7 +104,8 @@ qthread_t *mccoy = NULL;
 /* Memory Management and Initialization/Shutdown */
 qt_threadqueue_pools_t generic_threadqueue_pools;
 
-#define mycounter(q) (q->w_inds[qthread_worker(NULL) % (qlib->nshepherds * qlib->nworkerspershep)].n)
+#define myind(q) (q->w_inds[qthread_worker(NULL) % (qlib->nshepherds * qlib->nworkerspershep)])
+#define mycounter(q) (myind(q).n)
 #define myqueue(q) (q->t + mycounter(q))
 
 static qt_threadqueue_t* alloc_threadqueue(){
@@ -99,15 +131,6 @@ static QINLINE void free_tqnode(qt_threadqueue_node_t* t){
   qt_mpool_free(generic_threadqueue_pools.nodes, t);
 } 
 
-extern qt_mpool generic_qthread_pool;
-
-static QINLINE qthread_t* alloc_qthread() {
-  return (qthread_t*) qt_mpool_alloc(generic_qthread_pool);
-}
-static QINLINE void free_qthread(qthread_t* t){
-  return qt_mpool_free(generic_qthread_pool, t);
-}
-
 qt_threadqueue_t INTERNAL *qt_threadqueue_new(void){   
   qt_threadqueue_t *qe = alloc_threadqueue();
   for(int i=0; i<qe->num_queues; i++){
@@ -116,13 +139,17 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void){
       q->head              = NULL;
       q->tail              = NULL;
       q->qlength           = 0;
+#ifdef STEAL_PROFILE
+      q->steal_amount_stolen = 0;
+#endif
       QTHREAD_TRYLOCK_INIT(q->qlock);
     }
   }
   for(size_t i=0; i<qlib->nshepherds * qlib->nworkerspershep; i++){
     qe->w_inds[i].n = i % qe->num_queues;
+    qe->w_inds[i].rng = 2463534242u + (uint32_t)i * 2654435761u;
   }
-  QTHREAD_COND_INIT(qe->cond);
+  qt_parking_init(&qe->lot);
   return qe;
 } 
 
@@ -143,7 +170,7 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *qe){
           }
           t = node->value;
           free_tqnode(node);
-          free_qthread(t);
+          qthread_thread_free(t);
         }
       }
       assert(q->head == NULL);
@@ -154,7 +181,7 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *qe){
     assert(q->head == q->tail);
     QTHREAD_TRYLOCK_DESTROY(q->qlock);
   }
-  QTHREAD_COND_DESTROY(qe->cond);
+  qt_parking_destroy(&qe->lot);
   free_threadqueue(qe);
 } 
 
@@ -166,6 +193,17 @@ static void qt_threadqueue_subsystem_shutdown(){
 void INTERNAL qt_threadqueue_subsystem_init(){   
   steal_ratio = qt_internal_get_env_num("STEAL_RATIO", 8, 0);
   condwait_backoff = qt_internal_get_env_num("CONDWAIT_BACKOFF", 2048, 0);
+  steal_chunksize = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
+  {
+    const char *victim = qt_internal_get_env_str("STEAL_VICTIM", "random");
+    if (victim && !strcmp(victim, "index")) {
+      steal_victim = STEAL_VICTIM_INDEX;
+    } else if (victim && !strcmp(victim, "distance")) {
+      steal_victim = STEAL_VICTIM_DISTANCE;
+    } else {
+      steal_victim = STEAL_VICTIM_RANDOM;
+    }
+  }
   finalizing = 0;
   generic_threadqueue_pools.queues = qt_mpool_create_aligned(sizeof(qt_threadqueue_t),
                                                              qthread_cacheline());
@@ -210,15 +248,13 @@ void INTERNAL qt_threadqueue_enqueue_tail(qt_threadqueue_t *restrict qe,
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
   }
   // we need to wake up all threads when finalizing and if pushing the mccoy
-  // thread to make sure we get worker 0
-  if(finalizing || t->flags & QTHREAD_REAL_MCCOY){
-    QTHREAD_COND_LOCK(qe->cond);
-    QTHREAD_COND_BCAST(qe->cond);
-    QTHREAD_COND_UNLOCK(qe->cond);
-  } else if(qe->numwaiters){
-    QTHREAD_COND_LOCK(qe->cond);
-    if(qe->numwaiters) QTHREAD_COND_SIGNAL(qe->cond);
-    QTHREAD_COND_UNLOCK(qe->cond);
+  // thread to make sure we get worker 0 (which lives on shepherd 0)
+  if(t->flags & QTHREAD_REAL_MCCOY){
+    qt_park_notify(&qlib->shepherds[0].ready->lot, 1);
+  } else if(finalizing){
+    qt_park_notify(&qe->lot, 1);
+  } else {
+    qt_park_notify_stealable(&qe->lot, offsetof(qt_threadqueue_t, lot));
   }
 } 
 
@@ -230,6 +266,7 @@ void INTERNAL qt_threadqueue_enqueue_head(qt_threadqueue_t *restrict qe,
       exit(-1);
     }
     mccoy = t;
+    qt_park_notify(&qlib->shepherds[0].ready->lot, 1);
     return;
   }
 
@@ -249,13 +286,7 @@ void INTERNAL qt_threadqueue_enqueue_head(qt_threadqueue_t *restrict qe,
   }
   q->qlength++;
   QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
-  if(qe->numwaiters){
-    QTHREAD_COND_LOCK(qe->cond);
-    if(qe->numwaiters) {
-      QTHREAD_COND_SIGNAL(qe->cond);
-    }
-    QTHREAD_COND_UNLOCK(qe->cond);
-  }
+  qt_park_notify_stealable(&qe->lot, offsetof(qt_threadqueue_t, lot));
 } 
 
 qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_tail(qt_threadqueue_t *qe){                                     
@@ -302,7 +333,190 @@ qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_head(qt_threadqueue_t *qe
   QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
 
   return node;
-}                                   
+}
+
+/* Take up to max tasks that may run in one aggregate with t off the tails of
+ * the internal queues; a queue that is busy is passed over. */
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *qe,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max){
+  int n = 0;
+
+  for (size_t i = 0; i < qe->num_queues && n < max; i++) {
+    qt_threadqueue_internal *q = qe->t + i;
+    int lim;
+
+    if (q->qlength < QT_AGG_SHARE) continue;
+    if (!QTHREAD_TRYLOCK_TRY(&q->qlock)) continue;
+    lim = n + qt_agg_limit(max - n, q->qlength);
+    while (n < lim && q->tail != NULL && qt_agg_compatible(t, q->tail->value)) {
+      qt_threadqueue_node_t *node = q->tail;
+
+      q->tail = node->prev;
+      if(q->tail) q->tail->next = NULL;
+      if(q->head == node) q->head = NULL;
+      q->qlength--;
+      batch[n++] = node->value;
+      free_tqnode(node);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+  }
+  return n;
+}
+
+/* Look for the task that will fill value among the last few queued on each
+ * of the internal queues, which its parent spread its spawns over, and
+ * unlink it if it has not started. */
+qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *qe,
+                                                    void             *value){
+  for (size_t i = 0; i < qe->num_queues; i++) {
+    qt_threadqueue_internal *q = qe->t + i;
+    qt_threadqueue_node_t *node;
+    int n = 0;
+
+    if (q->qlength == 0) continue;
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    for (node = q->tail; node != NULL && n < QT_TOUCH_WINDOW; node = node->prev, n++) {
+      if (qt_touch_runnable(node->value, value)) break;
+    }
+    if (node != NULL && n < QT_TOUCH_WINDOW) {
+      qthread_t *t = node->value;
+
+      if(node->prev) node->prev->next = node->next; else q->head = node->next;
+      if(node->next) node->next->prev = node->prev; else q->tail = node->prev;
+      q->qlength--;
+      QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+      free_tqnode(node);
+      return t;
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+  }
+  return NULL;
+}
+
+/* Steal from the head of one of the victim's internal queues: half of what
+ * is there, or at most QT_STEAL_CHUNK tasks if that is set. Tasks that may
+ * not leave the victim (unstealable or node-bound) are passed over and stay
+ * where they are. The oldest stolen node is returned; the rest are chained
+ * off its next pointer. */
+static qt_threadqueue_node_t *qt_threadqueue_dequeue_steal(qthread_shepherd_t *thief,
+                                                           qt_threadqueue_t   *qe,
+                                                           long               *amount){
+  qt_threadqueue_internal* q = myqueue(qe);
+  mycounter(qe) = (mycounter(qe) + 1) % qe->num_queues;
+  qt_threadqueue_node_t *first = NULL, *last = NULL, *node, *next;
+  long desired_stolen, stolen = 0;
+
+  if (q->qlength == 0) return NULL;
+  STEAL_ATTEMPTED(thief);
+  if (!QTHREAD_TRYLOCK_TRY(&q->qlock)) {
+    STEAL_FAILED(thief);
+    return NULL;
+  }
+  desired_stolen = steal_chunksize ? steal_chunksize : (q->qlength + 1) / 2;
+
+  for (node = q->head; node != NULL && stolen < desired_stolen; node = next) {
+    next = node->next;
+    if (node->value->flags & (QTHREAD_UNSTEALABLE | QTHREAD_NODE_BOUND)) continue;
+    if(node->prev) node->prev->next = next; else q->head = next;
+    if(next) next->prev = node->prev; else q->tail = node->prev;
+    node->prev = last;
+    node->next = NULL;
+    if (last) last->next = node; else first = node;
+    last = node;
+    stolen++;
+  }
+  q->qlength -= stolen;
+  QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+  if (stolen == 0) {
+    STEAL_FAILED(thief);
+    return NULL;
+  }
+  STEAL_AMOUNT(q, stolen);
+
+  *amount = stolen;
+  return first;
+}
+
+/* enqueue a chain of count nodes (from steal) at the tail */
+static void qt_threadqueue_enqueue_multiple(qt_threadqueue_t      *qe,
+                                            qt_threadqueue_node_t *first,
+                                            long                   count){
+  qt_threadqueue_internal* q = myqueue(qe);
+  mycounter(qe) = (mycounter(qe) + 1) % qe->num_queues;
+  qt_threadqueue_node_t *last = first;
+
+  while (last->next) last = last->next;
+
+  QTHREAD_TRYLOCK_LOCK(&q->qlock);
+  first->prev = q->tail;
+  q->tail     = last;
+  if (q->head == NULL) {
+    q->head = first;
+  } else {
+    first->prev->next = first;
+  }
+  q->qlength += count;
+  QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+  qt_park_notify(&qe->lot, 1);
+}
+
+static QINLINE uint32_t xorshift32(uint32_t *state){
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/* Take a chunk from shepherd v's queue. One stolen task is returned; the
+ * surplus goes onto our own queue. */
+static qt_threadqueue_node_t *steal_from(qthread_shepherd_t   *thief,
+                                         qt_threadqueue_t     *myq,
+                                         qthread_shepherd_id_t v){
+  qt_threadqueue_node_t *node;
+  long amount;
+
+  node = qt_threadqueue_dequeue_steal(thief, qlib->shepherds[v].ready, &amount);
+  if (node && node->next) {
+    qt_threadqueue_node_t *surplus = node->next;
+    node->next    = NULL;
+    surplus->prev = NULL;
+    qt_threadqueue_enqueue_multiple(myq, surplus, amount - 1);
+  }
+  return node;
+}
+
+/* Visit every shepherd (including our own) in the order given by
+ * QT_STEAL_VICTIM and steal from the first one that has work. */
+static qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief,
+                                            qt_threadqueue_t   *myq){
+  const qthread_shepherd_id_t nsheps = qlib->nshepherds;
+  qthread_shepherd_id_t start = 0;
+  qt_threadqueue_node_t *node;
+
+  STEAL_CALLED(thief);
+  STEAL_ELECTED(thief); // there is no per-shepherd steal election here
+  if (steal_victim == STEAL_VICTIM_DISTANCE) {
+    qt_victim_iter_t      victims;
+    qthread_shepherd_id_t v;
+
+    qt_victim_iter_init(&victims, thief, qthread_worker(NULL), 1);
+    while ((v = qt_victim_next(&victims)) != NO_SHEPHERD) {
+      if ((node = steal_from(thief, myq, v)) != NULL) { return node; }
+    }
+    return NULL;
+  }
+  if (steal_victim == STEAL_VICTIM_RANDOM) {
+    start = xorshift32(&myind(myq).rng) % nsheps;
+  }
+  for (qthread_shepherd_id_t i = 0; i < nsheps; i++) {
+    if ((node = steal_from(thief, myq, (start + i) % nsheps)) != NULL) { return node; }
+  }
+  return NULL;
+}
 
 void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
                                      qthread_t *restrict        t){
@@ -314,12 +528,28 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
   return qt_threadqueue_enqueue_head(q, t);
 }
 
-/* Unsupported operations */
-qthread_t INTERNAL * qt_threadqueue_dequeue_specific(qt_threadqueue_t * q,
-                                                     void             * value){
-    return NULL;
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n){
+  qt_threadqueue_node_t *first = NULL, *last = NULL;
+
+  if (n == 0) { return; }
+  for (size_t i = 0; i < n; i++) {
+    qt_threadqueue_node_t *node = alloc_tqnode();
+    node->value = t[i];
+    node->next  = NULL;
+    node->prev  = last;
+    if (last == NULL) {
+      first = node;
+    } else {
+      last->next = node;
+    }
+    last = node;
+  }
+  qt_threadqueue_enqueue_multiple(q, first, n);
 }
 
+/* Unsupported operations */
 qthread_t INTERNAL *qt_threadqueue_private_dequeue(qt_threadqueue_private_t *c){
     return NULL;
 } 
@@ -343,6 +573,19 @@ int INTERNAL qt_threadqueue_private_enqueue_yielded(qt_threadqueue_private_t *re
                                                     qthread_t *restrict                t)
 { return 0; } 
 
+// Is there anything the calling worker could run, here or (as a thief) elsewhere?
+static int has_work(qt_threadqueue_t *qe){
+  if (qthread_worker(NULL) == 0 && mccoy) return 1;
+  for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+    qt_threadqueue_t *v = qlib->shepherds[s].ready;
+    if (v != qe && steal_ratio == 0) continue;
+    for (size_t i = 0; i < v->num_queues; i++) {
+      if (v->t[i].qlength > 0) return 1;
+    }
+  }
+  return 0;
+}
+
 // We try and dequeue locally, if that fails we should do some stealing
 qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *qe,
                                             qt_threadqueue_private_t *qc,
@@ -357,14 +600,11 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *qe,
 
     // If we've done QT_STEAL_RATIO waits on local queue, try to steal 
     if(!node && steal_ratio > 0 && numwaits % steal_ratio == 0) {
-      for(int i=0; i < qlib->nshepherds; i++){
-        qt_threadqueue_t *victim_queue = qlib->shepherds[i].ready;
-        node = qt_threadqueue_dequeue_head(victim_queue);
-        if (node){
-          t = node->value;
-          free_tqnode(node);
-          return t;
-        }
+      node = qthread_steal(my_shepherd, qe);
+      if (node){
+        t = node->value;
+        free_tqnode(node);
+        return t;
       }
     }
 
@@ -374,12 +614,12 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *qe,
       return t; 
     } else if(!node){
       if(numwaits > condwait_backoff && !finalizing){
-        QTHREAD_COND_LOCK(qe->cond);
-        qe->numwaiters++;
-        MACHINE_FENCE;
-        if(!finalizing) QTHREAD_COND_WAIT(qe->cond);
-        qe->numwaiters--;
-        QTHREAD_COND_UNLOCK(qe->cond);
+        uint32_t key = qt_park_prepare(&qe->lot);
+        if(finalizing || has_work(qe)) {
+          qt_park_cancel(&qe->lot);
+        } else {
+          qt_park_wait(&qe->lot, key);
+        }
         numwaits = 0;
       } else {
         SPINLOCK_BODY();
@@ -391,6 +631,28 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *qe,
   return t;
 } 
 
+#ifdef STEAL_PROFILE
+void INTERNAL qthread_steal_stat(void){
+  assert(qlib);
+  for (int i = 0; i < qlib->nshepherds; i++) {
+    qt_threadqueue_t *qe = qlib->shepherds[i].ready;
+    aligned_t stolen = 0;
+    for (size_t j = 0; j < qe->num_queues; j++) {
+      stolen += qe->t[j].steal_amount_stolen;
+    }
+    fprintf(stdout,
+            "QTHREADS: shepherd %d - steals called:%ld elected:%ld attempted:%ld(failed:%ld successful:%ld) tasks-stolen:%ld\n",
+            qlib->shepherds[i].shepherd_id,
+            qlib->shepherds[i].steal_called,
+            qlib->shepherds[i].steal_elected,
+            qlib->shepherds[i].steal_attempted,
+            qlib->shepherds[i].steal_failed,
+            qlib->shepherds[i].steal_attempted - qlib->shepherds[i].steal_failed,
+            stolen);
+  }
+}
+#endif  /* ifdef STEAL_PROFILE */
+
 void INTERNAL qthread_steal_enable(){     
 }   
 
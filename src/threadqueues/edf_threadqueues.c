@@ -0,0 +1,837 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h> /* for HUGE_VAL */
+
+/* Public Headers */
+#include "qthread/qthread.h"
+#include "qthread/qtimer.h"
+#include "qthread/cacheline.h"
+
+/* Internal Headers */
+#include "qt_alloc.h"
+#include "qt_visibility.h"
+#include "qthread_innards.h"           /* for qlib */
+#include "qt_shepherd_innards.h"
+#include "qt_qthread_struct.h"
+#include "qt_qthread_mgmt.h"
+#include "qt_asserts.h"
+#include "qt_threadqueues.h"
+#include "qt_envariables.h"
+#include "qt_debug.h"
+#ifdef QTHREAD_USE_EUREKAS
+#include "qt_eurekas.h" /* for qt_eureka_check() */
+#endif /* QTHREAD_USE_EUREKAS */
+#include "qt_expect.h"
+#include "qt_subsystems.h"
+#include "qt_parking.h"
+#include "qt_aggregation.h"
+#include "qt_touch.h"
+
+/* The EDF scheduler dispatches earliest-deadline-first. Every shepherd keeps
+ * the ready tasks that have a deadline (see qthread_spawn_deadline()) in a
+ * pairing heap (Fredman et al., Algorithmica 1986) shared by the workers of
+ * that shepherd; unstealable ones go in a second heap that thieves never
+ * look at. A yielding task is keyed no earlier than QT_EDF_SLACK
+ * microseconds from now, or it would just be picked again.
+ *
+ * Tasks without a deadline (including the main thread) keep the sherwood
+ * order in a per-shepherd deque: LIFO for the workers of the shepherd, which
+ * keeps divide-and-conquer programs from expanding breadth-first, and FIFO
+ * for thieves. The deque as a whole is treated as one more task that is due
+ * QT_EDF_SLACK microseconds after it was last served (or became nonempty),
+ * so that it is not starved by a stream of deadlines.
+ *
+ * An idle shepherd steals the most urgent stealable deadline task of any
+ * other shepherd, preferring nearer shepherds on ties, and failing that the
+ * oldest task from the nearest deque with any. */
+
+/* Data Structures */
+struct _qt_threadqueue_node {
+    struct _qt_threadqueue_node *next;  /* heap: next sibling; deque: next */
+    struct _qt_threadqueue_node *prev;  /* deque only */
+    struct _qt_threadqueue_node *child; /* heap only: leftmost child */
+    double                       key;   /* heap only: dispatch deadline, in qtimer_wtime() seconds */
+    uintptr_t                    stealable;
+    qthread_t                   *value;
+} /* qt_threadqueue_node_t */;
+
+struct _qt_threadqueue {
+    qt_threadqueue_node_t *heap;      /* stealable deadline tasks */
+    qt_threadqueue_node_t *pinned;    /* unstealable deadline tasks */
+    qt_threadqueue_node_t *head;      /* tasks without a deadline */
+    qt_threadqueue_node_t *tail;
+    double                 deque_key; /* when the deque is next due; 0 is "now" */
+    long                   qlength;
+    long                   qlength_stealable;
+    long                   deque_stealable;
+    volatile double        steal_key; /* key of heap's root, or EDF_NEVER; read by thieves without the lock */
+    qthread_t *volatile    mccoy;     /* parked here until worker 0 picks it up */
+#ifdef STEAL_PROFILE
+    aligned_t steal_amount_stolen;
+#endif
+
+    QTHREAD_TRYLOCK_TYPE qlock;
+    qt_parking_lot_t     lot;
+} /* qt_threadqueue_t */;
+
+#define EDF_NEVER HUGE_VAL
+
+static aligned_t steal_disable = 0;
+static double    edf_slack     = 1e-3;
+
+#ifdef STEAL_PROFILE
+# define STEAL_CALLED(shep)     qthread_incr( & ((shep)->steal_called), 1)
+# define STEAL_ELECTED(shep)    qthread_incr( & ((shep)->steal_elected), 1)
+# define STEAL_ATTEMPTED(shep)  qthread_incr( & ((shep)->steal_attempted), 1)
+# define STEAL_SUCCESSFUL(shep) do {} while (0)
+# define STEAL_FAILED(shep)     qthread_incr( & ((shep)->steal_failed), 1)
+# define STEAL_AMOUNT(q, ct)    qthread_incr( & ((q)->steal_amount_stolen), ct)
+#else
+# define STEAL_CALLED(shep)     do {} while(0)
+# define STEAL_ELECTED(shep)    do {} while(0)
+# define STEAL_ATTEMPTED(shep)  do {} while(0)
+# define STEAL_SUCCESSFUL(shep) do {} while(0)
+# define STEAL_FAILED(shep)     do {} while(0)
+# define STEAL_AMOUNT(q, ct)    do {} while(0)
+#endif /* ifdef STEAL_PROFILE */
+
+/* Memory Management */
+#if defined(UNPOOLED_QUEUES) || defined(UNPOOLED)
+# define ALLOC_THREADQUEUE() (qt_threadqueue_t *)MALLOC(sizeof(qt_threadqueue_t))
+# define FREE_THREADQUEUE(t) FREE(t, sizeof(qt_threadqueue_t))
+# define ALLOC_TQNODE()      (qt_threadqueue_node_t *)MALLOC(sizeof(qt_threadqueue_node_t))
+# define FREE_TQNODE(t)      FREE(t, sizeof(qt_threadqueue_node_t))
+
+static void qt_threadqueue_subsystem_shutdown(void)
+{}
+
+void INTERNAL qt_threadqueue_subsystem_init(void)
+{
+    edf_slack = qt_internal_get_env_num("EDF_SLACK", 1000, 0) * 1e-6;
+    qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
+}
+
+#else /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
+qt_threadqueue_pools_t generic_threadqueue_pools;
+# define ALLOC_THREADQUEUE() (qt_threadqueue_t *)qt_mpool_alloc(generic_threadqueue_pools.queues)
+# define FREE_THREADQUEUE(t) qt_mpool_free(generic_threadqueue_pools.queues, t)
+# define ALLOC_TQNODE()      (qt_threadqueue_node_t *)qt_mpool_alloc(generic_threadqueue_pools.nodes)
+# define FREE_TQNODE(t)      qt_mpool_free(generic_threadqueue_pools.nodes, t)
+
+static void qt_threadqueue_subsystem_shutdown(void)
+{   /*{{{*/
+    qt_mpool_destroy(generic_threadqueue_pools.nodes);
+    qt_mpool_destroy(generic_threadqueue_pools.queues);
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_subsystem_init(void)
+{   /*{{{*/
+    generic_threadqueue_pools.queues = qt_mpool_create_aligned(sizeof(qt_threadqueue_t),
+                                                               qthread_cacheline());
+    generic_threadqueue_pools.nodes = qt_mpool_create(sizeof(qt_threadqueue_node_t));
+    edf_slack = qt_internal_get_env_num("EDF_SLACK", 1000, 0) * 1e-6;
+    qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
+} /*}}}*/
+#endif /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
+
+/* tasks left in a queue come in any qthread_t size class */
+#define FREE_QTHREAD(t) qthread_thread_free(t)
+
+static QINLINE int qt_threadqueue_isstealable(qthread_t *t)
+{   /*{{{*/
+    return ((t->flags & (QTHREAD_UNSTEALABLE | QTHREAD_NODE_BOUND)) == 0) ? 1 : 0;
+} /*}}}*/
+
+/* When the deadline task t should be dispatched by */
+static QINLINE double edf_key(const qthread_t *t,
+                              int              yielded)
+{   /*{{{*/
+    double key = t->deadline;
+
+    if (yielded) {
+        double ready_key = qtimer_wtime() + edf_slack;
+        if (key < ready_key) {
+            key = ready_key;
+        }
+    }
+    return key;
+} /*}}}*/
+
+/* When the deque, about to be served or to become nonempty, is next due.
+ * With no deadline tasks waiting there is nothing to measure against, so
+ * the deque just stays due. Caller holds q->qlock. */
+static QINLINE double edf_deque_key(const qt_threadqueue_t *q)
+{   /*{{{*/
+    return (q->heap || q->pinned) ? (qtimer_wtime() + edf_slack) : 0.0;
+} /*}}}*/
+
+/*****************************************/
+/* Deque of tasks without a deadline     */
+/*****************************************/
+
+/* Caller holds q->qlock */
+static QINLINE void edf_deque_push(qt_threadqueue_t      *q,
+                                   qt_threadqueue_node_t *node,
+                                   int                    at_head)
+{   /*{{{*/
+    if (q->head == NULL) {
+        q->deque_key = edf_deque_key(q);
+    }
+    if (at_head) {
+        node->prev = NULL;
+        node->next = q->head;
+        q->head    = node;
+        if (q->tail == NULL) {
+            q->tail = node;
+        } else {
+            node->next->prev = node;
+        }
+    } else {
+        node->next = NULL;
+        node->prev = q->tail;
+        q->tail    = node;
+        if (q->head == NULL) {
+            q->head = node;
+        } else {
+            node->prev->next = node;
+        }
+    }
+    q->qlength++;
+    q->qlength_stealable += node->stealable;
+    q->deque_stealable   += node->stealable;
+} /*}}}*/
+
+/* Caller holds q->qlock */
+static QINLINE void edf_deque_unlink(qt_threadqueue_t      *q,
+                                     qt_threadqueue_node_t *node)
+{   /*{{{*/
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        q->head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        q->tail = node->prev;
+    }
+    node->next = node->prev = NULL;
+    q->qlength--;
+    q->qlength_stealable -= node->stealable;
+    q->deque_stealable   -= node->stealable;
+} /*}}}*/
+
+/*****************************************/
+/* Pairing heap                          */
+/*****************************************/
+
+/* a and b are roots of (sub)heaps with no siblings */
+static QINLINE qt_threadqueue_node_t *edf_meld(qt_threadqueue_node_t *a,
+                                               qt_threadqueue_node_t *b)
+{   /*{{{*/
+    if (a == NULL) { return b; }
+    if (b == NULL) { return a; }
+    if (b->key < a->key) {
+        qt_threadqueue_node_t *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    b->next  = a->child;
+    a->child = b;
+    return a;
+} /*}}}*/
+
+/* The standard two-pass merge of a sibling list: meld pairs left to right,
+ * then meld the results right to left. */
+static qt_threadqueue_node_t *edf_merge_pairs(qt_threadqueue_node_t *first)
+{   /*{{{*/
+    qt_threadqueue_node_t *pairs = NULL; /* linked through next, last pair first */
+    qt_threadqueue_node_t *root  = NULL;
+
+    while (first) {
+        qt_threadqueue_node_t *a = first;
+        qt_threadqueue_node_t *b = a->next;
+
+        first = b ? b->next : NULL;
+        a->next = NULL;
+        if (b) {
+            b->next = NULL;
+            a       = edf_meld(a, b);
+        }
+        a->next = pairs;
+        pairs   = a;
+    }
+    while (pairs) {
+        qt_threadqueue_node_t *next = pairs->next;
+
+        pairs->next = NULL;
+        root        = edf_meld(root, pairs);
+        pairs       = next;
+    }
+    return root;
+} /*}}}*/
+
+static QINLINE qt_threadqueue_node_t *edf_pop(qt_threadqueue_node_t **heap)
+{   /*{{{*/
+    qt_threadqueue_node_t *root = *heap;
+
+    *heap       = edf_merge_pairs(root->child);
+    root->child = NULL;
+    return root;
+} /*}}}*/
+
+/* Caller holds q->qlock */
+static QINLINE void edf_insert(qt_threadqueue_t      *q,
+                               qt_threadqueue_node_t *node)
+{   /*{{{*/
+    node->child = node->next = NULL;
+    q->qlength++;
+    if (node->stealable) {
+        q->heap = edf_meld(q->heap, node);
+        q->qlength_stealable++;
+        q->steal_key = q->heap->key;
+    } else {
+        q->pinned = edf_meld(q->pinned, node);
+    }
+} /*}}}*/
+
+/* Caller holds q->qlock */
+static QINLINE qt_threadqueue_node_t *edf_remove_min(qt_threadqueue_t *q,
+                                                     int               stealable_only)
+{   /*{{{*/
+    qt_threadqueue_node_t *node;
+
+    if (q->heap && (stealable_only || !q->pinned || (q->heap->key <= q->pinned->key))) {
+        node = edf_pop(&q->heap);
+        q->qlength_stealable--;
+        q->steal_key = q->heap ? q->heap->key : EDF_NEVER;
+    } else if (q->pinned && !stealable_only) {
+        node = edf_pop(&q->pinned);
+    } else {
+        return NULL;
+    }
+    q->qlength--;
+    return node;
+} /*}}}*/
+
+/* Apply f to every node of *heap, freeing those it removes. Once f says
+ * STOP, the remaining nodes are kept without asking. Returns nonzero if f
+ * said STOP. Caller holds the queue lock. */
+static int edf_filter_heap(qt_threadqueue_t        *q,
+                           qt_threadqueue_node_t  **heap,
+                           qt_threadqueue_filter_f  f,
+                           int                      stop)
+{   /*{{{*/
+    qt_threadqueue_node_t *todo = *heap;
+
+    *heap = NULL;
+    while (todo) {
+        qt_threadqueue_node_t *node = todo;
+        qthread_t             *t    = node->value;
+        int                    keep = 1;
+
+        todo = node->next;
+        if (node->child) {
+            qt_threadqueue_node_t *last = node->child;
+            while (last->next) last = last->next;
+            last->next = todo;
+            todo       = node->child;
+        }
+        node->child = node->next = NULL;
+        if (!stop) {
+            switch (f(t)) {
+                case IGNORE_AND_STOP:
+                    stop = 1;
+                    /* fallthrough */
+                case IGNORE_AND_CONTINUE:
+                    break;
+                case REMOVE_AND_STOP:
+                    stop = 1;
+                    /* fallthrough */
+                case REMOVE_AND_CONTINUE:
+                    keep = 0;
+                    break;
+            }
+        }
+        if (keep) {
+            *heap = edf_meld(*heap, node);
+        } else {
+            q->qlength--;
+            if (heap == &q->heap) { q->qlength_stealable--; }
+#ifdef QTHREAD_USE_EUREKAS
+            qthread_internal_assassinate(t);
+#endif /* QTHREAD_USE_EUREKAS */
+            FREE_TQNODE(node);
+        }
+    }
+    return stop;
+} /*}}}*/
+
+/*****************************************/
+/* functions to manage the thread queues */
+/*****************************************/
+
+qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
+{   /*{{{*/
+    qt_threadqueue_t *q = ALLOC_THREADQUEUE();
+
+    if (q != NULL) {
+        q->heap              = NULL;
+        q->pinned            = NULL;
+        q->head              = NULL;
+        q->tail              = NULL;
+        q->deque_key         = 0.0;
+        q->qlength           = 0;
+        q->qlength_stealable = 0;
+        q->deque_stealable   = 0;
+        q->steal_key         = EDF_NEVER;
+        q->mccoy             = NULL;
+#ifdef STEAL_PROFILE
+        q->steal_amount_stolen = 0;
+#endif
+        QTHREAD_TRYLOCK_INIT(q->qlock);
+        qt_parking_init(&q->lot);
+    }
+
+    return q;
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
+{   /*{{{*/
+    qt_threadqueue_node_t *node;
+
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    while ((node = edf_remove_min(q, 0)) != NULL) {
+        FREE_QTHREAD(node->value);
+        FREE_TQNODE(node);
+    }
+    while ((node = q->head) != NULL) {
+        edf_deque_unlink(q, node);
+        FREE_QTHREAD(node->value);
+        FREE_TQNODE(node);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    QTHREAD_TRYLOCK_DESTROY(q->qlock);
+    qt_parking_destroy(&q->lot);
+    FREE_THREADQUEUE(q);
+} /*}}}*/
+
+ssize_t INTERNAL qt_threadqueue_advisory_queuelen(qt_threadqueue_t *q)
+{   /*{{{*/
+    /* only an estimate; a basic load is good enough */
+    return q->qlength;
+} /*}}}*/
+
+/* Is there anything the calling worker could run, here or (as a thief)
+ * elsewhere? */
+static int has_work(qt_threadqueue_t   *q,
+                    qthread_worker_id_t worker_id,
+                    uint_fast8_t        active)
+{   /*{{{*/
+    if (((worker_id == 0) && (q->mccoy != NULL)) || q->heap || q->pinned || q->head) {
+        return 1;
+    }
+    if (active && (qlib->nshepherds > 1) && !steal_disable) {
+        for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+            if (qlib->shepherds[i].ready->qlength_stealable) { return 1; }
+        }
+    }
+    return 0;
+} /*}}}*/
+
+static QINLINE void edf_enqueue(qt_threadqueue_t *q,
+                                qthread_t        *t,
+                                int               yielded)
+{   /*{{{*/
+    qt_threadqueue_node_t *node      = ALLOC_TQNODE();
+    const int              stealable = qt_threadqueue_isstealable(t);
+
+    assert(node != NULL);
+    node->value     = t;
+    node->stealable = stealable;
+    node->child     = NULL;
+
+    if (t->deadline == 0.0) {
+        /* yielded tasks go to the far end, as in sherwood */
+        QTHREAD_TRYLOCK_LOCK(&q->qlock);
+        edf_deque_push(q, node, yielded);
+        QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    } else {
+        node->key = edf_key(t, yielded);
+        QTHREAD_TRYLOCK_LOCK(&q->qlock);
+        edf_insert(q, node);
+        QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    }
+    if (stealable) {
+        qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
+    } else {
+        /* the McCoy thread can only run on worker 0: wake everybody */
+        (void)qt_park_notify(&q->lot, (t->flags & QTHREAD_REAL_MCCOY) != 0);
+    }
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
+                                     qthread_t *restrict        t)
+{   /*{{{*/
+    assert(q != NULL);
+    assert(t != NULL);
+
+    edf_enqueue(q, t, 0);
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
+                                             qthread_t *restrict        t)
+{   /*{{{*/
+    assert(q != NULL);
+    assert(t != NULL);
+
+    edf_enqueue(q, t, 1);
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
+static QINLINE qthread_t *edf_dequeue(qt_threadqueue_t *q)
+{   /*{{{*/
+    qt_threadqueue_node_t *node;
+    qthread_t             *t = NULL;
+
+    if ((q->heap == NULL) && (q->pinned == NULL) && (q->head == NULL)) { return NULL; }
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    if (q->tail) {
+        double due = EDF_NEVER;
+
+        if (q->heap) { due = q->heap->key; }
+        if (q->pinned && (q->pinned->key < due)) { due = q->pinned->key; }
+        if (q->deque_key <= due) {
+            node = q->tail;
+            edf_deque_unlink(q, node);
+            q->deque_key = edf_deque_key(q);
+            QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+            t = node->value;
+            FREE_TQNODE(node);
+            return t;
+        }
+    }
+    node = edf_remove_min(q, 0);
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    if (node) {
+        t = node->value;
+        FREE_TQNODE(node);
+    }
+    return t;
+} /*}}}*/
+
+/* Steal the oldest stealable task from the deque of the nearest shepherd that
+ * has one. */
+static qthread_t *edf_steal_deque(qthread_shepherd_t *thief_shepherd)
+{   /*{{{*/
+    qthread_shepherd_t *const shepherds = qlib->shepherds;
+
+    for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds - 1; i++) {
+        qt_threadqueue_t *victim = shepherds[thief_shepherd->sorted_sheplist[i]].ready;
+
+        if (victim->deque_stealable == 0) { continue; }
+        STEAL_ELECTED(thief_shepherd);
+        STEAL_ATTEMPTED(thief_shepherd);
+        if (QTHREAD_TRYLOCK_TRY(&victim->qlock)) {
+            qt_threadqueue_node_t *node = victim->head;
+
+            while (node && !node->stealable) node = node->next;
+            if (node) {
+                qthread_t *t = node->value;
+
+                edf_deque_unlink(victim, node);
+                QTHREAD_TRYLOCK_UNLOCK(&victim->qlock);
+                FREE_TQNODE(node);
+                STEAL_SUCCESSFUL(thief_shepherd);
+                STEAL_AMOUNT(victim, 1);
+                return t;
+            }
+            QTHREAD_TRYLOCK_UNLOCK(&victim->qlock);
+        }
+        STEAL_FAILED(thief_shepherd);
+    }
+    return NULL;
+} /*}}}*/
+
+/* Steal the most urgent stealable deadline task of any other shepherd; among
+ * equally urgent ones, the nearest shepherd's. Failing that, steal a task
+ * without a deadline. */
+static qthread_t *qthread_steal(qthread_shepherd_t *thief_shepherd)
+{   /*{{{*/
+    qthread_shepherd_t *const shepherds = qlib->shepherds;
+    qt_threadqueue_t         *victim    = NULL;
+    double                    best      = EDF_NEVER;
+    qthread_t                *t         = NULL;
+
+    STEAL_CALLED(thief_shepherd);
+    assert(thief_shepherd->sorted_sheplist);
+    for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds - 1; i++) {
+        qt_threadqueue_t *v = shepherds[thief_shepherd->sorted_sheplist[i]].ready;
+        double            k = v->steal_key;
+
+        if (k < best) {
+            best   = k;
+            victim = v;
+        }
+    }
+    if (victim == NULL) {
+        return edf_steal_deque(thief_shepherd);
+    }
+    STEAL_ELECTED(thief_shepherd);
+    STEAL_ATTEMPTED(thief_shepherd);
+    if (QTHREAD_TRYLOCK_TRY(&victim->qlock)) {
+        qt_threadqueue_node_t *node = edf_remove_min(victim, 1);
+        QTHREAD_TRYLOCK_UNLOCK(&victim->qlock);
+        if (node) {
+            t = node->value;
+            FREE_TQNODE(node);
+            STEAL_SUCCESSFUL(thief_shepherd);
+            STEAL_AMOUNT(victim, 1);
+            return t;
+        }
+    }
+    STEAL_FAILED(thief_shepherd);
+    return NULL;
+} /*}}}*/
+
+/* dequeue the earliest deadline */
+qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
+#ifdef QTHREAD_LOCAL_PRIORITY
+                                            qt_threadqueue_t         *lpq,
+#endif /* ifdef QTHREAD_LOCAL_PRIORITY */
+                                            qt_threadqueue_private_t *qc,
+                                            uint_fast8_t              active)
+{   /*{{{*/
+    qthread_worker_t   *my_worker   = qthread_internal_getworker();
+    qthread_shepherd_t *my_shepherd = my_worker->shepherd;
+    qthread_t          *t;
+    unsigned long       spins = 0;
+
+    assert(q != NULL);
+    assert(my_shepherd);
+    assert(my_shepherd->ready == q);
+
+#ifdef QTHREAD_USE_EUREKAS
+    qt_eureka_disable();
+#endif /* QTHREAD_USE_EUREKAS */
+    while (1) {
+        if ((my_worker->worker_id == 0) && (q->mccoy != NULL)) {
+            t        = q->mccoy;
+            q->mccoy = NULL;
+            return t;
+        }
+#ifdef QTHREAD_LOCAL_PRIORITY
+        /* First check local priority queue */
+        t = edf_dequeue(lpq);
+        if (t == NULL)
+#endif /* ifdef QTHREAD_LOCAL_PRIORITY */
+        t = edf_dequeue(q);
+        if ((t == NULL) && active && (qlib->nshepherds > 1) && !steal_disable) {
+            t = qthread_steal(my_shepherd);
+        }
+        if (t == NULL) {
+#ifdef QTHREAD_USE_EUREKAS
+            qt_eureka_check(1);
+#endif /* QTHREAD_USE_EUREKAS */
+#ifndef QTHREAD_LOCAL_PRIORITY /* local priority queues have no parking lot */
+            if (spins++ >= qt_park_spincount) {
+                uint32_t key = qt_park_prepare(&q->lot);
+                if (has_work(q, my_worker->worker_id, active)) {
+                    qt_park_cancel(&q->lot);
+                } else {
+                    qt_park_wait(&q->lot, key);
+                }
+                spins = 0;
+                continue;
+            }
+#endif
+            SPINLOCK_BODY();
+            continue;
+        }
+        if ((t->flags & QTHREAD_REAL_MCCOY) && (my_worker->worker_id != 0)) {
+            /* McCoy thread can only run on worker 0 */
+            assert(q->mccoy == NULL);
+            q->mccoy = t;
+            (void)qt_park_notify(&q->lot, 1);
+            continue;
+        }
+        return t;
+    }
+} /*}}}*/
+
+#ifdef STEAL_PROFILE                   // should give mechanism to make steal profiling optional
+void INTERNAL qthread_steal_stat(void)
+{   /*{{{*/
+    int i;
+
+    assert(qlib);
+    for (i = 0; i < qlib->nshepherds; i++) {
+        fprintf(stdout,
+                "QTHREADS: shepherd %d - steals called:%ld elected:%ld attempted:%ld(failed:%ld successful:%ld) tasks-stolen:%ld\n",
+                qlib->shepherds[i].shepherd_id,
+                qlib->shepherds[i].steal_called,
+                qlib->shepherds[i].steal_elected,
+                qlib->shepherds[i].steal_attempted,
+                qlib->shepherds[i].steal_failed,
+                qlib->shepherds[i].steal_attempted - qlib->shepherds[i].steal_failed,
+                qlib->shepherds[i].ready->steal_amount_stolen);
+    }
+} /*}}}*/
+#endif  /* ifdef STEAL_PROFILE */
+
+/* walk queue removing all tasks matching this description; the deque is
+ * walked oldest first, the heaps in no particular order */
+void INTERNAL qt_threadqueue_filter(qt_threadqueue_t       *q,
+                                    qt_threadqueue_filter_f f)
+{   /*{{{*/
+    qt_threadqueue_node_t *node;
+    int                    stop = 0;
+
+    assert(q != NULL);
+
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    node = q->head;
+    while (node && !stop) {
+        qt_threadqueue_node_t *next = node->next;
+        qthread_t             *t    = node->value;
+
+        switch (f(t)) {
+            case IGNORE_AND_STOP:
+                stop = 1;
+                /* fallthrough */
+            case IGNORE_AND_CONTINUE:
+                break;
+            case REMOVE_AND_STOP:
+                stop = 1;
+                /* fallthrough */
+            case REMOVE_AND_CONTINUE:
+                edf_deque_unlink(q, node);
+#ifdef QTHREAD_USE_EUREKAS
+                qthread_internal_assassinate(t);
+#endif /* QTHREAD_USE_EUREKAS */
+                FREE_TQNODE(node);
+                break;
+        }
+        node = next;
+    }
+    (void)edf_filter_heap(q, &q->pinned, f, edf_filter_heap(q, &q->heap, f, stop));
+    q->steal_key = q->heap ? q->heap->key : EDF_NEVER;
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+} /*}}}*/
+
+/* Take up to max tasks that may run in one aggregate with t off the tail of
+ * the deque. Deadline tasks are never aggregated, and nothing is taken while
+ * any are waiting, since the aggregate would hold them up. */
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{   /*{{{*/
+    int n = 0;
+
+    if ((t->deadline != 0.0) || (q->tail == NULL)) { return 0; }
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    if ((q->heap == NULL) && (q->pinned == NULL)) {
+        max = qt_agg_limit(max, q->qlength);
+        while (n < max && q->tail != NULL && qt_agg_compatible(t, q->tail->value)) {
+            qt_threadqueue_node_t *node = q->tail;
+
+            edf_deque_unlink(q, node);
+            batch[n++] = node->value;
+            FREE_TQNODE(node);
+        }
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    return n;
+} /*}}}*/
+
+/* Look for the task that will fill value among the last few on the tail of
+ * the deque. Deadline tasks wait in the heap and are left to it. */
+qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *q,
+                                                    void             *value)
+{   /*{{{*/
+    qt_threadqueue_node_t *node;
+    qthread_t             *t = NULL;
+    int                    n = 0;
+
+    if (q->tail == NULL) { return NULL; }
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    for (node = q->tail; node != NULL && n < QT_TOUCH_WINDOW; node = node->prev, n++) {
+        if (qt_touch_runnable(node->value, value)) {
+            edf_deque_unlink(q, node);
+            q->deque_key = edf_deque_key(q);
+            t            = node->value;
+            FREE_TQNODE(node);
+            break;
+        }
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    return t;
+} /*}}}*/
+
+/* Unsupported operations */
+qthread_t INTERNAL *qt_threadqueue_private_dequeue(qt_threadqueue_private_t *c)
+{
+    return NULL;
+}
+
+void INTERNAL qt_threadqueue_enqueue_cache(qt_threadqueue_t         *q,
+                                           qt_threadqueue_private_t *cache)
+{}
+
+void INTERNAL qt_threadqueue_private_filter(qt_threadqueue_private_t *restrict c,
+                                            qt_threadqueue_filter_f            f)
+{}
+
+int INTERNAL qt_threadqueue_private_enqueue(qt_threadqueue_private_t *restrict pq,
+                                            qt_threadqueue_t *restrict         q,
+                                            qthread_t *restrict                t)
+{ return 0; }
+
+int INTERNAL qt_threadqueue_private_enqueue_yielded(qt_threadqueue_private_t *restrict q,
+                                                    qthread_t *restrict                t)
+{ return 0; }
+
+void INTERNAL qthread_steal_enable()
+{       /*{{{*/
+    steal_disable = 0;
+}     /*}}}*/
+
+void INTERNAL qthread_steal_disable()
+{       /*{{{*/
+    steal_disable = 1;
+}     /*}}}*/
+
+qthread_shepherd_id_t INTERNAL qt_threadqueue_choose_dest(qthread_shepherd_t * curr_shep)
+{
+    if (curr_shep) {
+        return curr_shep->shepherd_id;
+    } else {
+        return (qthread_shepherd_id_t)0;
+    }
+}
+
+size_t INTERNAL qt_threadqueue_policy(const enum threadqueue_policy policy)
+{
+    switch (policy) {
+        default:
+            return THREADQUEUE_POLICY_UNSUPPORTED;
+    }
+}
+
+/* vim:set expandtab: */
@@ -21,6 +21,7 @@
 #include "qt_eurekas.h"
 #endif /* QTHREAD_USE_EUREKAS */
 #include "qt_subsystems.h"
+#include "qt_parking.h"
 
 /* Note: this queue is SAFE to use with multiple de-queuers, with the caveat
  * that if you have multiple dequeuer's, you'll need to solve the ABA problem.
@@ -38,11 +39,8 @@ struct _qt_threadqueue {
     qt_threadqueue_node_t *stack;
     /* the following is for estimating a queue's "busy" level, and is not
      * guaranteed accurate (that would be a race condition) */
-    saligned_t advisory_queuelen;
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    uint32_t   frustration;
-    QTHREAD_COND_DECL(trigger)
-#endif
+    saligned_t       advisory_queuelen;
+    qt_parking_lot_t lot;
 } /* qt_threadqueue_t */;
 
 /* Memory Management */
@@ -83,10 +81,7 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
 
     q->stack             = NULL;
     q->advisory_queuelen = 0;
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    q->frustration = 0;
-    QTHREAD_COND_INIT(q->trigger);
-#endif /* ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE */
+    qt_parking_init(&q->lot);
 
     return q;
 } /*}}}*/
@@ -121,9 +116,7 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
 {   /*{{{*/
     assert(q);
     while (qt_threadqueue_dequeue(q)) ;
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    QTHREAD_COND_DESTROY(q->trigger);
-#endif
+    qt_parking_destroy(&q->lot);
     FREE_THREADQUEUE(q);
 } /*}}}*/
 
@@ -184,16 +177,7 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
     (void)qthread_incr(&(q->advisory_queuelen), 1);
 
     /* awake waiter */
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    if (q->frustration) {
-        QTHREAD_COND_LOCK(q->trigger);
-        if (q->frustration) {
-            q->frustration = 0;
-            QTHREAD_COND_SIGNAL(q->trigger);
-        }
-        QTHREAD_COND_UNLOCK(q->trigger);
-    }
-#endif
+    (void)qt_park_notify(&q->lot, 0);
 } /*}}}*/
 
 void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
@@ -225,12 +209,22 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
         /* append the node */
         cursor->next = node;
         (void)qthread_incr(&(q->advisory_queuelen), 1);
+        (void)qt_park_notify(&q->lot, 0);
     } else {
         qt_threadqueue_enqueue(q, t);
     }
 #endif /* ifdef QTHREAD_LIFO_MULTI_DEQUEUER */
 } /*}}}*/
 
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
 ssize_t INTERNAL qt_threadqueue_advisory_queuelen(qt_threadqueue_t *q)
 {   /*{{{*/
     assert(q);
@@ -244,7 +238,8 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
 #ifdef QTHREAD_USE_EUREKAS
     qt_eureka_disable();
 #endif /* QTHREAD_USE_EUREKAS */
-    qthread_t *retval = qt_threadqueue_dequeue(q);
+    qthread_t    *retval = qt_threadqueue_dequeue(q);
+    unsigned long spins  = 0;
 
     qthread_debug(THREADQUEUE_CALLS, "q(%p)\n", q);
     if (retval == NULL) {
@@ -252,18 +247,17 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
         qt_eureka_check(0);
 #endif /* QTHREAD_USE_EUREKAS */
         while (q->stack == NULL) {
-#ifndef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-            SPINLOCK_BODY();
-#else
-            COMPILER_FENCE;
-            if (qthread_incr(&q->frustration, 1) > 1000) {
-                QTHREAD_COND_LOCK(q->trigger);
-                if (q->frustration > 1000) {
-                    QTHREAD_COND_WAIT(q->trigger);
+            if (spins++ < qt_park_spincount) {
+                SPINLOCK_BODY();
+            } else {
+                uint32_t key = qt_park_prepare(&q->lot);
+                if (q->stack == NULL) {
+                    qt_park_wait(&q->lot, key);
+                } else {
+                    qt_park_cancel(&q->lot);
                 }
-                QTHREAD_COND_UNLOCK(q->trigger);
+                spins = 0;
             }
-#endif      /* ifdef USE_HARD_POLLING */
         }
 #ifdef QTHREAD_USE_EUREKAS
         qt_eureka_disable();
@@ -355,6 +349,15 @@ qthread_t INTERNAL * qt_threadqueue_dequeue_specific(qt_threadqueue_t * q,
     return NULL;
 }
 
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{
+    return 0;
+}
+
 size_t INTERNAL qt_threadqueue_policy(const enum threadqueue_policy policy)
 {
     switch (policy) {
@@ -14,11 +14,13 @@
 #include "qt_visibility.h"
 #include "qthread_innards.h"           /* for qlib  */
 #include "qt_shepherd_innards.h"
+#include "qt_victims.h"
 #include "qt_qthread_struct.h"
 #include "qt_threadqueues.h"
 #include "qt_envariables.h"
 #include "qt_threadqueue_stack.h"
 #include "qt_asserts.h"
+#include "qt_parking.h"
 
 
 #ifdef STEAL_PROFILE
@@ -51,6 +53,8 @@ struct _qt_threadqueue {
     /* used for the work stealing queue implementation */
     uint32_t empty;
     uint32_t stealing;
+
+    qt_parking_lot_t lot;
 } /* qt_threadqueue_t */;
 
 static const int enqueue_penalty_max   = 1048576;
@@ -90,6 +94,7 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
         qt_stack_create(&(q->shared_stack), 1024);
         QTHREAD_TRYLOCK_INIT(q->trylock);
         QTHREAD_FASTLOCK_INIT(q->steallock);
+        qt_parking_init(&q->lot);
         q->local = qt_calloc(local_length, sizeof(qt_threadqueue_local_t *));
         for(i = 0; i < local_length; i++) {
             posix_memalign((void **)&q->local[i], 64, sizeof(qt_threadqueue_local_t));
@@ -109,6 +114,7 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
     int local_length = qlib->nworkerspershep + 1;
 
     qt_stack_free(&q->shared_stack);
+    qt_parking_destroy(&q->lot);
     for(i = 0; i < local_length; i++) {
         qt_stack_free(&(q->local[i]->stack));
         qt_free(q->local[i]);
@@ -196,6 +202,7 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
     }
 
     q->empty = 0;
+    qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
 } /*}}}*/
 
 /* enqueue multiple (from steal) */
@@ -213,6 +220,7 @@ void INTERNAL qt_threadqueue_enqueue_multiple(qt_threadqueue_t   *q,
     }
     QTHREAD_TRYLOCK_UNLOCK(&q->trylock);
     q->empty = 0;
+    (void)qt_park_notify(&q->lot, 0);
 } /*}}}*/
 
 /* yielded threads enqueue at head */
@@ -223,6 +231,28 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
     qt_stack_enq_base(&q->shared_stack, t);
     QTHREAD_TRYLOCK_UNLOCK(&q->trylock);
     q->empty = 0;
+    qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
+/* Does q hold anything its own workers (or a thief) could run? */
+static int qt_threadqueue_has_work(qt_threadqueue_t *q)
+{   /*{{{*/
+    int local_length = qlib->nworkerspershep + 1;
+
+    if (!qt_stack_is_empty(&q->shared_stack)) { return 1; }
+    for (int i = 0; i < local_length; i++) {
+        if (!qt_stack_is_empty(&q->local[i]->stack)) { return 1; }
+    }
+    return 0;
 } /*}}}*/
 
 qthread_t static QINLINE *qt_threadqueue_dequeue_helper(qt_threadqueue_t *q)
@@ -264,6 +294,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
     int                     id    = qt_threadqueue_worker_id();
     qt_threadqueue_local_t *local = q->local[id];
     qthread_t              *t     = NULL, *retainer;
+    unsigned long           spins = 0;
 
     for(;;) {
 
@@ -296,12 +327,27 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
         if (t != NULL) { return(t); }
         t = qt_threadqueue_dequeue_helper(q);
         if (t != NULL) { return(t); }
+
+        /* nothing to run: spin for a while, then park until work arrives */
+        if (spins++ >= qt_park_spincount) {
+            uint32_t key  = qt_park_prepare(&q->lot);
+            int      work = qt_threadqueue_has_work(q);
+            for (qthread_shepherd_id_t s = 0; !work && !q->steal_disable && s < qlib->nshepherds; s++) {
+                work = qt_threadqueue_has_work(qlib->shepherds[s].ready);
+            }
+            if (work) {
+                qt_park_cancel(&q->lot);
+            } else {
+                qt_park_wait(&q->lot, key);
+            }
+            spins = 0;
+        }
     }
 }   /*}}}*/
 
 int static QINLINE qt_threadqueue_stealable(qthread_t *t)
 {
-    return(!(t->flags & QTHREAD_UNSTEALABLE));
+    return(!(t->flags & (QTHREAD_UNSTEALABLE | QTHREAD_NODE_BOUND)));
 }
 
 /* Returns the number of tasks to steal per steal operation (chunk size) */
@@ -430,8 +476,9 @@ static QINLINE qthread_t *qthread_steal(qt_threadqueue_t *thiefq)
         (qthread_shepherd_t *)worker->shepherd;
     qthread_t **nostealbuffer = worker->nostealbuffer;
     qthread_t **stealbuffer   = worker->stealbuffer;
-    int         nshepherds    = qlib->nshepherds;
     int         local_length  = qlib->nworkerspershep + 1;
+    qt_victim_iter_t      victims;
+    qthread_shepherd_id_t v;
 
     steal_profile_increment(thief_shepherd, steal_called);
 
@@ -448,14 +495,9 @@ static QINLINE qthread_t *qthread_steal(qt_threadqueue_t *thiefq)
 
     steal_profile_increment(thief_shepherd, steal_attempted);
 
-    int shepherd_offset = qthread_worker(NULL) % nshepherds;
-
-    for (i = 1; i < qlib->nshepherds; i++) {
-        shepherd_offset = (shepherd_offset + 1) % nshepherds;
-        if (shepherd_offset == thief_shepherd->shepherd_id) {
-            shepherd_offset = (shepherd_offset + 1) % nshepherds;
-        }
-        victim_shepherd = &qlib->shepherds[shepherd_offset];
+    qt_victim_iter_init(&victims, thief_shepherd, qthread_worker(NULL), 0);
+    while ((v = qt_victim_next(&victims)) != NO_SHEPHERD) {
+        victim_shepherd = &qlib->shepherds[v];
         victim_queue    = victim_shepherd->ready;
         if (victim_queue->empty) { continue; }
 
@@ -492,6 +534,16 @@ qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *q,
     return (NULL);
 }   /*}}}*/
 
+/* tasks are not aggregated from these queues */
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{   /*{{{*/
+    return 0;
+}   /*}}}*/
+
 void INTERNAL qthread_steal_enable()
 {   /*{{{*/
     qt_threadqueue_t *q;
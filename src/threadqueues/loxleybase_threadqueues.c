@@ -142,6 +142,15 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
     q->empty = 0;
 } /*}}}*/
 
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
 qthread_t static QINLINE *qt_threadqueue_dequeue_helper(qt_threadqueue_t *q)
 {
     qthread_t *t = NULL;
@@ -178,7 +187,7 @@ int static QINLINE qt_threadqueue_stealable(qthread_t *t)
 {
     return(t->thread_state != QTHREAD_STATE_YIELDED &&
            t->thread_state != QTHREAD_STATE_TERM_SHEP &&
-           !(t->flags & QTHREAD_UNSTEALABLE));
+           !(t->flags & (QTHREAD_UNSTEALABLE | QTHREAD_NODE_BOUND)));
 }
 
 /* Returns the number of tasks to steal per steal operation (chunk size) */
@@ -328,6 +337,16 @@ qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *q,
     return (NULL);
 }   /*}}}*/
 
+/* tasks are not aggregated from these queues */
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{   /*{{{*/
+    return 0;
+}   /*}}}*/
+
 #ifdef STEAL_PROFILE  // should give mechanism to make steal profiling optional
 void INTERNAL qthread_steal_stat(void)
 {
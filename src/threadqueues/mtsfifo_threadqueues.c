@@ -24,6 +24,7 @@
 #include "qt_eurekas.h"
 #endif /* QTHREAD_USE_EUREKAS */
 #include "qt_subsystems.h"
+#include "qt_parking.h"
 
 /* Data Structures */
 struct _qt_threadqueue_node {
@@ -34,10 +35,7 @@ struct _qt_threadqueue_node {
 struct _qt_threadqueue {
     qt_threadqueue_node_t *head;
     qt_threadqueue_node_t *tail;
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    aligned_t              fruitless;
-    QTHREAD_COND_DECL(trigger);
-#endif                          /* CONDWAIT */
+    qt_parking_lot_t       lot;
     /* the following is for estimating a queue's "busy" level, and is not
      * guaranteed accurate (that would be a race condition) */
     saligned_t advisory_queuelen;
@@ -114,21 +112,16 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
     qt_threadqueue_t *q = ALLOC_THREADQUEUE();
 
     if (q != NULL) {
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-        q->fruitless = 0;
-        QTHREAD_COND_INIT(q->trigger);
-#endif   /* ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE */
         ALLOC_TQNODE(((qt_threadqueue_node_t **)&(q->head)));
         assert(q->head != NULL);
         if (q->head == NULL) {   // if we're not using asserts, fail nicely
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-            QTHREAD_COND_DESTROY(q->trigger);
-#endif
             FREE_THREADQUEUE(q);
+            return NULL;
             q = NULL;
         }
         q->tail       = q->head;
         q->tail->next = NULL;
+        qt_parking_init(&q->lot);
     }
     return q;
 }                                      /*}}} */
@@ -186,9 +179,7 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
         qt_threadqueue_dequeue(q);
     }
     assert(q->head == q->tail);
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    QTHREAD_COND_DESTROY(q->trigger);
-#endif
+    qt_parking_destroy(&q->lot);
     FREE_TQNODE((qt_threadqueue_node_t *)q->head);
     FREE_THREADQUEUE(q);
 }                                      /*}}} */
@@ -267,16 +258,7 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
     qthread_debug(THREADQUEUE_DETAILS, "q(%p), t(%p:%i): appended head:%p nextptr:%p tail:%p\n", q, t, t->thread_id, q->head, q->head ? q->head->next : NULL, q->tail);
 
     (void)qthread_incr(&q->advisory_queuelen, 1);
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    if (q->fruitless) {
-        QTHREAD_COND_LOCK(q->trigger);
-        if (q->fruitless) {
-            q->fruitless = 0;
-            QTHREAD_BCAST(q->trigger);
-        }
-        QTHREAD_COND_UNLOCK(q->trigger);
-    }
-#endif
+    (void)qt_park_notify(&q->lot, 0);
     hazardous_ptr(0, NULL); // release the ptr (avoid hazardptr resource exhaustion)
 }                           /*}}} */
 
@@ -286,11 +268,21 @@ void qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
     qt_threadqueue_enqueue(q, t);
 } /*}}}*/
 
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
 qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                                             qt_threadqueue_private_t *QUNUSED(qc),
                                             uint_fast8_t              QUNUSED(active))
 {                                      /*{{{ */
-    qthread_t *p = NULL;
+    qthread_t    *p     = NULL;
+    unsigned long spins = 0;
 
     qt_threadqueue_node_t *head;
     qt_threadqueue_node_t *tail;
@@ -316,38 +308,20 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
         hazardous_ptr(1, next_ptr);
 
         if (next_ptr == NULL) { // queue is empty
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-            if (qthread_internal_incr(&q->fruitless, &q->fruitless_m, 1) > 1000) {
-# ifdef QTHREAD_USE_EUREKAS
-                qt_eureka_check(0);
-# endif /* QTHREAD_USE_EUREKAS */
-                QTHREAD_COND_LOCK(q->trigger);
-                while (q->fruitless > 1000) {
-                    QTHREAD_COND_WAIT(q->trigger);
-                }
-                QTHREAD_COND_UNLOCK(q->trigger);
-# ifdef QTHREAD_USE_EUREKAS
-                qt_eureka_disable();
-# endif /* QTHREAD_USE_EUREKAS */
+#ifdef QTHREAD_USE_EUREKAS
+            qt_eureka_check(1);
+#endif /* QTHREAD_USE_EUREKAS */
+            if (spins++ < qt_park_spincount) {
+                SPINLOCK_BODY();
             } else {
-# ifdef QTHREAD_USE_EUREKAS
-                qt_eureka_check(0);
-# endif /* QTHREAD_USE_EUREKAS */
-# ifdef HAVE_PTHREAD_YIELD
-                pthread_yield();
-# elif HAVE_SHED_YIELD
-                sched_yield();
-# endif
-# ifdef QTHREAD_USE_EUREKAS
-                qt_eureka_disable();
-# endif /* QTHREAD_USE_EUREKAS */
+                uint32_t key = qt_park_prepare(&q->lot);
+                if (head->next == NULL) {
+                    qt_park_wait(&q->lot, key);
+                } else {
+                    qt_park_cancel(&q->lot);
+                }
+                spins = 0;
             }
-#else       /* ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE */
-# ifdef QTHREAD_USE_EUREKAS
-            qt_eureka_check(1);
-# endif /* QTHREAD_USE_EUREKAS */
-            SPINLOCK_BODY();
-#endif              /* ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE */
             continue;
         }
         qthread_debug(THREADQUEUE_DETAILS, "q(%p): next_ptr = %p\n", q, next_ptr);
@@ -473,6 +447,15 @@ qthread_t INTERNAL * qt_threadqueue_dequeue_specific(qt_threadqueue_t * q,
     return NULL;
 }
 
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{
+    return 0;
+}
+
 size_t INTERNAL qt_threadqueue_policy(const enum threadqueue_policy policy)
 {
     switch (policy) {
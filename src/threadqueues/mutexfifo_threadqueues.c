@@ -24,6 +24,7 @@
 #include "qt_eurekas.h"
 #endif /* QTHREAD_USE_EUREKAS */
 #include "qt_subsystems.h"
+#include "qt_parking.h"
 
 /* Data Structures */
 struct _qt_threadqueue_node {
@@ -39,7 +40,8 @@ struct _qt_threadqueue {
     QTHREAD_FASTLOCK_TYPE  advisory_queuelen_m;
     /* the following is for estimating a queue's "busy" level, and is not
      * guaranteed accurate (that would be a race condition) */
-    saligned_t advisory_queuelen;
+    saligned_t       advisory_queuelen;
+    qt_parking_lot_t lot;
 } /* qt_threadqueue_t */;
 
 /* Memory Management */
@@ -107,6 +109,7 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
             q->tail        = q->head;
             q->head->next  = NULL;
             q->head->value = NULL;
+            qt_parking_init(&q->lot);
         }
     }
     return q;
@@ -144,6 +147,7 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
     QTHREAD_FASTLOCK_DESTROY(q->head_lock);
     QTHREAD_FASTLOCK_DESTROY(q->tail_lock);
     QTHREAD_FASTLOCK_DESTROY(q->advisory_queuelen_m);
+    qt_parking_destroy(&q->lot);
     FREE_TQNODE((qt_threadqueue_node_t *)(q->head));
     FREE_THREADQUEUE(q);
 }                                      /*}}} */
@@ -192,6 +196,7 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
     }
     QTHREAD_FASTLOCK_UNLOCK(&q->tail_lock);
     (void)qthread_internal_incr_s(&q->advisory_queuelen, &q->advisory_queuelen_m, 1);
+    (void)qt_park_notify(&q->lot, 0);
 }                                      /*}}} */
 
 void qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
@@ -200,15 +205,25 @@ void qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
     qt_threadqueue_enqueue(q, t);
 } /*}}}*/
 
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
+} /*}}}*/
+
 /* this function is amusing, but the point is to avoid unnecessary bus traffic
  * by allowing idle shepherds to sit for a while while still allowing for
  * low-overhead for busy shepherds. This is a hybrid approach: normally, it
- * functions as a spinlock, but if it spins too much, it waits for a signal */
+ * functions as a spinlock, but if it spins too much, it parks (qt_parking.h) */
 qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                                             qt_threadqueue_private_t *QUNUSED(qc),
                                             uint_fast8_t              QUNUSED(active))
 {                                      /*{{{ */
-    qthread_t *p = NULL;
+    qthread_t    *p     = NULL;
+    unsigned long spins = 0;
 
 #ifdef QTHREAD_USE_EUREKAS
     qt_eureka_disable();
@@ -217,7 +232,17 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
 #ifdef QTHREAD_USE_EUREKAS
         qt_eureka_check(1);
 #endif /* QTHREAD_USE_EUREKAS */
-        SPINLOCK_BODY();
+        if (spins++ < qt_park_spincount) {
+            SPINLOCK_BODY();
+        } else {
+            uint32_t key = qt_park_prepare(&q->lot);
+            if (q->advisory_queuelen == 0) {
+                qt_park_wait(&q->lot, key);
+            } else {
+                qt_park_cancel(&q->lot);
+            }
+            spins = 0;
+        }
     }
     return p;
 }                                      /*}}} */
@@ -315,6 +340,15 @@ qthread_t INTERNAL * qt_threadqueue_dequeue_specific(qt_threadqueue_t * q,
     return NULL;
 }
 
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{
+    return 0;
+}
+
 size_t INTERNAL qt_threadqueue_policy(const enum threadqueue_policy policy)
 {
     switch (policy) {
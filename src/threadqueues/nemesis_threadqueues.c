@@ -26,19 +26,13 @@
 #endif /* QTHREAD_USE_EUREKAS */
 #include "qt_subsystems.h"
 #include "qt_qthread_mgmt.h"             /* for qthread_thread_free() */
+#include "qt_parking.h"
 
 /* This thread queueing uses the NEMESIS lock-free queue protocol from
  * http://www.mcs.anl.gov/~buntinas/papers/ccgrid06-nemesis.pdf
  * Note: it is NOT SAFE to use with multiple de-queuers, it is ONLY safe to use
  * with multiple enqueuers and a single de-queuer. */
 
-int num_spins_before_condwait;
-#ifdef QTHREAD_OVERSUBSCRIPTION
-#define DEFAULT_SPINCOUNT 300
-#else
-#define DEFAULT_SPINCOUNT 300000
-#endif
-
 /* Data Structures */
 struct _qt_threadqueue_node {
     struct _qt_threadqueue_node *next;
@@ -63,11 +57,8 @@ struct _qt_threadqueue {
     NEMESIS_queue q;
     /* the following is for estimating a queue's "busy" level, and is not
      * guaranteed accurate (that would be a race condition) */
-    saligned_t advisory_queuelen;
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    uint32_t   frustration;
-    QTHREAD_COND_DECL(trigger);
-#endif
+    saligned_t       advisory_queuelen;
+    qt_parking_lot_t lot;
 } /* qt_threadqueue_t */;
 
 /* Memory Management */
@@ -93,8 +84,6 @@ static void qt_threadqueue_subsystem_shutdown(void)
 void INTERNAL qt_threadqueue_subsystem_init(void)
 {   /*{{{*/
 
-    num_spins_before_condwait = qt_internal_get_env_num("SPINCOUNT", DEFAULT_SPINCOUNT, 0);
-
     generic_threadqueue_pools.queues = qt_mpool_create(sizeof(qt_threadqueue_t));
     generic_threadqueue_pools.nodes  = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t), 8);
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
@@ -112,10 +101,7 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
     q->q.shadow_head               = q->q.head = q->q.tail = NULL;
     q->advisory_queuelen           = 0;
     q->q.nemesis_advisory_queuelen = 0; // redundant
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    q->frustration = 0;
-    QTHREAD_COND_INIT(q->trigger);
-#endif /* ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE */
+    qt_parking_init(&q->lot);
 
     return q;
 }                                      /*}}} */
@@ -208,9 +194,7 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
             break;
         }
     }
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-    QTHREAD_COND_DESTROY(q->trigger);
-#endif
+    qt_parking_destroy(&q->lot);
     FREE_THREADQUEUE(q);
 }                                      /*}}} */
 
@@ -331,20 +315,8 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
     }
     PARANOIA(sanity_check_tq(&q->q));
     (void)qthread_incr(&(q->advisory_queuelen), 1);
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
     /* awake waiter */
-    /* Yes, this needs to be here, to prevent reading frustration being hoisted
-     * to before the enqueue operations. */
-    MACHINE_FENCE;
-    if (q->frustration) {
-        QTHREAD_COND_LOCK(q->trigger);
-        if (q->frustration) {
-            q->frustration = 0;
-            QTHREAD_COND_SIGNAL(q->trigger);
-        }
-        QTHREAD_COND_UNLOCK(q->trigger);
-    }
-#endif /* ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE */
+    (void)qt_park_notify(&q->lot, 0);
 }                                      /*}}} */
 
 void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
@@ -353,6 +325,46 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
     qt_threadqueue_enqueue(q, t);
 }                                      /*}}} */
 
+/* link the n tasks into a chain first, so that it takes one swap of the tail
+ * to enqueue them all */
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{                                      /*{{{ */
+    qt_threadqueue_node_t *first = NULL, *last = NULL, *prev;
+
+    assert(q);
+    assert(t);
+
+    if (n == 0) { return; }
+    PARANOIA(sanity_check_tq(&q->q));
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_node_t *node = ALLOC_TQNODE();
+
+        assert(node != NULL);
+        node->thread = t[i];
+        node->next   = NULL;
+        if (last == NULL) {
+            first = node;
+        } else {
+            last->next = node;
+        }
+        last = node;
+    }
+
+    prev = qt_internal_atomic_swap_ptr((void **)&(q->q.tail), last);
+
+    if (prev == NULL) {
+        q->q.head = first;
+    } else {
+        prev->next = first;
+    }
+    PARANOIA(sanity_check_tq(&q->q));
+    (void)qthread_incr(&(q->advisory_queuelen), n);
+    /* awake waiter */
+    (void)qt_park_notify(&q->lot, 0);
+}                                      /*}}} */
+
 ssize_t INTERNAL qt_threadqueue_advisory_queuelen(qt_threadqueue_t *q)
 {                                      /*{{{ */
     assert(q);
@@ -363,7 +375,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                                             qt_threadqueue_private_t *QUNUSED(qc),
                                             uint_fast8_t              QUNUSED(active))
 {                                      /*{{{ */
-    int i;
+    unsigned long spins = 0;
 #ifdef QTHREAD_USE_EUREKAS
     qt_eureka_disable();
 #endif /* QTHREAD_USE_EUREKAS */
@@ -379,26 +391,18 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
         qt_eureka_check(0);
 #endif /* QTHREAD_USE_EUREKAS */
 
-#ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-        i = num_spins_before_condwait;
-        while (q->q.shadow_head == NULL && q->q.head == NULL && i > 0) {
-          SPINLOCK_BODY();
-          i--;
-        }
-#endif      /* QTHREAD_CONDWAIT_BLOCKING_QUEUE */
-
         while (q->q.shadow_head == NULL && q->q.head == NULL) {
-#ifndef QTHREAD_CONDWAIT_BLOCKING_QUEUE
-            SPINLOCK_BODY();
-#else
-            if (qthread_incr(&q->frustration, 1) > 1000) {
-                QTHREAD_COND_LOCK(q->trigger);
-                if (q->frustration > 1000) {
-                    QTHREAD_COND_WAIT(q->trigger);
+            if (spins++ < qt_park_spincount) {
+                SPINLOCK_BODY();
+            } else {
+                uint32_t key = qt_park_prepare(&q->lot);
+                if (q->q.shadow_head == NULL && q->q.head == NULL) {
+                    qt_park_wait(&q->lot, key);
+                } else {
+                    qt_park_cancel(&q->lot);
                 }
-                QTHREAD_COND_UNLOCK(q->trigger);
+                spins = 0;
             }
-#endif      /* ifdef USE_HARD_POLLING */
         }
 #ifdef QTHREAD_USE_EUREKAS
         qt_eureka_disable();
@@ -502,6 +506,15 @@ qthread_t INTERNAL * qt_threadqueue_dequeue_specific(qt_threadqueue_t * q,
     return NULL;
 }
 
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{
+    return 0;
+}
+
 size_t INTERNAL qt_threadqueue_policy(const enum threadqueue_policy policy)
 {
     switch (policy) {
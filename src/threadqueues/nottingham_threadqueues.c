@@ -4,6 +4,7 @@
 
 /* System Headers */
 #include <pthread.h>
+#include <stddef.h> /* for offsetof() */
 #include <stdint.h>
 #include <emmintrin.h>
 #include <stdio.h>
@@ -15,11 +16,14 @@
 #include "qt_visibility.h"
 #include "qthread_innards.h"           /* for qlib */
 #include "qt_shepherd_innards.h"
+#include "qt_victims.h"
 #include "qt_qthread_struct.h"
 #include "qt_asserts.h"
 #include "qt_prefetch.h"
 #include "qt_threadqueues.h"
 #include "qt_envariables.h"
+#include "qt_parking.h"
+#include "qt_expect.h"
 
 #ifndef NOINLINE
 # define NOINLINE __attribute__ ((noinline))
@@ -61,6 +65,8 @@ struct _qt_threadqueue {
     uint32_t empty;
     uint32_t stealing;
     uint32_t steal_disable;
+
+    qt_parking_lot_t lot;
 } /* qt_threadqueue_t */;
 
 // Forward declarations
@@ -74,6 +80,30 @@ INTERNAL int qt_threadqueue_dequeue_steal(qt_threadqueue_t *q,
                                           qthread_t       **nostealbuffer,
                                           qthread_t       **stealbuffer);
 
+/* The rwlock has a reader slot for each of the first MAX_READERS workers,
+ * indexed by qthread_worker_unique(). Anybody else (pthreads that are not
+ * workers, whose id is NO_WORKER, and workers past the last slot) takes it
+ * for writing instead. */
+static QINLINE void qt_threadqueue_rdlock(rwlock_t *l,
+                                          int       id)
+{   /*{{{*/
+    if (QTHREAD_LIKELY((unsigned)id < MAX_READERS)) {
+        rwlock_rdlock(l, id);
+    } else {
+        rwlock_wrlock(l, id);
+    }
+} /*}}}*/
+
+static QINLINE void qt_threadqueue_rdunlock(rwlock_t *l,
+                                            int       id)
+{   /*{{{*/
+    if (QTHREAD_LIKELY((unsigned)id < MAX_READERS)) {
+        rwlock_rdunlock(l, id);
+    } else {
+        rwlock_wrunlock(l);
+    }
+} /*}}}*/
+
 void INTERNAL qt_threadqueue_resize_and_enqueue(qt_threadqueue_t *q,
                                                 qthread_t        *t);
 
@@ -135,6 +165,7 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
         q->empty    = 1;
         q->stealing = 0;
         QTHREAD_FASTLOCK_INIT(q->spinlock);
+        qt_parking_init(&q->lot);
         posix_memalign((void **)&(q->base), 64, q->size * sizeof(m128i));
         posix_memalign((void **)&(q->rwlock), 64, sizeof(rwlock_t));
         rwlock_init(q->rwlock);
@@ -149,6 +180,7 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
     /* while (q->head != q->tail) {
      *  qt_scheduler_get_thread(q, 1);
      * } */
+    qt_parking_destroy(&q->lot);
     qt_free((void *)q->base);
     qt_free((void *)q);
 } /*}}}*/
@@ -242,7 +274,7 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
 
     int id = qthread_worker_unique(NULL);
 
-    rwlock_rdlock(q->rwlock, id);
+    qt_threadqueue_rdlock(q->rwlock, id);
 
     oldtop.sse = q->top;
 
@@ -258,7 +290,7 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
         if (nextindex == q->bottom) {
             // Pthread reader-writer locks will deadlock
             // on lock promotion attempts.
-            rwlock_rdunlock(q->rwlock, id);
+            qt_threadqueue_rdunlock(q->rwlock, id);
             qt_threadqueue_resize_and_enqueue(q, t);
             cas_profile_update(id, cycles - 1);
             return;
@@ -282,7 +314,9 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
 
     q->empty = 0;
 
-    rwlock_rdunlock(q->rwlock, id);
+    qt_threadqueue_rdunlock(q->rwlock, id);
+
+    qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
 
     cas_profile_update(id, cycles - 1);
 } /*}}}*/
@@ -383,6 +417,8 @@ void INTERNAL qt_threadqueue_resize_and_enqueue(qt_threadqueue_t *q,
     q->empty = 0;
 
     rwlock_wrunlock(q->rwlock);
+
+    qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
 } /*}}}*/
 
 /* yielded threads enqueue at head */
@@ -423,6 +459,7 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
         q->top             = newtop.sse;
         q->base[nextindex] = snapshot.sse;
         rwlock_wrunlock(q->rwlock);
+        qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
         return;
     } else if ((top.entry.index + 1) % q->size == q->bottom) {
         qt_threadqueue_resize(q);
@@ -447,6 +484,17 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
     q->empty = 0;
 
     rwlock_wrunlock(q->rwlock);
+
+    qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
+} /*}}}*/
+
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_enqueue(q, t[i]);
+    }
 } /*}}}*/
 
 qthread_t static QINLINE *qt_threadqueue_dequeue_helper(qt_threadqueue_t *q)
@@ -464,6 +512,26 @@ qthread_t static QINLINE *qt_threadqueue_dequeue_helper(qt_threadqueue_t *q)
     return(t);
 }
 
+/* Final check before parking: anything queued locally, or (if stealing is
+ * allowed) on any other shepherd. The empty flags are only cleared by
+ * thieves, so they cannot be trusted here. */
+static int qt_threadqueue_has_work(qt_threadqueue_t *q)
+{   /*{{{*/
+    qt_threadqueue_union_t top;
+
+    top.sse = q->top;
+    if (top.entry.index != q->bottom) { return 1; }
+    if (!q->steal_disable) {
+        for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+            qt_threadqueue_t *v = qlib->shepherds[i].ready;
+
+            top.sse = v->top;
+            if (top.entry.index != v->bottom) { return 1; }
+        }
+    }
+    return 0;
+} /*}}}*/
+
 /* dequeue at tail, unlike original qthreads implementation */
 qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                                             qt_threadqueue_private_t *QUNUSED(qc),
@@ -472,6 +540,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
     qthread_t             *t      = NULL;
     rwlock_t              *rwlock = q->rwlock;
     qt_threadqueue_union_t oldtop, lastchance;
+    unsigned long          spins = 0;
 
 #ifdef CAS_STEAL_PROFILE
     int cycles = 0;
@@ -481,7 +550,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
 
     assert(q != NULL);
 
-    rwlock_rdlock(rwlock, id);
+    qt_threadqueue_rdlock(rwlock, id);
 
     oldtop.sse = q->top;
 
@@ -491,7 +560,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
 #endif
 
         if (oldtop.entry.index == q->bottom) {
-            rwlock_rdunlock(rwlock, id);
+            qt_threadqueue_rdunlock(rwlock, id);
             if (active) {
                 t = qt_threadqueue_dequeue_helper(q);
                 if (t != NULL) {
@@ -499,7 +568,16 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                     return(t);
                 }
             }
-            rwlock_rdlock(rwlock, id);
+            if (spins++ >= qt_park_spincount) {
+                uint32_t key = qt_park_prepare(&q->lot);
+                if (qt_threadqueue_has_work(q)) {
+                    qt_park_cancel(&q->lot);
+                } else {
+                    qt_park_wait(&q->lot, key);
+                }
+                spins = 0;
+            }
+            qt_threadqueue_rdlock(rwlock, id);
             oldtop.sse = q->top;
         } else {
             t = oldtop.entry.value;
@@ -507,15 +585,15 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
             if ((t->flags & QTHREAD_REAL_MCCOY)) { // only needs to be on worker 0 for termination
                 switch(qthread_worker(NULL)) {
                     case NO_WORKER:                  // only happens during termination -- keep trying
-                        rwlock_rdunlock(rwlock, id); // release lock and get new value
-                        rwlock_rdlock(rwlock, id);
+                        qt_threadqueue_rdunlock(rwlock, id); // release lock and get new value
+                        qt_threadqueue_rdlock(rwlock, id);
                         oldtop.sse = q->top;
                         continue;
                     case 0:
                         break;
                     default:
                         /* McCoy thread can only run on worker 0 */
-                        rwlock_rdunlock(rwlock, id);
+                        qt_threadqueue_rdunlock(rwlock, id);
                         if (active) {
                             t = qt_threadqueue_dequeue_helper(q);
                             if (t != NULL) {
@@ -523,7 +601,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                                 return(t);
                             }
                         }
-                        rwlock_rdlock(rwlock, id);
+                        qt_threadqueue_rdlock(rwlock, id);
                         oldtop.sse = q->top;
                         continue;
                 }
@@ -549,7 +627,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
 
             if(qt_threadqueue_cas128((uint128_t *)&(q->top),
                                      (uint128_t *)&oldtop, (uint128_t *)&newtop)) {
-                rwlock_rdunlock(rwlock, id);
+                qt_threadqueue_rdunlock(rwlock, id);
                 assert(t != NULL);
                 cas_profile_update(id, cycles - 1);
                 return (t);
@@ -562,7 +640,7 @@ int static QINLINE qt_threadqueue_stealable(qthread_t *t)
 {
     return(t->thread_state != QTHREAD_STATE_YIELDED &&
            t->thread_state != QTHREAD_STATE_TERM_SHEP &&
-           !(t->flags & QTHREAD_UNSTEALABLE));
+           !(t->flags & (QTHREAD_UNSTEALABLE | QTHREAD_NODE_BOUND)));
 }
 
 void INTERNAL qt_threadqueue_enqueue_unstealable(qt_threadqueue_t *q,
@@ -698,6 +776,8 @@ static QINLINE qthread_t *qthread_steal(qt_threadqueue_t *thiefq)
         (qthread_shepherd_t *)worker->shepherd;
     qthread_t **nostealbuffer = worker->nostealbuffer;
     qthread_t **stealbuffer   = worker->stealbuffer;
+    qt_victim_iter_t      victims;
+    qthread_shepherd_id_t v;
 
 #ifdef STEAL_PROFILE                   // should give mechanism to make steal profiling optional
     qthread_incr(&thief_shepherd->steal_called, 1);
@@ -715,13 +795,9 @@ static QINLINE qthread_t *qthread_steal(qt_threadqueue_t *thiefq)
 #ifdef STEAL_PROFILE                   // should give mechanism to make steal profiling optional
     qthread_incr(&thief_shepherd->steal_attempted, 1);
 #endif
-    int shepherd_offset = qthread_worker(NULL) % qlib->nshepherds;
-    for (i = 1; i < qlib->nshepherds; i++) {
-        shepherd_offset = (shepherd_offset + 1) % qlib->nshepherds;
-        if (shepherd_offset == thief_shepherd->shepherd_id) {
-            shepherd_offset = (shepherd_offset + 1) % qlib->nshepherds;
-        }
-        victim_shepherd = &qlib->shepherds[shepherd_offset];
+    qt_victim_iter_init(&victims, thief_shepherd, qthread_worker(NULL), 0);
+    while ((v = qt_victim_next(&victims)) != NO_SHEPHERD) {
+        victim_shepherd = &qlib->shepherds[v];
         if (victim_shepherd->ready->empty) { continue; }
         int amtStolen = qt_threadqueue_dequeue_steal(victim_shepherd->ready,
                                                      nostealbuffer, stealbuffer);
@@ -795,82 +871,22 @@ void INTERNAL qthread_steal_stat(void)
 
 #endif  /* ifdef STEAL_PROFILE */
 
-/* walk queue looking for a specific value  -- if found remove it (and start
- * it running)  -- if not return NULL
- */
+/* tasks are not given back to their parent from the lock-free deque: taking
+ * one out of the middle of it races with the owner and with thieves */
 qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *q,
                                                     void             *value)
 {   /*{{{*/
-    int id = qthread_worker_unique(NULL);
-
-    assert(q != NULL);
-
-    rwlock_wrlock(q->rwlock, id);
-
-    qt_threadqueue_union_t top;
-
-    top.sse = q->top;
-    qt_threadqueue_finish(q, top.entry);
-
-    if (q->bottom == top.entry.index) {
-        rwlock_wrunlock(q->rwlock);
-        return(NULL);
-    }
-
-    if (top.entry.value->ret == value) {
-        qt_threadqueue_union_t snapshot;
-
-        qthread_t *retval    = top.entry.value;
-        uint32_t   previndex = (top.entry.index - 1) % q->size;
-        snapshot.sse = q->base[previndex];
-
-        top.entry.index   = previndex;
-        top.entry.value   = snapshot.entry.value;
-        top.entry.counter = snapshot.entry.counter;
-
-        q->top = top.sse;
-
-        rwlock_wrunlock(q->rwlock);
-        return(retval);
-    } else {
-        uint32_t current = (q->bottom + 1) % q->size;
-        uint32_t size    = q->size;
-        uint32_t bottom  = q->bottom;
-        while (current != top.entry.index) {
-            qt_threadqueue_union_t snapshot;
-
-            snapshot.sse = q->base[current];
-            qthread_t *t = snapshot.entry.value;
-            if (t->ret == value) {
-                /* Two cases:
-                 * (i)  The current index is below the top
-                 *    index in the array. It is easier to
-                 *    slide the elements above current, and
-                 *    decrement the top index.
-                 * (ii) The current index is above the top
-                 *    index in the array. It is easier to
-                 *    slide the elements below current, and
-                 *    increment the bottom index.
-                 */
-                if (current < top.entry.index) {
-                    memmove((void *)(q->base + current), (const void *)(q->base + current + 1),
-                            (top.entry.index - current - 1) * sizeof(qt_threadqueue_entry_t));
-                    top.entry.index = (top.entry.index - 1) % q->size;
-                    q->top          = top.sse;
-                } else {
-                    memmove((void *)(q->base + bottom + 1), (const void *)(q->base + bottom),
-                            (current - bottom) * sizeof(qt_threadqueue_entry_t));
-                    q->bottom = (bottom + 1) % q->size;
-                }
-                rwlock_wrunlock(q->rwlock);
-                return(t);
-            }
-            current = (current + 1) % size;
-        }
-    }
+    return NULL;
+} /*}}}*/
 
-    rwlock_wrunlock(q->rwlock);
-    return (NULL);
+/* tasks are not aggregated from the lock-free deque */
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{   /*{{{*/
+    return 0;
 } /*}}}*/
 
 void INTERNAL qthread_steal_enable()
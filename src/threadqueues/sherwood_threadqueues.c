@@ -16,6 +16,7 @@
 #include "qt_visibility.h"
 #include "qthread_innards.h"           /* for qlib */
 #include "qt_shepherd_innards.h"
+#include "qt_victims.h"
 #include "qt_qthread_struct.h"
 #include "qt_qthread_mgmt.h"
 #include "qt_asserts.h"
@@ -28,6 +29,9 @@
 #endif /* QTHREAD_USE_EUREKAS */
 #include "qt_expect.h"
 #include "qt_subsystems.h"
+#include "qt_parking.h"
+#include "qt_aggregation.h"
+#include "qt_touch.h"
 
 /* Data Structures */
 struct _qt_threadqueue_node {
@@ -37,6 +41,14 @@ struct _qt_threadqueue_node {
     qthread_t                   *value;
 } /* qt_threadqueue_node_t */;
 
+/* A priority band above band 0 (see QTHREAD_SPAWN_PRIORITY()) */
+typedef struct {
+    qt_threadqueue_node_t *head;
+    qt_threadqueue_node_t *tail;
+    long                   qlength;
+    long                   qlength_stealable;
+} qt_threadqueue_band_t;
+
 struct _qt_threadqueue {
     qt_threadqueue_node_t *head;
     qt_threadqueue_node_t *tail;
@@ -49,10 +61,22 @@ struct _qt_threadqueue {
 #endif
 
     QTHREAD_TRYLOCK_TYPE qlock;
+    qt_parking_lot_t     lot;
+
+    /* Priority bands 1 .. priority_bands-1 (band 0 is the queue above); all
+     * are protected by qlock. The prio_* fields total the bands, and aging
+     * counts consecutive picks from a band while a lower band was waiting. */
+    long                  prio_qlength;
+    long                  prio_qlength_stealable;
+    long                  qlength_bound; /* the stealable tasks, in any band, bound to their node */
+    unsigned long         aging;
+    qt_threadqueue_band_t band[QTHREAD_PRIORITY_BANDS_MAX - 1];
 } /* qt_threadqueue_t */;
 
-static aligned_t steal_disable   = 0;
-static long      steal_chunksize = 0;
+static aligned_t    steal_disable   = 0;
+static long         steal_chunksize = 0;
+static unsigned int priority_bands  = 1;
+static unsigned long priority_aging = 0;
 
 #ifdef STEAL_PROFILE
 # define STEAL_CALLED(shep)     qthread_incr( & ((shep)->steal_called), 1)
@@ -72,21 +96,12 @@ static long      steal_chunksize = 0;
 
 // Forward declarations
 qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_steal(qt_threadqueue_t *h,
-                                                             qt_threadqueue_t *v);
+                                                             qt_threadqueue_t *v,
+                                                             int               thief_node);
 
 void INTERNAL qt_threadqueue_enqueue_multiple(qt_threadqueue_t      *q,
                                               qt_threadqueue_node_t *first);
 
-qthread_t INTERNAL *qt_init_agg_task(void);
-int INTERNAL        qt_keep_adding_agg_task(qthread_t *agg_task,
-                                            int        max_t,
-                                            int       *curr_cost,
-                                            void      *q,
-                                            int        lock);
-void INTERNAL qt_add_first_agg_task(qthread_t             *agg_task,
-                                    int                   *curr_cost,
-                                    qt_threadqueue_node_t *node);
-
 #if defined(AKP_DEBUG) && AKP_DEBUG
 /* function added to ease debugging and tuning around queue critical sections - 4/1/11 AKP */
 
@@ -105,44 +120,27 @@ void qt_spin_exclusive_unlock(qt_spin_exclusive_t *l)
 /* end of added functions - AKP */
 #endif /* if AKP_DEBUG */
 
-/*FIXME: Cannot use pools for allcations of variable size */
-#define ALLOC_EXTRA(size) qt_malloc(size)
-#define FREE_EXTRA(t)     qt_free(t)
-#define DIV_FACTOR  4
-#define MAX_ABS_AGG 64
-static void      **agged_tasks_arg = NULL;
-static void      **agged_tasks_ret = NULL;
-static qthread_f **agged_tasks_f   = NULL;
-
-static void init_agged_tasks(void)
-{
-    int                i;
-    const unsigned int total_num_workers = qthread_readstate(TOTAL_WORKERS);
-
-    agged_tasks_arg = (void **)ALLOC_EXTRA(total_num_workers * sizeof(void *) * 3);
-    agged_tasks_ret = agged_tasks_arg + total_num_workers;
-    agged_tasks_f   = (qthread_f **)(agged_tasks_ret + total_num_workers);
-
-    int   dim_per_worker = (sizeof(void *) * 2 + sizeof(qthread_f)) * MAX_ABS_AGG + sizeof(int);
-    char *total_mem      = ALLOC_EXTRA(dim_per_worker * total_num_workers);
-    for(i = 0; i < total_num_workers; i++) {
-        agged_tasks_arg[i] = (void *)(total_mem + dim_per_worker * i);
-        agged_tasks_ret[i] = (void *)(total_mem + dim_per_worker * i + MAX_ABS_AGG * sizeof(void *));
-        agged_tasks_f[i]   = (void *)(total_mem + dim_per_worker * i + 2 * MAX_ABS_AGG * sizeof(void *));
+static void qt_threadqueue_priority_init(void)
+{   /*{{{*/
+    priority_bands = qt_internal_get_env_num("PRIORITY_BANDS", 4, 1);
+    if (priority_bands > QTHREAD_PRIORITY_BANDS_MAX) {
+        priority_bands = QTHREAD_PRIORITY_BANDS_MAX;
     }
-}
+    priority_aging = qt_internal_get_env_num("PRIORITY_AGING", 16, 0); /* 0: no aging */
+} /*}}}*/
 
-static void free_agged_tasks(void)
-{
-    FREE_EXTRA(agged_tasks_arg[0]);
-    FREE_EXTRA(agged_tasks_arg);
-}
+/* Does node count in qlength_bound? */
+static QINLINE long qt_threadqueue_isbound(const qt_threadqueue_node_t *node)
+{   /*{{{*/
+    return (node->stealable && (node->value->flags & QTHREAD_NODE_BOUND)) ? 1 : 0;
+} /*}}}*/
 
 #ifdef QTHREAD_PARANOIA
 static inline void sanity_check_queue(qt_threadqueue_t *q)
 {
     qt_threadqueue_node_t *cursor          = q->head;
     size_t                 count_stealable = 0, count_total = 0;
+    long                   count_bound     = 0;
 
     assert((q->head == NULL) || q->qlength);
     assert(q->qlength_stealable <= q->qlength);
@@ -151,10 +149,17 @@ static inline void sanity_check_queue(qt_threadqueue_t *q)
     while (cursor) {
         count_total++;
         count_stealable += cursor->stealable;
+        count_bound     += qt_threadqueue_isbound(cursor);
         cursor           = cursor->next;
     }
     assert(count_total == q->qlength);
     assert(count_stealable == q->qlength_stealable);
+    for (unsigned int b = 0; b < QTHREAD_PRIORITY_BANDS_MAX - 1; b++) {
+        for (cursor = q->band[b].head; cursor; cursor = cursor->next) {
+            count_bound += qt_threadqueue_isbound(cursor);
+        }
+    }
+    assert(count_bound == q->qlength_bound);
 }
 
 # define PARANOIA_ONLY(x) x
@@ -169,14 +174,12 @@ static inline void sanity_check_queue(qt_threadqueue_t *q)
 # define ALLOC_TQNODE()      (qt_threadqueue_node_t *)MALLOC(sizeof(qt_threadqueue_node_t))
 # define FREE_TQNODE(t)      FREE(t, sizeof(qt_threadqueue_node_t))
 static void qt_threadqueue_subsystem_shutdown(void)
-{
-    free_agged_tasks();
-}
+{}
 
 void INTERNAL qt_threadqueue_subsystem_init(void)
 {
-    init_agged_tasks();
     steal_chunksize = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
+    qt_threadqueue_priority_init();
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 }
 
@@ -196,17 +199,16 @@ static void qt_threadqueue_subsystem_shutdown(void)
 {   /*{{{*/
     qt_mpool_destroy(generic_threadqueue_pools.nodes);
     qt_mpool_destroy(generic_threadqueue_pools.queues);
-    free_agged_tasks();
 } /*}}}*/
 
 void INTERNAL qt_threadqueue_subsystem_init(void)
 {   /*{{{*/
-    init_agged_tasks();
     generic_threadqueue_pools.queues = qt_mpool_create_aligned(sizeof(qt_threadqueue_t),
                                                                qthread_cacheline());
     generic_threadqueue_pools.nodes = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t),
                                                               qthread_cacheline());
     steal_chunksize = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
+    qt_threadqueue_priority_init();
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 } /*}}}*/
 #endif /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
@@ -218,13 +220,13 @@ ssize_t INTERNAL qt_threadqueue_advisory_queuelen(qt_threadqueue_t *q)
     (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || \
     (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64))
     /* only works if a basic load is atomic */
-    return q->qlength;
+    return q->qlength + q->prio_qlength;
 
 #else
     ssize_t tmp;
     QTHREAD_TRYLOCK_LOCK(&q->qlock);
     PARANOIA_ONLY(sanity_check_queue(q));
-    tmp = q->qlength;
+    tmp = q->qlength + q->prio_qlength;
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
     return tmp;
 #endif /* if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64)) */
@@ -246,22 +248,36 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
         q->qlength           = 0;
         q->qlength_stealable = 0;
         QTHREAD_TRYLOCK_INIT(q->qlock);
+        qt_parking_init(&q->lot);
+        q->prio_qlength           = 0;
+        q->prio_qlength_stealable = 0;
+        q->qlength_bound          = 0;
+        q->aging                  = 0;
+        for (unsigned int b = 0; b < QTHREAD_PRIORITY_BANDS_MAX - 1; b++) {
+            q->band[b].head              = NULL;
+            q->band[b].tail              = NULL;
+            q->band[b].qlength           = 0;
+            q->band[b].qlength_stealable = 0;
+        }
     }
 
     return q;
 } /*}}}*/
 
-#if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED)
-# define ALLOC_QTHREAD() MALLOC(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
-# define FREE_QTHREAD(t) FREE(t, sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
-#else /* if defined(UNPOOLED_QTHREAD_T) ||./src/threadqueues/nemesis_threadqueues.c defined(UNPOOLED) */
-extern qt_mpool generic_qthread_pool;
-# define ALLOC_QTHREAD() (qthread_t *)qt_mpool_alloc(generic_qthread_pool)
-# define FREE_QTHREAD(t) qt_mpool_free(generic_qthread_pool, t)
-#endif /* if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED) */
+/* tasks left in a queue come in any qthread_t size class */
+#define FREE_QTHREAD(t) qthread_thread_free(t)
 
 void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
 {   /*{{{*/
+    for (unsigned int b = 0; b < QTHREAD_PRIORITY_BANDS_MAX - 1; b++) {
+        qt_threadqueue_node_t *node = q->band[b].head;
+        while (node != NULL) {
+            qt_threadqueue_node_t *next = node->next;
+            FREE_QTHREAD(node->value);
+            FREE_TQNODE(node);
+            node = next;
+        }
+    }
     if (q->head != q->tail) {
         qthread_t *t;
         QTHREAD_TRYLOCK_LOCK(&q->qlock);
@@ -284,10 +300,12 @@ void INTERNAL qt_threadqueue_free(qt_threadqueue_t *q)
         assert(q->tail == NULL);
         q->qlength           = 0;
         q->qlength_stealable = 0;
+        q->qlength_bound     = 0;
         QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
     }
     assert(q->head == q->tail);
     QTHREAD_TRYLOCK_DESTROY(q->qlock);
+    qt_parking_destroy(&q->lot);
     FREE_THREADQUEUE(q);
 } /*}}}*/
 
@@ -296,6 +314,192 @@ static QINLINE int qt_threadqueue_isstealable(qthread_t *t)
     return ((t->flags & QTHREAD_UNSTEALABLE) == 0) ? 1 : 0;
 } /*}}}*/
 
+/* May a thief on thief_node take node's task? Those spawned with
+ * QTHREAD_SPAWN_NEAR are only stolen from within their target's node. */
+static QINLINE int qt_threadqueue_maysteal(const qt_threadqueue_node_t *node,
+                                           int                          thief_node)
+{   /*{{{*/
+    const qthread_t *t = node->value;
+
+    return node->stealable &&
+           (!(t->flags & QTHREAD_NODE_BOUND) ||
+            (qlib->shepherds[t->target_shepherd].mem_node == thief_node));
+} /*}}}*/
+
+/* The band t is queued in; priorities beyond QT_PRIORITY_BANDS share the
+ * top band. Band 0 is the queue proper. */
+static QINLINE unsigned int qt_threadqueue_band(const qthread_t *t)
+{   /*{{{*/
+    return (t->priority < priority_bands) ? t->priority : (priority_bands - 1);
+} /*}}}*/
+
+/* Add node to band b (> 0) at the tail, or at the head if it yielded; the
+ * first such node after the bands drained starts aging afresh. Caller holds
+ * q->qlock. */
+static QINLINE void qt_threadqueue_band_push(qt_threadqueue_t      *q,
+                                             unsigned int           b,
+                                             qt_threadqueue_node_t *node,
+                                             int                    yielded)
+{   /*{{{*/
+    qt_threadqueue_band_t *band = &q->band[b - 1];
+
+    if (q->prio_qlength == 0) {
+        q->aging = 0;
+    }
+    if (yielded) {
+        node->prev = NULL;
+        node->next = band->head;
+        band->head = node;
+        if (band->tail == NULL) {
+            band->tail = node;
+        } else {
+            node->next->prev = node;
+        }
+    } else {
+        node->next = NULL;
+        node->prev = band->tail;
+        band->tail = node;
+        if (band->head == NULL) {
+            band->head = node;
+        } else {
+            node->prev->next = node;
+        }
+    }
+    band->qlength++;
+    band->qlength_stealable += node->stealable;
+    q->prio_qlength++;
+    q->prio_qlength_stealable += node->stealable;
+    q->qlength_bound          += qt_threadqueue_isbound(node);
+} /*}}}*/
+
+/* Remove node from band b (> 0). Caller holds q->qlock. */
+static QINLINE void qt_threadqueue_band_unlink(qt_threadqueue_t      *q,
+                                               unsigned int           b,
+                                               qt_threadqueue_node_t *node)
+{   /*{{{*/
+    qt_threadqueue_band_t *band = &q->band[b - 1];
+
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        band->head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        band->tail = node->prev;
+    }
+    node->next = node->prev = NULL;
+    band->qlength--;
+    band->qlength_stealable -= node->stealable;
+    q->prio_qlength--;
+    q->prio_qlength_stealable -= node->stealable;
+    q->qlength_bound          -= qt_threadqueue_isbound(node);
+} /*}}}*/
+
+/* Pick the next local task when any band above 0 is occupied: normally the
+ * newest task of the highest occupied band, but once priority_aging picks
+ * in a row have passed over a lower band, the lowest waiting band gets a
+ * turn instead (unless aging is disabled). Returns NULL when band 0 should
+ * be served. */
+static qt_threadqueue_node_t *qt_threadqueue_dequeue_band(qt_threadqueue_t         *q,
+                                                          qt_threadqueue_private_t *qc)
+{   /*{{{*/
+    qt_threadqueue_node_t *node = NULL;
+    unsigned int           top  = 0;
+    unsigned int           low  = priority_bands;
+    unsigned int           pick;
+
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    if (q->head || (qc && qc->on_deck)) {
+        low = 0;
+    }
+    for (unsigned int b = 1; b < priority_bands; b++) {
+        if (q->band[b - 1].tail != NULL) {
+            top = b;
+            if (low > b) { low = b; }
+        }
+    }
+    pick = top;
+    if ((low < top) && (priority_aging > 0)) {
+        if (++q->aging >= priority_aging) {
+            q->aging = 0;
+            pick     = low;
+        }
+    } else {
+        q->aging = 0;
+    }
+    if (pick > 0) {
+        node = q->band[pick - 1].tail;
+        qt_threadqueue_band_unlink(q, pick, node);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    return node;
+} /*}}}*/
+
+/* Steal one task from the highest band of v that has a stealable one;
+ * priority work is handed out a task at a time so it spreads across
+ * thieves. */
+static qt_threadqueue_node_t *qt_threadqueue_dequeue_steal_band(qt_threadqueue_t *v,
+                                                                int               thief_node)
+{   /*{{{*/
+    qt_threadqueue_node_t *node = NULL;
+
+    if (!QTHREAD_TRYLOCK_TRY(&v->qlock)) {
+        return NULL;
+    }
+    for (unsigned int b = priority_bands - 1; b > 0 && node == NULL; b--) {
+        if (v->band[b - 1].qlength_stealable == 0) { continue; }
+        for (node = v->band[b - 1].head; node != NULL; node = node->next) {
+            if (qt_threadqueue_maysteal(node, thief_node)) {
+                qt_threadqueue_band_unlink(v, b, node);
+                break;
+            }
+        }
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&v->qlock);
+    return node;
+} /*}}}*/
+
+/* Wake an idle worker to run work just added to q: one parked on q, or
+ * failing that the nearest parked thief. The McCoy thread may only run on
+ * worker 0, so for it everyone on q is woken. */
+static QINLINE void qt_threadqueue_wake(qt_threadqueue_t *q,
+                                        const qthread_t  *t)
+{   /*{{{*/
+    if (t && (t->flags & QTHREAD_REAL_MCCOY)) {
+        (void)qt_park_notify(&q->lot, 1);
+    } else {
+        qt_park_notify_stealable(&q->lot, offsetof(qt_threadqueue_t, lot));
+    }
+} /*}}}*/
+
+/* Is there anything this worker could run, here or (as a thief) elsewhere?
+ * Tasks bound to another node are not its to steal. */
+static int qt_threadqueue_has_work(qt_threadqueue_t         *q,
+                                   qt_threadqueue_private_t *qc,
+                                   uint_fast8_t              active,
+                                   int                       node)
+{   /*{{{*/
+    if (q->head || q->prio_qlength || (qc && qc->on_deck)) {
+        return 1;
+    }
+    if (active && (qlib->nshepherds > 1) && !steal_disable) {
+        for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+            const qt_threadqueue_t *v = qlib->shepherds[i].ready;
+            long                    n = v->qlength_stealable + v->prio_qlength_stealable;
+
+            if (qlib->shepherds[i].mem_node != node) {
+                n -= v->qlength_bound;
+            }
+            if (n > 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+} /*}}}*/
+
 /* enqueue at tail */
 void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
                                      qthread_t *restrict        t)
@@ -313,6 +517,12 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
 
     QTHREAD_TRYLOCK_LOCK(&q->qlock);
     PARANOIA_ONLY(sanity_check_queue(q));
+    if (t->priority && (priority_bands > 1)) {
+        qt_threadqueue_band_push(q, qt_threadqueue_band(t), node, 0);
+        QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+        qt_threadqueue_wake(q, t);
+        return;
+    }
     node->next = NULL;
     node->prev = q->tail;
     q->tail    = node;
@@ -323,7 +533,74 @@ void INTERNAL qt_threadqueue_enqueue(qt_threadqueue_t *restrict q,
     }
     q->qlength++;
     q->qlength_stealable += node->stealable;
+    q->qlength_bound     += qt_threadqueue_isbound(node);
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    qt_threadqueue_wake(q, t);
+} /*}}}*/
+
+/* enqueue n tasks at tail, taking the lock once */
+void INTERNAL qt_threadqueue_enqueue_bulk(qt_threadqueue_t *restrict q,
+                                          qthread_t *const          *t,
+                                          size_t                     n)
+{   /*{{{*/
+    qt_threadqueue_node_t *first = NULL, *last = NULL, *prio = NULL;
+    size_t                 qlength = 0, qlength_stealable = 0, qlength_bound = 0;
+
+    assert(q != NULL);
+    assert(t != NULL);
+
+    /* build the chain before taking the lock */
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_node_t *node = ALLOC_TQNODE();
+
+        assert(node != NULL);
+        node->value     = t[i];
+        node->stealable = qt_threadqueue_isstealable(t[i]);
+        if (t[i]->priority && (priority_bands > 1)) {
+            node->next = prio;
+            prio       = node;
+            continue;
+        }
+        node->next = NULL;
+        node->prev = last;
+        if (last == NULL) {
+            first = node;
+        } else {
+            last->next = node;
+        }
+        last = node;
+        qlength++;
+        qlength_stealable += node->stealable;
+        qlength_bound     += qt_threadqueue_isbound(node);
+    }
+
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    PARANOIA_ONLY(sanity_check_queue(q));
+    while (prio) {
+        qt_threadqueue_node_t *next = prio->next;
+
+        qt_threadqueue_band_push(q, qt_threadqueue_band(prio->value), prio, 0);
+        prio = next;
+    }
+    if (first) {
+        first->prev = q->tail;
+        q->tail     = last;
+        if (q->head == NULL) {
+            q->head = first;
+        } else {
+            first->prev->next = first;
+        }
+        q->qlength           += qlength;
+        q->qlength_stealable += qlength_stealable;
+        q->qlength_bound     += qlength_bound;
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    /* one worker per task, for as long as there are any to wake (the tasks
+     * may be running, or done, already; none of them is the McCoy thread) */
+    for (size_t i = 0; i < n; i++) {
+        qt_threadqueue_wake(q, NULL);
+        if (qt_parked_workers == 0) { break; }
+    }
 } /*}}}*/
 
 #ifdef QTHREAD_USE_SPAWNCACHE
@@ -335,6 +612,7 @@ int INTERNAL qt_threadqueue_private_enqueue(qt_threadqueue_private_t *restrict c
            ((c->head == c->tail && c->qlength < 2) ||
             (c->head != NULL && c->tail != NULL && c->qlength > 1)));
     assert(t != NULL);
+    assert(!(t->flags & QTHREAD_NODE_BOUND)); /* see qlength_bound */
 
     qt_threadqueue_node_t *node;
 
@@ -406,6 +684,9 @@ int INTERNAL qt_threadqueue_private_enqueue_yielded(qt_threadqueue_private_t *re
 
     qt_threadqueue_node_t *node;
 
+    /* caches are not counted in qlength_bound; the queue proper takes it */
+    if (t->flags & QTHREAD_NODE_BOUND) { return 0; }
+
     node = ALLOC_TQNODE();
     assert(node != NULL);
 
@@ -452,6 +733,12 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
 
     QTHREAD_TRYLOCK_LOCK(&q->qlock);
     PARANOIA_ONLY(sanity_check_queue(q));
+    if (t->priority && (priority_bands > 1)) {
+        qt_threadqueue_band_push(q, qt_threadqueue_band(t), node, 1);
+        QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+        qt_threadqueue_wake(q, t);
+        return;
+    }
     node->prev = NULL;
     node->next = q->head;
     q->head    = node;
@@ -462,236 +749,11 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
     }
     q->qlength++;
     if (node->stealable) { q->qlength_stealable++; }
+    q->qlength_bound += qt_threadqueue_isbound(node);
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    qt_threadqueue_wake(q, t);
 } /*}}}*/
 
-#define QTHREAD_TASK_IS_AGGREGABLE(f) (0 &&                                                \
-                                       (f &QTHREAD_SIMPLE) && !(f &QTHREAD_HAS_ARGCOPY) && \
-                                       !(f &QTHREAD_BIG_STRUCT) &&                         \
-                                       !(f &QTHREAD_FUTURE) && !(f &QTHREAD_REAL_MCCOY) && \
-                                       !(f &QTHREAD_AGGREGATED))
-// && (f & QTHREAD_AGGREGABLE) \
-//               )
-// (f & QTHREAD_AGGREGABLE)
-
-qthread_t INTERNAL *qt_init_agg_task() // partly a duplicate from qthread.c
-{
-    qthread_t *t = ALLOC_QTHREAD();
-
-#ifdef QTHREAD_NONLAZY_THREADIDS
-    /* give the thread an ID number */
-    t->thread_id =
-        qthread_internal_incr(&(qlib->max_thread_id),
-                              &qlib->max_thread_id_lock, 1);
-    if (QTHREAD_UNLIKELY(t->thread_id == QTHREAD_NULL_TASK_ID)) {
-        /* yes, this is wrapping around, but... thread_id should be prevented from being NULL */
-        t->thread_id = qthread_internal_incr(&(qlib->max_thread_id),
-                                             &qlib->max_thread_id_lock, 2);
-    } else if (QTHREAD_UNLIKELY(t->thread_id == QTHREAD_NON_TASK_ID)) {
-        /* yes, this is wrapping around, but... thread_id should be prevented from being NON */
-        t->thread_id = qthread_internal_incr(&(qlib->max_thread_id),
-                                             &qlib->max_thread_id_lock, 1);
-    }
-#else /* ifdef QTHREAD_NONLAZY_THREADIDS */
-    t->thread_id = QTHREAD_NON_TASK_ID;
-#endif /* ifdef QTHREAD_NONLAZY_THREADIDS */
-
-    t->thread_state    = QTHREAD_STATE_NEW;
-    t->flags           = 0;
-    t->target_shepherd = NO_SHEPHERD;
-    t->team            = NULL;
-    t->f               = (qthread_f)qlib->agg_f; // changed function pointer type!!!
-    t->arg             = NULL;                   // set later
-    t->ret             = 0;
-    t->rdata           = NULL;
-    t->preconds        = NULL;  // use for list of f and arg
-    t->flags &= ~QTHREAD_HAS_ARGCOPY;
-    t->flags |= QTHREAD_SIMPLE; // will remain a simple task if all tasks it batches are simple.
-    t->flags |= QTHREAD_AGGREGATED;
-
-    int loc_id = qthread_worker(NULL);
-    t->arg      = agged_tasks_arg[loc_id];
-    t->ret      = agged_tasks_ret[loc_id];
-    t->preconds = agged_tasks_f[loc_id];
-    return t;
-}
-
-int INTERNAL qt_keep_adding_agg_task(qthread_t *agg_task,
-                                     int        max_t,
-                                     int       *curr_cost,
-                                     void      *q,
-                                     int        lock)
-{
-    qt_threadqueue_node_t *node         = NULL;
-    qthread_t             *t            = NULL;
-    int                    count        = ((int *)agg_task->preconds)[0];
-    qthread_f             *list_of_f    /*= (qthread_f *)(&(((int *)agg_task->preconds)[1]))*/;
-    void                 **list_of_farg /*= (void **)agg_task->arg*/;
-    void                 **list_of_fret /*= (void **)agg_task->ret*/;
-    int                    local_cost   = *curr_cost;
-    // never getting more than what was initially allocated!
-
-    qt_threadqueue_node_t **head_addr, *head_l = NULL;
-    qt_threadqueue_node_t **tail_addr, *tail_l = NULL;
-    long                   *length, *stealable, len_l = 0, ste_l = 0;
-
-    if(lock) {
-        qt_threadqueue_t *public_q = (qt_threadqueue_t *)q;
-        head_addr = &(public_q->head);
-        tail_addr = &(public_q->tail);
-        length    = &(public_q->qlength);
-        assert(*length > 0);
-        stealable = &(public_q->qlength_stealable);
-        int stop_adding = 0;
-        if(count > 0) {
-            int local_max_t = (count + *length) / qthread_readstate(TOTAL_WORKERS) / DIV_FACTOR;
-            local_max_t = (local_max_t > MAX_ABS_AGG ? MAX_ABS_AGG : local_max_t);
-            if(local_max_t < max_t) {
-                max_t = local_max_t;
-            }
-            if(max_t <= count) {
-                stop_adding = 1;
-            }
-        }
-
-        if(!stop_adding) { // keep some tasks
-            head_l = *head_addr;
-            tail_l = *tail_addr;
-            if(tail_l != NULL) {
-                int max_allowed = max_t - count;
-                while((len_l < max_allowed) && QTHREAD_TASK_IS_AGGREGABLE(tail_l->value->flags) && tail_l != head_l) {
-                    len_l++;
-                    if (tail_l->stealable) { ste_l++; }
-                    tail_l = tail_l->prev;
-                }
-            }
-
-            if(tail_l == *tail_addr) { // didn't keep anything
-                assert(len_l == 0 && ste_l == 0);
-                head_l = NULL;
-                tail_l = NULL;
-            } else if(head_l == tail_l) { // kept eveything
-                head_l     = *head_addr;
-                tail_l     = *tail_addr;
-                *head_addr = *tail_addr = NULL; // empty q
-                *length    = *stealable = 0;
-            } else {   // tail_l is the new q tail, = first task which should remain there
-                       // interchange tail_l and real tail using head_l as tmp
-                head_l     = tail_l;
-                tail_l     = *tail_addr;
-                *tail_addr = head_l;
-                // break links
-                head_l             = (*tail_addr)->next;
-                head_l->prev       = NULL;
-                (*tail_addr)->next = NULL;
-                *length           -= len_l;
-                assert(*length > 0);
-                *stealable -= ste_l;
-            }
-        }
-        QTHREAD_TRYLOCK_UNLOCK(&public_q->qlock);
-        // work on locally grabbed q from now on
-        head_addr = &head_l;
-        tail_addr = &tail_l;
-        length    = &len_l;
-        stealable = &ste_l;
-    } else {
-        qt_threadqueue_private_t *private_q = (qt_threadqueue_private_t *)q;
-        head_addr = &(private_q->head);
-        tail_addr = &(private_q->tail);
-        length    = &(private_q->qlength);
-        stealable = &(private_q->qlength_stealable);
-    }
-
-    while(*head_addr != NULL) {
-        node = *tail_addr;
-        t    = node->value;
-        if(!QTHREAD_TASK_IS_AGGREGABLE(t->flags)) {
-            // printf("Found non-agg task, stopping\n");
-            break;
-        }
-
-        if((t->flags & QTHREAD_RET_MASK) != (agg_task->flags & QTHREAD_RET_MASK)) {
-            // printf("Found task with different return value, stopping\n");
-            break;
-        }
-
-        list_of_f[count]    = t->f;
-        list_of_farg[count] = t->arg;
-        local_cost          = (qlib->agg_cost)(count, list_of_f, list_of_farg);
-        if(local_cost < qlib->max_c) {
-            // cost ok => remove task from q;
-            *tail_addr = node->prev;
-            if (*tail_addr == NULL) {
-                *head_addr = NULL;
-            } else {
-                (*tail_addr)->next = NULL;
-            }
-            *length = *length - 1;
-            assert(*length >= 0);
-            if (node->stealable) { *stealable = *stealable - 1; }
-            // update the other info
-            list_of_fret[count] = t->ret;
-            count++;
-            assert(node->value->rdata == NULL);
-            qthread_thread_free(t);
-            FREE_TQNODE(node);
-        } else {
-            break;
-        }
-        if(count + 1 > max_t) {
-            // printf("Have enough tasks agg-ed(%d), stopping\n", count);
-            break;
-        }
-    }
-
-    *curr_cost                     = local_cost;
-    ((int *)agg_task->preconds)[0] = count;
-
-    if(lock) {
-        qt_threadqueue_t *public_q = (qt_threadqueue_t *)q;
-        QTHREAD_TRYLOCK_LOCK(&public_q->qlock);
-        if(head_l != NULL) { // need to put tasks back into q
-            tail_addr = &(public_q->tail);
-            if(*tail_addr == NULL) {
-                *tail_addr = tail_l;
-                assert(public_q->head == NULL);
-                public_q->head = head_l;
-            } else {
-                (*tail_addr)->next = head_l;
-                head_l->prev       = (*tail_addr);
-                (*tail_addr)       = tail_l;
-            }
-            assert(public_q->qlength >= 0);
-            public_q->qlength += len_l;
-            assert(public_q->qlength > 0);
-            public_q->qlength_stealable += ste_l;
-        }
-    }
-    return count;
-}
-
-void INTERNAL qt_add_first_agg_task(qthread_t             *agg_task,
-                                    int                   *curr_cost,
-                                    qt_threadqueue_node_t *node)
-{
-    int       *count_addr = &(((int *)agg_task->preconds)[0]);
-    qthread_f *list_of_f  = (qthread_f *)(&(((int *)agg_task->preconds)[1]));
-
-    *count_addr                   = 1;
-    list_of_f[0]                  = node->value->f;
-    ((void **)(agg_task->arg))[0] = node->value->arg;
-    ((void **)(agg_task->ret))[0] = node->value->ret;
-    // First task added defines the type of ret accepted inside this agg task
-    agg_task->flags |= ((node->value->flags & QTHREAD_RET_IS_SINC) |      \
-                        (node->value->flags & QTHREAD_RET_IS_VOID_SINC) | \
-                        (node->value->flags & QTHREAD_RET_IS_SYNCVAR));
-    assert(node->value->rdata == NULL);
-    qthread_thread_free(node->value);
-    FREE_TQNODE(node);
-    *curr_cost = (qlib->agg_cost)(1, list_of_f, (void **)agg_task->arg);
-}
-
 /* dequeue at tail */
 qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
 #ifdef QTHREAD_LOCAL_PRIORITY
@@ -703,24 +765,18 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
     qthread_shepherd_t *my_shepherd = qthread_internal_getshep();
     qthread_t          *t;
     qthread_worker_id_t worker_id = NO_WORKER;
-    int                 curr_cost, max_t, ret_agg_task;
+    unsigned long       spins = 0;
 
     assert(q != NULL);
     assert(my_shepherd);
     assert(my_shepherd->ready == q);
     assert(my_shepherd->sorted_sheplist);
-#ifdef QTHREAD_TASK_AGGREGATION
-    t = qt_init_agg_task();
-#endif
 
 #ifdef QTHREAD_USE_EUREKAS
     qt_eureka_disable();
 #endif /* QTHREAD_USE_EUREKAS */
     while (1) {
         qt_threadqueue_node_t *node = NULL;
-#ifdef QTHREAD_TASK_AGGREGATION
-        curr_cost = 0; ret_agg_task = 0;
-#endif
 
 #ifdef QTHREAD_LOCAL_PRIORITY
             /* First check local priority queue */
@@ -741,6 +797,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                 assert(lpq->qlength > 0);
                 lpq->qlength--;
                 lpq->qlength_stealable -= node->stealable;
+                lpq->qlength_bound     -= qt_threadqueue_isbound(node);
             }
             QTHREAD_TRYLOCK_UNLOCK(&lpq->qlock);
         }
@@ -748,39 +805,15 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
 #endif /* ifdef QTHREAD_LOCAL_PRIORITY */
 
         // printf("Total number of items: %d+%d\n", (qc?(qc->on_deck?(1+qc->qlength):0):0), q->qlength);
-        if (qc && (qc->on_deck != NULL)) {
+        if ((q->prio_qlength > 0) && ((node = qt_threadqueue_dequeue_band(q, qc)) != NULL)) {
+            /* a priority band won the pick; band 0 waits its turn */
+        } else if (qc && (qc->on_deck != NULL)) {
             assert(qc->tail == NULL || qc->tail->next == NULL);
             assert(qc->head == NULL || qc->head->prev == NULL);
             node        = qc->on_deck;
             qc->on_deck = NULL;
             assert(node->next == NULL);
             assert(node->prev == NULL);
-#ifdef QTHREAD_TASK_AGGREGATION
-            if(QTHREAD_TASK_IS_AGGREGABLE(node->value->flags) && \
-               ((max_t = (qc->qlength + 1 + q->qlength) / qthread_readstate(ACTIVE_WORKERS) / DIV_FACTOR) > 1)
-               ) {
-                max_t = (max_t > MAX_ABS_AGG ? MAX_ABS_AGG : max_t);
-                assert(node->value->thread_state != QTHREAD_STATE_TERM_SHEP);
-                qt_add_first_agg_task(t, &curr_cost, node);
-                node = NULL;
-
-                int *count_addr = &(((int *)t->preconds)[0]);
-                int  lcount     = qt_keep_adding_agg_task(t, max_t, &curr_cost, qc, 0);
-                if((qc->qlength == 0) && ((curr_cost < qlib->max_c) && (*count_addr < max_t))) {
-                    // cache empty and can still add, get more from q
-                    QTHREAD_TRYLOCK_LOCK(&q->qlock);
-                    if(q->head) {
-                        lcount = qt_keep_adding_agg_task(t, max_t, &curr_cost, q, 1);
-                    }
-                    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
-                } else {   // done, spill remaining cache
-                }
-                ret_agg_task = 1;
-            } else {   // no agg, spill cache
-                       // t = NULL;
-            }
-#endif      /* ifdef QTHREAD_TASK_AGGREGATION */
-
             qthread_debug(THREADQUEUE_DETAILS, "q(%p), qc(%p), active(%u): qc->qlen(%u) Push remaining items onto the real queue\n", q, qc, active, qc->qlength);
 
             if (qc->qlength > 0) {
@@ -839,6 +872,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                 QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
                 qc->head    = qc->tail = NULL;
                 qc->qlength = qc->qlength_stealable = 0;
+                qt_threadqueue_wake(q, NULL);
 #endif          /* if 0 */
             }
         } else if (q->head) {
@@ -858,32 +892,11 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                 assert(q->qlength > 0);
                 q->qlength--;
                 q->qlength_stealable -= node->stealable;
-#ifdef QTHREAD_TASK_AGGREGATION
-                if(QTHREAD_TASK_IS_AGGREGABLE(node->value->flags) && \
-                   ((max_t = (q->qlength) / qthread_readstate(ACTIVE_WORKERS) / DIV_FACTOR) > 1)
-                   ) { // no point creating an agg task with a single simple task
-                    max_t = (max_t > MAX_ABS_AGG ? MAX_ABS_AGG : max_t);
-                    assert(node->value->thread_state != QTHREAD_STATE_TERM_SHEP);
-                    qt_add_first_agg_task(t, &curr_cost, node);
-                    node = NULL;
-                    if(q->head) {
-                        int lcount = qt_keep_adding_agg_task(t, max_t, &curr_cost, q, 1);
-                    }
-                    ret_agg_task = 1;
-                } else {   // no agg, free agg task (delay)
-                           // t = NULL;
-                }
-#endif          /* ifdef QTHREAD_TASK_AGGREGATION */
+                q->qlength_bound     -= qt_threadqueue_isbound(node);
             }
             QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
         }
 
-#ifdef QTHREAD_TASK_AGGREGATION
-        if(ret_agg_task) { // use t, node is NULL
-            break;
-        }
-#endif
-
         if ((node == NULL) && my_shepherd->stealing) {
             if (worker_id == NO_WORKER) {
                 worker_id = qthread_worker(NULL);
@@ -896,20 +909,10 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
             continue;
         }
 
-        if ((node == NULL) && (active)) {
-            if (qlib->nshepherds > 1) {
-                if (!steal_disable) {
-                    node = qthread_steal(my_shepherd); // TODO: same agg behavior when stealing
-                } else {
-                    while (NULL == q->head) SPINLOCK_BODY();
-                    continue;
-                }
-            }
+        if ((node == NULL) && (active) && (qlib->nshepherds > 1) && !steal_disable) {
+            node = qthread_steal(my_shepherd);
         }
         if (node) {
-#ifdef QTHREAD_TASK_AGGREGATION
-            qthread_thread_free(t); // free agg task; only reallocate it if mccoy found
-#endif
             t = node->value;
             FREE_TQNODE(node);
             if ((t->flags & QTHREAD_REAL_MCCOY)) { // only needs to be on worker 0 for termination
@@ -930,15 +933,30 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
                         my_shepherd->stealing = 2; // no stealing
                         MACHINE_FENCE;
                         qt_threadqueue_enqueue_yielded(q, t);
-#ifdef QTHREAD_TASK_AGGREGATION
-                        t = qt_init_agg_task();
-#endif
                         continue; // keep looking
                 }
             } else {
                 break;
             }
         }
+
+        /* nothing to run: spin for a while, then park until work arrives
+         * (local priority queues have no parking lot, so keep spinning) */
+#ifndef QTHREAD_LOCAL_PRIORITY
+        if (spins++ < qt_park_spincount) {
+            SPINLOCK_BODY();
+        } else {
+            uint32_t key = qt_park_prepare(&q->lot);
+            if (qt_threadqueue_has_work(q, qc, active, my_shepherd->mem_node)) {
+                qt_park_cancel(&q->lot);
+            } else {
+                qt_park_wait(&q->lot, key);
+            }
+            spins = 0;
+        }
+#else
+        SPINLOCK_BODY();
+#endif /* ifndef QTHREAD_LOCAL_PRIORITY */
     }
     return (t);
 } /*}}}*/
@@ -949,13 +967,16 @@ void INTERNAL qt_threadqueue_enqueue_multiple(qt_threadqueue_t      *q,
 {   /*{{{*/
     qt_threadqueue_node_t *last;
     size_t                 addCnt = 1;
+    long                   bound;
 
     assert(first != NULL);
     assert(q != NULL);
 
-    last = first;
+    last  = first;
+    bound = qt_threadqueue_isbound(first);
     while (last->next) {
-        last = last->next;
+        last   = last->next;
+        bound += qt_threadqueue_isbound(last);
         addCnt++;
     }
 
@@ -971,7 +992,9 @@ void INTERNAL qt_threadqueue_enqueue_multiple(qt_threadqueue_t      *q,
     }
     q->qlength           += addCnt;
     q->qlength_stealable += addCnt;
+    q->qlength_bound     += bound;
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+    qt_threadqueue_wake(q, NULL);
 } /*}}}*/
 
 #ifdef QTHREAD_USE_SPAWNCACHE
@@ -1013,12 +1036,14 @@ void INTERNAL qt_threadqueue_enqueue_cache(qt_threadqueue_t         *q,
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
     cache->qlength           = 0;
     cache->qlength_stealable = 0;
+    qt_threadqueue_wake(q, NULL);
 } /*}}}*/
 #endif /* ifdef QTHREAD_USE_SPAWNCACHE */
 
 /* dequeue stolen threads at head, skip yielded threads */
 qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_steal(qt_threadqueue_t *h,
-                                                             qt_threadqueue_t *v)
+                                                             qt_threadqueue_t *v,
+                                                             int               thief_node)
 {                                      /*{{{ */
     qt_threadqueue_node_t *node;
     qt_threadqueue_node_t *first     = NULL;
@@ -1046,7 +1071,7 @@ qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_steal(qt_threadqueue_t *h
         do {
             // Find next stealable node (if one exists)
             while (node) {
-                if (!node->stealable) {
+                if (!qt_threadqueue_maysteal(node, thief_node)) {
                     node = node->next;
                 } else {
                     break;
@@ -1061,11 +1086,12 @@ qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_steal(qt_threadqueue_t *h
                 // Adjust queue length(s)
                 v->qlength--;
                 v->qlength_stealable--;
+                v->qlength_bound -= qt_threadqueue_isbound(node);
 
                 // Find next unstealable node, or amount we want to steal
                 qt_threadqueue_node_t *next_to_steal = last_stolen->next;
                 while (amtStolen < desired_stolen && next_to_steal) {
-                    if (!next_to_steal->stealable) {
+                    if (!qt_threadqueue_maysteal(next_to_steal, thief_node)) {
                         break;
                     } else {
                         last_stolen = next_to_steal;
@@ -1075,6 +1101,7 @@ qt_threadqueue_node_t INTERNAL *qt_threadqueue_dequeue_steal(qt_threadqueue_t *h
                         // Adjust queue length(s)
                         v->qlength--;
                         v->qlength_stealable--;
+                        v->qlength_bound -= qt_threadqueue_isbound(next_to_steal);
 
                         next_to_steal = next_to_steal->next;
                     }
@@ -1146,21 +1173,49 @@ static QINLINE qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief_sh
     }
     STEAL_ELECTED(thief_shepherd);
 
-    qthread_shepherd_id_t        i               = 0;
-    qthread_shepherd_t *const    shepherds       = qlib->shepherds;
-    qthread_shepherd_id_t *const sorted_sheplist = thief_shepherd->sorted_sheplist;
-    assert(sorted_sheplist);
+    qthread_shepherd_t *const shepherds = qlib->shepherds;
+    qt_victim_iter_t          victims;
+    qthread_shepherd_id_t     v;
+    assert(thief_shepherd->sorted_sheplist);
 
     qt_threadqueue_t *myqueue = thief_shepherd->ready;
 
 #ifdef QTHREAD_LOCAL_PRIORITY
     qt_threadqueue_t *mypriorityqueue = thief_shepherd->local_priority_queue;
 #endif /* ifdef QTHREAD_LOCAL_PRIORITY */
+    /* prefer the nearest victim holding stealable priority work */
+    if (priority_bands > 1) {
+        for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds - 1; i++) {
+            v = thief_shepherd->sorted_sheplist[i];
+            if (0 != shepherds[v].ready->prio_qlength_stealable) {
+                STEAL_ATTEMPTED(thief_shepherd);
+                stolen = qt_threadqueue_dequeue_steal_band(shepherds[v].ready, thief_shepherd->mem_node);
+                if (stolen) {
+                    STEAL_SUCCESSFUL(thief_shepherd);
+                    thief_shepherd->stealing = 0;
+                    return stolen;
+                }
+                STEAL_FAILED(thief_shepherd);
+            }
+        }
+    }
+    qt_victim_iter_init(&victims, thief_shepherd, qthread_worker(NULL), 0);
     while (stolen == NULL) {
-        qt_threadqueue_t *victim_queue = shepherds[sorted_sheplist[i]].ready;
-        if (0 != victim_queue->qlength_stealable) {
+        v = qt_victim_next(&victims);
+        if (v == NO_SHEPHERD) {
+            // swept every ring without luck; back off and let the caller decide whether to park
+#ifdef QTHREAD_USE_EUREKAS
+            qt_eureka_check(1);
+#endif /* QTHREAD_USE_EUREKAS */
+#ifdef HAVE_PTHREAD_YIELD
+            pthread_yield();
+#elif defined(HAVE_SCHED_YIELD)
+            sched_yield();
+#endif
+            break;
+        } else if (0 != shepherds[v].ready->qlength_stealable) {
             STEAL_ATTEMPTED(thief_shepherd);
-            stolen = qt_threadqueue_dequeue_steal(myqueue, victim_queue);
+            stolen = qt_threadqueue_dequeue_steal(myqueue, shepherds[v].ready, thief_shepherd->mem_node);
             if (stolen) {
                 qt_threadqueue_node_t *surplus = stolen->next;
                 if (surplus) {
@@ -1180,22 +1235,10 @@ static QINLINE qt_threadqueue_node_t *qthread_steal(qthread_shepherd_t *thief_sh
         }
 #endif /* ifdef QTHREAD_LOCAL_PRIORITY */
        
-        if ((0 < myqueue->qlength) || steal_disable) {  // work at home quit steal attempt
+        if ((0 < myqueue->qlength) || (0 < myqueue->prio_qlength) || steal_disable) {  // work at home quit steal attempt
             break;
         }
 
-        i++;
-        i *= (i < qlib->nshepherds - 1);
-        if (i == 0) {
-#ifdef QTHREAD_USE_EUREKAS
-            qt_eureka_check(1);
-#endif /* QTHREAD_USE_EUREKAS */
-#ifdef HAVE_PTHREAD_YIELD
-            pthread_yield();
-#elif defined(HAVE_SCHED_YIELD)
-            sched_yield();
-#endif
-        }
         SPINLOCK_BODY();
     }
     thief_shepherd->stealing = 0;
@@ -1373,11 +1416,40 @@ void INTERNAL qt_threadqueue_filter(qt_threadqueue_t       *q,
     /* For reference:
      *
      * dequeue (and filtering) starts at the tail and proceeds to follow the prev ptrs until the head is reached.
+     * The priority bands are filtered first, highest band first, the same way.
      */
 
     QTHREAD_TRYLOCK_LOCK(&q->qlock);
     PARANOIA_ONLY(sanity_check_queue(q));
-    if (q->qlength > 0) {
+    int stop = 0;
+    for (unsigned int b = priority_bands - 1; b > 0 && !stop; b--) {
+        node = q->band[b - 1].tail;
+        while (node && !stop) {
+            qt_threadqueue_node_t *prev = node->prev;
+
+            t = (qthread_t *)node->value;
+            switch (f(t)) {
+                case IGNORE_AND_CONTINUE:
+                    break;
+                case IGNORE_AND_STOP:
+                    stop = 1;
+                    break;
+                case REMOVE_AND_STOP:
+                    stop = 1;
+                /* fall through */
+                case REMOVE_AND_CONTINUE:
+                    qt_threadqueue_band_unlink(q, b, node);
+#ifdef QTHREAD_USE_EUREKAS
+                    qthread_internal_assassinate(t);
+#endif /* QTHREAD_USE_EUREKAS */
+                    FREE_TQNODE(node);
+                    break;
+            }
+            node = prev;
+        }
+    }
+    node = NULL;
+    if (!stop && (q->qlength > 0)) {
         qt_threadqueue_node_t **lp = NULL;
         qt_threadqueue_node_t **rp = NULL;
 
@@ -1413,6 +1485,7 @@ void INTERNAL qt_threadqueue_filter(qt_threadqueue_t       *q,
                     *rp = node->prev;
                     q->qlength--;
                     q->qlength_stealable -= node->stealable;
+                    q->qlength_bound     -= qt_threadqueue_isbound(node);
                     freeme                = node;
                     node                  = node->prev;
 #ifdef QTHREAD_USE_EUREKAS
@@ -1431,6 +1504,7 @@ void INTERNAL qt_threadqueue_filter(qt_threadqueue_t       *q,
                     *rp = node->prev;
                     q->qlength--;
                     q->qlength_stealable -= node->stealable;
+                    q->qlength_bound     -= qt_threadqueue_isbound(node);
 #ifdef QTHREAD_USE_EUREKAS
                     qthread_internal_assassinate(t);
 #endif /* QTHREAD_USE_EUREKAS */
@@ -1443,46 +1517,85 @@ void INTERNAL qt_threadqueue_filter(qt_threadqueue_t       *q,
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
 } /*}}}*/
 
-/* walk queue looking for a specific value  -- if found remove it (and start
- * it running)  -- if not return NULL
- */
+/* Look for the task that will fill value among the last few that were
+ * queued on the tail, which is where its parent queued it; if it is there
+ * and has not started, unlink it and return it, else return NULL. */
 qthread_t INTERNAL *qt_threadqueue_dequeue_specific(qt_threadqueue_t *q,
                                                     void             *value)
 {       /*{{{*/
-    qt_threadqueue_node_t *node = NULL;
-    qthread_t             *t    = NULL;
+    qt_threadqueue_node_t *node;
+    qthread_t             *t = NULL;
+    int                    i = 0;
 
     assert(q != NULL);
+    if (q->tail == NULL) { return NULL; }
 
     QTHREAD_TRYLOCK_LOCK(&q->qlock);
     PARANOIA_ONLY(sanity_check_queue(q));
-    if (q->qlength > 0) {
-        node = (qt_threadqueue_node_t *)q->tail;
-        t    = (node) ? (qthread_t *)node->value : NULL;
-        while ((t != NULL) && (t->ret != value)) {
-            node = (qt_threadqueue_node_t *)node->prev;
-            t    = (node) ? (qthread_t *)node->value : NULL;
+    for (node = q->tail; node != NULL && i < QT_TOUCH_WINDOW; node = node->prev, i++) {
+        if (qt_touch_runnable(node->value, value)) {
+            break;
         }
-        if ((node != NULL)) {
-            if (node != q->tail) {
-                if (node == q->head) {
-                    q->head = node->next;       // reset front ptr
-                } else {
-                    node->prev->next = node->next;
-                }
-                node->next->prev = node->prev;     // reset back ptr (know we're not tail
-                node->next       = NULL;
-                node->prev       = q->tail;
-                q->tail->next    = node;
-                q->tail          = node;
-            }
+    }
+    if (node != NULL && i < QT_TOUCH_WINDOW) {
+        if (node->prev) {
+            node->prev->next = node->next;
+        } else {
+            q->head = node->next;
+        }
+        if (node->next) {
+            node->next->prev = node->prev;
+        } else {
+            q->tail = node->prev;
         }
+        q->qlength--;
+        q->qlength_stealable -= node->stealable;
+        q->qlength_bound     -= qt_threadqueue_isbound(node);
+        t = node->value;
+        FREE_TQNODE(node);
     }
     QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
 
-    return (t);
+    return t;
 }     /*}}}*/
 
+/* Take up to max tasks that may run in one aggregate with t off the tail of
+ * q, where this worker takes its own work from. Tasks in the priority bands
+ * are left to the band scheduling. */
+int INTERNAL qt_threadqueue_dequeue_agg(qt_threadqueue_t         *q,
+                                        qt_threadqueue_private_t *qc,
+                                        const qthread_t          *t,
+                                        qthread_t               **batch,
+                                        int                       max)
+{   /*{{{*/
+    int n = 0;
+
+    assert(q != NULL);
+    if ((qt_threadqueue_band(t) != 0) || (q->tail == NULL)) { return 0; }
+
+    QTHREAD_TRYLOCK_LOCK(&q->qlock);
+    PARANOIA_ONLY(sanity_check_queue(q));
+    max = qt_agg_limit(max, q->qlength);
+    while (n < max && q->tail != NULL && qt_agg_compatible(t, q->tail->value)) {
+        qt_threadqueue_node_t *node = q->tail;
+
+        q->tail = node->prev;
+        if (q->tail == NULL) {
+            q->head = NULL;
+        } else {
+            q->tail->next = NULL;
+        }
+        q->qlength--;
+        q->qlength_stealable -= node->stealable;
+        q->qlength_bound     -= qt_threadqueue_isbound(node);
+        batch[n++]            = node->value;
+        FREE_TQNODE(node);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&q->qlock);
+
+    return n;
+} /*}}}*/
+
 void INTERNAL qthread_steal_enable()
 {       /*{{{*/
     steal_disable = 0;
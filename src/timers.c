@@ -0,0 +1,435 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <errno.h>
+#include <math.h> /* for HUGE_VAL, floor(), ceil() */
+#include <time.h> /* for nanosleep() */
+
+/* API Headers */
+#include "qthread/qthread.h"
+#include "qthread/qtimer.h"
+#include "qthread/performance.h"
+
+/* Internal Headers */
+#include "qt_visibility.h"
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qt_debug.h"
+#include "qt_alloc.h"
+#include "qt_mpool.h"
+#include "qt_envariables.h"
+#include "qt_subsystems.h"   /* for qthread_internal_cleanup() */
+#include "qthread_innards.h" /* for qlib */
+#include "qt_shepherd_innards.h"
+#include "qt_qthread_struct.h"
+#include "qt_qthread_mgmt.h" /* for qthread_internal_self() */
+#include "qt_threadqueues.h"
+#include "qt_threadstate.h"
+#include "qt_initialized.h"  /* for qthread_library_initialized */
+#include "qt_timers.h"
+
+/* The wheel (Varghese and Lauck, SOSP 1987) has WHEEL_LEVELS levels of
+ * WHEEL_SLOTS slots. A timer due within WHEEL_SLOTS ticks sits in the
+ * level-0 slot of its tick; one due later sits in the slot of a higher
+ * level that covers it, and moves down a level ("cascades") when the wheel
+ * reaches the start of that slot. Timers beyond the reach of the top level
+ * are parked in its farthest slot and re-filed when it cascades. */
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN   ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+typedef enum {
+    TIMER_SLEEP,    /* make a qthread_sleep()ing task ready */
+    TIMER_SPAWN,    /* qthread_fork_after() */
+    TIMER_PERIODIC  /* qthread_fork_periodic() */
+} qt_timer_kind_t;
+
+struct qt_timer_s {
+    struct qt_timer_s *next;
+    uint64_t           expires; /* in ticks since timer_epoch */
+    double             due;     /* in qtimer_wtime() seconds */
+    double             period;  /* TIMER_PERIODIC only */
+    qt_timer_kind_t    kind;
+    qthread_f          f;
+    void              *arg;
+    aligned_t         *ret;
+    qthread_t         *waiter;  /* TIMER_SLEEP only */
+};
+typedef struct qt_timer_s qt_timer_t;
+
+typedef struct {
+    QTHREAD_TRYLOCK_TYPE lock;
+    uint64_t             now;      /* last tick processed */
+    size_t               count;    /* timers in the wheel */
+    volatile double      next_due; /* nothing fires before this; HUGE_VAL if empty */
+    qt_timer_t          *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} qt_timer_wheel_t;
+
+aligned_t qt_timers_armed = 0;
+
+static qt_timer_wheel_t *wheels      = NULL; /* one per shepherd */
+static double            timer_epoch = 0.0;
+static double            timer_tick  = 1e-3;
+
+/* Memory Management */
+#ifdef UNPOOLED
+# define ALLOC_TIMER() (qt_timer_t *)MALLOC(sizeof(qt_timer_t))
+# define FREE_TIMER(t) FREE((t), sizeof(qt_timer_t))
+#else
+static qt_mpool timer_pool = NULL;
+# define ALLOC_TIMER() (qt_timer_t *)qt_mpool_alloc(timer_pool)
+# define FREE_TIMER(t) qt_mpool_free(timer_pool, (t))
+#endif
+
+static void qt_timers_subsystem_shutdown(void)
+{   /*{{{*/
+    for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+        qt_timer_wheel_t *w = &wheels[s];
+
+        for (int l = 0; l < WHEEL_LEVELS; l++) {
+            for (int i = 0; i < WHEEL_SLOTS; i++) {
+                while (w->slots[l][i]) {
+                    qt_timer_t *tm = w->slots[l][i];
+
+                    w->slots[l][i] = tm->next;
+                    /* sleepers' timers live on their stacks */
+                    if (tm->kind != TIMER_SLEEP) { FREE_TIMER(tm); }
+                }
+            }
+        }
+        QTHREAD_TRYLOCK_DESTROY(w->lock);
+    }
+    qt_free(wheels);
+    wheels          = NULL;
+    qt_timers_armed = 0;
+#ifndef UNPOOLED
+    qt_mpool_destroy(timer_pool);
+    timer_pool = NULL;
+#endif
+} /*}}}*/
+
+void INTERNAL qt_timers_subsystem_init(void)
+{   /*{{{*/
+    timer_tick  = qt_internal_get_env_num("TIMER_RESOLUTION", 1000, 1000) * 1e-6;
+    timer_epoch = qtimer_wtime();
+    wheels      = qt_calloc(qlib->nshepherds, sizeof(qt_timer_wheel_t));
+    assert(wheels);
+    for (qthread_shepherd_id_t s = 0; s < qlib->nshepherds; s++) {
+        QTHREAD_TRYLOCK_INIT(wheels[s].lock);
+        wheels[s].next_due = HUGE_VAL;
+    }
+    qt_timers_armed = 0;
+#ifndef UNPOOLED
+    timer_pool = qt_mpool_create(sizeof(qt_timer_t));
+#endif
+    qthread_internal_cleanup(qt_timers_subsystem_shutdown);
+} /*}}}*/
+
+/* The first tick at or after time t */
+static QINLINE uint64_t timer_ticks(double t)
+{   /*{{{*/
+    return (t <= timer_epoch) ? 0 : (uint64_t)ceil((t - timer_epoch) / timer_tick);
+} /*}}}*/
+
+/* The tick in progress at time t */
+static QINLINE uint64_t timer_current_tick(double t)
+{   /*{{{*/
+    return (t <= timer_epoch) ? 0 : (uint64_t)floor((t - timer_epoch) / timer_tick);
+} /*}}}*/
+
+static QINLINE double timer_tick_time(uint64_t tick)
+{   /*{{{*/
+    return timer_epoch + (double)tick * timer_tick;
+} /*}}}*/
+
+/* File tm in the slot that covers it. Caller holds w->lock. */
+static void wheel_place(qt_timer_wheel_t *w,
+                        qt_timer_t       *tm)
+{   /*{{{*/
+    uint64_t expires = tm->expires;
+    uint64_t delta;
+    int      level = 0;
+    size_t   slot;
+
+    assert(expires >= w->now);
+    delta = expires - w->now;
+    if (delta >= WHEEL_SPAN) {
+        expires = w->now + WHEEL_SPAN - 1;
+        delta   = WHEEL_SPAN - 1;
+    }
+    while (delta >= ((uint64_t)1 << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    slot                  = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    tm->next              = w->slots[level][slot];
+    w->slots[level][slot] = tm;
+} /*}}}*/
+
+/* Move the timers of level's current slot down. Caller holds w->lock. */
+static void wheel_cascade(qt_timer_wheel_t *w,
+                          int               level)
+{   /*{{{*/
+    const size_t slot = (w->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    qt_timer_t  *list = w->slots[level][slot];
+
+    w->slots[level][slot] = NULL;
+    while (list) {
+        qt_timer_t *tm = list;
+
+        list = tm->next;
+        wheel_place(w, tm);
+    }
+} /*}}}*/
+
+/* Process the ticks up to and including to, prepending the timers that
+ * expire to *fired. Caller holds w->lock. */
+static void wheel_advance(qt_timer_wheel_t *w,
+                          uint64_t          to,
+                          qt_timer_t      **fired)
+{   /*{{{*/
+    while (w->now < to) {
+        qt_timer_t *list;
+
+        if (w->count == 0) {
+            w->now = to;
+            break;
+        }
+        w->now++;
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if (w->now & (((uint64_t)1 << (WHEEL_BITS * level)) - 1)) { break; }
+            wheel_cascade(w, level);
+        }
+        list                             = w->slots[0][w->now & WHEEL_MASK];
+        w->slots[0][w->now & WHEEL_MASK] = NULL;
+        while (list) {
+            qt_timer_t *tm = list;
+
+            list     = tm->next;
+            tm->next = *fired;
+            *fired   = tm;
+            w->count--;
+        }
+    }
+} /*}}}*/
+
+/* A lower bound on when the next timer of w fires: the first occupied
+ * level-0 slot before the next cascade, or else that cascade. Caller holds
+ * w->lock. */
+static double wheel_next_due(const qt_timer_wheel_t *w)
+{   /*{{{*/
+    const uint64_t boundary = ((w->now >> WHEEL_BITS) + 1) << WHEEL_BITS;
+
+    if (w->count == 0) { return HUGE_VAL; }
+    for (uint64_t tick = w->now + 1; tick < boundary; tick++) {
+        if (w->slots[0][tick & WHEEL_MASK]) { return timer_tick_time(tick); }
+    }
+    return timer_tick_time(boundary);
+} /*}}}*/
+
+static aligned_t timer_periodic(void *arg);
+
+static void timer_fire(qt_timer_t *tm)
+{   /*{{{*/
+    switch (tm->kind) {
+        case TIMER_SLEEP:
+        {
+            qthread_t *t = tm->waiter; /* tm is on t's stack; done with it now */
+
+            qthread_debug(THREAD_DETAILS, "waking tid %u\n", t->thread_id);
+            t->thread_state = QTHREAD_STATE_RUNNING;
+            QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_RUNNING);
+            qt_threadqueue_enqueue(t->rdata->shepherd_ptr->ready, t);
+            break;
+        }
+        case TIMER_SPAWN:
+            qassert(qthread_spawn(tm->f, tm->arg, 0, tm->ret, 0, NULL, NO_SHEPHERD, 0), QTHREAD_SUCCESS);
+            FREE_TIMER(tm);
+            break;
+        case TIMER_PERIODIC:
+            qassert(qthread_spawn(timer_periodic, tm, 0, NULL, 0, NULL, NO_SHEPHERD, 0), QTHREAD_SUCCESS);
+            break;
+    }
+} /*}}}*/
+
+/* Arm tm on shep's wheel (or fire it, if it is already due) */
+static void timer_add(qthread_shepherd_t *shep,
+                      qt_timer_t         *tm)
+{   /*{{{*/
+    qt_timer_wheel_t *w = &wheels[shep->shepherd_id];
+
+    tm->expires = timer_ticks(tm->due);
+    QTHREAD_TRYLOCK_LOCK(&w->lock);
+    if (w->count == 0) {
+        /* nobody advanced the wheel while it was empty */
+        const uint64_t now = timer_current_tick(qtimer_wtime());
+        if (now > w->now) { w->now = now; }
+    }
+    if (tm->expires <= w->now) {
+        QTHREAD_TRYLOCK_UNLOCK(&w->lock);
+        timer_fire(tm);
+        return;
+    }
+    wheel_place(w, tm);
+    w->count++;
+    if (timer_tick_time(tm->expires) < w->next_due) {
+        w->next_due = timer_tick_time(tm->expires);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&w->lock);
+    (void)qthread_incr(&qt_timers_armed, 1);
+} /*}}}*/
+
+int INTERNAL qt_timers_run(qthread_shepherd_t *shep)
+{   /*{{{*/
+    qt_timer_wheel_t *w     = &wheels[shep->shepherd_id];
+    qt_timer_t       *fired = NULL;
+    double            now;
+    int               n = 0;
+
+    if (w->count == 0) { return 0; }
+    now = qtimer_wtime();
+    if (now < w->next_due) { return 0; }
+    if (!QTHREAD_TRYLOCK_TRY(&w->lock)) { return 0; } /* another worker is at it */
+    wheel_advance(w, timer_current_tick(now), &fired);
+    w->next_due = wheel_next_due(w);
+    QTHREAD_TRYLOCK_UNLOCK(&w->lock);
+    while (fired) {
+        qt_timer_t *tm = fired;
+
+        fired = tm->next;
+        timer_fire(tm);
+        n++;
+    }
+    if (n) { (void)qthread_incr(&qt_timers_armed, -n); }
+    return n;
+} /*}}}*/
+
+/* How long an idle worker of shep may sleep, in seconds; 0 for as long as
+ * it likes. */
+double INTERNAL qt_timers_timeout(qthread_shepherd_t *shep)
+{   /*{{{*/
+    const double next = wheels[shep->shepherd_id].next_due;
+    double       left;
+
+    if (next == HUGE_VAL) { return 0.0; }
+    left = next - qtimer_wtime();
+    return (left > 1e-6) ? left : 1e-6;
+} /*}}}*/
+
+void INTERNAL qt_timer_sleep(qthread_shepherd_t *shep,
+                             qt_timer_t         *tm)
+{   /*{{{*/
+    timer_add(shep, tm);
+} /*}}}*/
+
+static aligned_t timer_periodic(void *arg)
+{   /*{{{*/
+    qt_timer_t *tm = (qt_timer_t *)arg;
+    aligned_t   r  = tm->f(tm->arg);
+
+    if (r == 0) {
+        const double now = qtimer_wtime();
+
+        tm->due += tm->period;
+        if (tm->due <= now) {
+            /* fell behind: skip the runs that were missed */
+            tm->due += tm->period * (floor((now - tm->due) / tm->period) + 1.0);
+        }
+        timer_add(qthread_internal_getshep(), tm);
+    } else {
+        if (tm->ret) {
+            qassert(qthread_writeF_const(tm->ret, r), QTHREAD_SUCCESS);
+        }
+        FREE_TIMER(tm);
+    }
+    return r;
+} /*}}}*/
+
+/* Used to arm a timer from outside the workers: file it from a task */
+static aligned_t timer_add_task(void *arg)
+{   /*{{{*/
+    timer_add(qthread_internal_getshep(), (qt_timer_t *)arg);
+    return 0;
+} /*}}}*/
+
+static int timer_arm(qt_timer_kind_t kind,
+                     qthread_f       f,
+                     const void     *arg,
+                     aligned_t      *ret,
+                     double          delay,
+                     double          period)
+{   /*{{{*/
+    qthread_shepherd_t *shep = qthread_internal_getshep();
+    qt_timer_t         *tm;
+
+    assert(qthread_library_initialized);
+    qassert_ret(f, QTHREAD_BADARGS);
+    if (ret) {
+        int r = qthread_empty(ret);
+        if (r != QTHREAD_SUCCESS) { return r; }
+    }
+    tm = ALLOC_TIMER();
+    qassert_ret(tm, QTHREAD_MALLOC_ERROR);
+    tm->kind   = kind;
+    tm->f      = f;
+    tm->arg    = (void *)arg;
+    tm->ret    = ret;
+    tm->period = period;
+    tm->waiter = NULL;
+    tm->due    = qtimer_wtime() + delay;
+    if (shep) {
+        timer_add(shep, tm);
+    } else {
+        return qthread_spawn(timer_add_task, tm, 0, NULL, 0, NULL, NO_SHEPHERD, 0);
+    }
+    return QTHREAD_SUCCESS;
+} /*}}}*/
+
+int API_FUNC qthread_fork_after(qthread_f   f,
+                                const void *arg,
+                                aligned_t  *ret,
+                                double      delay)
+{   /*{{{*/
+    return timer_arm(TIMER_SPAWN, f, arg, ret, delay, 0.0);
+} /*}}}*/
+
+int API_FUNC qthread_fork_periodic(qthread_f   f,
+                                   const void *arg,
+                                   aligned_t  *ret,
+                                   double      period)
+{   /*{{{*/
+    qassert_ret(period > 0.0, QTHREAD_BADARGS);
+    return timer_arm(TIMER_PERIODIC, f, arg, ret, period, period);
+} /*}}}*/
+
+int API_FUNC qthread_sleep(double seconds)
+{   /*{{{*/
+    qthread_t *me = qthread_internal_self();
+    qt_timer_t tm;
+
+    assert(qthread_library_initialized);
+    if (seconds <= 0.0) { return QTHREAD_SUCCESS; }
+    if ((me == NULL) || (me->flags & QTHREAD_SIMPLE)) {
+        /* not a task that can be suspended: sleep the old-fashioned way */
+        struct timespec ts;
+
+        ts.tv_sec  = (time_t)seconds;
+        ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR) ;
+        return QTHREAD_SUCCESS;
+    }
+    tm.kind   = TIMER_SLEEP;
+    tm.waiter = me;
+    tm.due    = qtimer_wtime() + seconds;
+    qthread_debug(THREAD_BEHAVIOR, "tid %u sleeping for %g secs\n", me->thread_id, seconds);
+    me->rdata->blockedon.timer = &tm;
+    me->thread_state           = QTHREAD_STATE_SLEEPING;
+    QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_SLEEPING);
+    qthread_back_to_master(me);
+    return QTHREAD_SUCCESS;
+} /*}}}*/
+
+/* vim:set expandtab: */
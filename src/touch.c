@@ -5,33 +5,40 @@
 /* System Headers */
 
 /* Internal Headers */
+#include "qthread_innards.h"
 #include "qt_qthread_mgmt.h" /* for qthread_internal_self() */
 #include "qt_shepherd_innards.h"
 #include "qt_threadqueues.h"
 #include "qt_touch.h"
 
-void qthread_run_needed_task(syncvar_t *value)
-{
-    qthread_shepherd_t *shep   = qthread_internal_getshep();
-    qthread_t          *target = NULL;
-    qthread_t          *orig_t = qthread_internal_self();
+/* If the task that will fill value was spawned lazily by this task and has
+ * not been started, run it here and return 1; otherwise return 0, and the
+ * caller blocks as usual. The task runs on what is left of the caller's
+ * stack, so it is only attempted while no more than a quarter of it is in
+ * use: blocking, from within the task, takes a good part of the rest. */
+int INTERNAL qthread_run_needed_task(void *value)
+{   /*{{{*/
+    qthread_t          *me = qthread_internal_self();
+    qthread_shepherd_t *shep;
+    qthread_t          *t;
+    size_t              stack_size;
 
-    //  ucontext_t my_context;
-
-    if ((target = qt_threadqueue_dequeue_specific(shep->ready, value))) {
-        // switch to task and run -- else missing and return
-        //    qthread_t * t = n->value;
-
-        // getcontext(&my_context); // done inside qthread_exec
-        // t->rdata->return_context = &my_context;  // done inside qthread_exec
-        // qassert(qthread_writeEF_const(t, (aligned_t*)t->ret, (t->f) (t->arg, t->arg)), QTHREAD_SUCCESS);
-        /* note: there's a good argument that the following should
-         * be: (*t->f)(t), however the state management would be
-         * more complex
-         */
-        //    qthread_exec(t, &my_context);
-        qthread_back_to_master(orig_t);
+    if ((me == NULL) || !(me->flags & QTHREAD_LAZY_PARENT)) { return 0; }
+    stack_size = me->rdata->stack_size;
+    if (qthread_stackleft() < stack_size - stack_size / 4) { return 0; }
+    shep = me->rdata->shepherd_ptr;
+    t    = qt_threadqueue_dequeue_specific(shep->ready, value);
+    if (t == NULL) { return 0; }
+    /* nor is a task that asked for a bigger stack than the caller's run here */
+    if (!qt_touch_runnable(t, value) ||
+        (qlib->qthread_stack_class_size[t->stack_class] > stack_size)) {
+        qt_threadqueue_enqueue(shep->ready, t);
+        return 0;
     }
-}
+    me->rdata->inline_depth++;
+    qthread_run_inline(t);
+    me->rdata->inline_depth--;
+    return 1;
+} /*}}}*/
 
 /* vim:set expandtab: */
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+/* more than qthread_readFF_many() keeps on its stack */
+#define NADDRS 200
+
+static aligned_t        vals[NADDRS];
+static aligned_t        copies[NADDRS];
+static const aligned_t *srcs[NADDRS];
+static aligned_t       *dsts[NADDRS];
+
+static aligned_t wait_all(void *arg)
+{
+    assert(qthread_readFF_many(dsts, srcs, NADDRS) == QTHREAD_SUCCESS);
+    for (int i = 0; i < NADDRS; i++) {
+        assert(qthread_feb_status(&vals[i]));
+        assert(copies[i] == vals[i]);
+    }
+    return 1;
+}
+
+static aligned_t wait_one(void *arg)
+{
+    aligned_t v;
+
+    qthread_readFF(&v, arg);
+    return v;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t ret, rets[NADDRS];
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    for (int i = 0; i < NADDRS; i++) {
+        vals[i] = i + 1;
+        srcs[i] = &vals[i];
+        dsts[i] = &copies[i];
+    }
+
+    /* nothing to do */
+    assert(qthread_readFF_many(NULL, NULL, 0) == QTHREAD_SUCCESS);
+    assert(qthread_fill_many(NULL, 0) == QTHREAD_SUCCESS);
+
+    /* all full already */
+    wait_all(NULL);
+    assert(qthread_readFF_many(NULL, srcs, NADDRS) == QTHREAD_SUCCESS);
+    iprintf("read %d full addresses\n", NADDRS);
+
+    /* all empty, filled one by one, in reverse */
+    for (int i = 0; i < NADDRS; i++) {
+        qthread_empty(&vals[i]);
+        copies[i] = 0;
+    }
+    qthread_fork(wait_all, NULL, &ret);
+    qthread_yield();
+    for (int i = NADDRS - 1; i >= 0; i--) {
+        qthread_writeEF_const(&vals[i], 2 * i);
+    }
+    qthread_readFF(NULL, &ret);
+    iprintf("read %d addresses as they were filled\n", NADDRS);
+
+    /* every other one empty, filled all at once */
+    for (int i = 0; i < NADDRS; i += 2) {
+        qthread_empty(&vals[i]);
+        copies[i] = 0;
+    }
+    qthread_fork(wait_all, NULL, &ret);
+    qthread_yield();
+    assert(qthread_fill_many(srcs, NADDRS) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, &ret);
+    iprintf("read %d addresses filled with qthread_fill_many()\n", NADDRS);
+
+    /* qthread_fill_many() wakes plain readFF waiters too */
+    for (int i = 0; i < NADDRS; i++) {
+        qthread_empty(&vals[i]);
+        qthread_fork(wait_one, &vals[i], &rets[i]);
+    }
+    qthread_yield();
+    assert(qthread_fill_many(srcs, NADDRS) == QTHREAD_SUCCESS);
+    for (int i = 0; i < NADDRS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == vals[i]);
+    }
+    iprintf("woke %d readFF waiters\n", NADDRS);
+
+    return 0;
+}
+
+/* vim:set expandtab */
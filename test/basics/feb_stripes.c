@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/performance.h>
+#include "argparsing.h"
+
+#define ROUNDS 64
+
+static aligned_t ping = 0, pong = 0;
+
+static aligned_t player(void *arg)
+{
+    aligned_t *mine   = arg ? &pong : &ping;
+    aligned_t *theirs = arg ? &ping : &pong;
+
+    for (aligned_t i = 0; i < ROUNDS; i++) {
+        aligned_t v;
+
+        qthread_readFE(&v, mine);
+        v++;
+        qthread_writeEF(theirs, &v);
+    }
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qtperf_feb_stripe_t *stripes;
+    size_t               nstripes;
+    size_t               acquisitions = 0, contended = 0;
+    aligned_t            rets[2];
+
+    /* not a power of two, so it must be rounded up */
+    setenv("QT_LOCKING_STRIPES", "100", 1);
+    /* the stripes only have locks when there is more than one worker */
+    setenv("QT_NUM_SHEPHERDS", "2", 0);
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    nstripes = qtperf_feb_stripes(NULL, 0);
+    iprintf("%lu locking stripes\n", (unsigned long)nstripes);
+    assert(nstripes == 128);
+
+    qthread_empty(&pong);
+    qthread_fork(player, NULL, &rets[0]);
+    qthread_fork(player, (void *)1, &rets[1]);
+    qthread_readFF(NULL, &rets[0]);
+    qthread_readFF(NULL, &rets[1]);
+    assert(ping == 2 * ROUNDS);
+
+    stripes = malloc(nstripes * sizeof(qtperf_feb_stripe_t));
+    assert(stripes != NULL);
+    assert(qtperf_feb_stripes(stripes, nstripes) == nstripes);
+    for (size_t i = 0; i < nstripes; i++) {
+        assert(stripes[i].contended <= stripes[i].acquisitions);
+        acquisitions += stripes[i].acquisitions;
+        contended    += stripes[i].contended;
+    }
+    iprintf("%lu acquisitions, %lu contended\n",
+            (unsigned long)acquisitions, (unsigned long)contended);
+    /* zero only if the stripes have no locks (one worker, or lock-free FEBs) */
+    if ((qthread_num_workers() > 1) && (acquisitions == 0)) {
+        iprintf("the locking stripes have no locks\n");
+    }
+    if (verbose) {
+        qtperf_print_feb_stripes();
+    }
+    free(stripes);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+#define NUM_ITEMS   1000
+#define NUM_READERS 8
+
+static qt_feb_word_t box   = QT_FEB_WORD_STATIC_EMPTY_INITIALIZER;
+static qt_feb_word_t flag  = QT_FEB_WORD_STATIC_EMPTY_INITIALIZER;
+static aligned_t     total = 0;
+
+static aligned_t producer(void *arg)
+{
+    for (aligned_t i = 1; i <= NUM_ITEMS; i++) {
+        qthread_feb_word_writeEF_const(&box, i);
+    }
+    return 0;
+}
+
+static aligned_t consumer(void *arg)
+{
+    for (aligned_t i = 1; i <= NUM_ITEMS; i++) {
+        aligned_t v;
+
+        qthread_feb_word_readFE(&v, &box);
+        assert(v == i);
+        total += v;
+    }
+    return 0;
+}
+
+static aligned_t reader(void *arg)
+{
+    aligned_t v;
+
+    qthread_feb_word_readFF(&v, &flag);
+    assert(v == 42);
+    return v;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qt_feb_word_t *words;
+    aligned_t      rets[NUM_READERS + 2];
+    aligned_t      v;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    /* zeroed words are full */
+    words = calloc(4, sizeof(qt_feb_word_t));
+    assert(words != NULL);
+    assert(qthread_feb_word_status(&words[0]));
+    qthread_feb_word_empty(&words[0]);
+    assert(!qthread_feb_word_status(&words[0]));
+    qthread_feb_word_writeF_const(&words[0], 7);
+    assert(qthread_feb_word_status(&words[0]));
+    qthread_feb_word_readFF(&v, &words[0]);
+    assert(v == 7);
+    qthread_feb_word_readFE(&v, &words[0]);
+    assert(v == 7 && !qthread_feb_word_status(&words[0]));
+    qthread_feb_word_fill(&words[0]);
+    qthread_feb_word_readFF(NULL, &words[0]);
+    free(words);
+
+    /* many readers released by one fill */
+    for (int i = 0; i < NUM_READERS; i++) {
+        qthread_fork(reader, NULL, &rets[i]);
+    }
+    qthread_feb_word_writeEF_const(&flag, 42);
+    for (int i = 0; i < NUM_READERS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == 42);
+    }
+    iprintf("%d readers released\n", NUM_READERS);
+
+    /* a producer and a consumer handing values over one word */
+    qthread_fork(consumer, NULL, &rets[NUM_READERS]);
+    qthread_fork(producer, NULL, &rets[NUM_READERS + 1]);
+    qthread_readFF(NULL, &rets[NUM_READERS]);
+    qthread_readFF(NULL, &rets[NUM_READERS + 1]);
+    iprintf("total %lu, expected %lu\n", (unsigned long)total,
+            (unsigned long)(NUM_ITEMS * (NUM_ITEMS + 1) / 2));
+    assert(total == NUM_ITEMS * (NUM_ITEMS + 1) / 2);
+    assert(!qthread_feb_word_status(&box));
+
+    return 0;
+}
+
+/* vim:set expandtab */
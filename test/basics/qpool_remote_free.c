@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qpool.h>
+#include "argparsing.h"
+
+/* Objects allocated on one shepherd and freed on another must come back,
+ * intact and each exactly once, to the shepherd they were allocated on. */
+
+#define NUM_OBJS 4096
+#define OBJ_SIZE 48
+
+static qpool *pool;
+static void  *objs[NUM_OBJS];
+
+static aligned_t alloc_all(void *arg)
+{
+    assert(qthread_shep() == 0);
+    for (size_t i = 0; i < NUM_OBJS; i++) {
+        objs[i] = qpool_alloc(pool);
+        assert(objs[i] != NULL);
+        memset(objs[i], (int)(i & 0xff), OBJ_SIZE);
+    }
+    return 0;
+}
+
+static aligned_t free_all(void *arg)
+{
+    assert(qthread_shep() == 1);
+    for (size_t i = 0; i < NUM_OBJS; i++) {
+        unsigned char *o = objs[i];
+
+        for (size_t j = 0; j < OBJ_SIZE; j++) {
+            assert(o[j] == (unsigned char)(i & 0xff));
+        }
+        qpool_free(pool, objs[i]);
+    }
+    return 0;
+}
+
+static int cmp_ptr(const void *a,
+                   const void *b)
+{
+    uintptr_t x = (uintptr_t)*(void *const *)a;
+    uintptr_t y = (uintptr_t)*(void *const *)b;
+
+    return (x > y) - (x < y);
+}
+
+static aligned_t realloc_all(void *arg)
+{
+    void **again = malloc(sizeof(void *) * NUM_OBJS);
+
+    assert(again != NULL);
+    assert(qthread_shep() == 0);
+    for (size_t i = 0; i < NUM_OBJS; i++) {
+        again[i] = qpool_alloc(pool);
+        assert(again[i] != NULL);
+        memset(again[i], 0, OBJ_SIZE);
+    }
+    qsort(again, NUM_OBJS, sizeof(void *), cmp_ptr);
+    for (size_t i = 1; i < NUM_OBJS; i++) {
+        assert((uintptr_t)again[i - 1] + OBJ_SIZE <= (uintptr_t)again[i]);
+    }
+    for (size_t i = 0; i < NUM_OBJS; i++) {
+        qpool_free(pool, again[i]);
+    }
+    free(again);
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t ret;
+    size_t    before;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+    if (qthread_num_shepherds() < 2) {
+        iprintf("needs two shepherds; skipping\n");
+        return 0;
+    }
+
+    pool = qpool_create(OBJ_SIZE);
+    assert(pool != NULL);
+
+    qthread_fork_to(alloc_all, NULL, &ret, 0);
+    qthread_readFF(NULL, &ret);
+    qthread_fork_to(free_all, NULL, &ret, 1);
+    qthread_readFF(NULL, &ret);
+    before = qthread_readstate(MPOOL_REMOTE_FREES);
+    qthread_fork_to(realloc_all, NULL, &ret, 0);
+    qthread_readFF(NULL, &ret);
+    iprintf("remote frees taken back: %lu\n",
+            (unsigned long)(qthread_readstate(MPOOL_REMOTE_FREES) - before));
+    assert(qthread_readstate(MPOOL_REMOTE_FREES) >= before);
+
+    qpool_destroy(pool);
+
+    return 0;
+}
+
+/* vim:set expandtab */
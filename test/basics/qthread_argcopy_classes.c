@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+/* argument sizes on either side of each qthread_t size class, and past the
+ * default QTHREAD_ARGCOPY_SIZE, where the argument is copied out of line */
+static const size_t arg_sizes[] = { 1, 8, 48, 49, 64, 112, 113, 240, 241, 496, 497, 1024, 1025, 4000 };
+#define NUM_SIZES (sizeof(arg_sizes) / sizeof(arg_sizes[0]))
+
+typedef struct {
+    size_t        size;
+    unsigned char bytes[];
+} blob_t;
+
+static aligned_t check_blob(void *arg)
+{
+    blob_t     *b = (blob_t *)arg;
+    aligned_t **tl;
+
+    assert(((uintptr_t)b % sizeof(size_t)) == 0);
+
+    /* the task-local area must not overlap the copied argument */
+    tl  = (aligned_t **)qthread_get_tasklocal(sizeof(aligned_t *));
+    *tl = (aligned_t *)~(uintptr_t)0;
+    qthread_yield();
+    assert(*tl == (aligned_t *)~(uintptr_t)0);
+
+    for (size_t i = 0; i < b->size; i++) {
+        assert(b->bytes[i] == (unsigned char)(b->size + i));
+    }
+    memset(b->bytes, 0, b->size);
+    return b->size;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t rets[NUM_SIZES];
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        size_t  arg_size = sizeof(blob_t) + arg_sizes[s];
+        blob_t *b        = malloc(arg_size);
+
+        assert(b != NULL);
+        b->size = arg_sizes[s];
+        for (size_t i = 0; i < b->size; i++) {
+            b->bytes[i] = (unsigned char)(b->size + i);
+        }
+        qthread_spawn(check_blob, b, arg_size, &rets[s], 0, NULL, NO_SHEPHERD, 0);
+        free(b); /* the task has its own copy */
+    }
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        qthread_readFF(NULL, &rets[s]);
+        iprintf("%lu-byte argument copied\n", (unsigned long)arg_sizes[s]);
+        assert(rets[s] == arg_sizes[s]);
+    }
+
+    return 0;
+}
+
+/* vim:set expandtab */
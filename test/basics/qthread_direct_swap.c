@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/sinc.h>
+#include "argparsing.h"
+
+static aligned_t       x;
+static qt_sinc_t      *sinc;
+static qthread_queue_t queue;
+static aligned_t       released;
+
+static aligned_t filler(void *arg)
+{
+    qthread_fill(&x);
+    released = 1;
+    return 0;
+}
+
+static aligned_t submitter(void *arg)
+{
+    qt_sinc_submit(sinc, NULL);
+    released = 1;
+    return 0;
+}
+
+static aligned_t releaser(void *arg)
+{
+    qthread_queue_release_one(queue);
+    released = 1;
+    return 0;
+}
+
+/* Blocks until the task it spawns releases it; returns whether it ran
+ * before that task got to continue. */
+static aligned_t waiter(void *arg)
+{
+    const int kind = (int)(uintptr_t)arg;
+    aligned_t ret;
+
+    released = 0;
+    switch (kind) {
+        case 0:
+            qthread_empty(&x);
+            qthread_fork(filler, NULL, &ret);
+            qthread_readFF(NULL, &x);
+            break;
+        case 1:
+            sinc = qt_sinc_create(0, NULL, NULL, 1);
+            qthread_fork(submitter, NULL, &ret);
+            qt_sinc_wait(sinc, NULL);
+            break;
+        case 2:
+            queue = qthread_queue_create(QTHREAD_QUEUE_MULTI_JOIN_LENGTH, 0);
+            qthread_fork(releaser, NULL, &ret);
+            qthread_queue_join(queue);
+            break;
+    }
+    aligned_t first = !released;
+    qthread_readFF(NULL, &ret);
+    switch (kind) {
+        case 1: qt_sinc_destroy(sinc); break;
+        case 2: qthread_queue_destroy(queue); break;
+    }
+    return first;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    static const char *names[] = { "FEB fill", "sinc submit", "queue release" };
+
+    /* one worker, so that the woken task can only run early by a swap */
+    setenv("QT_NUM_SHEPHERDS", "1", 1);
+    setenv("QT_NUM_WORKERS_PER_SHEPHERD", "1", 1);
+    setenv("QT_DIRECT_SWAP", "1", 1);
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    for (int kind = 0; kind < 3; kind++) {
+        aligned_t first;
+
+        qthread_fork(waiter, (void *)(uintptr_t)kind, &first);
+        qthread_readFF(&first, &first);
+        iprintf("%s: woken task ran %s\n", names[kind], first ? "first" : "second");
+        assert(first);
+    }
+
+    return 0;
+}
+
+/* vim:set expandtab */
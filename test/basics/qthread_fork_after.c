@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include "argparsing.h"
+
+#define NSLEEPERS 100
+#define NTICKS    5
+
+static double    started;
+static aligned_t ticks = 0;
+
+static aligned_t when(void *arg)
+{
+    double *ran = (double *)arg;
+
+    *ran = qtimer_wtime();
+    return 1;
+}
+
+static aligned_t tick(void *arg)
+{
+    return qthread_incr(&ticks, 1) + 1 >= NTICKS;
+}
+
+static aligned_t sleeper(void *arg)
+{
+    double t = qtimer_wtime();
+
+    qthread_sleep(0.05);
+    return qtimer_wtime() - t >= 0.05;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t ret;
+    aligned_t rets[NSLEEPERS];
+    double    ran = 0.0;
+    double    elapsed;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    /* delayed task */
+    started = qtimer_wtime();
+    assert(qthread_fork_after(when, &ran, &ret, 0.02) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, &ret);
+    iprintf("delayed task ran after %g secs\n", ran - started);
+    assert(ret == 1);
+    assert(ran - started >= 0.02);
+
+    /* periodic task, until it says stop */
+    started = qtimer_wtime();
+    assert(qthread_fork_periodic(tick, NULL, &ret, 0.01) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, &ret);
+    elapsed = qtimer_wtime() - started;
+    iprintf("%u periodic runs in %g secs\n", (unsigned)ticks, elapsed);
+    assert(ret == 1);
+    assert(ticks == NTICKS);
+    assert(elapsed >= 0.01 * NTICKS);
+
+    /* sleepers do not hold on to their workers */
+    started = qtimer_wtime();
+    for (int i = 0; i < NSLEEPERS; i++) {
+        qthread_fork(sleeper, NULL, &rets[i]);
+    }
+    for (int i = 0; i < NSLEEPERS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == 1);
+    }
+    elapsed = qtimer_wtime() - started;
+    iprintf("%i sleepers done in %g secs\n", NSLEEPERS, elapsed);
+    assert(elapsed < 0.05 * NSLEEPERS / 2);
+
+    /* the main thread can sleep too */
+    started = qtimer_wtime();
+    assert(qthread_sleep(0.01) == QTHREAD_SUCCESS);
+    assert(qtimer_wtime() - started >= 0.01);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -85,6 +85,43 @@ static aligned_t array_producer(void *arg)
     return 0;
 }
 
+// //////////////////////////////////////////////////////////////////////////////
+static aligned_t syncvar_consumer(void *arg)
+{
+    syncvar_t *m   = (syncvar_t *)arg;
+    aligned_t  sum = 0;
+
+    for (int i = 0; i < NUM_MULTI; i++) {
+        uint64_t value;
+
+        assert(qthread_syncvar_status(&m[i]));
+        qthread_syncvar_readFF(&value, &m[i]);
+        iprintf("Syncvar-consumer: got value %u\n", (unsigned)value);
+        sum += value;
+    }
+
+    return sum;
+}
+
+static aligned_t syncvar_producer(void *arg)
+{
+    iprintf("Syncvar-producer: setting value 42\n");
+    qthread_syncvar_writeEF_const((syncvar_t *)arg, 42);
+
+    return 0;
+}
+
+static aligned_t mixed_consumer(void *arg)
+{
+    void    **m = (void **)arg;
+    uint64_t  value;
+
+    qthread_syncvar_readFF(&value, (syncvar_t *)m[1]);
+    iprintf("Mixed-consumer: got values %u and %u\n", (unsigned)*(aligned_t *)m[0], (unsigned)value);
+
+    return *(aligned_t *)m[0] + value;
+}
+
 #ifdef __INTEL_COMPILER
 int setenv(const char *name,
            const char *value,
@@ -256,6 +293,67 @@ int main(int   argc,
         }
     }
 
+    iprintf("\n***** Test single consumer, multiple producers (syncvar_t) *****\n");
+    {
+        aligned_t ret;
+
+        // Initialize values as empty
+        syncvar_t   v[NUM_MULTI];
+        syncvar_t **vptr = malloc((NUM_MULTI + 1) * sizeof(syncvar_t *));
+        assert(vptr != NULL);
+        vptr[0] = (syncvar_t *)(uintptr_t)NUM_MULTI;
+        for (int i = 0; i < NUM_MULTI; i++) {
+            v[i]        = SYNCVAR_EMPTY_INITIALIZER;
+            vptr[i + 1] = &v[i];
+        }
+
+        // the library frees vptr
+        assert(qthread_spawn(syncvar_consumer, v, 0, &ret, NUM_MULTI, vptr,
+                             NO_SHEPHERD, QTHREAD_SPAWN_PC_SYNCVAR_T) == QTHREAD_SUCCESS);
+        for (int i = 0; i < NUM_MULTI; i++) qthread_fork_to(syncvar_producer, &v[i], NULL, i % 2);
+
+        qthread_readFF(&ret, &ret);
+
+        // Verify return value
+        if (ret != NUM_MULTI * 42) {
+            iprintf("Bad return value! Wanted %u, got %u\n", NUM_MULTI * 42, (unsigned int)ret);
+            return 1;
+        }
+    }
+
+    iprintf("\n***** Test single consumer, mixed aligned_t and syncvar_t producers *****\n");
+    {
+        aligned_t ret;
+
+        // Initialize values as empty
+        aligned_t v1 = 1;
+        qthread_empty(&v1);
+
+        syncvar_t v2 = SYNCVAR_EMPTY_INITIALIZER;
+
+        void *args[2] = { &v1, &v2 };
+        qthread_fork_precond(mixed_consumer, args, &ret, 2, &v1, QTHREAD_PRECOND_SYNCVAR(&v2));
+        qthread_fork_to(syncvar_producer, &v2, NULL, 1);
+        qthread_fork_to(multi_producer, &v1, NULL, 0);
+
+        qthread_readFF(&ret, &ret);
+
+        // Verify return value
+        if (ret != 2 * 42) {
+            iprintf("Bad return value! Wanted %u, got %u\n", 2 * 42, (unsigned int)ret);
+            return 1;
+        }
+    }
+
+    iprintf("\n***** Test rejection of an unaligned aligned_t precondition *****\n");
+    {
+        aligned_t  v[2] = { 0, 0 };
+        aligned_t *odd  = (aligned_t *)((char *)&v[0] + 2);
+
+        // the low bits of a precondition's address are not the caller's
+        assert(qthread_fork_precond(multi_producer, &v[1], NULL, 1, odd) == QTHREAD_BADARGS);
+    }
+
     iprintf("Success!\n");
 
     return 0;
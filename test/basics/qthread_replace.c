@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+/* far more replacements than would fit on a task's stack as plain calls */
+#define CHAIN 100000
+
+typedef struct {
+    aligned_t n;
+    aligned_t sum;
+} step_t;
+
+/* an argument too big to be copied into any qthread_t */
+typedef struct {
+    aligned_t     n;
+    unsigned char bytes[2000];
+} big_t;
+
+static aligned_t frames[2];
+
+static aligned_t countdown(void *arg)
+{
+    step_t     s = *(step_t *)arg;
+    aligned_t *tl;
+
+    /* the task's own stack, task-local data, and return value are kept */
+    tl = (aligned_t *)qthread_get_tasklocal(sizeof(aligned_t));
+    if (s.sum == 0) {
+        *tl = 42;
+    }
+    assert(*tl == 42);
+    if (s.n % 1000 == 0) {
+        aligned_t here;
+
+        frames[s.n != 0] = (aligned_t)(uintptr_t)&here;
+        qthread_yield();
+    }
+    if (s.n > 0) {
+        s.sum += s.n;
+        s.n--;
+        qthread_replace(countdown, &s, sizeof(s));
+        assert(0);
+    }
+    return s.sum;
+}
+
+static aligned_t through_pointer(void *arg)
+{
+    aligned_t *n = (aligned_t *)arg;
+
+    if (*n > 0) {
+        (*n)--;
+        qthread_replace(through_pointer, n, 0);
+        assert(0);
+    }
+    return 7;
+}
+
+static aligned_t shrink(void *arg)
+{
+    return ((step_t *)arg)->n + ((step_t *)arg)->sum;
+}
+
+static aligned_t grow(void *arg)
+{
+    big_t *b = (big_t *)arg;
+
+    for (size_t i = 0; i < sizeof(b->bytes); i++) {
+        assert(b->bytes[i] == (unsigned char)i);
+    }
+    if (b->n > 0) {
+        big_t copy = *b;
+
+        copy.n--;
+        qthread_replace(grow, &copy, sizeof(copy));
+        assert(0);
+    } else {
+        step_t s = { 1, 2 };
+
+        qthread_replace(shrink, &s, sizeof(s));
+        assert(0);
+    }
+    return 0;
+}
+
+static aligned_t start_grow(void *arg)
+{
+    big_t b;
+
+    b.n = 10;
+    for (size_t i = 0; i < sizeof(b.bytes); i++) {
+        b.bytes[i] = (unsigned char)i;
+    }
+    qthread_replace(grow, &b, sizeof(b));
+    assert(0);
+    return 0;
+}
+
+static aligned_t check_big(void *arg)
+{
+    big_t *b = (big_t *)arg;
+
+    for (size_t i = 0; i < sizeof(b->bytes); i++) {
+        assert(b->bytes[i] == (unsigned char)i);
+    }
+    return b->n;
+}
+
+/* passes on its own argument, which was copied out of line, uncopied */
+static aligned_t pass_own(void *arg)
+{
+    qthread_replace(check_big, arg, 0);
+    assert(0);
+    return 0;
+}
+
+static aligned_t try_simple(void *arg)
+{
+    return qthread_replace(shrink, arg, 0) == QTHREAD_NOT_ALLOWED;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    step_t    s = { CHAIN, 0 };
+    aligned_t n = 1000;
+    aligned_t ret;
+    syncvar_t sv = SYNCVAR_EMPTY_INITIALIZER;
+    uint64_t  svret;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    /* a long chain, with the argument copied each time */
+    qthread_spawn(countdown, &s, sizeof(s), &ret, 0, NULL, NO_SHEPHERD, 0);
+    qthread_readFF(NULL, &ret);
+    iprintf("sum of 1..%d by replacement: %lu\n", CHAIN, (unsigned long)ret);
+    assert(ret == (aligned_t)CHAIN * (CHAIN + 1) / 2);
+    assert(frames[0] == frames[1]); /* every step starts at the same depth */
+
+    /* the argument passed as a pointer, and a syncvar_t return value */
+    qthread_spawn(through_pointer, &n, 0, &sv, 0, NULL, NO_SHEPHERD,
+                  QTHREAD_SPAWN_RET_SYNCVAR_T);
+    qthread_syncvar_readFF(&svret, &sv);
+    assert(svret == 7 && n == 0);
+
+    /* arguments copied out of line and back into the qthread_t; every
+     * step has a big_t on its stack */
+    qthread_spawn(start_grow, NULL, 0, &ret, 0, NULL, NO_SHEPHERD,
+                  QTHREAD_SPAWN_STACK(QTHREAD_STACK_64K));
+    qthread_readFF(NULL, &ret);
+    assert(ret == 3);
+    iprintf("argument copies resized\n");
+
+    /* the task's own out-of-line argument copy, passed through as is */
+    {
+        big_t b;
+
+        b.n = 5;
+        for (size_t i = 0; i < sizeof(b.bytes); i++) {
+            b.bytes[i] = (unsigned char)i;
+        }
+        qthread_spawn(pass_own, &b, sizeof(b), &ret, 0, NULL, NO_SHEPHERD, 0);
+        memset(&b, 0, sizeof(b));
+        qthread_readFF(NULL, &ret);
+        assert(ret == 5);
+    }
+
+    /* neither the main task nor a simple task can be replaced */
+    assert(qthread_replace(shrink, &s, 0) == QTHREAD_NOT_ALLOWED);
+    assert(qthread_replace(NULL, NULL, 0) == QTHREAD_BADARGS);
+    qthread_spawn(try_simple, NULL, 0, &ret, 0, NULL, NO_SHEPHERD, QTHREAD_SPAWN_SIMPLE);
+    qthread_readFF(NULL, &ret);
+    assert(ret == 1);
+
+    return 0;
+}
+
+/* vim:set expandtab */
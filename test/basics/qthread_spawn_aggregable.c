@@ -0,0 +1,110 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h" /* for QTHREAD_TASK_AGGREGATION */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/sinc.h>
+#include "argparsing.h"
+
+#define NTASKS 4096
+
+static aligned_t rets[NTASKS];
+static aligned_t ids[NTASKS];
+
+static aligned_t square(void *arg)
+{
+    const aligned_t i = (aligned_t)(uintptr_t)arg;
+
+    ids[i] = qthread_id();
+    return i * i;
+}
+
+static aligned_t deref(void *arg)
+{
+    return *(aligned_t *)arg + 1;
+}
+
+static void spawn_all(qthread_f f,
+                      int       sinc_ret,
+                      qt_sinc_t *sinc)
+{
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        if (sinc_ret) {
+            qthread_spawn(f, (void *)(uintptr_t)i, 0, sinc, 0, NULL, NO_SHEPHERD,
+                          QTHREAD_SPAWN_AGGREGABLE | QTHREAD_SPAWN_SIMPLE | QTHREAD_SPAWN_RET_SINC);
+        } else {
+            qthread_spawn(f, (void *)(uintptr_t)i, 0, &rets[i], 0, NULL, NO_SHEPHERD,
+                          QTHREAD_SPAWN_AGGREGABLE | QTHREAD_SPAWN_SIMPLE);
+        }
+    }
+}
+
+static void sum(void *tgt,
+                const void *src)
+{
+    *(aligned_t *)tgt += *(aligned_t *)src;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    const aligned_t zero = 0;
+    aligned_t       total, expect = 0;
+    unsigned long   runs = 0;
+    qt_sinc_t      *sinc;
+
+    /* one worker, so that the spawned tasks pile up in its queue */
+    setenv("QT_NUM_SHEPHERDS", "1", 1);
+    setenv("QT_NUM_WORKERS_PER_SHEPHERD", "1", 1);
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    /* every task fills its own return value, aggregated or not */
+    for (int round = 0; round < 4; round++) {
+        spawn_all(square, 0, NULL);
+        for (aligned_t i = 0; i < NTASKS; i++) {
+            qthread_readFF(NULL, &rets[i]);
+            assert(rets[i] == i * i);
+        }
+    }
+    /* tasks run in one aggregate share the id of the task that heads it */
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        runs += (i == 0) || (ids[i] != ids[i - 1]);
+    }
+    iprintf("%d tasks ran as %lu separate runs\n", NTASKS, runs);
+#if defined(QTHREAD_TASK_AGGREGATION) && !defined(NO_AGGREGATING_QUEUE)
+    /* the batch size is learned within the first round, so some tasks of the
+     * last one must have been run in aggregates */
+    assert(runs < NTASKS);
+#else
+    assert(runs == NTASKS);
+#endif
+
+    /* aggregates submit to a sinc like their tasks would */
+    sinc = qt_sinc_create(sizeof(aligned_t), &zero, sum, NTASKS);
+    spawn_all(square, 1, sinc);
+    qt_sinc_wait(sinc, &total);
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        expect += i * i;
+    }
+    iprintf("sinc total %lu, expected %lu\n", (unsigned long)total, (unsigned long)expect);
+    assert(total == expect);
+    qt_sinc_destroy(sinc);
+
+    /* tasks with a copied argument are never folded into another */
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        qthread_spawn(deref, &i, sizeof(aligned_t), &rets[i], 0, NULL, NO_SHEPHERD,
+                      QTHREAD_SPAWN_AGGREGABLE | QTHREAD_SPAWN_SIMPLE);
+    }
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == i + 1);
+    }
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/sinc.h>
+#include "argparsing.h"
+
+/* more than one batch of qthread_spawn_bulk(), and not a multiple of one */
+#define NTASKS 1000
+
+typedef struct {
+    aligned_t i;
+    aligned_t pad[3];
+} arg_t;
+
+static arg_t     args[NTASKS];
+static void     *ptrs[NTASKS];
+static aligned_t rets[NTASKS];
+static syncvar_t svs[NTASKS];
+
+static aligned_t copied(void *arg)
+{
+    arg_t *a = (arg_t *)arg;
+
+    assert(a != &args[a->i]); /* a copy */
+    return a->i * 2;
+}
+
+static aligned_t pointed(void *arg)
+{
+    return *(aligned_t *)arg + 1;
+}
+
+static aligned_t where(void *arg)
+{
+    return qthread_shep();
+}
+
+static void sum(void       *tgt,
+                const void *src)
+{
+    *(aligned_t *)tgt += *(aligned_t *)src;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    const aligned_t        zero = 0;
+    aligned_t              total, expect = 0;
+    qthread_shepherd_id_t  nsheps;
+    qthread_shepherd_id_t *sheps;
+    qt_sinc_t             *sinc;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+    nsheps = qthread_num_shepherds();
+
+    /* copied arguments, one return value each */
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        args[i].i = i;
+        ptrs[i]   = &args[i].i;
+    }
+    assert(qthread_spawn_bulk(copied, args, sizeof(arg_t), NTASKS, rets, NULL, 0) == QTHREAD_SUCCESS);
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == i * 2);
+    }
+    iprintf("%d tasks with copied arguments done\n", NTASKS);
+
+    /* pointer arguments, syncvar_t return values, simple tasks */
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        svs[i] = SYNCVAR_EMPTY_INITIALIZER;
+    }
+    assert(qthread_spawn_bulk(pointed, ptrs, 0, NTASKS, svs, NULL,
+                              QTHREAD_SPAWN_RET_SYNCVAR_T | QTHREAD_SPAWN_SIMPLE) == QTHREAD_SUCCESS);
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        uint64_t r;
+
+        qthread_syncvar_readFF(&r, &svs[i]);
+        assert(r == i + 1);
+    }
+    iprintf("%d tasks with pointer arguments done\n", NTASKS);
+
+    /* one sinc for them all */
+    sinc = qt_sinc_create(sizeof(aligned_t), &zero, sum, NTASKS);
+    assert(qthread_spawn_bulk(pointed, ptrs, 0, NTASKS, sinc, NULL,
+                              QTHREAD_SPAWN_RET_SINC) == QTHREAD_SUCCESS);
+    qt_sinc_wait(sinc, &total);
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        expect += i + 1;
+    }
+    iprintf("sinc total %lu, expected %lu\n", (unsigned long)total, (unsigned long)expect);
+    assert(total == expect);
+    qt_sinc_destroy(sinc);
+
+    /* every task runs on the shepherd it was sent to */
+    sheps = malloc(NTASKS * sizeof(qthread_shepherd_id_t));
+    assert(sheps != NULL);
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        sheps[i] = (qthread_shepherd_id_t)((i * 7) % nsheps);
+    }
+    assert(qthread_spawn_bulk(where, NULL, 0, NTASKS, rets, sheps, 0) == QTHREAD_SUCCESS);
+    for (aligned_t i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == sheps[i]);
+    }
+    iprintf("%d tasks ran on %u shepherds as sent\n", NTASKS, (unsigned)nsheps);
+    free(sheps);
+
+    /* spawning nothing succeeds; spawning into a new team is refused */
+    assert(qthread_spawn_bulk(where, NULL, 0, 0, NULL, NULL, 0) == QTHREAD_SUCCESS);
+    assert(qthread_spawn_bulk(where, NULL, 0, 1, NULL, NULL, QTHREAD_SPAWN_NEW_TEAM) == QTHREAD_BADARGS);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include "argparsing.h"
+
+#define NTASKS 8
+#define NLATE  4
+
+static aligned_t    seq = 0;
+static unsigned int order[NTASKS];
+
+static aligned_t record(void *arg)
+{
+    order[qthread_incr(&seq, 1)] = (unsigned int)(uintptr_t)arg;
+    return 0;
+}
+
+static aligned_t nothing(void *arg)
+{
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t          rets[NTASKS];
+    qthread_lateness_t stats;
+    double             now;
+    int                edf;
+
+    /* one worker, so the run order is the dispatch order */
+    setenv("QT_NUM_SHEPHERDS", "1", 1);
+    setenv("QT_NUM_WORKERS_PER_SHEPHERD", "1", 1);
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    edf = (qthread_lateness(&stats) == QTHREAD_SUCCESS);
+    iprintf("deadlines are %s\n", edf ? "tracked" : "ignored");
+
+    /* spawned latest deadline first; none of them can be late */
+    now = qtimer_wtime();
+    for (int i = 0; i < NTASKS; i++) {
+        int r = qthread_spawn_deadline(record, (void *)(uintptr_t)i, 0, &rets[i], 0, NULL,
+                                       NO_SHEPHERD, 0, now + 1000.0 * (NTASKS - i));
+        assert(r == QTHREAD_SUCCESS);
+    }
+    for (int i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    for (int i = 0; i < NTASKS; i++) {
+        iprintf("run %i: task %u\n", i, order[i]);
+        if (edf) {
+            assert(order[i] == NTASKS - 1 - i);
+        }
+    }
+
+    /* these are already late when spawned */
+    now = qtimer_wtime();
+    for (int i = 0; i < NLATE; i++) {
+        int r = qthread_fork_deadline(nothing, NULL, &rets[i], now - 1.0);
+        assert(r == QTHREAD_SUCCESS);
+    }
+    for (int i = 0; i < NLATE; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    if (edf) {
+        assert(qthread_lateness(&stats) == QTHREAD_SUCCESS);
+        iprintf("%lu tasks, %lu late, max %g s, p50 %g s, p100 %g s\n",
+                (unsigned long)stats.tasks, (unsigned long)stats.late,
+                stats.max_lateness,
+                qthread_lateness_quantile(&stats, 0.5),
+                qthread_lateness_quantile(&stats, 1.0));
+        assert(stats.tasks == NTASKS + NLATE);
+        assert(stats.late == NLATE);
+        assert(stats.max_lateness >= 1.0);
+        assert(stats.total_lateness >= NLATE * 1.0);
+        assert(qthread_lateness_quantile(&stats, 0.5) == 0.0);
+        assert(qthread_lateness_quantile(&stats, 1.0) >= 1.0);
+
+        qthread_lateness_reset();
+        assert(qthread_lateness(&stats) == QTHREAD_SUCCESS);
+        assert(stats.tasks == 0 && stats.late == 0);
+    }
+
+    return 0;
+}
+
+/* vim:set expandtab */
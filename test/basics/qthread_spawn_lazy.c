@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+static aligned_t inlined = 0;
+
+static aligned_t serial_fib(unsigned int n)
+{
+    return (n < 2) ? n : serial_fib(n - 1) + serial_fib(n - 2);
+}
+
+typedef struct {
+    unsigned int n;
+    unsigned int parent; /* id of the spawning task */
+} fib_arg_t;
+
+static aligned_t fib(void *arg_)
+{
+    fib_arg_t *arg = (fib_arg_t *)arg_;
+    aligned_t  ret1, ret2;
+    fib_arg_t  a1, a2;
+
+    /* a task run by the task that joins on it has that task's id */
+    if (qthread_id() == arg->parent) {
+        qthread_incr(&inlined, 1);
+    }
+    if (arg->n < 2) {
+        return arg->n;
+    }
+    a1.n      = arg->n - 1;
+    a2.n      = arg->n - 2;
+    a1.parent = a2.parent = qthread_id();
+    qthread_spawn(fib, &a1, 0, &ret1, 0, NULL, NO_SHEPHERD, QTHREAD_SPAWN_LAZY);
+    qthread_spawn(fib, &a2, 0, &ret2, 0, NULL, NO_SHEPHERD, QTHREAD_SPAWN_LAZY);
+    qthread_readFF(NULL, &ret1);
+    qthread_readFF(NULL, &ret2);
+    return ret1 + ret2;
+}
+
+static aligned_t fib_syncvar(void *arg_)
+{
+    unsigned int n = (unsigned int)(uintptr_t)arg_;
+    syncvar_t    ret1 = SYNCVAR_STATIC_INITIALIZER;
+    syncvar_t    ret2 = SYNCVAR_STATIC_INITIALIZER;
+    uint64_t     r1, r2;
+
+    if (n < 2) {
+        return n;
+    }
+    qthread_spawn(fib_syncvar, (void *)(uintptr_t)(n - 1), 0, &ret1, 0, NULL, NO_SHEPHERD,
+                  QTHREAD_SPAWN_LAZY | QTHREAD_SPAWN_RET_SYNCVAR_T);
+    qthread_spawn(fib_syncvar, (void *)(uintptr_t)(n - 2), 0, &ret2, 0, NULL, NO_SHEPHERD,
+                  QTHREAD_SPAWN_LAZY | QTHREAD_SPAWN_RET_SYNCVAR_T);
+    qthread_syncvar_readFF(&r1, &ret1);
+    qthread_syncvar_readFF(&r2, &ret2);
+    return r1 + r2;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    fib_arg_t arg = { 20, 0 };
+    aligned_t ret;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    NUMARG(arg.n, "FIB_INPUT");
+
+    /* lazily spawned tasks compute the same results whoever runs them */
+    arg.parent = (unsigned int)-1;
+    qthread_fork(fib, &arg, &ret);
+    qthread_readFF(NULL, &ret);
+    iprintf("fib(%u) = %lu, %lu tasks ran on their parent's stack\n",
+            arg.n, (unsigned long)ret, (unsigned long)inlined);
+    assert(ret == serial_fib(arg.n));
+
+    qthread_fork(fib_syncvar, (void *)(uintptr_t)arg.n, &ret);
+    qthread_readFF(NULL, &ret);
+    iprintf("fib_syncvar(%u) = %lu\n", arg.n, (unsigned long)ret);
+    assert(ret == serial_fib(arg.n));
+
+    return 0;
+}
+
+/* vim:set expandtab */
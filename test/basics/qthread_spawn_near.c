@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+#define NCHUNKS   64
+#define CHUNK_LEN 4096
+#define NTASKS    1000
+
+static aligned_t data[NCHUNKS][CHUNK_LEN];
+static aligned_t sums[NCHUNKS];
+static aligned_t rets[NTASKS];
+
+static aligned_t sum_chunk(void *arg)
+{
+    const aligned_t *chunk = (const aligned_t *)arg;
+    aligned_t        sum   = 0;
+
+    for (size_t i = 0; i < CHUNK_LEN; i++) {
+        sum += chunk[i];
+    }
+    return sum;
+}
+
+typedef struct {
+    const aligned_t      *addr;
+    qthread_shepherd_id_t target;
+} placement_t;
+
+static placement_t where[NTASKS];
+
+/* Did the task run where it was placed: on the node that holds addr, if
+ * that is known, and on its target shepherd, unless thieves on the target's
+ * node may take it (NODE_STEALING)? qthread_shep_near() returns the caller's
+ * own shepherd if it is on the node that holds addr. */
+static aligned_t placed(void *arg)
+{
+    const placement_t    *p = (const placement_t *)arg;
+    qthread_shepherd_id_t here, near;
+
+    qthread_yield();
+    here = qthread_shep();
+    near = qthread_shep_near(p->addr);
+    if ((near != NO_SHEPHERD) && (near != here)) {
+        return 0;
+    }
+#ifdef NODE_STEALING
+    return 1;
+#else
+    return (p->target == NO_SHEPHERD) || (here == p->target);
+#endif
+}
+
+/* Memory first touched on a shepherd is on that shepherd's node, so the
+ * shepherd must count as near it: this checks the node that each shepherd
+ * believes it is on against the one the OS put its memory on. */
+static aligned_t touch_here(void *arg)
+{
+    const size_t          len  = 1 << 16;
+    qthread_shepherd_id_t here = qthread_shep();
+    qthread_shepherd_id_t near;
+    volatile char        *page;
+
+    (void)arg;
+    page = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(page != MAP_FAILED);
+    page[0] = 1;
+    near    = qthread_shep_near((const void *)page);
+    iprintf("memory touched on shepherd %d is near shepherd %d\n", (int)here, (int)near);
+    munmap((void *)page, len);
+    return (near == NO_SHEPHERD) || (near == here);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qthread_shepherd_id_t  nsheps, near;
+    qthread_shepherd_id_t *sheps;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+    nsheps = qthread_num_shepherds();
+
+    /* the node of an address that is not there is not known */
+    assert(qthread_shep_near(NULL) == NO_SHEPHERD);
+
+    for (size_t c = 0; c < NCHUNKS; c++) {
+        for (size_t i = 0; i < CHUNK_LEN; i++) {
+            data[c][i] = c + i;
+        }
+    }
+    near = qthread_shep_near(data[0]);
+    iprintf("data[0] is near shepherd %d\n", (int)near);
+    assert(near == NO_SHEPHERD || near < nsheps);
+
+    /* tasks placed by the data they work on */
+    for (size_t c = 0; c < NCHUNKS; c++) {
+        qthread_fork_near(sum_chunk, data[c], &sums[c], data[c]);
+    }
+    for (size_t c = 0; c < NCHUNKS; c++) {
+        qthread_readFF(NULL, &sums[c]);
+        assert(sums[c] == c * CHUNK_LEN + (aligned_t)CHUNK_LEN * (CHUNK_LEN - 1) / 2);
+    }
+    iprintf("%d chunks summed near their data\n", NCHUNKS);
+
+    /* ... and they run on that data's node */
+    for (size_t i = 0; i < NTASKS; i++) {
+        where[i].addr   = data[i % NCHUNKS];
+        where[i].target = NO_SHEPHERD;
+        assert(qthread_spawn_near(placed, &where[i], sizeof(placement_t), &rets[i], 0, NULL,
+                                  where[i].addr, 0) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == 1);
+    }
+
+    /* a target shepherd as a hint: the tasks run there, or on its node */
+    for (size_t i = 0; i < NTASKS; i++) {
+        where[i].addr   = NULL;
+        where[i].target = (qthread_shepherd_id_t)(i % nsheps);
+        assert(qthread_spawn(placed, &where[i], sizeof(placement_t), &rets[i], 0, NULL,
+                             where[i].target, QTHREAD_SPAWN_NEAR) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == 1);
+    }
+
+    /* ... and in bulk */
+    sheps = malloc(NTASKS * sizeof(qthread_shepherd_id_t));
+    assert(sheps != NULL);
+    for (size_t i = 0; i < NTASKS; i++) {
+        sheps[i] = where[i].target;
+    }
+    assert(qthread_spawn_bulk(placed, where, sizeof(placement_t), NTASKS, rets, sheps,
+                              QTHREAD_SPAWN_NEAR) == QTHREAD_SUCCESS);
+    for (size_t i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == 1);
+    }
+    free(sheps);
+    iprintf("%d hinted tasks done on %d shepherds\n", NTASKS, (int)nsheps);
+
+    /* each shepherd is on the node of the memory it touches */
+    for (qthread_shepherd_id_t s = 0; s < nsheps; s++) {
+        assert(qthread_spawn(touch_here, NULL, 0, &rets[s], 0, NULL, s,
+                             QTHREAD_SPAWN_STACK(QTHREAD_STACK_64K)) == QTHREAD_SUCCESS);
+    }
+    for (qthread_shepherd_id_t s = 0; s < nsheps; s++) {
+        qthread_readFF(NULL, &rets[s]);
+        assert(rets[s] == 1);
+    }
+
+    return 0;
+}
+
+/* vim:set expandtab */
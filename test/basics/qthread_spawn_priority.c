@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+#define NHIGH 12
+
+static aligned_t    seq = 0;
+static unsigned int order[NHIGH + 1];
+
+static aligned_t record(void *arg)
+{
+    order[qthread_incr(&seq, 1)] = (unsigned int)(uintptr_t)arg;
+    return 0;
+}
+
+static void spawn_band(unsigned int band,
+                       aligned_t   *ret)
+{
+    int r = qthread_spawn(record, (void *)(uintptr_t)band, 0, ret, 0, NULL,
+                          NO_SHEPHERD, QTHREAD_SPAWN_PRIORITY(band));
+
+    assert(r == QTHREAD_SUCCESS);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    static const unsigned int bands[] = { 0, 0, 0, 3, 3, 2 };
+    aligned_t                 rets[NHIGH + 1];
+    unsigned int              low_at = NHIGH;
+
+    /* one worker, so the run order is the pick order */
+    setenv("QT_NUM_SHEPHERDS", "1", 1);
+    setenv("QT_NUM_WORKERS_PER_SHEPHERD", "1", 1);
+    setenv("QT_PRIORITY_BANDS", "4", 1);
+    setenv("QT_PRIORITY_AGING", "4", 1);
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+
+    /* higher bands run first; three priority picks stay under the aging limit */
+    for (int i = 0; i < 6; i++) {
+        spawn_band(bands[i], &rets[i]);
+    }
+    for (int i = 0; i < 6; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    for (int i = 0; i < 6; i++) {
+        iprintf("pick %i: band %u\n", i, order[i]);
+        if (i > 0) {
+            assert(order[i] <= order[i - 1]);
+        }
+    }
+
+    /* a band-0 task must not wait behind every band-3 task, nor jump them */
+    seq = 0;
+    spawn_band(0, &rets[0]);
+    for (int i = 1; i <= NHIGH; i++) {
+        spawn_band(3, &rets[i]);
+    }
+    for (int i = 0; i <= NHIGH; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    for (unsigned int i = 0; i <= NHIGH; i++) {
+        if (order[i] == 0) { low_at = i; }
+    }
+    iprintf("band-0 task ran at pick %u of %u\n", low_at, NHIGH + 1);
+    assert(low_at > 0 && low_at < NHIGH);
+
+    return 0;
+}
+
+/* vim:set expandtab */
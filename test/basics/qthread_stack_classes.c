@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+static const size_t class_size[QTHREAD_STACK_CLASSES] = { 0, 4096, 16384, 65536, 1048576 };
+
+/* uses about depth KiB of stack */
+static size_t deep(size_t depth)
+{
+    volatile char frame[1024];
+
+    memset((char *)frame, (int)depth, sizeof(frame));
+    return depth ? frame[depth % sizeof(frame)] + deep(depth - 1) : 0;
+}
+
+static aligned_t measure(void *arg)
+{
+    size_t depth = (size_t)(uintptr_t)arg;
+    size_t size  = (size_t)((char *)qthread_bos() - (char *)qthread_tos());
+
+    assert(qthread_stackleft() < size);
+    if (depth) {
+        deep(depth);
+    }
+    return size;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t rets[QTHREAD_STACK_CLASSES];
+    aligned_t dflt;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    for (int c = 0; c < QTHREAD_STACK_CLASSES; c++) {
+        /* recurse through half of the stacks of 64K and up */
+        size_t depth = (class_size[c] >= 65536) ? class_size[c] / 2048 : 0;
+
+        qthread_spawn(measure, (void *)(uintptr_t)depth, 0, &rets[c], 0, NULL,
+                      NO_SHEPHERD, QTHREAD_SPAWN_STACK(c));
+    }
+    for (int c = 0; c < QTHREAD_STACK_CLASSES; c++) {
+        qthread_readFF(NULL, &rets[c]);
+        iprintf("class %d: %lu byte stack\n", c, (unsigned long)rets[c]);
+        if (c == QTHREAD_STACK_DEFAULT) {
+            assert(rets[c] == qthread_readstate(STACK_SIZE));
+        } else {
+            assert(rets[c] >= class_size[c]);
+        }
+    }
+
+    /* a class past the last one means the default */
+    qthread_spawn(measure, NULL, 0, &dflt, 0, NULL, NO_SHEPHERD,
+                  QTHREAD_SPAWN_STACK(QTHREAD_STACK_CLASSES));
+    qthread_readFF(NULL, &dflt);
+    assert(dflt == qthread_readstate(STACK_SIZE));
+
+    return 0;
+}
+
+/* vim:set expandtab */
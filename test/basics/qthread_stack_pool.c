@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+#define NTASKS 2000
+
+static aligned_t go;
+static aligned_t started;
+
+static aligned_t waiter(void *arg)
+{
+    qthread_incr(&started, 1);
+    qthread_readFF(NULL, &go);
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    static aligned_t rets[NTASKS];
+    size_t           stacksize, reserved, resident;
+
+    /* one shepherd, so that every freed stack is on the same free list */
+    setenv("QT_NUM_SHEPHERDS", "1", 1);
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+    if (qthread_readstate(STACK_RESERVED_BYTES) == (size_t)(-1)) {
+        iprintf("stacks are not mmap()ed\n");
+        return 0;
+    }
+    stacksize = qthread_readstate(STACK_SIZE);
+
+    /* every blocked task holds on to a stack */
+    qthread_empty(&go);
+    for (int i = 0; i < NTASKS; i++) {
+        qthread_fork(waiter, NULL, &rets[i]);
+    }
+    while (started < NTASKS) {
+        qthread_yield();
+    }
+    reserved = qthread_readstate(STACK_RESERVED_BYTES);
+    resident = qthread_readstate(STACK_RESIDENT_BYTES);
+    iprintf("%d blocked tasks: %lu stack bytes reserved, %lu resident\n",
+            NTASKS, (unsigned long)reserved, (unsigned long)resident);
+    assert(reserved >= NTASKS * stacksize);
+    assert(resident <= reserved);
+    qthread_fill(&go);
+    for (int i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+
+    /* freed stacks are reused, rather than more being reserved */
+    for (int i = 0; i < NTASKS; i++) {
+        qthread_fork(waiter, NULL, &rets[i]);
+    }
+    for (int i = 0; i < NTASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    iprintf("after reuse: %lu reserved, %lu resident\n",
+            (unsigned long)qthread_readstate(STACK_RESERVED_BYTES),
+            (unsigned long)qthread_readstate(STACK_RESIDENT_BYTES));
+    assert(qthread_readstate(STACK_RESERVED_BYTES) == reserved);
+
+    return 0;
+}
+
+/* vim:set expandtab */
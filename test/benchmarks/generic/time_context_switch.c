@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include "argparsing.h"
+
+// Yield ping-pong: tasks on one shepherd take turns yielding to each other.
+// Every yield is two context switches, from the task to its worker and from
+// the worker to the next task.
+
+static aligned_t iterations = 10000000;
+static aligned_t ready      = 0;
+
+static aligned_t pingpong(void *arg)
+{
+    qthread_incr(&ready, 1);
+    while (ready < (aligned_t)(uintptr_t)arg) {
+        qthread_yield();
+    }
+    for (aligned_t i = 0; i < iterations; i++) {
+        qthread_yield();
+    }
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qtimer_t   timer = qtimer_create();
+    aligned_t  ntasks = 2;
+    aligned_t *rets;
+    double     secs;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    NUMARG(iterations, "ITERATIONS");
+    NUMARG(ntasks, "TASKS");
+    assert(ntasks > 0);
+    rets = malloc(ntasks * sizeof(aligned_t));
+    assert(rets);
+
+    qtimer_start(timer);
+    for (aligned_t i = 0; i < ntasks; i++) {
+        qthread_fork_to(pingpong, (void *)(uintptr_t)ntasks, &rets[i], 0);
+    }
+    for (aligned_t i = 0; i < ntasks; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    qtimer_stop(timer);
+    secs = qtimer_secs(timer);
+
+    printf("%lu tasks, %lu yields each: %f secs, %f nsecs per switch\n",
+           (unsigned long)ntasks, (unsigned long)iterations, secs,
+           secs * 1e9 / (2.0 * ntasks * iterations));
+
+    qtimer_destroy(timer);
+    free(rets);
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -84,6 +84,21 @@ static void balanced_noncomp_readFF(const size_t startat,
     }
 }                                      /*}}} */
 
+static void balanced_noncomp_readFE_writeEF(const size_t startat,
+                                            const size_t stopat,
+                                            void        *arg)
+{                                      /*{{{ */
+    size_t    i;
+    aligned_t myinc = 0;
+    aligned_t tmp;
+
+    for (i = startat; i < stopat; i++) {
+        qthread_readFE(&tmp, &myinc);
+        tmp++;
+        qthread_writeEF(&myinc, &tmp);
+    }
+}                                      /*}}} */
+
 static aligned_t justreturn(void *arg)
 {   /*{{{*/
     return 7;
@@ -280,6 +295,24 @@ int main(int   argc,
                human_readable_rate(rate));
     }
 
+    if (TEST_SELECTION & (1 << 8)) {
+        /* BALANCED INDEPENDENT EMPTY/FILL LOOP */
+        printf("\tBalanced independent readFE/writeEF: ");
+        fflush(stdout);
+        qtimer_start(timer);
+        qt_loop_balance(0, ITERATIONS * MAXPARALLELISM,
+                        balanced_noncomp_readFE_writeEF,
+                        NULL);
+        qtimer_stop(timer);
+
+        printf("%13g secs (%u-threads %u iters)\n", qtimer_secs(timer),
+               workers, (unsigned)(ITERATIONS * MAXPARALLELISM));
+        iprintf("\t + average readFE/writeEF time: %19g secs\n",
+                qtimer_secs(timer) / (ITERATIONS * MAXPARALLELISM));
+        printf("\t = readFE/writeEF throughput: %21f pairs/sec\n",
+               (ITERATIONS * MAXPARALLELISM) / qtimer_secs(timer));
+    }
+
     if (TEST_SELECTION & (1 << 6)) {
         syncvar_t *rets = calloc(ITERATIONS, sizeof(syncvar_t));
         size_t     i;
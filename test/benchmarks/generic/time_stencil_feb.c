@@ -10,6 +10,25 @@
 
 #include "argparsing.h"
 
+/* With STENCIL_FEB_WORD defined (the time_stencil_feb_word build), the stencil
+ * points are qt_feb_word_t's rather than aligned_t's whose full/empty bits live
+ * in the FEB table. */
+#ifdef STENCIL_FEB_WORD
+typedef qt_feb_word_t point_t;
+# define VALUE(p)              ((p)->data)
+# define WAIT_FULL(p)          qthread_feb_word_readFF(NULL, (p))
+# define EMPTY(p)              qthread_feb_word_empty(p)
+# define WRITEF_CONST(p, v)    qthread_feb_word_writeF_const((p), (v))
+# define WRITEEF_CONST(p, v)   qthread_feb_word_writeEF_const((p), (v))
+#else
+typedef aligned_t point_t;
+# define VALUE(p)              (*(p))
+# define WAIT_FULL(p)          qthread_readFF((p), (p))
+# define EMPTY(p)              qthread_empty(p)
+# define WRITEF_CONST(p, v)    qthread_writeF_const((p), (v))
+# define WRITEEF_CONST(p, v)   qthread_writeEF_const((p), (v))
+#endif
+
 #define NUM_STAGES 3
 #define BOUNDARY 42
 //#define BOUNDARY_SYNC
@@ -35,7 +54,7 @@ static int workload_var;
 typedef struct stencil {
     size_t N;
     size_t M;
-    aligned_t **stage[NUM_STAGES];
+    point_t **stage[NUM_STAGES];
     qt_barrier_t *barrier;
 } stencil_t;
 
@@ -78,9 +97,9 @@ static inline void perform_local_work(void)
 static inline void print_stage(stencil_t *points, size_t stage)
 {
     for (int i = 0; i < points->N; i++) {
-        fprintf(stderr, "%02lu", (unsigned long)points->stage[stage][i][0]);
+        fprintf(stderr, "%02lu", (unsigned long)VALUE(&points->stage[stage][i][0]));
         for (int j = 1; j < points->M; j++) {
-            fprintf(stderr, "  %02lu", (unsigned long)points->stage[stage][i][j]);
+            fprintf(stderr, "  %02lu", (unsigned long)VALUE(&points->stage[stage][i][j]));
         }
         fprintf(stderr, "\n");
     }
@@ -108,65 +127,65 @@ static aligned_t update_prime(void *arg)
     size_t next_stage_id = next_stage(stage);
 
     // Sum all neighboring values from previous stage
-    aligned_t **prev = points->stage[prev_stage(stage)];
+    point_t **prev = points->stage[prev_stage(stage)];
 #ifdef BOUNDARY_SYNC
-    qthread_readFF(NORTH(prev, i, j), NORTH(prev, i, j));
-    qthread_readFF(WEST(prev, i, j), WEST(prev, i, j));
-    qthread_readFF(EAST(prev, i, j), EAST(prev, i, j));
-    qthread_readFF(SOUTH(prev, i, j), SOUTH(prev, i, j));
+    WAIT_FULL(NORTH(prev, i, j));
+    WAIT_FULL(WEST(prev, i, j));
+    WAIT_FULL(EAST(prev, i, j));
+    WAIT_FULL(SOUTH(prev, i, j));
 #else
     if (i == 1) {                   // North edge
         if (j == 1) {                   // West edge: EAST & SOUTH
-            qthread_readFF(EAST(prev, i, j), EAST(prev, i, j));
-            qthread_readFF(SOUTH(prev, i, j), SOUTH(prev, i, j));
+            WAIT_FULL(EAST(prev, i, j));
+            WAIT_FULL(SOUTH(prev, i, j));
         } else if (j == points->M-2) {    // East edge: WEST & SOUTH
-            qthread_readFF(WEST(prev, i, j), WEST(prev, i, j));
-            qthread_readFF(SOUTH(prev, i, j), SOUTH(prev, i, j));
+            WAIT_FULL(WEST(prev, i, j));
+            WAIT_FULL(SOUTH(prev, i, j));
         } else                            // Interior: WEST & EAST & SOUTH
-            qthread_readFF(WEST(prev, i, j), WEST(prev, i, j));
-            qthread_readFF(EAST(prev, i, j), EAST(prev, i, j));
-            qthread_readFF(SOUTH(prev, i, j), SOUTH(prev, i, j));
+            WAIT_FULL(WEST(prev, i, j));
+            WAIT_FULL(EAST(prev, i, j));
+            WAIT_FULL(SOUTH(prev, i, j));
     } else if (i == points->N-2) {  // South edge
         if (j == 1) {                   // West edge: NORTH & EAST
-            qthread_readFF(NORTH(prev, i, j), NORTH(prev, i, j));
-            qthread_readFF(EAST(prev, i, j), EAST(prev, i, j));
+            WAIT_FULL(NORTH(prev, i, j));
+            WAIT_FULL(EAST(prev, i, j));
         } else if (j == points->M-2) {    // East edge: NORTH & WEST
-            qthread_readFF(NORTH(prev, i, j), NORTH(prev, i, j));
-            qthread_readFF(WEST(prev, i, j), WEST(prev, i, j));
+            WAIT_FULL(NORTH(prev, i, j));
+            WAIT_FULL(WEST(prev, i, j));
         } else                            // Interior: NORTH & WEST & EAST
-            qthread_readFF(NORTH(prev, i, j), NORTH(prev, i, j));
-            qthread_readFF(WEST(prev, i, j), WEST(prev, i, j));
-            qthread_readFF(EAST(prev, i, j), EAST(prev, i, j));
+            WAIT_FULL(NORTH(prev, i, j));
+            WAIT_FULL(WEST(prev, i, j));
+            WAIT_FULL(EAST(prev, i, j));
     } else {                        // Interior
         if (j == 1) {                   // West edge: NORTH & EAST & SOUTH
-            qthread_readFF(NORTH(prev, i, j), NORTH(prev, i, j));
-            qthread_readFF(EAST(prev, i, j), EAST(prev, i, j));
-            qthread_readFF(SOUTH(prev, i, j), SOUTH(prev, i, j));
+            WAIT_FULL(NORTH(prev, i, j));
+            WAIT_FULL(EAST(prev, i, j));
+            WAIT_FULL(SOUTH(prev, i, j));
         } else if (j == points->M-2) {    // East edge: NORTH & WEST & SOUTH
-            qthread_readFF(NORTH(prev, i, j), NORTH(prev, i, j));
-            qthread_readFF(WEST(prev, i, j), WEST(prev, i, j));
-            qthread_readFF(SOUTH(prev, i, j), SOUTH(prev, i, j));
+            WAIT_FULL(NORTH(prev, i, j));
+            WAIT_FULL(WEST(prev, i, j));
+            WAIT_FULL(SOUTH(prev, i, j));
         } else                            // Interior: ALL
-            qthread_readFF(NORTH(prev, i, j), NORTH(prev, i, j));
-            qthread_readFF(WEST(prev, i, j), WEST(prev, i, j));
-            qthread_readFF(EAST(prev, i, j), EAST(prev, i, j));
-            qthread_readFF(SOUTH(prev, i, j), SOUTH(prev, i, j));
+            WAIT_FULL(NORTH(prev, i, j));
+            WAIT_FULL(WEST(prev, i, j));
+            WAIT_FULL(EAST(prev, i, j));
+            WAIT_FULL(SOUTH(prev, i, j));
     }
 #endif // BOUNDARY_SYNC
 
     // Perform local work
     perform_local_work();
-    aligned_t sum = *(NORTH(prev, i, j)) 
-                  + *(WEST(prev, i, j)) 
-                  + *(HERE(prev, i, j)) 
-                  + *(EAST(prev, i, j)) 
-                  + *(SOUTH(prev, i, j));
+    aligned_t sum = VALUE(NORTH(prev, i, j)) 
+                  + VALUE(WEST(prev, i, j)) 
+                  + VALUE(HERE(prev, i, j)) 
+                  + VALUE(EAST(prev, i, j)) 
+                  + VALUE(SOUTH(prev, i, j));
 
     // Empty the next stage for this index
-    qthread_empty(&points->stage[next_stage_id][i][j]);
+    EMPTY(&points->stage[next_stage_id][i][j]);
 
     // Update this point
-    qthread_writeEF_const(&points->stage[stage][i][j], sum/NUM_NEIGHBORS);
+    WRITEEF_CONST(&points->stage[stage][i][j], sum/NUM_NEIGHBORS);
     
     if (step < num_timesteps) {
         // Spawn next stage
@@ -190,21 +209,21 @@ static aligned_t update(void *arg)
     size_t next_stage_id = next_stage(stage);
 
     // Sum all neighboring values from previous stage
-    aligned_t **prev = points->stage[prev_stage(stage)];
+    point_t **prev = points->stage[prev_stage(stage)];
 
     // Perform local work
     perform_local_work();
-    aligned_t sum = *(NORTH(prev, i, j)) 
-                  + *(WEST(prev, i, j)) 
-                  + *(HERE(prev, i, j)) 
-                  + *(EAST(prev, i, j)) 
-                  + *(SOUTH(prev, i, j));
+    aligned_t sum = VALUE(NORTH(prev, i, j)) 
+                  + VALUE(WEST(prev, i, j)) 
+                  + VALUE(HERE(prev, i, j)) 
+                  + VALUE(EAST(prev, i, j)) 
+                  + VALUE(SOUTH(prev, i, j));
 
     // Empty the next stage for this index
-    qthread_empty(&points->stage[next_stage_id][i][j]);
+    EMPTY(&points->stage[next_stage_id][i][j]);
 
     // Update this point
-    qthread_writeEF_const(&points->stage[stage][i][j], sum/NUM_NEIGHBORS);
+    WRITEEF_CONST(&points->stage[stage][i][j], sum/NUM_NEIGHBORS);
     
     if (step < num_timesteps) {
         // Spawn next stage
@@ -253,19 +272,19 @@ int main(int argc, char *argv[])
     points.N = n + 2;
     points.M = m + 2;
 
-    points.stage[0] = calloc(points.N,sizeof(aligned_t *));
+    points.stage[0] = calloc(points.N,sizeof(point_t *));
     assert(NULL != points.stage[0]);
-    points.stage[1] = calloc(points.N,sizeof(aligned_t *));
+    points.stage[1] = calloc(points.N,sizeof(point_t *));
     assert(NULL != points.stage[1]);
-    points.stage[2] = calloc(points.N,sizeof(aligned_t *));
+    points.stage[2] = calloc(points.N,sizeof(point_t *));
     assert(NULL != points.stage[2]);
 
     for (int i = 0; i < points.N; i++) {
-        points.stage[0][i] = calloc(points.M, sizeof(aligned_t));
+        points.stage[0][i] = calloc(points.M, sizeof(point_t));
         assert(NULL != points.stage[0][i]);
-        points.stage[1][i] = calloc(points.M, sizeof(aligned_t));
+        points.stage[1][i] = calloc(points.M, sizeof(point_t));
         assert(NULL != points.stage[1][i]);
-        points.stage[2][i] = calloc(points.M, sizeof(aligned_t));
+        points.stage[2][i] = calloc(points.M, sizeof(point_t));
         assert(NULL != points.stage[2][i]);
     }
     qtimer_stop(alloc_timer);
@@ -274,43 +293,43 @@ int main(int argc, char *argv[])
     qtimer_start(init_timer);
     for (int i = 1; i < points.N-1; i++) {
         for (int j = 1; j < points.M-1; j++) {
-            qthread_writeF_const(&points.stage[0][i][j], 0);
-            qthread_empty(&points.stage[1][i][j]);
-            qthread_empty(&points.stage[2][i][j]);
+            WRITEF_CONST(&points.stage[0][i][j], 0);
+            EMPTY(&points.stage[1][i][j]);
+            EMPTY(&points.stage[2][i][j]);
         }
     }
     for (int i = 0; i < points.N; i++) {
 #ifdef BOUNDARY_SYNC
-        qthread_writeF_const(&points.stage[0][i][0], BOUNDARY);
-        qthread_writeF_const(&points.stage[0][i][points.M-1], BOUNDARY);
-        qthread_writeF_const(&points.stage[1][i][0], BOUNDARY);
-        qthread_writeF_const(&points.stage[1][i][points.M-1], BOUNDARY);
-        qthread_writeF_const(&points.stage[2][i][0], BOUNDARY);
-        qthread_writeF_const(&points.stage[2][i][points.M-1], BOUNDARY);
+        WRITEF_CONST(&points.stage[0][i][0], BOUNDARY);
+        WRITEF_CONST(&points.stage[0][i][points.M-1], BOUNDARY);
+        WRITEF_CONST(&points.stage[1][i][0], BOUNDARY);
+        WRITEF_CONST(&points.stage[1][i][points.M-1], BOUNDARY);
+        WRITEF_CONST(&points.stage[2][i][0], BOUNDARY);
+        WRITEF_CONST(&points.stage[2][i][points.M-1], BOUNDARY);
 #else
-        points.stage[0][i][0] =BOUNDARY;
-        points.stage[0][i][points.M-1] = BOUNDARY;
-        points.stage[1][i][0] = BOUNDARY;
-        points.stage[1][i][points.M-1] = BOUNDARY;
-        points.stage[2][i][0] = BOUNDARY;
-        points.stage[2][i][points.M-1] = BOUNDARY;
+        VALUE(&points.stage[0][i][0]) = BOUNDARY;
+        VALUE(&points.stage[0][i][points.M-1]) = BOUNDARY;
+        VALUE(&points.stage[1][i][0]) = BOUNDARY;
+        VALUE(&points.stage[1][i][points.M-1]) = BOUNDARY;
+        VALUE(&points.stage[2][i][0]) = BOUNDARY;
+        VALUE(&points.stage[2][i][points.M-1]) = BOUNDARY;
 #endif // BOUNDARY_SYNC
     }
     for (int j = 0; j < points.M; j++) {
 #ifdef BOUNDARY_SYNC
-        qthread_writeF_const(&points.stage[0][0][j], BOUNDARY);
-        qthread_writeF_const(&points.stage[0][points.N-1][j], BOUNDARY);
-        qthread_writeF_const(&points.stage[1][0][j], BOUNDARY);
-        qthread_writeF_const(&points.stage[1][points.N-1][j], BOUNDARY);
-        qthread_writeF_const(&points.stage[2][0][j], BOUNDARY);
-        qthread_writeF_const(&points.stage[2][points.N-1][j], BOUNDARY);
+        WRITEF_CONST(&points.stage[0][0][j], BOUNDARY);
+        WRITEF_CONST(&points.stage[0][points.N-1][j], BOUNDARY);
+        WRITEF_CONST(&points.stage[1][0][j], BOUNDARY);
+        WRITEF_CONST(&points.stage[1][points.N-1][j], BOUNDARY);
+        WRITEF_CONST(&points.stage[2][0][j], BOUNDARY);
+        WRITEF_CONST(&points.stage[2][points.N-1][j], BOUNDARY);
 #else
-        points.stage[0][0][j] = BOUNDARY;
-        points.stage[0][points.N-1][j] = BOUNDARY;
-        points.stage[1][0][j] = BOUNDARY;
-        points.stage[1][points.N-1][j] = BOUNDARY;
-        points.stage[2][0][j] = BOUNDARY;
-        points.stage[2][points.N-1][j] = BOUNDARY;
+        VALUE(&points.stage[0][0][j]) = BOUNDARY;
+        VALUE(&points.stage[0][points.N-1][j]) = BOUNDARY;
+        VALUE(&points.stage[1][0][j]) = BOUNDARY;
+        VALUE(&points.stage[1][points.N-1][j]) = BOUNDARY;
+        VALUE(&points.stage[2][0][j]) = BOUNDARY;
+        VALUE(&points.stage[2][points.N-1][j]) = BOUNDARY;
 #endif // BOUNDARY_SYNC
     }
     qtimer_stop(init_timer);
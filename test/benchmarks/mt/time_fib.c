@@ -46,6 +46,8 @@ static aligned_t validation[] = {
     39088169  // 38
 };
 
+static aligned_t lazy = 0;
+
 static aligned_t fib(void *arg_)
 {
     unsigned int n = *(unsigned int*)arg_;
@@ -59,9 +61,17 @@ static aligned_t fib(void *arg_)
     unsigned int n1 = n - 1;
     unsigned int n2 = n - 2;
 
-    qthread_fork_syncvar(fib, &n1, &ret1);
-    qthread_fork_syncvar(fib, &n2, &ret2);
-    qthread_yield_near();
+    if (lazy) {
+        /* children not stolen by the time they are joined run on this stack */
+        qthread_spawn(fib, &n1, 0, &ret1, 0, NULL, NO_SHEPHERD,
+                      QTHREAD_SPAWN_RET_SYNCVAR_T | QTHREAD_SPAWN_LAZY);
+        qthread_spawn(fib, &n2, 0, &ret2, 0, NULL, NO_SHEPHERD,
+                      QTHREAD_SPAWN_RET_SYNCVAR_T | QTHREAD_SPAWN_LAZY);
+    } else {
+        qthread_fork_syncvar(fib, &n1, &ret1);
+        qthread_fork_syncvar(fib, &n2, &ret2);
+        qthread_yield_near();
+    }
 
     qthread_syncvar_readFF(NULL, &ret1);
     qthread_syncvar_readFF(NULL, &ret2);
@@ -80,6 +90,7 @@ int main(int   argc,
     assert(qthread_initialize() == QTHREAD_SUCCESS);
     CHECK_VERBOSE();
     NUMARG(n, "FIB_INPUT");
+    NUMARG(lazy, "FIB_LAZY");
 
     qtimer_start(timer);
     qthread_fork(fib, &n, &ret);
@@ -26,6 +26,7 @@ int main(int   argc,
 {
     uint64_t count    = 1048576;
     int      par_fork = 0;
+    int      simple   = 0;
 
     qtimer_t timer;
     double   total_time = 0.0;
@@ -34,6 +35,7 @@ int main(int   argc,
 
     NUMARG(count, "MT_COUNT");
     NUMARG(par_fork, "MT_PAR_FORK");
+    NUMARG(simple, "MT_SIMPLE");
     assert(0 != count);
 
     assert(qthread_initialize() == 0);
@@ -47,7 +49,15 @@ int main(int   argc,
     } else {
         qtimer_start(timer);
 
-        for (uint64_t i = 0; i < count; i++) qthread_fork(null_task, NULL, NULL);
+        if (simple) {
+            /* simple tasks run on their worker's stack */
+            for (uint64_t i = 0; i < count; i++) {
+                qthread_spawn(null_task, NULL, 0, NULL, 0, NULL,
+                              NO_SHEPHERD, QTHREAD_SPAWN_SIMPLE);
+            }
+        } else {
+            for (uint64_t i = 0; i < count; i++) qthread_fork(null_task, NULL, NULL);
+        }
         do {
             qthread_yield();
         } while (donecount != count);
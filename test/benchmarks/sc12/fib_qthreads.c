@@ -49,6 +49,8 @@ static aligned_t validation[] = {
     39088169  // 38
 };
 
+static aligned_t lazy = 0;
+
 static aligned_t fib(void *arg_)
 {
     unsigned int n = *(unsigned int*)arg_;
@@ -62,8 +64,14 @@ static aligned_t fib(void *arg_)
     unsigned int n1 = n - 1;
     unsigned int n2 = n - 2;
 
-    qthread_fork(fib, &n1, &ret1);
-    qthread_fork(fib, &n2, &ret2);
+    if (lazy) {
+        /* children not stolen by the time they are joined run on this stack */
+        qthread_spawn(fib, &n1, 0, &ret1, 0, NULL, NO_SHEPHERD, QTHREAD_SPAWN_LAZY);
+        qthread_spawn(fib, &n2, 0, &ret2, 0, NULL, NO_SHEPHERD, QTHREAD_SPAWN_LAZY);
+    } else {
+        qthread_fork(fib, &n1, &ret1);
+        qthread_fork(fib, &n2, &ret2);
+    }
 
     qthread_readFF(NULL, &ret1);
     qthread_readFF(NULL, &ret2);
@@ -82,6 +90,7 @@ int main(int   argc,
     assert(qthread_initialize() == QTHREAD_SUCCESS);
     CHECK_VERBOSE();
     NUMARG(n, "FIB_INPUT");
+    NUMARG(lazy, "FIB_LAZY");
 
     qtimer_start(timer);
     qthread_fork(fib, &n, &ret);
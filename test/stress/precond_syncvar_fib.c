@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+
+#include "argparsing.h"
+
+/* precond_fib, with syncvar_t's in place of aligned_t's: each sum is a task
+ * that is only spawned for real once both of its inputs are full. */
+
+typedef struct {
+    aligned_t n;
+    syncvar_t result;
+} f_arg_t;
+
+typedef struct {
+    f_arg_t    fargs[2];
+    syncvar_t *target;
+} fr_arg_t;
+
+static aligned_t fib_result(void *arg)
+{
+    fr_arg_t *fibs = (fr_arg_t *)arg;
+    uint64_t  r0, r1;
+
+    /* both are full, so neither of these blocks */
+    qthread_syncvar_readFF(&r0, &fibs->fargs[0].result);
+    qthread_syncvar_readFF(&r1, &fibs->fargs[1].result);
+    qthread_syncvar_writeEF_const(fibs->target, r0 + r1);
+    free(arg);
+
+    return 0;
+}
+
+static aligned_t fib_(void *arg)
+{
+    aligned_t  n      = ((f_arg_t *)arg)->n;
+    syncvar_t *result = &((f_arg_t *)arg)->result;
+
+    if (n < 2) {
+        qthread_syncvar_writeEF_const(result, n);
+        return 0;
+    }
+
+    fr_arg_t   *fibs     = malloc(sizeof(fr_arg_t));
+    syncvar_t **preconds = malloc(3 * sizeof(syncvar_t *));
+    f_arg_t    *f1       = &fibs->fargs[0];
+    f_arg_t    *f2       = &fibs->fargs[1];
+
+    f1->n      = n - 1;
+    f2->n      = n - 2;
+    f1->result = SYNCVAR_EMPTY_INITIALIZER;
+    f2->result = SYNCVAR_EMPTY_INITIALIZER;
+
+    fibs->target = result;
+
+    // Collect results of sub-actions
+    preconds[0] = (syncvar_t *)(uintptr_t)2;
+    preconds[1] = &f1->result;
+    preconds[2] = &f2->result;
+    qthread_spawn(fib_result, fibs, 0, NULL, 2, preconds, NO_SHEPHERD,
+                  QTHREAD_SPAWN_PC_SYNCVAR_T);
+
+    // Fork off recursive actions
+    qthread_fork(fib_, f1, NULL);
+    qthread_fork(fib_, f2, NULL);
+
+    return 0;
+}
+
+inline static uint64_t fib(aligned_t value)
+{
+    f_arg_t  args = { value, SYNCVAR_EMPTY_INITIALIZER };
+    uint64_t ret;
+
+    qthread_fork(fib_, &args, NULL);
+    qthread_syncvar_readFF(&ret, &args.result);
+
+    return ret;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t n = 20;
+    uint64_t  r, expect[2] = { 0, 1 };
+    qtimer_t  timer;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    NUMARG(n, "FIB_INPUT");
+
+    timer = qtimer_create();
+    qtimer_start(timer);
+    r = fib(n);
+    qtimer_stop(timer);
+    iprintf("fib(%3lu) =            %lu\n", (unsigned long)n, (unsigned long)r);
+    iprintf("time:                  %f secs\n", qtimer_secs(timer));
+    qtimer_destroy(timer);
+
+    for (aligned_t i = 2; i <= n; i++) {
+        expect[i % 2] = expect[0] + expect[1];
+    }
+    iprintf("known correct answer: %lu\n", (unsigned long)expect[n % 2]);
+    assert(r == expect[n % 2]);
+
+    return 0;
+}
+
+/* vim:set expandtab */